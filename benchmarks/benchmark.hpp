@@ -0,0 +1,275 @@
+/*
+ * PoPS model - minimal benchmark runner
+ *
+ * Copyright (C) 2023 by the authors.
+ *
+ * Authors: Vaclav Petras <wenzeslaus gmail com>
+ *
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef POPS_BENCHMARK_HPP
+#define POPS_BENCHMARK_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace pops {
+namespace benchmark {
+
+/**
+ * One prepared benchmark
+ *
+ * The *run* function performs one iteration of the measured work and returns the
+ * number of items processed (e.g., number of kernel draws or number of cells). The
+ * optional *reset* function restores the state before each measured iteration and
+ * is not included in the time. Benchmarks with reset run one iteration per
+ * repetition because each iteration needs to start from the same state.
+ */
+struct Benchmark
+{
+    std::function<std::size_t()> run;
+    std::function<void()> reset;
+};
+
+/** Measured times of one benchmark (in nanoseconds per iteration) */
+struct Result
+{
+    std::string name;
+    std::string group;
+    std::size_t iterations{0};
+    std::size_t items{0};
+    std::vector<double> times;
+
+    double min_time() const
+    {
+        return *std::min_element(times.begin(), times.end());
+    }
+
+    double median_time() const
+    {
+        std::vector<double> sorted = times;
+        std::sort(sorted.begin(), sorted.end());
+        std::size_t middle = sorted.size() / 2;
+        if (sorted.size() % 2)
+            return sorted[middle];
+        return (sorted[middle - 1] + sorted[middle]) / 2;
+    }
+
+    double mean_time() const
+    {
+        double sum = 0;
+        for (double time : times)
+            sum += time;
+        return sum / times.size();
+    }
+
+    double stddev_time() const
+    {
+        if (times.size() < 2)
+            return 0;
+        double mean = mean_time();
+        double sum = 0;
+        for (double time : times)
+            sum += (time - mean) * (time - mean);
+        return std::sqrt(sum / (times.size() - 1));
+    }
+
+    /** Items per second based on the median time */
+    double items_per_second() const
+    {
+        return items / median_time() * 1e9;
+    }
+};
+
+/**
+ * Registry and runner of benchmarks
+ *
+ * Benchmarks are registered with a function which prepares the data (e.g., creates
+ * a landscape) and returns the Benchmark. The preparation runs only for benchmarks
+ * which are selected, and it is not included in the time.
+ */
+class Runner
+{
+public:
+    using Factory = std::function<Benchmark()>;
+
+    /** Register a benchmark in a group (micro or macro) */
+    void add(const std::string& name, const std::string& group, Factory factory)
+    {
+        entries_.push_back({name, group, std::move(factory)});
+    }
+
+    /** Get names of benchmarks which contain *filter* */
+    std::vector<std::string> names(const std::string& filter = "") const
+    {
+        std::vector<std::string> selected;
+        for (const auto& entry : entries_) {
+            if (matches(entry, filter))
+                selected.push_back(entry.name);
+        }
+        return selected;
+    }
+
+    /**
+     * @brief Run benchmarks which contain *filter* in their name or group
+     *
+     * @param filter Text to look for in name or group (empty for all)
+     * @param repetitions Number of measurements for each benchmark
+     * @param min_time Minimal time of one measurement in seconds (when there is no
+     * reset)
+     * @param progress Stream for progress messages
+     */
+    std::vector<Result> run(
+        const std::string& filter,
+        unsigned repetitions,
+        double min_time,
+        std::ostream& progress) const
+    {
+        std::vector<Result> results;
+        for (const auto& entry : entries_) {
+            if (!matches(entry, filter))
+                continue;
+            Benchmark benchmark = entry.factory();
+            Result result;
+            result.name = entry.name;
+            result.group = entry.group;
+            result.iterations =
+                benchmark.reset ? 1 : calibrate(benchmark, min_time, result.items);
+            for (unsigned i = 0; i < repetitions; ++i) {
+                if (benchmark.reset)
+                    benchmark.reset();
+                auto start = Clock::now();
+                std::size_t items = 0;
+                for (std::size_t k = 0; k < result.iterations; ++k)
+                    items += benchmark.run();
+                auto end = Clock::now();
+                result.items = items / result.iterations;
+                result.times.push_back(
+                    std::chrono::duration<double, std::nano>(end - start).count()
+                    / result.iterations);
+            }
+            progress << std::left << std::setw(40) << result.name << std::right
+                     << std::setw(14) << std::fixed << std::setprecision(0)
+                     << result.median_time() << " ns" << std::setw(14)
+                     << std::setprecision(3) << result.items_per_second() / 1e6
+                     << " M items/s\n";
+            results.push_back(std::move(result));
+        }
+        return results;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry
+    {
+        std::string name;
+        std::string group;
+        Factory factory;
+    };
+
+    static bool matches(const Entry& entry, const std::string& filter)
+    {
+        return entry.name.find(filter) != std::string::npos
+               || entry.group.find(filter) != std::string::npos;
+    }
+
+    /** Find number of iterations which takes at least *min_time* seconds */
+    static std::size_t
+    calibrate(const Benchmark& benchmark, double min_time, std::size_t& items)
+    {
+        std::size_t iterations = 1;
+        while (true) {
+            auto start = Clock::now();
+            for (std::size_t k = 0; k < iterations; ++k)
+                items = benchmark.run();
+            double elapsed =
+                std::chrono::duration<double>(Clock::now() - start).count();
+            if (elapsed >= min_time || iterations >= (std::size_t(1) << 30))
+                return iterations;
+            // Aim slightly above the minimal time, but grow at most tenfold.
+            double factor = elapsed > 0 ? 1.2 * min_time / elapsed : 10;
+            iterations = static_cast<std::size_t>(
+                std::ceil(iterations * std::min(std::max(factor, 1.5), 10.0)));
+        }
+    }
+
+    std::vector<Entry> entries_;
+};
+
+/** Escape text for a JSON string */
+inline std::string json_string(const std::string& text)
+{
+    std::ostringstream stream;
+    stream << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            stream << '\\' << c;
+        else if (static_cast<unsigned char>(c) < 0x20)
+            stream << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                   << int(c) << std::dec << std::setfill(' ');
+        else
+            stream << c;
+    }
+    stream << '"';
+    return stream.str();
+}
+
+/**
+ * Write results as JSON
+ *
+ * The context is a list of key-value pairs with already formatted JSON values.
+ */
+inline void write_json(
+    std::ostream& stream,
+    const std::vector<std::pair<std::string, std::string>>& context,
+    const std::vector<Result>& results)
+{
+    stream << "{\n  \"context\": {";
+    for (std::size_t i = 0; i < context.size(); ++i) {
+        stream << (i ? ",\n    " : "\n    ") << json_string(context[i].first) << ": "
+               << context[i].second;
+    }
+    stream << "\n  },\n  \"benchmarks\": [";
+    stream << std::setprecision(12);
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        stream << (i ? ",\n    {" : "\n    {")
+               << "\n      \"name\": " << json_string(result.name)
+               << ",\n      \"group\": " << json_string(result.group)
+               << ",\n      \"iterations\": " << result.iterations
+               << ",\n      \"repetitions\": " << result.times.size()
+               << ",\n      \"items_per_iteration\": " << result.items
+               << ",\n      \"time_unit\": \"ns\""
+               << ",\n      \"min_time\": " << result.min_time()
+               << ",\n      \"median_time\": " << result.median_time()
+               << ",\n      \"mean_time\": " << result.mean_time()
+               << ",\n      \"stddev_time\": " << result.stddev_time()
+               << ",\n      \"items_per_second\": " << result.items_per_second()
+               << ",\n      \"times\": [";
+        for (std::size_t k = 0; k < result.times.size(); ++k)
+            stream << (k ? ", " : "") << result.times[k];
+        stream << "]\n    }";
+    }
+    stream << "\n  ]\n}\n";
+}
+
+}  // namespace benchmark
+}  // namespace pops
+
+#endif  // POPS_BENCHMARK_HPP
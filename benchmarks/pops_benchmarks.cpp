@@ -0,0 +1,777 @@
+/*
+ * PoPS model - benchmarks of the core hot paths
+ *
+ * Copyright (C) 2023 by the authors.
+ *
+ * Authors: Vaclav Petras <wenzeslaus gmail com>
+ *
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/*
+ * Micro benchmarks measure single components (kernels, host pool, spread action,
+ * network) and macro benchmarks measure model steps. All data are synthetic and
+ * generated from a fixed seed, so the same work is measured in each run.
+ *
+ * Usage:
+ *
+ *     pops_benchmarks [--filter TEXT] [--repetitions N] [--min-time SECONDS]
+ *                     [--output FILE] [--list]
+ *
+ * Results are written as JSON to the standard output or to a file. A summary is
+ * printed to the standard error.
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <pops/deterministic_kernel.hpp>
+#include <pops/model.hpp>
+#include <pops/neighbor_kernel.hpp>
+#include <pops/network.hpp>
+#include <pops/network_kernel.hpp>
+#include <pops/radial_kernel.hpp>
+#include <pops/raster.hpp>
+#include <pops/uniform_kernel.hpp>
+
+#include "benchmark.hpp"
+
+using namespace pops;
+using benchmark::Benchmark;
+using benchmark::Runner;
+
+using BenchmarkModel = Model<Raster<int>, Raster<double>, Raster<double>::IndexType>;
+using BenchmarkHostPool = BenchmarkModel::StandardSingleHostPool;
+using BenchmarkMultiHostPool = BenchmarkModel::StandardMultiHostPool;
+using BenchmarkPestPool = BenchmarkModel::StandardPestPool;
+using GeneratorProvider = RandomNumberGeneratorProvider<std::default_random_engine>;
+
+/** Seed for the synthetic data and for the simulations */
+const unsigned benchmark_seed = 42;
+
+/** Sum of results, so that the compiler keeps the measured code */
+volatile long long sink = 0;
+
+/**
+ * Synthetic landscape
+ *
+ * Each cell has hosts with probability given by density. A small part of cells with
+ * hosts has infected hosts.
+ */
+struct Landscape
+{
+    Raster<int> total_hosts;
+    Raster<int> infected;
+    Raster<int> susceptible;
+    Raster<int> total_populations;
+    std::vector<std::vector<int>> suitable_cells;
+};
+
+Landscape create_landscape(int size, double density, unsigned seed = benchmark_seed)
+{
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::uniform_int_distribution<int> hosts(20, 100);
+    Landscape landscape;
+    landscape.total_hosts = Raster<int>(size, size, 0);
+    landscape.infected = Raster<int>(size, size, 0);
+    for (int row = 0; row < size; ++row) {
+        for (int col = 0; col < size; ++col) {
+            if (uniform(generator) >= density)
+                continue;
+            landscape.total_hosts(row, col) = hosts(generator);
+            if (uniform(generator) < 0.05)
+                landscape.infected(row, col) = landscape.total_hosts(row, col) / 10 + 1;
+        }
+    }
+    landscape.susceptible = landscape.total_hosts - landscape.infected;
+    landscape.total_populations = landscape.total_hosts + 50;
+    landscape.suitable_cells =
+        find_suitable_cells<int, Raster<int>>(landscape.total_hosts);
+    return landscape;
+}
+
+/** Configuration used by host pools and models */
+Config create_config(int size, const std::string& model_type = "SI")
+{
+    Config config;
+    config.model_type = model_type;
+    config.latency_period_steps = model_type == "SEI" ? 2 : 0;
+    config.reproductive_rate = 4;
+    config.natural_kernel_type = "cauchy";
+    config.natural_direction = "none";
+    config.natural_scale = 30;
+    config.anthro_scale = 30;
+    config.use_anthropogenic_kernel = false;
+    config.random_seed = static_cast<int>(benchmark_seed);
+    config.rows = size;
+    config.cols = size;
+    config.ew_res = 30;
+    config.ns_res = 30;
+    config.set_date_start(2020, 1, 1);
+    config.set_date_end(2020, 12, 31);
+    config.set_step_unit(StepUnit::Month);
+    config.set_step_num_units(1);
+    config.use_spreadrates = false;
+    config.create_schedules();
+    return config;
+}
+
+/** Register a benchmark of a kernel drawing many dispersers from the same cell */
+template<typename Kernel>
+void add_kernel_benchmark(
+    Runner& runner, const std::string& name, std::function<Kernel()> create)
+{
+    runner.add("kernel/" + name, "micro", [create]() {
+        auto kernel = std::make_shared<Kernel>(create());
+        auto generator = std::make_shared<std::default_random_engine>(benchmark_seed);
+        Benchmark benchmark;
+        benchmark.run = [kernel, generator]() {
+            const std::size_t draws = 100000;
+            int row;
+            int col;
+            for (std::size_t i = 0; i < draws; ++i) {
+                std::tie(row, col) = (*kernel)(*generator, 500, 500);
+                sink += static_cast<long long>(row) + col;
+            }
+            return draws;
+        };
+        return benchmark;
+    });
+}
+
+void add_kernel_benchmarks(Runner& runner)
+{
+    std::vector<std::string> radial_types = {
+        "cauchy",
+        "exponential",
+        "weibull",
+        "normal",
+        "log-normal",
+        "power-law",
+        "hyperbolic-secant",
+        "gamma",
+        "exponential-power",
+        "logistic"};
+    for (const auto& type : radial_types) {
+        // Log-normal and power law with the same scale (alpha for power law) give
+        // distances beyond the integer range.
+        double scale = 5;
+        if (type == "log-normal")
+            scale = 1;
+        else if (type == "power-law")
+            scale = 1.5;
+        add_kernel_benchmark<RadialDispersalKernel<Raster<int>>>(
+            runner, type, [type, scale]() {
+                return RadialDispersalKernel<Raster<int>>(
+                    1,
+                    1,
+                    kernel_type_from_string(type),
+                    scale,
+                    Direction::None,
+                    0,
+                    1.5);
+            });
+    }
+    add_kernel_benchmark<RadialDispersalKernel<Raster<int>>>(
+        runner, "cauchy-directional", []() {
+            return RadialDispersalKernel<Raster<int>>(
+                1, 1, DispersalKernelType::Cauchy, 5, Direction::NE, 2, 1.5);
+        });
+    add_kernel_benchmark<UniformDispersalKernel>(runner, "uniform", []() {
+        return UniformDispersalKernel(999, 999);
+    });
+    add_kernel_benchmark<DeterministicNeighborDispersalKernel>(
+        runner, "deterministic-neighbor", []() {
+            return DeterministicNeighborDispersalKernel(Direction::E);
+        });
+    // The deterministic kernel gives different results for each disperser in a cell,
+    // so it is measured over many cells.
+    for (std::string type : {"cauchy", "exponential"}) {
+        runner.add("kernel/deterministic-" + type, "micro", [type]() {
+            const int size = 40;
+            const int dispersers_per_cell = 10;
+            auto dispersers =
+                std::make_shared<Raster<int>>(size, size, dispersers_per_cell);
+            auto kernel = std::make_shared<DeterministicDispersalKernel<Raster<int>>>(
+                kernel_type_from_string(type), *dispersers, 0.9, 1, 1, 1.5);
+            auto generator = std::make_shared<std::default_random_engine>();
+            Benchmark benchmark;
+            benchmark.run = [dispersers, kernel, generator]() {
+                int row;
+                int col;
+                for (int i = 0; i < size; ++i) {
+                    for (int j = 0; j < size; ++j) {
+                        for (int k = 0; k < dispersers_per_cell; ++k) {
+                            std::tie(row, col) = (*kernel)(*generator, i, j);
+                            sink += static_cast<long long>(row) + col;
+                        }
+                    }
+                }
+                return std::size_t(size) * size * dispersers_per_cell;
+            };
+            return benchmark;
+        });
+    }
+}
+
+/**
+ * State of a single host simulation with a copy of the initial state
+ *
+ * The host pool refers to the rasters, so the rasters are reset by assignment.
+ */
+struct HostState
+{
+    HostState(const Landscape& landscape, const Config& config)
+        : initial(landscape),
+          current(landscape),
+          exposed(
+              config.latency_period_steps ? config.latency_period_steps + 1 : 0,
+              Raster<int>(config.rows, config.cols, 0)),
+          total_exposed(config.rows, config.cols, 0),
+          resistant(config.rows, config.cols, 0),
+          died(config.rows, config.cols, 0),
+          dispersers(config.rows, config.cols, 0),
+          established_dispersers(config.rows, config.cols, 0),
+          zeros(config.rows, config.cols, 0)
+    {}
+
+    void reset()
+    {
+        current.infected = initial.infected;
+        current.susceptible = initial.susceptible;
+        current.total_hosts = initial.total_hosts;
+        current.total_populations = initial.total_populations;
+        current.suitable_cells = initial.suitable_cells;
+        for (auto& raster : exposed)
+            raster.fill(0);
+        total_exposed.fill(0);
+        resistant.fill(0);
+        died.fill(0);
+        outside_dispersers.clear();
+    }
+
+    Landscape initial;
+    Landscape current;
+    std::vector<Raster<int>> exposed;
+    std::vector<Raster<int>> mortality_tracker;
+    Raster<int> total_exposed;
+    Raster<int> resistant;
+    Raster<int> died;
+    Raster<int> dispersers;
+    Raster<int> established_dispersers;
+    Raster<int> zeros;
+    std::vector<std::tuple<int, int>> outside_dispersers;
+};
+
+/** Host pool with its own data and environment */
+struct HostPoolFixture
+{
+    HostPoolFixture(int size, double density)
+        : config(create_config(size)),
+          state(create_landscape(size, density), config),
+          host_pool(
+              config,
+              state.current.susceptible,
+              state.exposed,
+              state.current.infected,
+              state.total_exposed,
+              state.resistant,
+              state.mortality_tracker,
+              state.died,
+              state.current.total_hosts,
+              environment,
+              state.current.suitable_cells),
+          generator(benchmark_seed)
+    {}
+
+    Config config;
+    HostState state;
+    Environment<Raster<int>, Raster<double>, int, GeneratorProvider> environment;
+    BenchmarkHostPool host_pool;
+    std::default_random_engine generator;
+};
+
+void add_host_pool_benchmarks(Runner& runner)
+{
+    runner.add("host_pool/dispersers_from", "micro", []() {
+        auto fixture = std::make_shared<HostPoolFixture>(300, 1);
+        Benchmark benchmark;
+        benchmark.run = [fixture]() {
+            for (const auto& cell : fixture->state.current.suitable_cells)
+                sink += fixture->host_pool.dispersers_from(
+                    cell[0], cell[1], fixture->generator);
+            return fixture->state.current.suitable_cells.size();
+        };
+        return benchmark;
+    });
+    runner.add("host_pool/disperser_to", "micro", []() {
+        auto fixture = std::make_shared<HostPoolFixture>(300, 1);
+        Benchmark benchmark;
+        benchmark.reset = [fixture]() { fixture->state.reset(); };
+        benchmark.run = [fixture]() {
+            const std::size_t landings = 200000;
+            std::uniform_int_distribution<int> cell(0, fixture->config.rows - 1);
+            for (std::size_t i = 0; i < landings; ++i) {
+                int row = cell(fixture->generator);
+                int col = cell(fixture->generator);
+                sink += fixture->host_pool.disperser_to(row, col, fixture->generator);
+            }
+            return landings;
+        };
+        return benchmark;
+    });
+}
+
+/** Spread action with a radial kernel over a host pool */
+struct SpreadFixture
+{
+    using Kernel = RadialDispersalKernel<Raster<int>>;
+    using Spread = SpreadAction<
+        BenchmarkMultiHostPool,
+        BenchmarkPestPool,
+        Raster<int>,
+        Raster<double>,
+        int,
+        Kernel,
+        GeneratorProvider>;
+
+    SpreadFixture(int size, double density)
+        : hosts(size, density),
+          host_pools{&hosts.host_pool},
+          multi_host_pool(host_pools, hosts.config),
+          pest_pool(
+              hosts.state.dispersers,
+              hosts.state.established_dispersers,
+              hosts.state.outside_dispersers),
+          kernel(
+              hosts.config.ew_res,
+              hosts.config.ns_res,
+              DispersalKernelType::Cauchy,
+              hosts.config.natural_scale),
+          spread(kernel),
+          generator(benchmark_seed)
+    {}
+
+    HostPoolFixture hosts;
+    std::vector<BenchmarkHostPool*> host_pools;
+    BenchmarkMultiHostPool multi_host_pool;
+    BenchmarkPestPool pest_pool;
+    Kernel kernel;
+    Spread spread;
+    GeneratorProvider generator;
+};
+
+void add_spread_benchmarks(Runner& runner)
+{
+    for (int size : {200, 600}) {
+        for (double density : {1.0, 0.1}) {
+            std::string name = "spread/" + std::to_string(size) + "/"
+                               + (density < 1 ? "sparse" : "dense");
+            runner.add(name, "micro", [size, density]() {
+                auto fixture = std::make_shared<SpreadFixture>(size, density);
+                Benchmark benchmark;
+                benchmark.reset = [fixture]() {
+                    fixture->hosts.state.reset();
+                    fixture->generator.seed(benchmark_seed);
+                };
+                benchmark.run = [fixture]() {
+                    fixture->spread.action(
+                        fixture->multi_host_pool,
+                        fixture->pest_pool,
+                        fixture->generator);
+                    return fixture->hosts.state.current.suitable_cells.size();
+                };
+                return benchmark;
+            });
+        }
+    }
+}
+
+/**
+ * Network of streets in a regular grid
+ *
+ * Nodes are in the center of every *spacing*-th cell and each node is connected
+ * to its neighbors in rows and columns by a segment going through each cell.
+ */
+struct NetworkData
+{
+    int size;
+    BBox<double> bbox;
+    std::string text;
+    std::vector<std::tuple<int, int>> node_cells;
+};
+
+NetworkData create_network_data(int size, int spacing)
+{
+    NetworkData data;
+    data.size = size;
+    data.bbox.north = size;
+    data.bbox.south = 0;
+    data.bbox.east = size;
+    data.bbox.west = 0;
+    int nodes_per_side = size / spacing;
+    auto node_id = [nodes_per_side](int i, int j) {
+        return i * nodes_per_side + j + 1;
+    };
+    // Coordinates of the center of a cell
+    auto x = [](int col) { return col + 0.5; };
+    auto y = [size](int row) { return size - row - 0.5; };
+    std::ostringstream stream;
+    for (int i = 0; i < nodes_per_side; ++i) {
+        for (int j = 0; j < nodes_per_side; ++j) {
+            int row = i * spacing;
+            int col = j * spacing;
+            data.node_cells.emplace_back(row, col);
+            if (j + 1 < nodes_per_side) {
+                stream << node_id(i, j) << "," << node_id(i, j + 1);
+                for (int k = 0; k <= spacing; ++k)
+                    stream << (k ? ";" : ",") << x(col + k) << ";" << y(row);
+                stream << "\n";
+            }
+            if (i + 1 < nodes_per_side) {
+                stream << node_id(i, j) << "," << node_id(i + 1, j);
+                for (int k = 0; k <= spacing; ++k)
+                    stream << (k ? ";" : ",") << x(col) << ";" << y(row + k);
+                stream << "\n";
+            }
+        }
+    }
+    data.text = stream.str();
+    return data;
+}
+
+void add_network_benchmarks(Runner& runner)
+{
+    const int size = 500;
+    const int spacing = 5;
+    runner.add("network/load", "micro", []() {
+        auto data = std::make_shared<NetworkData>(create_network_data(size, spacing));
+        Benchmark benchmark;
+        benchmark.run = [data]() {
+            Network<int> network(data->bbox, 1, 1);
+            std::istringstream stream(data->text);
+            network.load(stream);
+            sink += network.has_node_at(0, 0);
+            return data->node_cells.size();
+        };
+        return benchmark;
+    });
+    // Walk and teleport start at randomly picked nodes.
+    auto add_trips = [&runner](const std::string& name, int teleport_steps) {
+        runner.add("network/" + name, "micro", [teleport_steps]() {
+            auto data =
+                std::make_shared<NetworkData>(create_network_data(size, spacing));
+            auto network = std::make_shared<Network<int>>(data->bbox, 1, 1);
+            std::istringstream stream(data->text);
+            network->load(stream);
+            if (teleport_steps > 1)
+                network->precompute_teleport_steps(teleport_steps);
+            auto generator =
+                std::make_shared<std::default_random_engine>(benchmark_seed);
+            Benchmark benchmark;
+            benchmark.run = [data, network, generator, teleport_steps]() {
+                const std::size_t trips = 20000;
+                std::uniform_int_distribution<std::size_t> pick(
+                    0, data->node_cells.size() - 1);
+                int row;
+                int col;
+                for (std::size_t i = 0; i < trips; ++i) {
+                    std::tie(row, col) = data->node_cells[pick(*generator)];
+                    if (teleport_steps)
+                        std::tie(row, col) =
+                            network->teleport(row, col, *generator, teleport_steps);
+                    else
+                        std::tie(row, col) = network->walk(row, col, 50, *generator);
+                    sink += static_cast<long long>(row) + col;
+                }
+                return trips;
+            };
+            return benchmark;
+        });
+    };
+    add_trips("walk", 0);
+    add_trips("teleport", 1);
+    add_trips("teleport-3-steps", 3);
+}
+
+/** Run steps of a single host model */
+Benchmark single_host_model_benchmark(
+    int size, double density, const std::string& model_type, int tile_size = 0)
+{
+    Config config = create_config(size, model_type);
+    config.spread_tile_size = tile_size;
+    config.spread_threads = 1;
+    auto state = std::make_shared<HostState>(create_landscape(size, density), config);
+    auto model = std::make_shared<std::unique_ptr<BenchmarkModel>>();
+    const int steps = 3;
+    Benchmark benchmark;
+    benchmark.reset = [state, model, config]() {
+        state->reset();
+        model->reset(new BenchmarkModel(config));
+    };
+    benchmark.run = [state, model]() {
+        std::vector<Raster<double>> no_rasters;
+        std::vector<std::vector<int>> movements;
+        QuarantineEscapeAction<Raster<int>> quarantine(state->zeros, 30, 30, 0);
+        for (int step = 0; step < steps; ++step) {
+            (*model)->run_step(
+                step,
+                state->current.infected,
+                state->current.susceptible,
+                state->current.total_populations,
+                state->current.total_hosts,
+                state->dispersers,
+                state->established_dispersers,
+                state->total_exposed,
+                state->exposed,
+                state->mortality_tracker,
+                state->died,
+                no_rasters,
+                no_rasters,
+                state->resistant,
+                state->outside_dispersers,
+                quarantine,
+                state->zeros,
+                movements,
+                Network<int>::null_network(),
+                state->current.suitable_cells);
+        }
+        return steps * state->current.suitable_cells.size();
+    };
+    return benchmark;
+}
+
+/** Model with two host species sharing the landscape */
+struct MultiHostFixture
+{
+    explicit MultiHostFixture(int size)
+        : config(create_config(size)),
+          first(create_landscape(size, 0.7, benchmark_seed), config),
+          second(create_landscape(size, 0.7, benchmark_seed + 1), config),
+          total_populations(first.initial.total_hosts + second.initial.total_hosts)
+    {
+        suitable_cells = find_suitable_cells<int, Raster<int>>(
+            {&first.initial.total_hosts, &second.initial.total_hosts});
+    }
+
+    Config config;
+    HostState first;
+    HostState second;
+    Raster<int> total_populations;
+    std::vector<std::vector<int>> suitable_cells;
+};
+
+Benchmark multi_host_model_benchmark(int size)
+{
+    auto fixture = std::make_shared<MultiHostFixture>(size);
+    const int steps = 3;
+    Benchmark benchmark;
+    benchmark.reset = [fixture]() {
+        fixture->first.reset();
+        fixture->second.reset();
+    };
+    benchmark.run = [fixture]() {
+        const Config& config = fixture->config;
+        BenchmarkModel model(config);
+        HostState& first = fixture->first;
+        HostState& second = fixture->second;
+        BenchmarkHostPool host_pool_1(
+            config,
+            first.current.susceptible,
+            first.exposed,
+            first.current.infected,
+            first.total_exposed,
+            first.resistant,
+            first.mortality_tracker,
+            first.died,
+            first.current.total_hosts,
+            model.environment(),
+            fixture->suitable_cells);
+        BenchmarkHostPool host_pool_2(
+            config,
+            second.current.susceptible,
+            second.exposed,
+            second.current.infected,
+            second.total_exposed,
+            second.resistant,
+            second.mortality_tracker,
+            second.died,
+            second.current.total_hosts,
+            model.environment(),
+            fixture->suitable_cells);
+        std::vector<BenchmarkHostPool*> host_pools = {&host_pool_1, &host_pool_2};
+        BenchmarkMultiHostPool multi_host_pool(host_pools, config);
+        BenchmarkPestPool pest_pool(
+            first.dispersers, first.established_dispersers, first.outside_dispersers);
+        Treatments<BenchmarkHostPool, Raster<double>> treatments(config.scheduler());
+        SpreadRateAction<BenchmarkMultiHostPool, int> spread_rate(
+            multi_host_pool, config.rows, config.cols, config.ew_res, config.ns_res, 0);
+        QuarantineEscapeAction<Raster<int>> quarantine(
+            first.zeros, config.ew_res, config.ns_res, 0);
+        Raster<int> total_populations = fixture->total_populations;
+        std::vector<Raster<double>> no_rasters;
+        std::vector<std::vector<int>> movements;
+        for (int step = 0; step < steps; ++step) {
+            model.run_step(
+                step,
+                multi_host_pool,
+                pest_pool,
+                total_populations,
+                treatments,
+                no_rasters,
+                no_rasters,
+                spread_rate,
+                quarantine,
+                first.zeros,
+                movements,
+                Network<int>::null_network());
+        }
+        return steps * fixture->suitable_cells.size();
+    };
+    return benchmark;
+}
+
+void add_model_benchmarks(Runner& runner)
+{
+    runner.add("model/SI/200", "macro", []() {
+        return single_host_model_benchmark(200, 1, "SI");
+    });
+    runner.add("model/SI/600", "macro", []() {
+        return single_host_model_benchmark(600, 1, "SI");
+    });
+    runner.add("model/SI/600/sparse", "macro", []() {
+        return single_host_model_benchmark(600, 0.1, "SI");
+    });
+    runner.add("model/SI/600/tiled", "macro", []() {
+        return single_host_model_benchmark(600, 1, "SI", 64);
+    });
+    runner.add("model/SEI/200", "macro", []() {
+        return single_host_model_benchmark(200, 1, "SEI");
+    });
+    runner.add("model/SEI/600", "macro", []() {
+        return single_host_model_benchmark(600, 1, "SEI");
+    });
+    runner.add("model/multi-host/200", "macro", []() {
+        return multi_host_model_benchmark(200);
+    });
+    runner.add("model/multi-host/400", "macro", []() {
+        return multi_host_model_benchmark(400);
+    });
+}
+
+void print_usage(std::ostream& stream, const char* program)
+{
+    stream << "Usage: " << program
+           << " [--filter TEXT] [--repetitions N] [--min-time SECONDS]"
+              " [--output FILE] [--list]\n";
+}
+
+std::string compiler_name()
+{
+#if defined(__clang__)
+    return std::string("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+    return std::string("gcc ") + __VERSION__;
+#elif defined(_MSC_VER)
+    return "msvc " + std::to_string(_MSC_VER);
+#else
+    return "unknown";
+#endif
+}
+
+int main(int argc, char** argv)
+{
+    std::string filter;
+    unsigned repetitions = 5;
+    double min_time = 0.2;
+    std::string output;
+    bool list = false;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool has_value = i + 1 < argc;
+            if (arg == "--filter" && has_value)
+                filter = argv[++i];
+            else if (arg == "--repetitions" && has_value)
+                repetitions = static_cast<unsigned>(std::stoul(argv[++i]));
+            else if (arg == "--min-time" && has_value)
+                min_time = std::stod(argv[++i]);
+            else if (arg == "--output" && has_value)
+                output = argv[++i];
+            else if (arg == "--list")
+                list = true;
+            else if (arg == "--help" || arg == "-h") {
+                print_usage(std::cout, argv[0]);
+                return EXIT_SUCCESS;
+            }
+            else
+                throw std::invalid_argument("Unknown or incomplete option: " + arg);
+        }
+        if (!repetitions)
+            throw std::invalid_argument("Number of repetitions must be at least one");
+    }
+    catch (const std::exception& error) {
+        std::cerr << error.what() << "\n";
+        print_usage(std::cerr, argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    Runner runner;
+    add_kernel_benchmarks(runner);
+    add_host_pool_benchmarks(runner);
+    add_spread_benchmarks(runner);
+    add_network_benchmarks(runner);
+    add_model_benchmarks(runner);
+
+    if (list) {
+        for (const auto& name : runner.names(filter))
+            std::cout << name << "\n";
+        return EXIT_SUCCESS;
+    }
+
+    auto results = runner.run(filter, repetitions, min_time, std::cerr);
+
+    std::vector<std::pair<std::string, std::string>> context = {
+        {"library", benchmark::json_string("pops-core")},
+#ifdef POPS_VERSION
+        {"library_version", benchmark::json_string(POPS_VERSION)},
+#endif
+        {"compiler", benchmark::json_string(compiler_name())},
+#ifdef __OPTIMIZE__
+        {"optimized", "true"},
+#else
+        {"optimized", "false"},
+#endif
+        {"seed", std::to_string(benchmark_seed)},
+        {"repetitions", std::to_string(repetitions)},
+        {"min_time", std::to_string(min_time)},
+        {"filter", benchmark::json_string(filter)},
+        {"hardware_threads", std::to_string(std::thread::hardware_concurrency())}};
+    if (output.empty()) {
+        benchmark::write_json(std::cout, context, results);
+    }
+    else {
+        std::ofstream stream(output);
+        benchmark::write_json(stream, context, results);
+        if (!stream) {
+            std::cerr << "Cannot write to " << output << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
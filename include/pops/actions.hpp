@@ -25,6 +25,7 @@
 #include <random>
 #include <string>
 #include <stdexcept>
+#include <utility>
 
 #include "utils.hpp"
 #include "model_type.hpp"
@@ -81,24 +82,38 @@ public:
     void generate(Hosts& host_pool, Pests& pests, Generator& generator)
     {
         for (auto indices : host_pool.suitable_cells()) {
-            int i = indices[0];
-            int j = indices[1];
-            int dispersers_from_cell =
-                host_pool.dispersers_from(i, j, generator.disperser_generation());
-            if (dispersers_from_cell > 0) {
-                if (soil_pool_) {
-                    // From all the generated dispersers, some go to the soil in the
-                    // same cell and don't participate in the kernel-driven dispersal.
-                    auto dispersers_to_soil =
-                        std::lround(to_soil_percentage_ * dispersers_from_cell);
-                    soil_pool_->dispersers_to(dispersers_to_soil, i, j, generator);
-                    dispersers_from_cell -= dispersers_to_soil;
-                }
-                pests.set_dispersers_at(i, j, dispersers_from_cell, 0);
-            }
-            else {
-                pests.set_dispersers_at(i, j, 0, 0);
+            this->generate_at(host_pool, pests, indices[0], indices[1], generator);
+        }
+    }
+
+    /** Generates dispersers in one cell
+     *
+     * This is what generate() does for each suitable cell. The function is
+     * available separately, so that the generation can be part of a sweep over cells
+     * (see sweep_cells()).
+     */
+    void generate_at(
+        Hosts& host_pool,
+        Pests& pests,
+        RasterIndex i,
+        RasterIndex j,
+        Generator& generator)
+    {
+        int dispersers_from_cell =
+            host_pool.dispersers_from(i, j, generator.disperser_generation());
+        if (dispersers_from_cell > 0) {
+            if (soil_pool_) {
+                // From all the generated dispersers, some go to the soil in the
+                // same cell and don't participate in the kernel-driven dispersal.
+                auto dispersers_to_soil =
+                    std::lround(to_soil_percentage_ * dispersers_from_cell);
+                soil_pool_->dispersers_to(dispersers_to_soil, i, j, generator);
+                dispersers_from_cell -= dispersers_to_soil;
             }
+            pests.set_dispersers_at(i, j, dispersers_from_cell, 0);
+        }
+        else {
+            pests.set_dispersers_at(i, j, 0, 0);
         }
     }
 
@@ -218,12 +233,17 @@ public:
     void action(Hosts& hosts, Generator& generator)
     {
         for (auto indices : hosts.suitable_cells()) {
-            int i = indices[0];
-            int j = indices[1];
-            if (survival_rate_(i, j) < 1) {
-                hosts.remove_infection_by_ratio_at(
-                    i, j, survival_rate_(i, j), generator.survival_rate());
-            }
+            this->action_at(hosts, indices[0], indices[1], generator);
+        }
+    }
+
+    /** Reduce the infection in one cell (see action()) */
+    template<typename Generator, typename RasterIndex>
+    void action_at(Hosts& hosts, RasterIndex i, RasterIndex j, Generator& generator)
+    {
+        if (survival_rate_(i, j) < 1) {
+            hosts.remove_infection_by_ratio_at(
+                i, j, survival_rate_(i, j), generator.survival_rate());
         }
     }
 
@@ -263,12 +283,16 @@ public:
     void action(Hosts& hosts, Generator& generator)
     {
         for (auto indices : hosts.suitable_cells()) {
-            int i = indices[0];
-            int j = indices[1];
-            if (environment_.temperature_at(i, j) < lethal_temperature_) {
-                // now this includes also mortality, but it does not include exposed
-                hosts.remove_all_infected_at(i, j, generator.lethal_temperature());
-            }
+            this->action_at(hosts, indices[0], indices[1], generator);
+        }
+    }
+
+    /** Perform the removal of infection in one cell */
+    void action_at(Hosts& hosts, RasterIndex i, RasterIndex j, Generator& generator)
+    {
+        if (environment_.temperature_at(i, j) < lethal_temperature_) {
+            // now this includes also mortality, but it does not include exposed
+            hosts.remove_all_infected_at(i, j, generator.lethal_temperature());
         }
     }
 
@@ -506,14 +530,32 @@ public:
     void action(Hosts& hosts)
     {
         for (auto indices : hosts.suitable_cells()) {
-            if (static_cast<bool>(action_mortality_)) {
-                hosts.apply_mortality_at(
-                    indices[0], indices[1], mortality_rate_, mortality_time_lag_);
-            }
-            else {
-                hosts.apply_mortality_at(indices[0], indices[1]);
-            }
+            this->action_at(hosts, indices[0], indices[1]);
         }
+        this->finish_action(hosts);
+    }
+
+    /**
+     * Apply mortality in one cell
+     *
+     * All cells need to be processed before calling finish_action().
+     */
+    template<typename RasterIndex>
+    void action_at(Hosts& hosts, RasterIndex i, RasterIndex j)
+    {
+        if (static_cast<bool>(action_mortality_)) {
+            hosts.apply_mortality_at(i, j, mortality_rate_, mortality_time_lag_);
+        }
+        else {
+            hosts.apply_mortality_at(i, j);
+        }
+    }
+
+    /**
+     * Move the mortality tracker forward after action_at() was applied to all cells
+     */
+    void finish_action(Hosts& hosts)
+    {
         hosts.step_forward_mortality();
     }
 
@@ -523,6 +565,100 @@ private:
     const double action_mortality_ = false;
 };
 
+/**
+ * Action which does nothing, used when a swept action has no cell or final part
+ */
+struct NoSweepAction
+{
+    template<typename... Args>
+    void operator()(Args&&...) const
+    {}
+};
+
+/**
+ * Action applied as a part of a sweep over cells (see sweep_cells())
+ *
+ * The cell action is called for each suitable cell with row and column and the final
+ * action is called once all cells were processed. A disabled action is skipped.
+ * When *visit_cells* is false, only the final action is called (for actions which
+ * don't need to visit cells, but need to be called in order with the other final
+ * actions).
+ */
+template<typename CellAction, typename FinalAction = NoSweepAction>
+struct SweptCellAction
+{
+    bool enabled;
+    bool visit_cells;
+    CellAction cell_action;
+    FinalAction final_action;
+
+    /** Apply the cell action to one cell if enabled */
+    template<typename RasterIndex>
+    void action_at(RasterIndex i, RasterIndex j)
+    {
+        if (enabled && visit_cells)
+            cell_action(i, j);
+    }
+
+    /** Call the final action if enabled */
+    void finish_action()
+    {
+        if (enabled)
+            final_action();
+    }
+};
+
+/**
+ * @brief Create an action for sweep_cells()
+ *
+ * @param enabled True if the action is part of the sweep
+ * @param cell_action Action to apply to each suitable cell
+ * @param final_action Optional action to call once all cells were processed
+ * @param visit_cells False if only the final action should be called
+ */
+template<typename CellAction, typename FinalAction = NoSweepAction>
+SweptCellAction<CellAction, FinalAction> swept_cell_action(
+    bool enabled,
+    CellAction cell_action,
+    FinalAction final_action = FinalAction(),
+    bool visit_cells = true)
+{
+    return {enabled, visit_cells, std::move(cell_action), std::move(final_action)};
+}
+
+/**
+ * Sweep over suitable cells applying multiple per-cell actions at once
+ *
+ * Actions which read and modify only the cell they are applied to can be applied in
+ * one pass over the suitable cells instead of one pass per action. This reduces the
+ * number of times the whole state needs to be read from memory. Cross-cell processes
+ * such as dispersal can't be part of a sweep.
+ *
+ * In each cell, the enabled cell actions are applied in the order they are given.
+ * When all cells are processed, the final actions are called, again in the order
+ * they are given. Results are the same as when the actions are applied one after
+ * another as long as each action modifies only the cell it is called for and actions
+ * using random numbers use independent generators (otherwise, the order in which the
+ * random numbers are drawn changes).
+ *
+ * The actions are passed with their concrete types (see swept_cell_action()), so the
+ * calls in the loop over cells can be inlined. The cells are not visited at all when
+ * no enabled action needs to visit them.
+ */
+template<typename RasterIndex, typename Hosts, typename... Actions>
+void sweep_cells(const Hosts& hosts, Actions&&... actions)
+{
+    bool visit_cells = (false || ... || (actions.enabled && actions.visit_cells));
+    if (visit_cells) {
+        for (const auto& indices : hosts.suitable_cells()) {
+            RasterIndex i = indices[0];
+            RasterIndex j = indices[1];
+            (actions.action_at(i, j), ...);
+        }
+    }
+    (actions.finish_action(), ...);
+}
+
 }  // namespace pops
 
 #endif  // POPS_ACTIONS_HPP
@@ -38,6 +38,7 @@ namespace pops {
  * @param config Configuration for the kernel
  * @param dispersers The disperser raster (reference, for deterministic kernel)
  * @param network Network (initialized or not)
+ * @param probability_window Shared window for deterministic kernel (or null)
  *
  * @return Created kernel
  */
@@ -45,7 +46,8 @@ template<typename Generator, typename IntegerRaster, typename RasterIndex>
 std::unique_ptr<KernelInterface<Generator>> create_anthro_kernel(
     const Config& config,
     const IntegerRaster& dispersers,
-    const Network<RasterIndex>& network)
+    const Network<RasterIndex>& network,
+    std::shared_ptr<const DeterministicProbabilityRaster> probability_window = nullptr)
 {
     auto anthro_kernel = kernel_type_from_string(config.anthro_kernel_type);
     if (anthro_kernel == DispersalKernelType::Uniform) {
@@ -61,9 +63,10 @@ std::unique_ptr<KernelInterface<Generator>> create_anthro_kernel(
     else if (anthro_kernel == DispersalKernelType::Network) {
         using Kernel =
             DynamicWrapperKernel<NetworkDispersalKernel<RasterIndex>, Generator>;
-        if (config.network_movement == "teleport")
+        auto movement = network_movement_from_string(config.network_movement);
+        if (movement == NetworkMovement::Teleport)
             return std::unique_ptr<Kernel>(new Kernel(network));
-        bool jump = config.network_movement == "jump" ? true : false;
+        bool jump = movement == NetworkMovement::Jump;
         return std::unique_ptr<Kernel>(new Kernel(
             network, config.network_min_distance, config.network_max_distance, jump));
     }
@@ -78,7 +81,8 @@ std::unique_ptr<KernelInterface<Generator>> create_anthro_kernel(
             config.ew_res,
             config.ns_res,
             config.anthro_scale,
-            config.shape));
+            config.shape,
+            probability_window));
     }
     else {
         using Kernel =
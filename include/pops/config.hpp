@@ -116,6 +116,30 @@ std::map<std::string, Value> read_key_value_pairs(
         std_text, record_separator, key_value_separator, conversion);
 }
 
+/** Behavior of dispersers arriving to a cell with multiple hosts
+ *
+ * @see MultiHostPool::disperser_to()
+ */
+enum class ArrivalBehavior
+{
+    Infect,  ///< Pick a host which performs the establishment test
+    Land,  ///< Establishment test with combined suitability of all hosts
+};
+
+/*! Get a corresponding enum value for a string with arrival behavior name.
+ *
+ * Throws an std::invalid_argument exception if the value is not supported.
+ */
+inline ArrivalBehavior arrival_behavior_from_string(const std::string& text)
+{
+    if (text == "infect")
+        return ArrivalBehavior::Infect;
+    if (text == "land")
+        return ArrivalBehavior::Land;
+    throw std::invalid_argument(
+        "arrival_behavior_from_string: Invalid value '" + text + "' provided");
+}
+
 /** Configuration for Model */
 class Config
 {
@@ -144,6 +168,12 @@ public:
     int random_seed{0};
     bool multiple_random_seeds{false};
     std::map<std::string, unsigned> random_seeds;
+    /**
+     * Replicate number used to select random number streams for spread in tiles
+     *
+     * @see DecomposedSpreadAction
+     */
+    unsigned replicate{0};
     // Size
     int rows{0};
     int cols{0};
@@ -218,6 +248,30 @@ public:
     double leaving_percentage{0};
     double leaving_scale_coefficient{1};
     double dispersers_to_soils_percentage{0};  ///< Ratio of dispersers going into soil
+    /**
+     * Apply per-cell actions in a step in one sweep over cells (same results)
+     *
+     * @see sweep_cells()
+     */
+    bool fuse_cell_actions{true};
+    /**
+     * Size of tiles (rows and columns) for spread in parallel (0 to disable)
+     *
+     * @see DecomposedSpreadAction
+     */
+    int spread_tile_size{0};
+    /** Number of threads for spread in tiles (0 for all hardware threads) */
+    unsigned spread_threads{0};
+    /**
+     * Random number streams for spread in tiles (cell or tile)
+     *
+     * With streams for cells, the result depends neither on the number of threads
+     * nor on the tile size. With streams for tiles, the result depends on the tile
+     * size.
+     *
+     * @see RandomStreams
+     */
+    std::string spread_random_streams{"cell"};
 
     /** Get model type as ModelType enum value */
     ModelType model_type_as_enum() const
@@ -320,6 +374,12 @@ public:
         return quarantine_schedule_;
     }
 
+    /** Return true if create_schedules() was called */
+    bool schedules_created() const
+    {
+        return schedules_created_;
+    }
+
     const std::vector<bool>& output_schedule() const
     {
         if (!schedules_created_)
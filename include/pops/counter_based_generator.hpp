@@ -0,0 +1,370 @@
+/*
+ * PoPS model - counter-based random number generation
+ *
+ * Copyright (C) 2023 by the authors.
+ *
+ * Authors: Vaclav Petras <wenzeslaus gmail com>
+ *
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef POPS_COUNTER_BASED_GENERATOR_HPP
+#define POPS_COUNTER_BASED_GENERATOR_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+
+#include "generator_provider.hpp"
+#include "utils.hpp"
+
+namespace pops {
+
+/**
+ * Counter-based random number generator Philox4x32-10
+ *
+ * The generator is a keyed bijection (ten rounds of the Philox function) applied
+ * to a 128-bit counter, so each combination of a key and a counter gives four
+ * independent 32-bit numbers. There is no other state, so setting the key and the
+ * counter is cheap and any number of independent streams can be created by using
+ * different keys or different parts of the counter. The algorithm and constants
+ * follow Salmon et al. (2011) Parallel random numbers: as easy as 1, 2, 3.
+ *
+ * The first counter word is incremented for each block of four numbers, the
+ * remaining three words identify the stream.
+ *
+ * Satisfies UniformRandomBitGenerator and it can be seeded with one number as the
+ * standard engines, so it can be used as the Generator in
+ * RandomNumberGeneratorProvider and Model.
+ */
+class Philox4x32
+{
+public:
+    using result_type = std::uint32_t;
+    using Counter = std::array<std::uint32_t, 4>;
+    using Key = std::array<std::uint32_t, 2>;
+
+    static constexpr result_type min()
+    {
+        return 0;
+    }
+
+    static constexpr result_type max()
+    {
+        return 0xFFFFFFFF;
+    }
+
+    /** Create generator with seed zero */
+    Philox4x32()
+    {
+        seed(0);
+    }
+
+    /** Create generator with a given seed (the seed is the first key word) */
+    explicit Philox4x32(unsigned seed)
+    {
+        this->seed(seed);
+    }
+
+    /** Create generator with a given key and counter */
+    Philox4x32(const Key& key, const Counter& counter)
+    {
+        set_key(key);
+        set_counter(counter);
+    }
+
+    /** Set the seed as the first key word and reset the counter */
+    void seed(unsigned seed)
+    {
+        set_key({static_cast<std::uint32_t>(seed), 0});
+        set_counter({0, 0, 0, 0});
+    }
+
+    /** Set the key (the current counter is kept) */
+    void set_key(const Key& key)
+    {
+        key_ = key;
+        position_ = 4;
+    }
+
+    /** Set the counter of the next block */
+    void set_counter(const Counter& counter)
+    {
+        counter_ = counter;
+        position_ = 4;
+    }
+
+    /** Get the key */
+    const Key& key() const
+    {
+        return key_;
+    }
+
+    /** Get the next random number */
+    result_type operator()()
+    {
+        if (position_ == 4) {
+            block_ = block(counter_, key_);
+            ++counter_[0];
+            position_ = 0;
+        }
+        return block_[position_++];
+    }
+
+    /** Skip the given number of random numbers */
+    void discard(unsigned long long n)
+    {
+        std::size_t buffered = 4 - position_;
+        if (n <= buffered) {
+            position_ += static_cast<unsigned>(n);
+            return;
+        }
+        n -= buffered;
+        counter_[0] += static_cast<std::uint32_t>(n / 4);
+        position_ = 4;
+        for (unsigned long long i = 0; i < n % 4; ++i)
+            this->operator()();
+    }
+
+    /** Compute one block of four random numbers for a counter and key */
+    static Counter block(Counter counter, Key key)
+    {
+        for (int round = 0; round < 10; ++round) {
+            if (round) {
+                key[0] += 0x9E3779B9;
+                key[1] += 0xBB67AE85;
+            }
+            std::uint64_t product0 = std::uint64_t(0xD2511F53) * counter[0];
+            std::uint64_t product1 = std::uint64_t(0xCD9E8D57) * counter[2];
+            counter = {
+                static_cast<std::uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+                static_cast<std::uint32_t>(product1),
+                static_cast<std::uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+                static_cast<std::uint32_t>(product0)};
+        }
+        return counter;
+    }
+
+    bool operator==(const Philox4x32& other) const
+    {
+        return key_ == other.key_ && counter_ == other.counter_
+               && (position_ == 4 ? other.position_ == 4
+                                  : position_ == other.position_);
+    }
+
+    bool operator!=(const Philox4x32& other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    Key key_;
+    Counter counter_;
+    Counter block_;
+    unsigned position_{4};
+};
+
+/**
+ * Generator provider with streams for each purpose, step, and cell
+ *
+ * The provider offers the same functions as RandomNumberGeneratorProvider, but
+ * each generator is a Philox4x32 generator with the key given by the seed and the
+ * replicate number and with the counter given by the purpose (e.g., natural
+ * dispersal or establishment), step, and cell (or any other stream number). The
+ * streams don't overlap for different replicates, purposes, steps, or cells.
+ *
+ * Selecting a stream using select_stream() does not involve any computation, so
+ * the stream can be selected for each cell. Then, the random numbers used for a
+ * cell don't depend on the order in which the cells are processed. This makes
+ * results of parallel or reordered execution reproducible (see
+ * DecomposedSpreadAction which selects streams for cells and which creates the
+ * provider with the replicate number from the configuration).
+ *
+ * With multiple generators disabled, all purposes use the same stream (as
+ * RandomNumberGeneratorProvider does with a single seed).
+ *
+ * Up to 2^40 cells (stream numbers) and up to 2^32 steps are supported.
+ */
+class CounterBasedGeneratorProvider
+{
+public:
+    using Generator = Philox4x32;
+
+    /**
+     * @brief Create provider with a given seed
+     *
+     * The streams for step zero and cell zero are selected.
+     *
+     * @param seed Seed (the first key word)
+     * @param multiple Use separate streams for purposes
+     * @param replicate Replicate number (the second key word)
+     */
+    CounterBasedGeneratorProvider(
+        unsigned seed, bool multiple = true, unsigned replicate = 0)
+        : seed_(seed), replicate_(replicate), multiple_(multiple)
+    {
+        select_stream(0, 0);
+    }
+
+    /** Change seed and select streams for step zero and cell zero */
+    void seed(unsigned seed)
+    {
+        seed_ = seed;
+        select_stream(0, 0);
+    }
+
+    /** Change replicate number and select streams for step zero and cell zero */
+    void set_replicate(unsigned replicate)
+    {
+        replicate_ = replicate;
+        select_stream(0, 0);
+    }
+
+    /**
+     * @brief Select streams for a given step and cell for all purposes
+     *
+     * @param step Step in the simulation
+     * @param cell Index of the cell or any other stream number (<2^40)
+     *
+     * @throw std::out_of_range when the cell index is too large
+     */
+    void select_stream(std::uint64_t step, std::uint64_t cell)
+    {
+        if (cell >> 40) {
+            throw std::out_of_range(
+                "CounterBasedGeneratorProvider: Stream number "
+                + std::to_string(cell) + " is too large (maximum is 2^40-1)");
+        }
+        Philox4x32::Key key{
+            static_cast<std::uint32_t>(seed_),
+            static_cast<std::uint32_t>(replicate_)};
+        for (std::size_t purpose = 0; purpose < generators_.size(); ++purpose) {
+            std::uint32_t purpose_id =
+                multiple_ ? static_cast<std::uint32_t>(purpose) : 0;
+            generators_[purpose].set_key(key);
+            generators_[purpose].set_counter(
+                {0,
+                 static_cast<std::uint32_t>(step),
+                 static_cast<std::uint32_t>(cell),
+                 static_cast<std::uint32_t>(cell >> 32) | (purpose_id << 8)});
+        }
+    }
+
+    Generator& disperser_generation()
+    {
+        return generator(0);
+    }
+
+    Generator& natural_dispersal()
+    {
+        return generator(1);
+    }
+
+    Generator& anthropogenic_dispersal()
+    {
+        return generator(2);
+    }
+
+    Generator& establishment()
+    {
+        return generator(3);
+    }
+
+    Generator& weather()
+    {
+        return generator(4);
+    }
+
+    Generator& lethal_temperature()
+    {
+        return generator(5);
+    }
+
+    Generator& movement()
+    {
+        return generator(6);
+    }
+
+    Generator& overpopulation()
+    {
+        return generator(7);
+    }
+
+    Generator& survival_rate()
+    {
+        return generator(8);
+    }
+
+    Generator& soil()
+    {
+        return generator(9);
+    }
+
+    // API to behave like the underlying generator.
+
+    using result_type = Generator::result_type;
+
+    static constexpr result_type min()
+    {
+        return Generator::min();
+    }
+
+    static constexpr result_type max()
+    {
+        return Generator::max();
+    }
+
+    /* Throws std::runtime_error if using multiple streams */
+    result_type operator()()
+    {
+        if (multiple_) {
+            throw std::runtime_error(
+                "CounterBasedGeneratorProvider used as a single generator "
+                "but it is set to provide multiple streams");
+        }
+        return generators_[0]();
+    }
+
+private:
+    Generator& generator(std::size_t purpose)
+    {
+        return generators_[multiple_ ? purpose : 0];
+    }
+
+    unsigned seed_;
+    unsigned replicate_;
+    bool multiple_;
+    std::array<Generator, 10> generators_;
+};
+
+/**
+ * Select streams of a counter-based provider for a step and stream number
+ *
+ * The seed is already part of the provider, so it is not used here. Selecting the
+ * streams is cheap, so streams for all purposes are selected.
+ *
+ * @see select_random_stream()
+ */
+inline void select_random_stream(
+    CounterBasedGeneratorProvider& generator,
+    unsigned seed,
+    unsigned step,
+    std::uint64_t stream,
+    std::initializer_list<GeneratorPurpose> purposes)
+{
+    UNUSED(seed);
+    UNUSED(purposes);
+    generator.select_stream(step, stream);
+}
+
+}  // namespace pops
+
+#endif  // POPS_COUNTER_BASED_GENERATOR_HPP
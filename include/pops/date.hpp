@@ -24,6 +24,78 @@
 
 namespace pops {
 
+/*!
+ * Calendar date as plain numbers without any validation
+ */
+struct CivilDate
+{
+    int year;
+    int month;
+    int day;
+};
+
+/*!
+ * \brief Decides if a year is a leap year in the Gregorian calendar
+ */
+inline bool is_leap_year(int year)
+{
+    return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+}
+
+/*!
+ * \brief Gets number of days in a month (1-12) of a given year
+ */
+inline int days_in_month(int year, int month)
+{
+    static const int days[2][13] = {
+        {0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31},
+        {0, 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31}};
+    return days[is_leap_year(year)][month];
+}
+
+/*!
+ * \brief Converts a date to a day number
+ *
+ * The day number is the number of days since 1970-01-01 (negative for earlier
+ * dates) in the proleptic Gregorian calendar, so the difference of two day
+ * numbers is the number of days between the dates. Days outside of the month
+ * continue to the next or previous month, e.g., February 30 is March 1 or 2.
+ *
+ * Uses the algorithm by Howard Hinnant which needs only a few integer operations.
+ */
+inline int days_from_civil(int year, int month, int day)
+{
+    year -= month <= 2;
+    const int era = (year >= 0 ? year : year - 399) / 400;
+    const int year_of_era = year - era * 400;
+    const int shifted_month = month > 2 ? month - 3 : month + 9;
+    const int day_of_year = (153 * shifted_month + 2) / 5 + day - 1;
+    const int day_of_era =
+        year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+/*!
+ * \brief Converts a day number to a date
+ *
+ * Inverse of days_from_civil().
+ */
+inline CivilDate civil_from_days(int days)
+{
+    days += 719468;
+    const int era = (days >= 0 ? days : days - 146096) / 146097;
+    const int day_of_era = days - era * 146097;
+    const int year_of_era =
+        (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096)
+        / 365;
+    const int day_of_year =
+        day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    const int shifted_month = (5 * day_of_year + 2) / 153;
+    const int day = day_of_year - (153 * shifted_month + 2) / 5 + 1;
+    const int month = shifted_month < 10 ? shifted_month + 3 : shifted_month - 9;
+    return {year_of_era + era * 400 + (month <= 2), month, day};
+}
+
 /*! Representation and manipulation of a date for the simulation.
  *
  * This class represents and manipulates dates in way which is most
@@ -76,6 +148,8 @@ public:
         return day_;
     }
     inline int weeks_from_date(Date start) const;
+    inline int day_number() const;
+    inline static Date from_day_number(int days);
     inline friend std::ostream& operator<<(std::ostream& os, const Date& d);
     inline friend bool operator>(const Date& d1, const Date& d2);
     inline friend bool operator>=(const Date& d1, const Date& d2);
@@ -444,6 +518,27 @@ int Date::weeks_from_date(Date start) const
     return week - 1;
 }
 
+/*!
+ * \brief Gets the date as a day number
+ *
+ * \see days_from_civil()
+ */
+int Date::day_number() const
+{
+    return days_from_civil(year_, month_, day_);
+}
+
+/*!
+ * \brief Creates date from a day number
+ *
+ * \see civil_from_days()
+ */
+Date Date::from_day_number(int days)
+{
+    CivilDate date = civil_from_days(days);
+    return Date(date.year, date.month, date.day);
+}
+
 /*!
  * Returns the current date as a string
  *
@@ -18,8 +18,10 @@
 
 #include <vector>
 #include <tuple>
+#include <memory>
 
 #include "raster.hpp"
+#include "raster_allocator.hpp"
 #include "kernel_types.hpp"
 #include "utils.hpp"
 #include "hyperbolic_secant_kernel.hpp"
@@ -43,6 +45,21 @@ using std::ceil;
 using std::abs;
 using std::sqrt;
 
+/** Probability window of DeterministicDispersalKernel */
+using DeterministicProbabilityRaster = Raster<double, int, PooledAllocator<double>>;
+
+/**
+ * Probability windows of the deterministic natural and anthropogenic kernels
+ *
+ * The windows are computed once for each step and shared read-only by all kernels
+ * created in that step. A null window is computed by the kernel itself.
+ */
+struct DeterministicProbabilityWindows
+{
+    std::shared_ptr<const DeterministicProbabilityRaster> natural;
+    std::shared_ptr<const DeterministicProbabilityRaster> anthro;
+};
+
 /*!
  * Dispersal kernel for deterministic spread to cell with highest probability of
  * spread
@@ -71,8 +88,12 @@ protected:
     int number_of_columns = 0;
     // maximum distance from center cell to outer cells
     double max_distance{0};
-    Raster<double> probability;
-    Raster<double> probability_copy;
+    // The kernel is created for each step, so the probability window can be
+    // shared between kernels with the same parameters and the storage for the copy
+    // is taken from the default pool of buffers and reused.
+    using ProbabilityRaster = DeterministicProbabilityRaster;
+    std::shared_ptr<const ProbabilityRaster> probability;
+    ProbabilityRaster probability_copy;
     CauchyKernel cauchy;
     ExponentialKernel exponential;
     WeibullKernel weibull;
@@ -110,6 +131,8 @@ public:
      * @param ns_res North-south resolution
      * @param distance_scale Scale parameter for the kernels
      * @param shape Shape parameter for the kernels
+     * @param probability_window Window computed by another kernel with the same
+     * parameters (see probability_window()) or null to compute a new one
      */
     DeterministicDispersalKernel(
         DispersalKernelType dispersal_kernel,
@@ -118,7 +141,8 @@ public:
         double ew_res,
         double ns_res,
         double distance_scale,
-        double shape = 1.0)
+        double shape = 1.0,
+        std::shared_ptr<const ProbabilityRaster> probability_window = nullptr)
         : dispersers_(dispersers),
           cauchy(distance_scale),
           exponential(distance_scale),
@@ -176,53 +200,33 @@ public:
             static_cast<int>(ceil(max_distance / east_west_resolution)) * 2 + 1;
         number_of_rows =
             static_cast<int>(ceil(max_distance / north_south_resolution)) * 2 + 1;
-        Raster<double> prob_size(number_of_rows, number_of_columns, 0);
-        probability = prob_size;
-        probability_copy = prob_size;
         mid_row = number_of_rows / 2;
         mid_col = number_of_columns / 2;
-        double sum = 0.0;
-        for (int i = 0; i < number_of_rows; i++) {
-            for (int j = 0; j < number_of_columns; j++) {
-                double distance_to_center = std::sqrt(
-                    pow((abs(mid_row - i) * east_west_resolution), 2)
-                    + pow((abs(mid_col - j) * north_south_resolution), 2));
-                // determine probability based on distance
-                if (kernel_type_ == DispersalKernelType::Cauchy) {
-                    probability(i, j) = abs(cauchy.pdf(distance_to_center));
-                }
-                else if (kernel_type_ == DispersalKernelType::Exponential) {
-                    probability(i, j) = abs(exponential.pdf(distance_to_center));
-                }
-                else if (kernel_type_ == DispersalKernelType::Weibull) {
-                    probability(i, j) = abs(weibull.pdf(distance_to_center));
-                }
-                else if (kernel_type_ == DispersalKernelType::Normal) {
-                    probability(i, j) = abs(normal.pdf(distance_to_center));
-                }
-                else if (kernel_type_ == DispersalKernelType::LogNormal) {
-                    probability(i, j) = abs(log_normal.pdf(distance_to_center));
-                }
-                else if (kernel_type_ == DispersalKernelType::PowerLaw) {
-                    probability(i, j) = abs(power_law.pdf(distance_to_center));
-                }
-                else if (kernel_type_ == DispersalKernelType::HyperbolicSecant) {
-                    probability(i, j) = abs(hyperbolic_secant.pdf(distance_to_center));
-                }
-                else if (kernel_type_ == DispersalKernelType::Logistic) {
-                    probability(i, j) = abs(logistic.pdf(distance_to_center));
-                }
-                else if (kernel_type_ == DispersalKernelType::Gamma) {
-                    probability(i, j) = abs(gamma.pdf(distance_to_center));
-                }
-                else if (kernel_type_ == DispersalKernelType::ExponentialPower) {
-                    probability(i, j) = abs(exponential_power.pdf(distance_to_center));
-                }
-                sum += probability(i, j);
-            }
+        if (!probability_window) {
+            probability =
+                std::make_shared<const ProbabilityRaster>(compute_probability());
+        }
+        else if (
+            probability_window->rows() != number_of_rows
+            || probability_window->cols() != number_of_columns) {
+            throw std::invalid_argument(
+                "DeterministicDispersalKernel: Probability window does not match "
+                "kernel parameters");
+        }
+        else {
+            probability = probability_window;
         }
-        // normalize based on the sum of all probabilities in the raster
-        probability /= sum;
+    }
+
+    /**
+     * Get the probability window
+     *
+     * The window does not change, so it can be passed to other kernels with the
+     * same parameters. Null for unsupported kernel types.
+     */
+    std::shared_ptr<const ProbabilityRaster> probability_window() const
+    {
+        return probability;
     }
 
     /*! Generates a new position for the spread.
@@ -255,7 +259,7 @@ public:
         // reset the window if considering a new cell
         if (row != prev_row || col != prev_col) {
             proportion_of_dispersers = 1.0 / (double)dispersers_(row, col);
-            probability_copy = probability;
+            probability_copy = *probability;
         }
 
         int row_movement = 0;
@@ -319,6 +323,56 @@ public:
         auto it = std::find(supports.cbegin(), supports.cend(), type);
         return it != supports.cend();
     }
+
+protected:
+    /** Compute probability for each cell of the window */
+    ProbabilityRaster compute_probability()
+    {
+        ProbabilityRaster window(number_of_rows, number_of_columns, 0);
+        double sum = 0.0;
+        for (int i = 0; i < number_of_rows; i++) {
+            for (int j = 0; j < number_of_columns; j++) {
+                double distance_to_center = std::sqrt(
+                    pow((abs(mid_row - i) * east_west_resolution), 2)
+                    + pow((abs(mid_col - j) * north_south_resolution), 2));
+                // determine probability based on distance
+                if (kernel_type_ == DispersalKernelType::Cauchy) {
+                    window(i, j) = abs(cauchy.pdf(distance_to_center));
+                }
+                else if (kernel_type_ == DispersalKernelType::Exponential) {
+                    window(i, j) = abs(exponential.pdf(distance_to_center));
+                }
+                else if (kernel_type_ == DispersalKernelType::Weibull) {
+                    window(i, j) = abs(weibull.pdf(distance_to_center));
+                }
+                else if (kernel_type_ == DispersalKernelType::Normal) {
+                    window(i, j) = abs(normal.pdf(distance_to_center));
+                }
+                else if (kernel_type_ == DispersalKernelType::LogNormal) {
+                    window(i, j) = abs(log_normal.pdf(distance_to_center));
+                }
+                else if (kernel_type_ == DispersalKernelType::PowerLaw) {
+                    window(i, j) = abs(power_law.pdf(distance_to_center));
+                }
+                else if (kernel_type_ == DispersalKernelType::HyperbolicSecant) {
+                    window(i, j) = abs(hyperbolic_secant.pdf(distance_to_center));
+                }
+                else if (kernel_type_ == DispersalKernelType::Logistic) {
+                    window(i, j) = abs(logistic.pdf(distance_to_center));
+                }
+                else if (kernel_type_ == DispersalKernelType::Gamma) {
+                    window(i, j) = abs(gamma.pdf(distance_to_center));
+                }
+                else if (kernel_type_ == DispersalKernelType::ExponentialPower) {
+                    window(i, j) = abs(exponential_power.pdf(distance_to_center));
+                }
+                sum += window(i, j);
+            }
+        }
+        // normalize based on the sum of all probabilities in the raster
+        window /= sum;
+        return window;
+    }
 };
 
 }  // namespace pops
@@ -24,8 +24,12 @@
 #ifndef POPS_SIMPLE_GENERATOR_HPP
 #define POPS_SIMPLE_GENERATOR_HPP
 
+#include <array>
+#include <cstdint>
+#include <initializer_list>
 #include <random>
 #include <map>
+#include <memory>
 #include <string>
 #include <exception>
 
@@ -33,6 +37,42 @@
 
 namespace pops {
 
+/** Purpose of a generator in a provider (in the order of the provider functions) */
+enum class GeneratorPurpose
+{
+    DisperserGeneration,
+    NaturalDispersal,
+    AnthropogenicDispersal,
+    Establishment,
+    Weather,
+    LethalTemperature,
+    Movement,
+    Overpopulation,
+    SurvivalRate,
+    Soil,
+};
+
+/**
+ * Seed generator for a given purpose using a 64-bit seed
+ *
+ * The seed and the purpose are mixed using the SplitMix64 finalizer. Generators
+ * with 64-bit values (e.g., std::mt19937_64) are seeded with all 64 bits, others
+ * with the value folded to 32 bits. Unlike seeding using std::seed_seq, this does
+ * not allocate, so it can be used for each cell.
+ */
+template<typename Generator>
+void seed_generator(Generator& generator, std::uint64_t seed, std::uint32_t purpose)
+{
+    using Seed = typename Generator::result_type;
+    std::uint64_t value = seed ^ (std::uint64_t(purpose) * 0x9E3779B97F4A7C15ULL);
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    value ^= value >> 31;
+    if (sizeof(Seed) < sizeof(std::uint64_t))
+        value ^= value >> 32;
+    generator.seed(static_cast<Seed>(value));
+}
+
 /**
  * Interface for generator providers.
  *
@@ -374,6 +414,10 @@ private:
  * However, unlike the simple generator for single seed, this will throw
  * an exception if used directly as UniformRandomBitGenerator, but the
  * object was seeded with multiple seeds.
+ *
+ * The generators are obtained from the underlying provider once when the object
+ * is created, so getting a generator for a given purpose is only a pointer load
+ * without a virtual function call.
  */
 template<typename GeneratorType>
 class RandomNumberGeneratorProvider
@@ -393,12 +437,15 @@ public:
         else {
             impl.reset(new SingleGeneratorProvider<Generator>(seed));
         }
+        cache_generators();
     }
 
     /** Creates multiple isolated generators based on named seeds */
     RandomNumberGeneratorProvider(const std::map<std::string, unsigned>& seeds)
         : impl(new MultiRandomNumberGeneratorProvider<Generator>(seeds)), mutli_(true)
-    {}
+    {
+        cache_generators();
+    }
 
     /**
      * Result can be multiple independent generators or a single generator
@@ -414,56 +461,92 @@ public:
             impl.reset(new SingleGeneratorProvider<Generator>(config.random_seed));
             mutli_ = false;
         }
+        cache_generators();
+    }
+
+    /**
+     * Re-seed the generators with a single value
+     *
+     * With multiple isolated generators, the seed is incremented for each generator.
+     * This allows for reuse of the object for independent random number streams,
+     * e.g., one for each cell.
+     */
+    void seed(unsigned seed)
+    {
+        impl->seed(seed);
+    }
+
+    /**
+     * @brief Re-seed only generators for the given purposes using a 64-bit seed
+     *
+     * Each selected generator is seeded from the seed and its purpose (see
+     * seed_generator()), other generators are not changed. With a single
+     * generator, the generator is seeded once. This is cheaper than seed() for
+     * independent random number streams selected often, e.g., for each cell,
+     * when only some of the generators are used.
+     */
+    void
+    seed_purposes(std::uint64_t seed, std::initializer_list<GeneratorPurpose> purposes)
+    {
+        if (!mutli_) {
+            if (purposes.size())
+                seed_generator(*generators_[0], seed, 0);
+            return;
+        }
+        for (GeneratorPurpose purpose : purposes) {
+            auto index = static_cast<std::uint32_t>(purpose);
+            seed_generator(*generators_[index], seed, index);
+        }
     }
 
     Generator& disperser_generation()
     {
-        return impl->disperser_generation();
+        return *generators_[0];
     }
 
     Generator& natural_dispersal()
     {
-        return impl->natural_dispersal();
+        return *generators_[1];
     }
 
     Generator& anthropogenic_dispersal()
     {
-        return impl->anthropogenic_dispersal();
+        return *generators_[2];
     }
 
     Generator& establishment()
     {
-        return impl->establishment();
+        return *generators_[3];
     }
 
     Generator& weather()
     {
-        return impl->weather();
+        return *generators_[4];
     }
 
     Generator& lethal_temperature()
     {
-        return impl->lethal_temperature();
+        return *generators_[5];
     }
 
     Generator& movement()
     {
-        return impl->movement();
+        return *generators_[6];
     }
 
     Generator& overpopulation()
     {
-        return impl->overpopulation();
+        return *generators_[7];
     }
 
     Generator& survival_rate()
     {
-        return impl->survival_rate();
+        return *generators_[8];
     }
 
     Generator& soil()
     {
-        return impl->soil();
+        return *generators_[9];
     }
 
     // API to behave like the underlying generator.
@@ -488,7 +571,7 @@ public:
                 "RandomNumberGeneratorProvider used as a single generator "
                 "but it is set to provide multiple isolated generators");
         }
-        return impl->disperser_generation().operator()();
+        return generators_[0]->operator()();
     }
 
     /* Throws std::runtime_error if using multiple isolated generators */
@@ -499,12 +582,30 @@ public:
                 "RandomNumberGeneratorProvider used as a single generator "
                 "but it is set to provide multiple isolated generators");
         }
-        impl->disperser_generation().discard(n);
+        generators_[0]->discard(n);
     }
 
 private:
+    /** Store pointers to generators for all purposes */
+    void cache_generators()
+    {
+        generators_ = {
+            &impl->disperser_generation(),
+            &impl->natural_dispersal(),
+            &impl->anthropogenic_dispersal(),
+            &impl->establishment(),
+            &impl->weather(),
+            &impl->lethal_temperature(),
+            &impl->movement(),
+            &impl->overpopulation(),
+            &impl->survival_rate(),
+            &impl->soil()};
+    }
+
     std::unique_ptr<RandomNumberGeneratorProviderInterface<Generator>> impl;
     bool mutli_ = false;
+    /** Generators in the order of the purpose functions */
+    std::array<Generator*, 10> generators_;
 };
 
 /**
@@ -20,8 +20,13 @@
 #include <random>
 #include <stdexcept>
 #include <algorithm>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <utility>
 
 #include "host_pool_interface.hpp"
+#include "infection_observer_interface.hpp"
 #include "model_type.hpp"
 #include "environment_interface.hpp"
 #include "competency_table.hpp"
@@ -62,6 +67,15 @@ public:
      * Standard random number generator to be passed directly to the methods.
      */
     using Generator = typename GeneratorProvider::Generator;
+    /**
+     * Type of values (host counts) stored in the integer rasters.
+     *
+     * Types narrower than int (e.g., std::int16_t or std::uint16_t) can be used to
+     * reduce memory use. All changes of counts done by the host pool are then checked
+     * to fit into the type.
+     */
+    using Count = typename std::decay<decltype(
+        std::declval<const IntegerRaster&>()(RasterIndex(), RasterIndex()))>::type;
 
     /**
      * @brief Creates an object with stored references and host properties.
@@ -307,15 +321,17 @@ public:
     {
         if (susceptible_(row, col) <= 0)
             return 0;
-        susceptible_(row, col) -= 1;
+        change_count_at(susceptible_, row, col, -1);
         if (model_type_ == ModelType::SusceptibleInfected) {
-            infected_(row, col) += 1;
+            change_count_at(infected_, row, col, 1);
+            if (infected_(row, col) == 1)
+                notify_infection_change(row, col, true);
             if (use_mortality_)
-                mortality_tracker_vector_.back()(row, col) += 1;
+                change_count_at(mortality_tracker_vector_.back(), row, col, 1);
         }
         else if (model_type_ == ModelType::SusceptibleExposedInfected) {
-            exposed_.back()(row, col) += 1;
-            total_exposed_(row, col) += 1;
+            change_count_at(exposed_.back(), row, col, 1);
+            change_count_at(total_exposed_, row, col, 1);
         }
         else {
             throw std::runtime_error(
@@ -410,8 +426,10 @@ public:
     pests_from(RasterIndex row, RasterIndex col, int count, const Generator& generator)
     {
         UNUSED(generator);
-        susceptible_(row, col) += count;
-        infected_(row, col) -= count;
+        int before = infected_(row, col);
+        change_count_at(susceptible_, row, col, count);
+        change_count_at(infected_, row, col, -count);
+        notify_if_infection_changed(row, col, before);
         return count;
     }
 
@@ -446,17 +464,19 @@ public:
     pests_to(RasterIndex row, RasterIndex col, int count, const Generator& generator)
     {
         UNUSED(generator);
+        int before = infected_(row, col);
         // The target cell can accept all.
         if (susceptible_(row, col) >= count) {
-            susceptible_(row, col) -= count;
-            infected_(row, col) += count;
+            change_count_at(susceptible_, row, col, -count);
+            change_count_at(infected_, row, col, count);
         }
         // More pests than the target cell can accept.
         else {
             count = susceptible_(row, col);
-            susceptible_(row, col) -= count;
-            infected_(row, col) += count;
+            change_count_at(susceptible_, row, col, -count);
+            change_count_at(infected_, row, col, count);
         }
+        notify_if_infection_changed(row, col, before);
         return count;
     }
 
@@ -512,8 +532,8 @@ public:
                 exposed_, exposed_moved, row_from, col_from, generator);
             int index = 0;
             for (auto& raster : exposed_) {
-                raster(row_from, col_from) -= exposed_draw[index];
-                raster(row_to, col_to) += exposed_draw[index];
+                change_count_at(raster, row_from, col_from, -exposed_draw[index]);
+                change_count_at(raster, row_to, col_to, exposed_draw[index]);
                 index += 1;
             }
         }
@@ -526,8 +546,8 @@ public:
                 generator);
             int index = 0;
             for (auto& raster : mortality_tracker_vector_) {
-                raster(row_from, col_from) -= mortality_draw[index];
-                raster(row_to, col_to) += mortality_draw[index];
+                change_count_at(raster, row_from, col_from, -mortality_draw[index]);
+                change_count_at(raster, row_to, col_to, mortality_draw[index]);
                 index += 1;
             }
         }
@@ -541,16 +561,20 @@ public:
             }
         }
 
-        infected_(row_from, col_from) -= infected_moved;
-        susceptible_(row_from, col_from) -= susceptible_moved;
-        total_hosts_(row_from, col_from) -= total_hosts_moved;
-        total_exposed_(row_from, col_from) -= exposed_moved;
-        resistant_(row_from, col_from) -= resistant_moved;
-        infected_(row_to, col_to) += infected_moved;
-        susceptible_(row_to, col_to) += susceptible_moved;
-        total_hosts_(row_to, col_to) += total_hosts_moved;
-        total_exposed_(row_to, col_to) += exposed_moved;
-        resistant_(row_to, col_to) += resistant_moved;
+        int infected_from_before = infected_(row_from, col_from);
+        int infected_to_before = infected_(row_to, col_to);
+        change_count_at(infected_, row_from, col_from, -infected_moved);
+        change_count_at(susceptible_, row_from, col_from, -susceptible_moved);
+        change_count_at(total_hosts_, row_from, col_from, -total_hosts_moved);
+        change_count_at(total_exposed_, row_from, col_from, -exposed_moved);
+        change_count_at(resistant_, row_from, col_from, -resistant_moved);
+        change_count_at(infected_, row_to, col_to, infected_moved);
+        change_count_at(susceptible_, row_to, col_to, susceptible_moved);
+        change_count_at(total_hosts_, row_to, col_to, total_hosts_moved);
+        change_count_at(total_exposed_, row_to, col_to, exposed_moved);
+        change_count_at(resistant_, row_to, col_to, resistant_moved);
+        notify_if_infection_changed(row_from, col_from, infected_from_before);
+        notify_if_infection_changed(row_to, col_to, infected_to_before);
 
         // Returned total hosts actually moved is based only on the total host and no
         // other checks are performed. This assumes that the counts are correct in the
@@ -583,7 +607,7 @@ public:
         const std::vector<int>& mortality)
     {
         if (susceptible > 0)
-            susceptible_(row, col) = susceptible_(row, col) - susceptible;
+            change_count_at(susceptible_, row, col, -susceptible);
 
         if (exposed.size() != exposed_.size()) {
             throw std::invalid_argument(
@@ -595,14 +619,18 @@ public:
 
         // no simple zip in C++, falling back to indices
         for (size_t i = 0; i < exposed.size(); ++i) {
-            exposed_[i](row, col) -= exposed[i];
+            change_count_at(exposed_[i], row, col, -exposed[i]);
         }
 
         // Possibly reuse in the I->S removal.
-        if (infected <= 0)
+        if (infected <= 0) {
+            reset_total_host(row, col);
             return;
+        }
         if (!use_mortality_) {
-            infected_(row, col) -= infected;
+            int before = infected_(row, col);
+            change_count_at(infected_, row, col, -infected);
+            notify_if_infection_changed(row, col, before);
             reset_total_host(row, col);
             return;
         }
@@ -623,8 +651,7 @@ public:
                     + ") for cell (" + std::to_string(row) + ", " + std::to_string(col)
                     + ")");
             }
-            mortality_tracker_vector_[i](row, col) =
-                mortality_tracker_vector_[i](row, col) - mortality[i];
+            change_count_at(mortality_tracker_vector_[i], row, col, -mortality[i]);
             mortality_total += mortality[i];
         }
         if (infected != mortality_total) {
@@ -643,7 +670,9 @@ public:
                 + ") for cell (" + std::to_string(row) + ", " + std::to_string(col)
                 + ")");
         }
-        infected_(row, col) -= infected;
+        int before = infected_(row, col);
+        change_count_at(infected_, row, col, -infected);
+        notify_if_infection_changed(row, col, before);
         reset_total_host(row, col);
     }
 
@@ -664,7 +693,9 @@ public:
         RasterIndex row, RasterIndex col, int count, Generator& generator)
     {
         // remove percentage of infestation/infection in the infected class
-        infected_(row, col) -= count;
+        int before = infected_(row, col);
+        change_count_at(infected_, row, col, -count);
+        notify_if_infection_changed(row, col, before);
         // remove the removed infected from mortality cohorts
         if (use_mortality_) {
             if (count > 0) {
@@ -672,13 +703,13 @@ public:
                     mortality_tracker_vector_, count, row, col, generator);
                 int index = 0;
                 for (auto& raster : mortality_tracker_vector_) {
-                    raster(row, col) -= mortality_draw[index];
+                    change_count_at(raster, row, col, -mortality_draw[index]);
                     index += 1;
                 }
             }
         }
         // move infested/infected host back to susceptible pool
-        susceptible_(row, col) += count;
+        change_count_at(susceptible_, row, col, count);
     }
 
     /**
@@ -730,18 +761,18 @@ public:
     {
         // remove the same percentage for total exposed and remove randomly from
         // each cohort
-        total_exposed_(row, col) -= count;
+        change_count_at(total_exposed_, row, col, -count);
         if (count > 0) {
             std::vector<int> exposed_draw =
                 draw_n_from_cohorts(exposed_, count, row, col, generator);
             int index = 0;
             for (auto& raster : exposed_) {
-                raster(row, col) -= exposed_draw[index];
+                change_count_at(raster, row, col, -exposed_draw[index]);
                 index += 1;
             }
         }
         // move infested/infected host back to susceptible pool
-        susceptible_(row, col) += count;
+        change_count_at(susceptible_, row, col, count);
     }
 
     /**
@@ -779,7 +810,7 @@ public:
                 + std::to_string(row) + ", " + std::to_string(col) + ")");
         }
 
-        susceptible_(row, col) -= susceptible;
+        change_count_at(susceptible_, row, col, -susceptible);
         total_resistant += susceptible;
 
         if (exposed.size() != exposed_.size()) {
@@ -791,12 +822,14 @@ public:
         }
         // no simple zip in C++, falling back to indices
         for (size_t i = 0; i < exposed.size(); ++i) {
-            exposed_[i](row, col) -= exposed[i];
+            change_count_at(exposed_[i], row, col, -exposed[i]);
             total_resistant += exposed[i];
         }
-        infected_(row, col) -= infected;
+        int infected_before = infected_(row, col);
+        change_count_at(infected_, row, col, -infected);
+        notify_if_infection_changed(row, col, infected_before);
         total_resistant += infected;
-        resistant_(row, col) += total_resistant;
+        change_count_at(resistant_, row, col, total_resistant);
         if (!use_mortality_) {
             reset_total_host(row, col);
             return;
@@ -811,7 +844,7 @@ public:
         int mortality_total = 0;
         // no simple zip in C++, falling back to indices
         for (size_t i = 0; i < mortality_tracker_vector_.size(); ++i) {
-            mortality_tracker_vector_[i](row, col) -= mortality[i];
+            change_count_at(mortality_tracker_vector_[i], row, col, -mortality[i]);
             mortality_total += mortality[i];
         }
         // These two values will only match if we actually compute one from another
@@ -839,7 +872,7 @@ public:
      */
     void remove_resistance_at(RasterIndex row, RasterIndex col)
     {
-        susceptible_(row, col) += resistant_(row, col);
+        change_count_at(susceptible_, row, col, resistant_(row, col));
         resistant_(row, col) = 0;
     }
 
@@ -881,8 +914,9 @@ public:
                     mortality_in_index = std::lround(
                         mortality_rate * mortality_tracker_vector_[index](row, col));
                 }
-                mortality_tracker_vector_[index](row, col) -= mortality_in_index;
-                died_(row, col) += mortality_in_index;
+                change_count_at(
+                    mortality_tracker_vector_[index], row, col, -mortality_in_index);
+                change_count_at(died_, row, col, mortality_in_index);
                 if (mortality_in_index > infected_(row, col)) {
                     throw std::runtime_error(
                         "Mortality[" + std::to_string(index)
@@ -900,10 +934,12 @@ public:
                         + std::to_string(row) + ", " + std::to_string(col) + ")");
                 }
                 if (infected_(row, col) > 0) {
-                    infected_(row, col) -= mortality_in_index;
+                    change_count_at(infected_, row, col, -mortality_in_index);
+                    if (infected_(row, col) <= 0)
+                        notify_infection_change(row, col, false);
                 }
                 if (total_hosts_(row, col) > 0) {
-                    total_hosts_(row, col) -= mortality_in_index;
+                    change_count_at(total_hosts_, row, col, -mortality_in_index);
                 }
             }
         }
@@ -1138,11 +1174,32 @@ public:
             if (step >= latency_period_) {
                 // Oldest item needs to be in the front
                 auto& oldest = exposed_.front();
-                // Move hosts to infected raster
-                infected_ += oldest;
-                if (use_mortality_)
-                    mortality_tracker_vector_.back() += oldest;
-                total_exposed_ += (oldest * (-1));
+                if (checked_counts || !infection_observers_.empty()) {
+                    // Cell by cell to check counts and report changes. Only cells
+                    // with hosts can have exposed hosts, so suitable cells are enough.
+                    for (const auto& indices : suitable_cells_) {
+                        int i = indices[0];
+                        int j = indices[1];
+                        int count = oldest(i, j);
+                        if (count == 0)
+                            continue;
+                        int before = infected_(i, j);
+                        change_count_at(infected_, i, j, count);
+                        if (use_mortality_) {
+                            change_count_at(
+                                mortality_tracker_vector_.back(), i, j, count);
+                        }
+                        change_count_at(total_exposed_, i, j, -count);
+                        notify_if_infection_changed(i, j, before);
+                    }
+                }
+                else {
+                    // Move hosts to infected raster
+                    infected_ += oldest;
+                    if (use_mortality_)
+                        mortality_tracker_vector_.back() += oldest;
+                    total_exposed_ += (oldest * (-1));
+                }
                 // Reset the raster
                 // (hosts moved from the raster)
                 oldest.fill(0);
@@ -1175,6 +1232,59 @@ public:
         return suitable_cells_;
     }
 
+    /**
+     * @brief Add observer to be notified about changes in infection
+     *
+     * The observer is immediately notified about all currently infected cells (among
+     * suitable cells), so it does not need to be initialized separately. Afterwards,
+     * the observer is notified whenever number of infected hosts in a cell changes
+     * from zero to non-zero or back.
+     *
+     * The observer is not owned by the host pool and it needs to exist as long as it is
+     * added to the host pool.
+     *
+     * @param observer Observer to add
+     * @param notify_infected False if the observer already knows the infected cells,
+     * e.g., when it observed another host pool with the same rasters before
+     *
+     * @note Only changes done through the host pool are reported.
+     */
+    void add_infection_observer(
+        InfectionObserverInterface<RasterIndex>& observer, bool notify_infected = true)
+    {
+        infection_observers_.push_back(&observer);
+        if (!notify_infected)
+            return;
+        for (const auto& indices : suitable_cells_) {
+            if (infected_(indices[0], indices[1]) > 0)
+                observer.infection_changed(indices[0], indices[1], true);
+        }
+    }
+
+    /**
+     * @brief Remove observer added with add_infection_observer()
+     *
+     * @param observer Observer to remove
+     */
+    void remove_infection_observer(InfectionObserverInterface<RasterIndex>& observer)
+    {
+        infection_observers_.erase(
+            std::remove(
+                infection_observers_.begin(), infection_observers_.end(), &observer),
+            infection_observers_.end());
+    }
+
+    /**
+     * @brief Check whether any observers of infection changes were added
+     *
+     * Observers are not thread-safe, so changes in different cells can be done in
+     * parallel only when there are no observers.
+     */
+    bool has_infection_observers() const
+    {
+        return !infection_observers_.empty();
+    }
+
     /**
      * @brief Get list which contains this host pool
      *
@@ -1204,8 +1314,77 @@ private:
      */
     void reset_total_host(RasterIndex row, RasterIndex col)
     {
-        total_hosts_(row, col) = susceptible_(row, col) + computed_exposed_at(row, col)
-                                 + infected_(row, col) + resistant_(row, col);
+        set_count_at(
+            total_hosts_,
+            row,
+            col,
+            susceptible_(row, col) + computed_exposed_at(row, col) + infected_(row, col)
+                + resistant_(row, col));
+    }
+
+    /**
+     * @brief True if Count can't hold all int values and assignments need a check
+     */
+    static constexpr bool checked_counts =
+        std::numeric_limits<Count>::min() > std::numeric_limits<int>::min()
+        || std::numeric_limits<Count>::max() < std::numeric_limits<int>::max();
+
+    /**
+     * @brief Set count in a raster cell
+     *
+     * @throw std::overflow_error if the value does not fit into the raster value type
+     */
+    static void
+    set_count_at(IntegerRaster& raster, RasterIndex row, RasterIndex col, int value)
+    {
+        if (checked_counts
+            && (value < std::numeric_limits<Count>::min()
+                || value > std::numeric_limits<Count>::max())) {
+            throw std::overflow_error(
+                "Host count " + std::to_string(value)
+                + " is out of range of the raster value type ("
+                + std::to_string(std::numeric_limits<Count>::min()) + " to "
+                + std::to_string(std::numeric_limits<Count>::max()) + ") for cell ("
+                + std::to_string(row) + ", " + std::to_string(col) + ")");
+        }
+        raster(row, col) = static_cast<Count>(value);
+    }
+
+    /**
+     * @brief Add to count in a raster cell (negative value subtracts)
+     *
+     * @throw std::overflow_error if the result does not fit into the raster value type
+     */
+    static void
+    change_count_at(IntegerRaster& raster, RasterIndex row, RasterIndex col, int value)
+    {
+        if (checked_counts)
+            set_count_at(raster, row, col, raster(row, col) + value);
+        else
+            raster(row, col) += value;
+    }
+
+    /**
+     * @brief Notify observers that a cell became infected or not infected
+     */
+    void notify_infection_change(RasterIndex row, RasterIndex col, bool infected)
+    {
+        for (auto observer : infection_observers_)
+            observer->infection_changed(row, col, infected);
+    }
+
+    /**
+     * @brief Notify observers if infection in a cell changed
+     *
+     * @param row Row index of the cell
+     * @param col Column index of the cell
+     * @param before Number of infected hosts in the cell before the change
+     */
+    void notify_if_infection_changed(RasterIndex row, RasterIndex col, int before)
+    {
+        bool infected = infected_(row, col) > 0;
+        if ((before > 0) != infected)
+            notify_infection_change(row, col, infected);
     }
 
     IntegerRaster& susceptible_;
@@ -1240,6 +1419,9 @@ private:
     RasterIndex cols_{0};
 
     std::vector<std::vector<int>>& suitable_cells_;
+
+    /** Observers of infection changes (non-owning) */
+    std::vector<InfectionObserverInterface<RasterIndex>*> infection_observers_;
 };
 
 }  // namespace pops
@@ -0,0 +1,52 @@
+/*
+ * PoPS model - pest or pathogen spread simulation
+ *
+ * Copyright (C) 2023 by the authors.
+ *
+ * Authors: Vaclav Petras (wenzeslaus gmail com)
+ *
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef POPS_INFECTION_OBSERVER_INTERFACE_HPP
+#define POPS_INFECTION_OBSERVER_INTERFACE_HPP
+
+namespace pops {
+
+/**
+ * Interface for objects notified about changes of infection in host pools.
+ *
+ * A host pool notifies its observers when the number of infected hosts in a cell
+ * changes from zero to a non-zero value or from non-zero to zero. Changes which keep
+ * the cell infected (or not infected) are not reported.
+ *
+ * With multiple host pools, each host pool reports its own changes, so an observer
+ * registered with all of them is notified once for each host which became infected or
+ * not infected in a cell.
+ */
+template<typename RasterIndexType>
+class InfectionObserverInterface
+{
+public:
+    using RasterIndex = RasterIndexType;
+
+    virtual ~InfectionObserverInterface() {}
+
+    /**
+     * @brief Called when a cell becomes infected or not infected
+     *
+     * @param row Row index of the cell
+     * @param col Column index the cell
+     * @param infected true if the cell became infected, false if it has no infection
+     */
+    virtual void infection_changed(RasterIndex row, RasterIndex col, bool infected) = 0;
+};
+
+}  // namespace pops
+
+#endif  // POPS_INFECTION_OBSERVER_INTERFACE_HPP
@@ -0,0 +1,227 @@
+/*
+ * PoPS model - incremental tracking of infected cells
+ *
+ * Copyright (C) 2023 by the authors.
+ *
+ * Authors: Vaclav Petras (wenzeslaus gmail com)
+ *
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef POPS_INFECTION_TRACKER_HPP
+#define POPS_INFECTION_TRACKER_HPP
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "infection_observer_interface.hpp"
+#include "utils.hpp"
+
+namespace pops {
+
+/**
+ * Tracks extent of infection using change notifications from host pools.
+ *
+ * The tracker keeps number of infected cells in each row and column, so it can
+ * provide the bounding box of infection without going over all cells. The counts are
+ * updated only when a cell becomes infected or not infected.
+ *
+ * The tracker needs to be added to the host pool (using add_infection_observer()) which
+ * also reports the cells which are already infected. All subsequent changes need to
+ * go through the host pool. If the rasters are modified directly, the tracker needs to
+ * be cleared and added to the host pool again.
+ */
+template<typename RasterIndex>
+class InfectionExtentTracker : public InfectionObserverInterface<RasterIndex>
+{
+public:
+    /**
+     * @brief Create tracker with no infection
+     *
+     * @param rows Number of rows
+     * @param cols Number of columns
+     */
+    InfectionExtentTracker(RasterIndex rows, RasterIndex cols)
+        : row_counts_(rows, 0), col_counts_(cols, 0)
+    {}
+
+    void infection_changed(RasterIndex row, RasterIndex col, bool infected) override
+    {
+        int change = infected ? 1 : -1;
+        row_counts_[row] += change;
+        col_counts_[col] += change;
+        count_ += change;
+    }
+
+    /**
+     * @brief Get number of infected cells
+     *
+     * With multiple hosts, a cell is counted once for each infected host.
+     */
+    int count() const
+    {
+        return count_;
+    }
+
+    /**
+     * @brief Return true if there are no infected cells
+     */
+    bool empty() const
+    {
+        return count_ <= 0;
+    }
+
+    /**
+     * @brief Get bounding box of infected cells
+     *
+     * @return North, south, east, and west as row and column indices or -1 in all
+     * directions if there is no infection
+     */
+    BBoxInt boundary() const
+    {
+        if (empty())
+            return std::make_tuple(-1, -1, -1, -1);
+        return std::make_tuple(
+            first_nonzero(row_counts_),
+            last_nonzero(row_counts_),
+            last_nonzero(col_counts_),
+            first_nonzero(col_counts_));
+    }
+
+    /**
+     * @brief Forget all infected cells
+     */
+    void clear()
+    {
+        std::fill(row_counts_.begin(), row_counts_.end(), 0);
+        std::fill(col_counts_.begin(), col_counts_.end(), 0);
+        count_ = 0;
+    }
+
+private:
+    std::vector<int> row_counts_;
+    std::vector<int> col_counts_;
+    int count_{0};
+
+    static int first_nonzero(const std::vector<int>& counts)
+    {
+        for (size_t i = 0; i < counts.size(); ++i) {
+            if (counts[i] > 0)
+                return i;
+        }
+        return -1;
+    }
+
+    static int last_nonzero(const std::vector<int>& counts)
+    {
+        for (size_t i = counts.size(); i > 0; --i) {
+            if (counts[i - 1] > 0)
+                return i - 1;
+        }
+        return -1;
+    }
+};
+
+/**
+ * Tracks extent of infection in each zone and presence of infection outside of zones.
+ *
+ * Zones are given by a raster where 0 means no zone and positive integers are
+ * identifiers of the zones. This is the same representation as used for quarantine
+ * areas. Cells with other values are not tracked.
+ *
+ * Same as with InfectionExtentTracker, the tracker needs to be added to the host pool
+ * using add_infection_observer().
+ */
+template<typename IntegerRaster, typename RasterIndex>
+class ZonalInfectionExtentTracker : public InfectionObserverInterface<RasterIndex>
+{
+public:
+    /**
+     * @brief Create tracker with no infection
+     *
+     * The raster is referenced, not copied, so it needs to exist for the whole life
+     * of the tracker.
+     *
+     * @param zones Raster with zone identifiers
+     */
+    ZonalInfectionExtentTracker(const IntegerRaster& zones)
+        : zones_(zones), outside_(zones.rows(), zones.cols())
+    {
+        for (RasterIndex i = 0; i < zones.rows(); ++i) {
+            for (RasterIndex j = 0; j < zones.cols(); ++j) {
+                auto value = zones(i, j);
+                if (value > 0 && trackers_.find(value) == trackers_.end()) {
+                    trackers_.emplace(
+                        value,
+                        InfectionExtentTracker<RasterIndex>(
+                            zones.rows(), zones.cols()));
+                }
+            }
+        }
+    }
+
+    void infection_changed(RasterIndex row, RasterIndex col, bool infected) override
+    {
+        int value = zones_(row, col);
+        if (value == 0) {
+            outside_.infection_changed(row, col, infected);
+            return;
+        }
+        auto search = trackers_.find(value);
+        if (search != trackers_.end())
+            search->second.infection_changed(row, col, infected);
+    }
+
+    /**
+     * @brief Return true if there are infected cells outside of all zones
+     */
+    bool infected_outside() const
+    {
+        return !outside_.empty();
+    }
+
+    /**
+     * @brief Get tracker for a zone
+     *
+     * @param zone Zone identifier (value in the zone raster)
+     *
+     * @throw std::invalid_argument if there is no such zone
+     */
+    const InfectionExtentTracker<RasterIndex>& zone(int zone) const
+    {
+        auto search = trackers_.find(zone);
+        if (search == trackers_.end()) {
+            throw std::invalid_argument(
+                "ZonalInfectionExtentTracker: No zone " + std::to_string(zone));
+        }
+        return search->second;
+    }
+
+    /**
+     * @brief Forget all infected cells
+     */
+    void clear()
+    {
+        outside_.clear();
+        for (auto& item : trackers_)
+            item.second.clear();
+    }
+
+private:
+    const IntegerRaster& zones_;
+    InfectionExtentTracker<RasterIndex> outside_;
+    std::map<int, InfectionExtentTracker<RasterIndex>> trackers_;
+};
+
+}  // namespace pops
+
+#endif  // POPS_INFECTION_TRACKER_HPP
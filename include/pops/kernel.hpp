@@ -82,17 +82,72 @@ using DispersalKernel = NaturalAnthropogenicDispersalKernel<
     KernelInterface<Generator>,
     KernelInterface<Generator>>;
 
+/**
+ * @brief Create probability windows for deterministic kernels from configuration
+ *
+ * Windows are created only when the kernels are deterministic, i.e., when
+ * dispersal stochasticity is disabled and the kernel type is supported by
+ * DeterministicDispersalKernel.
+ *
+ * @param config Configuration for the kernels
+ * @param dispersers The disperser raster (reference, for deterministic kernel)
+ *
+ * @return Windows to pass to create_dynamic_kernel()
+ */
+template<typename IntegerRaster>
+DeterministicProbabilityWindows
+create_deterministic_windows(const Config& config, const IntegerRaster& dispersers)
+{
+    DeterministicProbabilityWindows windows;
+    if (config.dispersal_stochasticity)
+        return windows;
+    using Kernel = DeterministicDispersalKernel<IntegerRaster>;
+    auto natural_kernel = kernel_type_from_string(config.natural_kernel_type);
+    if (Kernel::supports_kernel(natural_kernel)) {
+        Kernel kernel(
+            natural_kernel,
+            dispersers,
+            config.dispersal_percentage,
+            config.ew_res,
+            config.ns_res,
+            config.natural_scale,
+            config.shape);
+        windows.natural = kernel.probability_window();
+    }
+    auto anthro_kernel = kernel_type_from_string(config.anthro_kernel_type);
+    if (Kernel::supports_kernel(anthro_kernel)) {
+        Kernel kernel(
+            anthro_kernel,
+            dispersers,
+            config.dispersal_percentage,
+            config.ew_res,
+            config.ns_res,
+            config.anthro_scale,
+            config.shape);
+        windows.anthro = kernel.probability_window();
+    }
+    return windows;
+}
+
+/**
+ * @brief Create dispersal kernel from configuration
+ *
+ * Deterministic kernels use the given probability windows when available, so
+ * kernels created repeatedly in one step share the windows (see
+ * create_deterministic_windows()).
+ */
 template<typename Generator, typename IntegerRaster, typename RasterIndex>
 DispersalKernel<Generator> create_dynamic_kernel(
     const Config& config,
     const IntegerRaster& dispersers,
-    const Network<RasterIndex>& network)
+    const Network<RasterIndex>& network,
+    const DeterministicProbabilityWindows& windows = {})
 {
     return DispersalKernel<Generator>(
         create_natural_kernel<Generator, IntegerRaster, RasterIndex>(
-            config, dispersers),
+            config, dispersers, windows.natural),
         create_anthro_kernel<Generator, IntegerRaster, RasterIndex>(
-            config, dispersers, network),
+            config, dispersers, network, windows.anthro),
         config.use_anthropogenic_kernel,
         config.percent_natural_dispersal);
 }
@@ -0,0 +1,493 @@
+/*
+ * PoPS model - read-only files mapped to memory and arrays using them
+ *
+ * Copyright (C) 2023 by the authors.
+ *
+ * Authors: Vaclav Petras <wenzeslaus gmail com>
+ *
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef POPS_MAPPED_FILE_HPP
+#define POPS_MAPPED_FILE_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define POPS_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "utils.hpp"
+
+namespace pops {
+
+/** How a file is mapped to memory */
+enum class MappingMode
+{
+    ReadOnly,  ///< Read existing file, pages are shared with other processes
+    ReadWrite,  ///< Read and write existing file, changes are written to the file
+    CopyOnWrite,  ///< Read existing file, changes are private and not written
+    Create,  ///< Create (or overwrite) file with the given size, read and write
+};
+
+/** Expected pattern of access to the mapped memory (hint for the system) */
+enum class MappingAccess
+{
+    Normal,  ///< No special treatment
+    Sequential,  ///< Pages are accessed in order, read ahead aggressively
+    Random,  ///< Pages are accessed in random order, don't read ahead
+    WillNeed,  ///< Pages will be needed soon, start reading them now
+    DontNeed,  ///< Pages won't be needed soon, they can be freed
+};
+
+/**
+ * File (or its part) mapped to memory
+ *
+ * The file is mapped using mmap, so the content is loaded only when accessed and
+ * multiple processes reading the same file share the same pages in the page
+ * cache. The mapped part may start at an offset in the file, e.g., after a header.
+ *
+ * On systems without memory mapping, the file is read to memory for read-only and
+ * copy-on-write modes and the other modes are not supported.
+ */
+class MappedFile
+{
+public:
+    /** Size used to map the file from the offset to its end */
+    static constexpr std::size_t to_end = std::size_t(-1);
+
+    /**
+     * @brief Map a file
+     *
+     * @param path Path to the file
+     * @param mode How to map the file
+     * @param offset Position of the first mapped byte in the file
+     * @param size Number of mapped bytes (required for MappingMode::Create)
+     *
+     * @throw std::runtime_error when the file cannot be opened or mapped or when the
+     * file is smaller than the mapped part
+     */
+    explicit MappedFile(
+        const std::string& path,
+        MappingMode mode = MappingMode::ReadOnly,
+        std::size_t offset = 0,
+        std::size_t size = to_end)
+        : path_(path), mode_(mode)
+    {
+        if (mode == MappingMode::Create && size == to_end) {
+            throw std::invalid_argument(
+                "MappedFile: Size is required to create file " + path);
+        }
+#if defined(POPS_HAVE_MMAP)
+        int flags = O_RDONLY;
+        if (mode == MappingMode::ReadWrite)
+            flags = O_RDWR;
+        else if (mode == MappingMode::Create)
+            flags = O_RDWR | O_CREAT | O_TRUNC;
+        int fd = ::open(path.c_str(), flags, 0644);
+        if (fd < 0)
+            throw_system_error("Cannot open file");
+        if (mode == MappingMode::Create) {
+            if (::ftruncate(fd, static_cast<off_t>(offset + size)) != 0) {
+                ::close(fd);
+                throw_system_error("Cannot set size of file");
+            }
+        }
+        else {
+            struct stat info;
+            if (::fstat(fd, &info) != 0) {
+                ::close(fd);
+                throw_system_error("Cannot get size of file");
+            }
+            try {
+                size = checked_size(
+                    static_cast<std::size_t>(info.st_size), offset, size);
+            }
+            catch (...) {
+                ::close(fd);
+                throw;
+            }
+        }
+        size_ = size;
+        // The mapping needs to start at a page boundary.
+        std::size_t map_offset = offset - offset % page_size();
+        length_ = offset - map_offset + size;
+        int protection = PROT_READ;
+        if (mode != MappingMode::ReadOnly)
+            protection |= PROT_WRITE;
+        int sharing = mode == MappingMode::CopyOnWrite ? MAP_PRIVATE : MAP_SHARED;
+        if (length_) {
+            void* address =
+                ::mmap(nullptr, length_, protection, sharing, fd, off_t(map_offset));
+            if (address == MAP_FAILED) {
+                ::close(fd);
+                throw_system_error("Cannot map file");
+            }
+            address_ = address;
+            data_ = static_cast<char*>(address_) + (offset - map_offset);
+        }
+        // The mapping stays valid after the file is closed.
+        ::close(fd);
+#else
+        if (mode == MappingMode::ReadWrite || mode == MappingMode::Create) {
+            throw std::runtime_error(
+                "MappedFile: Writable memory-mapped files are not supported on this "
+                "platform");
+        }
+        std::ifstream stream(path, std::ios::binary | std::ios::ate);
+        if (!stream)
+            throw_system_error("Cannot open file");
+        size_ = checked_size(static_cast<std::size_t>(stream.tellg()), offset, size);
+        buffer_.resize(size_);
+        stream.seekg(static_cast<std::streamoff>(offset));
+        if (!stream.read(buffer_.data(), static_cast<std::streamsize>(size_)))
+            throw_system_error("Cannot read file");
+        data_ = buffer_.data();
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other)
+        : path_(std::move(other.path_)),
+          mode_(other.mode_),
+          address_(other.address_),
+          length_(other.length_),
+          data_(other.data_),
+          size_(other.size_)
+#if !defined(POPS_HAVE_MMAP)
+          ,
+          buffer_(std::move(other.buffer_))
+#endif
+    {
+        other.address_ = nullptr;
+        other.length_ = 0;
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+
+    ~MappedFile()
+    {
+#if defined(POPS_HAVE_MMAP)
+        if (address_)
+            ::munmap(address_, length_);
+#endif
+    }
+
+    /** Get the mapped content */
+    const char* data() const
+    {
+        return data_;
+    }
+
+    /**
+     * @brief Get the mapped content for writing
+     *
+     * Writing is allowed only when the file is not mapped read-only.
+     */
+    char* data()
+    {
+        return data_;
+    }
+
+    /** Get size of the mapped content in bytes */
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    /** Get path to the file */
+    const std::string& path() const
+    {
+        return path_;
+    }
+
+    MappingMode mode() const
+    {
+        return mode_;
+    }
+
+    /**
+     * @brief Write changes to the file now
+     *
+     * The changes are written by the system eventually even without calling this
+     * function. Does nothing for read-only and copy-on-write mappings.
+     *
+     * @throw std::runtime_error when the synchronization fails
+     */
+    void sync()
+    {
+#if defined(POPS_HAVE_MMAP)
+        if (mode_ == MappingMode::ReadOnly || mode_ == MappingMode::CopyOnWrite)
+            return;
+        if (address_ && ::msync(address_, length_, MS_SYNC) != 0)
+            throw_system_error("Cannot write changes to file");
+#endif
+    }
+
+    /**
+     * @brief Tell the system how the whole content will be accessed
+     *
+     * The advice is only a hint, so failures are ignored.
+     */
+    void advise(MappingAccess access)
+    {
+        advise_mapping(address_, length_, access);
+    }
+
+    /**
+     * @brief Tell the system how a part of the content will be accessed
+     *
+     * The part is extended to whole pages and limited to the mapped content.
+     *
+     * @param begin Position of the first byte of the part in the content
+     * @param length Number of bytes in the part
+     * @param access Expected access
+     */
+    void advise(std::size_t begin, std::size_t length, MappingAccess access)
+    {
+        if (!address_)
+            return;
+        auto start = static_cast<std::size_t>(data_ - static_cast<char*>(address_));
+        std::size_t first = start + begin;
+        std::size_t last = std::min(length_, first + length);
+        first -= first % page_size();
+        if (first < last)
+            advise_mapping(static_cast<char*>(address_) + first, last - first, access);
+    }
+
+    /** Get size of memory page in bytes */
+    static std::size_t page_size()
+    {
+#if defined(POPS_HAVE_MMAP)
+        return static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+#else
+        return 4096;
+#endif
+    }
+
+private:
+    std::string path_;
+    MappingMode mode_;
+    void* address_{nullptr};
+    std::size_t length_{0};
+    char* data_{nullptr};
+    std::size_t size_{0};
+#if !defined(POPS_HAVE_MMAP)
+    std::vector<char> buffer_;
+#endif
+
+    /** Get size of the mapped part and check that the file is large enough */
+    std::size_t
+    checked_size(std::size_t file_size, std::size_t offset, std::size_t size) const
+    {
+        if (size == to_end && offset <= file_size)
+            return file_size - offset;
+        if (size == to_end || file_size < offset + size) {
+            throw std::runtime_error(
+                "MappedFile: File " + path_ + " has " + std::to_string(file_size)
+                + " bytes, but "
+                + std::to_string(offset + (size == to_end ? 0 : size))
+                + " bytes are needed");
+        }
+        return size;
+    }
+
+    static void advise_mapping(void* address, std::size_t length, MappingAccess access)
+    {
+#if defined(POPS_HAVE_MMAP)
+        if (!address || !length)
+            return;
+        int advice = POSIX_MADV_NORMAL;
+        switch (access) {
+        case MappingAccess::Normal:
+            advice = POSIX_MADV_NORMAL;
+            break;
+        case MappingAccess::Sequential:
+            advice = POSIX_MADV_SEQUENTIAL;
+            break;
+        case MappingAccess::Random:
+            advice = POSIX_MADV_RANDOM;
+            break;
+        case MappingAccess::WillNeed:
+            advice = POSIX_MADV_WILLNEED;
+            break;
+        case MappingAccess::DontNeed:
+            advice = POSIX_MADV_DONTNEED;
+            break;
+        }
+        // The advice is only a hint, so the result is ignored.
+        ::posix_madvise(address, length, advice);
+#else
+        UNUSED(address);
+        UNUSED(length);
+        UNUSED(access);
+#endif
+    }
+
+    [[noreturn]] void throw_system_error(const std::string& message) const
+    {
+        throw std::runtime_error(
+            "MappedFile: " + message + " " + path_ + ": " + std::strerror(errno));
+    }
+};
+
+/**
+ * Constant array which either owns its values or uses values owned by another object
+ *
+ * The values are either in a vector owned by the array or in memory kept alive by
+ * a shared owner, e.g., in a file mapped to memory (see MappedFile), so that values
+ * can be used without copying them. Copies of an array with shared values share the
+ * values. Copies of an array with owned values copy the values.
+ */
+template<typename Value>
+class SharedArray
+{
+public:
+    using value_type = Value;
+    using const_iterator = const Value*;
+    using size_type = std::size_t;
+
+    /** Create an empty array */
+    SharedArray() = default;
+
+    /** Create an array owning the values */
+    SharedArray(std::vector<Value> values) : values_(std::move(values))
+    {
+        point_to_values();
+    }
+
+    /**
+     * @brief Create an array using values owned by another object
+     *
+     * @param data Pointer to the first value
+     * @param size Number of values
+     * @param owner Object which keeps the values alive
+     */
+    SharedArray(const Value* data, std::size_t size, std::shared_ptr<const void> owner)
+        : data_(data), size_(size), owner_(std::move(owner))
+    {}
+
+    SharedArray(const SharedArray& other)
+        : values_(other.values_),
+          data_(other.data_),
+          size_(other.size_),
+          owner_(other.owner_)
+    {
+        if (!owner_)
+            point_to_values();
+    }
+
+    SharedArray(SharedArray&& other)
+        : values_(std::move(other.values_)),
+          data_(other.data_),
+          size_(other.size_),
+          owner_(std::move(other.owner_))
+    {
+        if (!owner_)
+            point_to_values();
+        other.values_.clear();
+        other.point_to_values();
+    }
+
+    SharedArray& operator=(SharedArray other)
+    {
+        std::swap(values_, other.values_);
+        std::swap(owner_, other.owner_);
+        data_ = other.data_;
+        size_ = other.size_;
+        if (!owner_)
+            point_to_values();
+        return *this;
+    }
+
+    /** Replace the values by the given owned values */
+    SharedArray& operator=(std::vector<Value> values)
+    {
+        values_ = std::move(values);
+        owner_.reset();
+        point_to_values();
+        return *this;
+    }
+
+    const Value* data() const
+    {
+        return data_;
+    }
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    const Value* begin() const
+    {
+        return data_;
+    }
+
+    const Value* end() const
+    {
+        return data_ + size_;
+    }
+
+    const Value& front() const
+    {
+        return data_[0];
+    }
+
+    const Value& back() const
+    {
+        return data_[size_ - 1];
+    }
+
+    const Value& operator[](std::size_t index) const
+    {
+        return data_[index];
+    }
+
+    /** Return true if the values are owned by another object */
+    bool is_shared() const
+    {
+        return static_cast<bool>(owner_);
+    }
+
+private:
+    void point_to_values()
+    {
+        data_ = values_.data();
+        size_ = values_.size();
+    }
+
+    std::vector<Value> values_;
+    const Value* data_{nullptr};
+    std::size_t size_{0};
+    std::shared_ptr<const void> owner_;
+};
+
+}  // namespace pops
+
+#endif  // POPS_MAPPED_FILE_HPP
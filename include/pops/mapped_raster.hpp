@@ -0,0 +1,182 @@
+/*
+ * PoPS model - rasters stored in memory-mapped files
+ *
+ * Copyright (C) 2023 by the authors.
+ *
+ * Authors: Vaclav Petras <wenzeslaus gmail com>
+ *
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef POPS_MAPPED_RASTER_HPP
+#define POPS_MAPPED_RASTER_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#include "mapped_file.hpp"
+#include "raster.hpp"
+
+namespace pops {
+
+/**
+ * Raster with values stored in a file mapped to memory.
+ *
+ * The file contains the cell values as a raw array in row-major order, i.e., the
+ * same layout as the one used by Raster. The values may start at an offset in the
+ * file, e.g., after a header. The file is mapped using mmap, so the values are
+ * loaded only when accessed and rasters larger than the available memory can be
+ * used. When multiple processes map the same file read-only, e.g., replicates
+ * running in parallel, they share the same pages in the page cache.
+ *
+ * The values are accessed through a non-owning Raster (see raster()), so the mapped
+ * raster can be used anywhere a Raster can be used. The Raster object is valid as
+ * long as the MappedRaster object exists. Values are written to the file using
+ * operator(), fill(), the in-place operators, or by assigning a lazy expression
+ * (see RasterExpression). Copy assignment of another raster replaces the storage,
+ * so it disconnects the raster from the file.
+ *
+ * The file is mapped using MappedFile. Memory mapping is available only on
+ * Unix-like systems. On other systems, read-only and copy-on-write rasters are read
+ * to memory and the other modes throw an exception.
+ */
+template<typename Number, typename Index = int>
+class MappedRaster
+{
+public:
+    using RasterType = Raster<Number, Index>;
+
+    /**
+     * @brief Map a file
+     *
+     * @param path Path to the file
+     * @param rows Number of rows
+     * @param cols Number of columns
+     * @param mode How to map the file
+     * @param offset Position of the first value in the file in bytes
+     *
+     * @throw std::runtime_error when the file cannot be opened or mapped or when the
+     * file is smaller than the raster
+     */
+    MappedRaster(
+        const std::string& path,
+        Index rows,
+        Index cols,
+        MappingMode mode = MappingMode::ReadOnly,
+        std::size_t offset = 0)
+        : file_(
+            path, mode, offset, std::size_t(rows) * std::size_t(cols) * sizeof(Number)),
+          raster_(reinterpret_cast<Number*>(file_.data()), rows, cols)
+    {}
+
+    /**
+     * @brief Get raster using the mapped values
+     *
+     * @throw std::logic_error when the file is mapped read-only (use the const
+     * version instead)
+     */
+    RasterType& raster()
+    {
+        if (file_.mode() == MappingMode::ReadOnly) {
+            throw std::logic_error(
+                "MappedRaster: File " + file_.path()
+                + " is mapped read-only, use a const object to access it");
+        }
+        return raster_;
+    }
+
+    /**
+     * @brief Get read-only raster using the mapped values
+     */
+    const RasterType& raster() const
+    {
+        return raster_;
+    }
+
+    /**
+     * @brief Write changes to the file now
+     *
+     * The changes are written by the system eventually even without calling this
+     * function. Does nothing for read-only and copy-on-write mappings.
+     *
+     * @throw std::runtime_error when the synchronization fails
+     */
+    void sync()
+    {
+        file_.sync();
+    }
+
+    /**
+     * @brief Tell the system how the whole raster will be accessed
+     *
+     * The advice is only a hint, so failures are ignored.
+     */
+    void advise(MappingAccess access)
+    {
+        file_.advise(access);
+    }
+
+    /**
+     * @brief Tell the system which parts of the raster will be accessed
+     *
+     * Pages with the given cells are requested to be loaded ahead of time. When the
+     * cells are in row-major order (as the suitable cells are), the whole mapping
+     * is marked for sequential access, otherwise for random access.
+     *
+     * Use this with suitable cells for rasters which are accessed only at the
+     * suitable cells such as host rasters.
+     *
+     * @param cells List of row and column indices
+     */
+    template<typename Cells>
+    void advise_cells(const Cells& cells)
+    {
+        if (!file_.size() || cells.empty())
+            return;
+        bool sorted = true;
+        std::size_t page = MappedFile::page_size();
+        std::size_t first_page = std::size_t(-1);
+        std::size_t last_page = 0;
+        std::size_t previous = 0;
+        for (const auto& cell : cells) {
+            std::size_t position =
+                std::size_t(cell[0]) * std::size_t(raster_.cols()) + cell[1];
+            if (position < previous)
+                sorted = false;
+            previous = position;
+            std::size_t cell_page = position * sizeof(Number) / page;
+            if (first_page != std::size_t(-1) && cell_page <= last_page + 1
+                && cell_page >= first_page) {
+                last_page = std::max(last_page, cell_page);
+                continue;
+            }
+            if (first_page != std::size_t(-1))
+                advise_pages(first_page, last_page, MappingAccess::WillNeed);
+            first_page = cell_page;
+            last_page = cell_page;
+        }
+        advise_pages(first_page, last_page, MappingAccess::WillNeed);
+        advise(sorted ? MappingAccess::Sequential : MappingAccess::Random);
+    }
+
+private:
+    MappedFile file_;
+    RasterType raster_;
+
+    void advise_pages(std::size_t first, std::size_t last, MappingAccess access)
+    {
+        std::size_t page = MappedFile::page_size();
+        file_.advise(first * page, (last - first + 1) * page, access);
+    }
+};
+
+}  // namespace pops
+
+#endif  // POPS_MAPPED_RASTER_HPP
@@ -38,7 +38,12 @@
 #include "quarantine.hpp"
 #include "soils.hpp"
 #include "generator_provider.hpp"
+#include "spatial_decomposition.hpp"
+#include "run_plan.hpp"
 
+#include <algorithm>
+#include <memory>
+#include <type_traits>
 #include <vector>
 
 namespace pops {
@@ -49,11 +54,16 @@ template<
     typename RasterIndex,
     typename Generator = std::default_random_engine,
     typename KernelFactory = DispersalKernel<Generator>(
-        const Config&, const IntegerRaster&, const Network<RasterIndex>&)>
+        const Config&,
+        const IntegerRaster&,
+        const Network<RasterIndex>&,
+        const DeterministicProbabilityWindows&)>
 class Model
 {
 protected:
     Config config_;
+    /** Options and schedules from config resolved for the run */
+    RunPlan plan_;
     RandomNumberGeneratorProvider<Generator> generator_provider_;
     DispersalKernelType natural_kernel;
     DispersalKernelType anthro_kernel;
@@ -80,6 +90,15 @@ protected:
         RandomNumberGeneratorProvider<Generator>>>
         soil_pool_{nullptr};
     unsigned last_index{0};
+    /** Observer of infection kept across steps (non-owning) */
+    struct StepObserver
+    {
+        InfectionObserverInterface<RasterIndex>* observer;
+        /** True if the observer was notified about the infected cells */
+        bool initialized;
+    };
+    /** Observers added to host pools created from rasters in each step */
+    std::vector<StepObserver> infection_observers_;
 
     /**
      * @brief Create overpopulation movement kernel
@@ -101,7 +120,7 @@ protected:
             config_.ns_res,
             natural_kernel,
             config_.natural_scale * config_.leaving_scale_coefficient,
-            direction_from_string(config_.natural_direction),
+            plan_.natural_direction(),
             config_.natural_kappa,
             config_.shape);
         DeterministicDispersalKernel<IntegerRaster> deterministic_kernel(
@@ -125,6 +144,50 @@ protected:
         return selectable_kernel;
     }
 
+    /**
+     * True if the kernel factory accepts probability windows of deterministic
+     * kernels (as create_dynamic_kernel() does)
+     */
+    static constexpr bool factory_takes_windows = std::is_invocable<
+        KernelFactory&,
+        const Config&,
+        const IntegerRaster&,
+        const Network<RasterIndex>&,
+        const DeterministicProbabilityWindows&>::value;
+
+    /**
+     * @brief Create dispersal kernel using the kernel factory
+     *
+     * Probability windows are passed only to factories which accept them.
+     */
+    auto create_kernel(
+        const IntegerRaster& dispersers,
+        const Network<RasterIndex>& network,
+        const DeterministicProbabilityWindows& windows)
+    {
+        if constexpr (factory_takes_windows) {
+            return kernel_factory_(config_, dispersers, network, windows);
+        }
+        else {
+            UNUSED(windows);
+            return kernel_factory_(config_, dispersers, network);
+        }
+    }
+
+    /**
+     * @brief Get seed for spread in tiles
+     *
+     * Combines the single seed and all named seeds, so that any change in seeds
+     * changes the result.
+     */
+    unsigned spread_seed() const
+    {
+        unsigned seed = static_cast<unsigned>(config_.random_seed);
+        for (const auto& item : config_.random_seeds)
+            seed = derive_seed(seed, item.second);
+        return seed;
+    }
+
 public:
     /** Type for single-host pool */
     using StandardSingleHostPool = HostPool<
@@ -147,12 +210,13 @@ public:
         KernelFactory& kernel_factory =
             create_dynamic_kernel<Generator, IntegerRaster, RasterIndex>)
         : config_(config),
+          plan_(config),
           generator_provider_(config),
-          natural_kernel(kernel_type_from_string(config.natural_kernel_type)),
-          anthro_kernel(kernel_type_from_string(config.anthro_kernel_type)),
+          natural_kernel(plan_.natural_kernel_type()),
+          anthro_kernel(plan_.anthro_kernel_type()),
           uniform_kernel(config.rows, config.cols),
-          natural_neighbor_kernel(direction_from_string(config.natural_direction)),
-          anthro_neighbor_kernel(direction_from_string(config.anthro_direction)),
+          natural_neighbor_kernel(plan_.natural_direction()),
+          anthro_neighbor_kernel(plan_.anthro_direction()),
           kernel_factory_(kernel_factory)
     {}
 
@@ -171,6 +235,9 @@ public:
      * dispersers, but only the number of dispersers generated (and subsequently
      * used) in this step. There are no dispersers in between simulation steps.
      *
+     * Observers added with add_infection_observer() are notified about changes in
+     * infection, so *quarantine* can use a tracker of infection.
+     *
      * @param step Step number in the simulation
      * @param[in,out] infected Infected hosts
      * @param[in,out] susceptible Susceptible hosts
@@ -240,6 +307,12 @@ public:
             suitable_cells);
         std::vector<StandardSingleHostPool*> host_pools = {&host_pool};
         StandardMultiHostPool multi_host_pool(host_pools, config_);
+        // Observers are up to date from the previous steps, so they are notified
+        // about all infected cells only in the first step.
+        for (auto& item : infection_observers_) {
+            multi_host_pool.add_infection_observer(*item.observer, !item.initialized);
+            item.initialized = true;
+        }
         StandardPestPool pest_pool{
             dispersers, established_dispersers, outside_dispersers};
         SpreadRateAction<StandardMultiHostPool, RasterIndex> spread_rate(
@@ -273,8 +346,7 @@ public:
      * @param host_pool Host pool
      * @param pest_pool Pest pool
      * @param[in,out] total_populations All host and non-host individuals in the area
-     * @param[in,out] treatments Treatments to be applied (also tracks use of
-     * treatments)
+     * @param[in] treatments Treatments to be applied
      * @param[in] temperatures Vector of temperatures used to evaluate lethal
      * temperature
      * @param[in] survival_rates Pest survival rates
@@ -289,7 +361,7 @@ public:
         StandardMultiHostPool& host_pool,
         StandardPestPool& pest_pool,
         IntegerRaster& total_populations,
-        Treatments<StandardSingleHostPool, FloatRaster>& treatments,
+        const Treatments<StandardSingleHostPool, FloatRaster>& treatments,
         const std::vector<FloatRaster>& temperatures,
         const std::vector<FloatRaster>& survival_rates,
         SpreadRateAction<StandardMultiHostPool, RasterIndex>& spread_rate,
@@ -301,52 +373,121 @@ public:
         // Soil step is the same as simulation step.
         if (soil_pool_)
             soil_pool_->next_step(step);
+        // Actions before dispersal draw random numbers, so they can be applied in one
+        // sweep over cells only when each uses its own generator. Otherwise, the order
+        // of random numbers and thus the result would change.
+        bool fuse_before_spread =
+            config_.fuse_cell_actions && config_.multiple_random_seeds;
         // removal of dispersers due to lethal temperatures
-        if (config_.use_lethal_temperature && config_.lethal_schedule()[step]) {
-            int lethal_step =
-                simulation_step_to_action_step(config_.lethal_schedule(), step);
+        bool remove_in_sweep = false;
+        RemoveByTemperature<
+            StandardMultiHostPool,
+            IntegerRaster,
+            FloatRaster,
+            RasterIndex,
+            RandomNumberGeneratorProvider<Generator>>
+            remove(this->environment(), config_.lethal_temperature);
+        if (config_.use_lethal_temperature
+            && plan_.lethal_schedule().is_scheduled(step)) {
+            int lethal_step = plan_.lethal_schedule().action_step(step);
             this->environment().update_temperature(temperatures[lethal_step]);
-            RemoveByTemperature<
-                StandardMultiHostPool,
-                IntegerRaster,
-                FloatRaster,
-                RasterIndex,
-                RandomNumberGeneratorProvider<Generator>>
-                remove(this->environment(), config_.lethal_temperature);
-            remove.action(host_pool, generator_provider_);
+            if (fuse_before_spread)
+                remove_in_sweep = true;
+            else
+                remove.action(host_pool, generator_provider_);
         }
         // removal of percentage of dispersers
-        if (config_.use_survival_rate && config_.survival_rate_schedule()[step]) {
-            int survival_step =
-                simulation_step_to_action_step(config_.survival_rate_schedule(), step);
-            SurvivalRateAction<StandardMultiHostPool, IntegerRaster, FloatRaster>
-                survival(survival_rates[survival_step]);
-            survival.action(host_pool, generator_provider_);
+        // Created only when scheduled because it needs the raster for the step.
+        using SurvivalRate =
+            SurvivalRateAction<StandardMultiHostPool, IntegerRaster, FloatRaster>;
+        std::unique_ptr<SurvivalRate> survival;
+        if (config_.use_survival_rate
+            && plan_.survival_rate_schedule().is_scheduled(step)) {
+            int survival_step = plan_.survival_rate_schedule().action_step(step);
+            survival.reset(new SurvivalRate(survival_rates[survival_step]));
+            if (!fuse_before_spread)
+                survival->action(host_pool, generator_provider_);
         }
+        auto swept_remove = swept_cell_action(
+            remove_in_sweep, [this, &remove, &host_pool](RasterIndex i, RasterIndex j) {
+                remove.action_at(host_pool, i, j, generator_provider_);
+            });
+        auto swept_survival = swept_cell_action(
+            survival && fuse_before_spread,
+            [this, &survival, &host_pool](RasterIndex i, RasterIndex j) {
+                survival->action_at(host_pool, i, j, generator_provider_);
+            });
         // actual spread
-        if (config_.spread_schedule()[step]) {
-            auto dispersal_kernel =
-                kernel_factory_(config_, pest_pool.dispersers(), network);
+        if (plan_.spread_schedule().is_scheduled(step)) {
             auto overpopulation_kernel =
                 create_overpopulation_movement_kernel(pest_pool.dispersers(), network);
-            SpreadAction<
-                StandardMultiHostPool,
-                StandardPestPool,
-                IntegerRaster,
-                FloatRaster,
-                RasterIndex,
-                decltype(dispersal_kernel),
-                RandomNumberGeneratorProvider<Generator>>
-                spread_action{dispersal_kernel};
-
             environment_.set_total_population(&total_populations);
-            // Soils are activated by an independent function call for model, but spread
-            // action is temporary, so it is activated for every step.
-            if (this->soil_pool_) {
-                spread_action.activate_soils(
-                    soil_pool_, config_.dispersers_to_soils_percentage);
+            // Windows of deterministic kernels are computed once for all kernels
+            // created in this step.
+            DeterministicProbabilityWindows windows;
+            if (factory_takes_windows)
+                windows = create_deterministic_windows(config_, pest_pool.dispersers());
+            if (config_.spread_tile_size > 0) {
+                using DispersalKernel =
+                    decltype(create_kernel(pest_pool.dispersers(), network, windows));
+                DecomposedSpreadAction<
+                    StandardMultiHostPool,
+                    StandardPestPool,
+                    IntegerRaster,
+                    FloatRaster,
+                    RasterIndex,
+                    DispersalKernel,
+                    RandomNumberGeneratorProvider<Generator>>
+                    spread_action{
+                        [this, &pest_pool, &network, &windows]() {
+                            return create_kernel(
+                                pest_pool.dispersers(), network, windows);
+                        },
+                        config_.rows,
+                        config_.cols,
+                        config_.spread_tile_size,
+                        spread_seed(),
+                        config_.multiple_random_seeds,
+                        config_.spread_threads,
+                        plan_.spread_random_streams(),
+                        config_.replicate};
+                if (this->soil_pool_) {
+                    spread_action.activate_soils(
+                        soil_pool_, config_.dispersers_to_soils_percentage);
+                }
+                sweep_cells<RasterIndex>(host_pool, swept_remove, swept_survival);
+                spread_action.action(host_pool, pest_pool, step);
+            }
+            else {
+                auto dispersal_kernel =
+                    create_kernel(pest_pool.dispersers(), network, windows);
+                SpreadAction<
+                    StandardMultiHostPool,
+                    StandardPestPool,
+                    IntegerRaster,
+                    FloatRaster,
+                    RasterIndex,
+                    decltype(dispersal_kernel),
+                    RandomNumberGeneratorProvider<Generator>>
+                    spread_action{dispersal_kernel};
+                // Soils are activated by an independent function call for model, but
+                // spread action is temporary, so it is activated for every step.
+                if (this->soil_pool_) {
+                    spread_action.activate_soils(
+                        soil_pool_, config_.dispersers_to_soils_percentage);
+                }
+                // Generation is the last action in the sweep (the only one if not
+                // fused).
+                sweep_cells<RasterIndex>(
+                    host_pool,
+                    swept_remove,
+                    swept_survival,
+                    swept_cell_action(true, [&](RasterIndex i, RasterIndex j) {
+                        spread_action.generate_at(
+                            host_pool, pest_pool, i, j, generator_provider_);
+                    }));
+                spread_action.disperse(host_pool, pest_pool, generator_provider_);
             }
-            spread_action.action(host_pool, pest_pool, generator_provider_);
             host_pool.step_forward(step);
             if (config_.use_overpopulation_movements) {
                 MoveOverpopulatedPests<
@@ -379,31 +520,126 @@ public:
                 last_index = host_movement.action(host_pool, generator_provider_);
             }
         }
+        else {
+            sweep_cells<RasterIndex>(host_pool, swept_remove, swept_survival);
+        }
+        // Actions after dispersal don't use random numbers, so they can be always
+        // applied in one sweep.
+        bool fuse_after_spread = config_.fuse_cell_actions;
         // treatments
+        // Treatments visit only treated cells, so they are not part of the sweep.
         if (config_.use_treatments) {
             for (auto& host : host_pool.host_pools()) {
                 treatments.manage(step, *host);
             }
         }
-        if (config_.use_mortality && config_.mortality_schedule()[step]) {
-            // expectation is that mortality tracker is of length (1/mortality_rate
-            // + mortality_time_lag).
-            // TODO: died.zero(); should be done by the caller if needed, document!
-            Mortality<StandardMultiHostPool, IntegerRaster, FloatRaster> mortality;
+        Mortality<StandardMultiHostPool, IntegerRaster, FloatRaster> mortality;
+        bool use_mortality =
+            config_.use_mortality && plan_.mortality_schedule().is_scheduled(step);
+        // expectation is that mortality tracker is of length (1/mortality_rate
+        // + mortality_time_lag).
+        // TODO: died.zero(); should be done by the caller if needed, document!
+        if (use_mortality && !fuse_after_spread)
             mortality.action(host_pool);
-        }
         // compute spread rate
-        if (config_.use_spreadrates && config_.spread_rate_schedule()[step]) {
-            unsigned rates_step =
-                simulation_step_to_action_step(config_.spread_rate_schedule(), step);
+        bool use_spread_rate = config_.use_spreadrates
+                               && plan_.spread_rate_schedule().is_scheduled(step);
+        unsigned rates_step =
+            use_spread_rate ? plan_.spread_rate_schedule().action_step(step) : 0;
+        if (use_spread_rate && !fuse_after_spread)
             spread_rate.action(host_pool, rates_step);
-        }
         // compute quarantine escape
-        if (config_.use_quarantine && config_.quarantine_schedule()[step]) {
-            unsigned action_step =
-                simulation_step_to_action_step(config_.quarantine_schedule(), step);
-            quarantine.action(host_pool, quarantine_areas, action_step);
-        }
+        bool use_quarantine =
+            config_.use_quarantine && plan_.quarantine_schedule().is_scheduled(step);
+        unsigned quarantine_step =
+            use_quarantine ? plan_.quarantine_schedule().action_step(step) : 0;
+        if (use_quarantine && !fuse_after_spread)
+            quarantine.action(host_pool, quarantine_areas, quarantine_step);
+        // With tracking, spread rate and quarantine don't need to visit the cells,
+        // but they still need to run after the other actions.
+        sweep_cells<RasterIndex>(
+            host_pool,
+            swept_cell_action(
+                use_mortality && fuse_after_spread,
+                [&mortality, &host_pool](RasterIndex i, RasterIndex j) {
+                    mortality.action_at(host_pool, i, j);
+                },
+                [&mortality, &host_pool]() { mortality.finish_action(host_pool); }),
+            swept_cell_action(
+                use_spread_rate && fuse_after_spread,
+                [&spread_rate, &host_pool](RasterIndex i, RasterIndex j) {
+                    spread_rate.action_at(host_pool, i, j);
+                },
+                [&spread_rate, &host_pool, rates_step]() {
+                    if (spread_rate.tracks_infection())
+                        spread_rate.action(host_pool, rates_step);
+                    else
+                        spread_rate.finish_action(rates_step);
+                },
+                !spread_rate.tracks_infection()),
+            swept_cell_action(
+                use_quarantine && fuse_after_spread,
+                [&quarantine, &host_pool, &quarantine_areas](
+                    RasterIndex i, RasterIndex j) {
+                    quarantine.action_at(host_pool, quarantine_areas, i, j);
+                },
+                [&quarantine, &host_pool, &quarantine_areas, quarantine_step]() {
+                    if (quarantine.tracks_infection())
+                        quarantine.action(host_pool, quarantine_areas, quarantine_step);
+                    else
+                        quarantine.finish_action(quarantine_step);
+                },
+                !quarantine.tracks_infection()));
+    }
+
+    /**
+     * @brief Add observer of infection changes kept across steps
+     *
+     * The run_step() overload which takes rasters creates a new host pool in each
+     * step, so observers such as ZonalInfectionExtentTracker (used with
+     * QuarantineEscapeAction::track_infection()) can't be added to the host pool
+     * directly. The observer added here is added to the host pool in each step.
+     *
+     * The observer is notified about all infected cells in the next step and then
+     * only about changes, so the rasters need to be modified only by run_step()
+     * afterwards. If the rasters are modified elsewhere, remove the observer, clear
+     * it, and add it again.
+     *
+     * The observer is not owned by the model and it needs to exist as long as it is
+     * added to the model. With the run_step() overload which takes host pools, add
+     * the observer to the host pool instead.
+     *
+     * @param observer Observer to add
+     */
+    void add_infection_observer(InfectionObserverInterface<RasterIndex>& observer)
+    {
+        infection_observers_.push_back({&observer, false});
+    }
+
+    /**
+     * @brief Remove observer added with add_infection_observer()
+     *
+     * @param observer Observer to remove
+     */
+    void remove_infection_observer(InfectionObserverInterface<RasterIndex>& observer)
+    {
+        infection_observers_.erase(
+            std::remove_if(
+                infection_observers_.begin(),
+                infection_observers_.end(),
+                [&observer](const StepObserver& item) {
+                    return item.observer == &observer;
+                }),
+            infection_observers_.end());
+    }
+
+    /**
+     * @brief Get the run plan compiled from the model configuration
+     * @return Reference to the plan
+     */
+    const RunPlan& run_plan() const
+    {
+        return plan_;
     }
 
     /**
@@ -429,6 +665,20 @@ public:
         return environment_;
     }
 
+    /**
+     * @brief Get soil pool
+     * @return Soil pool or null if soils were not activated
+     */
+    const SoilPool<
+        IntegerRaster,
+        FloatRaster,
+        RasterIndex,
+        RandomNumberGeneratorProvider<Generator>>*
+    soil_pool() const
+    {
+        return soil_pool_.get();
+    }
+
     /**
      * @brief Activate movement to and from soil pool
      *
@@ -450,6 +700,29 @@ public:
             config_.generate_stochasticity,
             config_.establishment_stochasticity));
     }
+
+    /**
+     * @brief Activate movement to and from soil pool with sparse storage
+     *
+     * The dispersers are stored by the soil pool only for cells where some
+     * dispersers were added (see SoilPool).
+     *
+     * @param num_cohorts Number of simulation steps dispersers stay in the soil
+     */
+    void activate_soils(int num_cohorts)
+    {
+        this->soil_pool_.reset(new SoilPool<
+                               IntegerRaster,
+                               FloatRaster,
+                               RasterIndex,
+                               RandomNumberGeneratorProvider<Generator>>(
+            config_.rows,
+            config_.cols,
+            num_cohorts,
+            this->environment_,
+            config_.generate_stochasticity,
+            config_.establishment_stochasticity));
+    }
 };
 
 }  // namespace pops
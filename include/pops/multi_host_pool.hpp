@@ -22,6 +22,7 @@
 
 #include "competency_table.hpp"
 #include "config.hpp"
+#include "infection_observer_interface.hpp"
 #include "pest_host_table.hpp"
 #include "utils.hpp"
 
@@ -55,7 +56,9 @@ public:
      * @param config Configuration to use
      */
     MultiHostPool(const std::vector<HostPool*>& host_pools, const Config& config)
-        : host_pools_(host_pools), config_(config)
+        : host_pools_(host_pools),
+          config_(config),
+          arrival_behavior_(arrival_behavior_from_string(config.arrival_behavior()))
     {}
 
     /**
@@ -86,6 +89,47 @@ public:
         }
     }
 
+    /**
+     * @brief Add observer of infection changes to all hosts
+     *
+     * The observer is notified separately by each host.
+     *
+     * @see HostPool::add_infection_observer()
+     */
+    void add_infection_observer(
+        InfectionObserverInterface<RasterIndex>& observer, bool notify_infected = true)
+    {
+        for (auto& host_pool : host_pools_) {
+            host_pool->add_infection_observer(observer, notify_infected);
+        }
+    }
+
+    /**
+     * @brief Remove observer of infection changes from all hosts
+     *
+     * @see HostPool::remove_infection_observer()
+     */
+    void remove_infection_observer(InfectionObserverInterface<RasterIndex>& observer)
+    {
+        for (auto& host_pool : host_pools_) {
+            host_pool->remove_infection_observer(observer);
+        }
+    }
+
+    /**
+     * @brief Check whether any host has observers of infection changes
+     *
+     * @see HostPool::has_infection_observers()
+     */
+    bool has_infection_observers() const
+    {
+        for (const auto& host_pool : host_pools_) {
+            if (host_pool->has_infection_observers())
+                return true;
+        }
+        return false;
+    }
+
     /**
      * @brief Get suitable cells spatial index
      *
@@ -367,7 +411,7 @@ public:
                 + " but it needs to be <=1");
         }
         auto host = pick_host_by_weight(host_pools_, suitabilities, generator);
-        if (config_.arrival_behavior() == "land") {
+        if (arrival_behavior_ == ArrivalBehavior::Land) {
             // The operations are ordered so that for single host, this gives an
             // identical results to the infect behavior (influenced by usage of random
             // numbers and presence of susceptible hosts).
@@ -382,11 +426,8 @@ public:
                 return host->add_disperser_at(row, col);  // simply increases the counts
             return 0;
         }
-        else if (config_.arrival_behavior() == "infect") {
-            return host->disperser_to(row, col, generator);  // with establishment test
-        }
-        throw std::invalid_argument(
-            "Unknown value for arrival_behavior: " + config_.arrival_behavior());
+        // Infecting (the host performs its own establishment test).
+        return host->disperser_to(row, col, generator);
     }
     /**
      * @brief Move hosts from a cell to a cell (multi-host)
@@ -466,6 +507,8 @@ private:
      * Reference to configuration
      */
     const Config& config_;
+    /** Arrival behavior from config (resolved once) */
+    ArrivalBehavior arrival_behavior_;
 };
 
 }  // namespace pops
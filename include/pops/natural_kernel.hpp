@@ -35,12 +35,15 @@ namespace pops {
  *
  * @param config Configuration for the kernel
  * @param dispersers The disperser raster (reference, for deterministic kernel)
+ * @param probability_window Shared window for deterministic kernel (or null)
  *
  * @return Created kernel
  */
 template<typename Generator, typename IntegerRaster, typename RasterIndex>
-std::unique_ptr<KernelInterface<Generator>>
-create_natural_kernel(const Config& config, const IntegerRaster& dispersers)
+std::unique_ptr<KernelInterface<Generator>> create_natural_kernel(
+    const Config& config,
+    const IntegerRaster& dispersers,
+    std::shared_ptr<const DeterministicProbabilityRaster> probability_window = nullptr)
 {
     auto natural_kernel = kernel_type_from_string(config.natural_kernel_type);
     if (natural_kernel == DispersalKernelType::Uniform) {
@@ -65,7 +68,8 @@ create_natural_kernel(const Config& config, const IntegerRaster& dispersers)
             config.ew_res,
             config.ns_res,
             config.natural_scale,
-            config.shape));
+            config.shape,
+            probability_window));
     }
     else {
         using Kernel =
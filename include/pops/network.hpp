@@ -16,16 +16,29 @@
 #ifndef POPS_NETWORK_HPP
 #define POPS_NETWORK_HPP
 
+#include "mapped_file.hpp"
 #include "raster.hpp"
 #include "utils.hpp"
 
 #include <algorithm>
+#include <array>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <memory>
 #include <set>
 #include <random>
 #include <string>
 #include <sstream>
 #include <map>
 #include <cmath>
+#include <fstream>
+#include <thread>
 #include <vector>
 
 namespace pops {
@@ -105,6 +118,10 @@ private:
  * Notably, the view uses iterators to flip the direction of the geometry,
  * but the total cost is still for the whole geometry, i.e., this is not view of
  * a part of the geometry, but view of a potentially reversed geometry.
+ *
+ * The iterators can point to an edge geometry object or to any other storage of
+ * cells with the same iterator type, e.g., to a vector with cells of all segments.
+ * In that case, the cost of the segment is passed explicitly.
  */
 template<typename EdgeGeometryType>
 class EdgeGeometryView : public ContainerView<EdgeGeometryType>
@@ -114,20 +131,40 @@ public:
         typename EdgeGeometryType::const_iterator first,
         typename EdgeGeometryType::const_iterator last,
         const EdgeGeometryType& segment)
-        : ContainerView<EdgeGeometryType>(first, last), segment_(segment)
+        : EdgeGeometryView(first, last, segment.cost(), segment.cost_per_cell())
     {}
     EdgeGeometryView(
         typename EdgeGeometryType::const_reverse_iterator first,
         typename EdgeGeometryType::const_reverse_iterator last,
         const EdgeGeometryType& segment)
-        : ContainerView<EdgeGeometryType>(first, last), segment_(segment)
+        : EdgeGeometryView(first, last, segment.cost(), segment.cost_per_cell())
+    {}
+    EdgeGeometryView(
+        typename EdgeGeometryType::const_iterator first,
+        typename EdgeGeometryType::const_iterator last,
+        double cost,
+        double cost_per_cell)
+        : ContainerView<EdgeGeometryType>(first, last),
+          cost_(cost),
+          cost_per_cell_(cost_per_cell)
+    {}
+    EdgeGeometryView(
+        typename EdgeGeometryType::const_reverse_iterator first,
+        typename EdgeGeometryType::const_reverse_iterator last,
+        double cost,
+        double cost_per_cell)
+        : ContainerView<EdgeGeometryType>(first, last),
+          cost_(cost),
+          cost_per_cell_(cost_per_cell)
     {}
 
     /** Get cell by cost instead of an index */
     typename EdgeGeometryType::const_reference cell_by_cost(double cost) const
     {
         // The index is without a direction, so we can use it in reverse too.
-        auto index = segment_.index_from_cost(cost);
+        // This is the same as EdgeGeometry::index_from_cost().
+        auto index = static_cast<typename EdgeGeometryType::size_type>(
+            std::lround(cost / cost_per_cell_));
         return this->operator[](index);
     }
 
@@ -138,17 +175,217 @@ public:
      */
     double cost() const
     {
-        return segment_.cost();
+        return cost_;
     }
 
     /** Get cost per cell for the underlying segment (edge). */
     double cost_per_cell() const
     {
-        return segment_.cost_per_cell();
+        return cost_per_cell_;
     }
 
 private:
-    const EdgeGeometryType& segment_;
+    double cost_;
+    double cost_per_cell_;
+};
+
+/**
+ * Constant view of a contiguous sequence of values stored elsewhere
+ *
+ * The view is valid as long as the storage exists and is not modified.
+ */
+template<typename Value>
+class ArrayView
+{
+public:
+    using value_type = Value;
+    using const_reference = const Value&;
+    using const_iterator = const Value*;
+    using const_reverse_iterator = std::reverse_iterator<const Value*>;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+
+    ArrayView() = default;
+    ArrayView(const Value* first, const Value* last) : begin_(first), end_(last) {}
+
+    const Value* begin() const
+    {
+        return begin_;
+    }
+
+    const Value* end() const
+    {
+        return end_;
+    }
+
+    size_type size() const
+    {
+        return end_ - begin_;
+    }
+
+    bool empty() const
+    {
+        return begin_ == end_;
+    }
+
+    const Value& operator[](size_type index) const
+    {
+        return begin_[index];
+    }
+
+private:
+    const Value* begin_{nullptr};
+    const Value* end_{nullptr};
+};
+
+/**
+ * Builder of tables for sampling from discrete distributions using the alias method
+ *
+ * With the alias method (Walker 1977, here in the variant by Vose 1991), a value
+ * from a discrete distribution with n values is picked using one uniform random
+ * number regardless of n. The table consists of a probability and an alias for each
+ * value. The value is picked uniformly and then it is either kept (based on its
+ * probability) or replaced by its alias.
+ *
+ * The builder keeps working memory, so it can be reused to build many tables
+ * without allocations.
+ *
+ * @see sample_alias_table()
+ */
+class AliasTableBuilder
+{
+public:
+    /**
+     * @brief Build an alias table for given weights
+     *
+     * Weights don't need to be normalized. If all weights are zero, the values are
+     * picked with equal probabilities.
+     *
+     * @param weights Weights of the values (n items)
+     * @param n Number of values
+     * @param probabilities Probabilities of keeping the values (output, n items)
+     * @param aliases Aliases of the values (output, n items)
+     */
+    void build(
+        const double* weights,
+        std::size_t n,
+        double* probabilities,
+        std::uint32_t* aliases)
+    {
+        double sum = 0;
+        for (std::size_t i = 0; i < n; ++i)
+            sum += weights[i];
+        scaled_.resize(n);
+        small_.clear();
+        large_.clear();
+        for (std::size_t i = 0; i < n; ++i) {
+            scaled_[i] = sum > 0 ? weights[i] * n / sum : 1;
+            if (scaled_[i] < 1)
+                small_.push_back(static_cast<std::uint32_t>(i));
+            else
+                large_.push_back(static_cast<std::uint32_t>(i));
+        }
+        while (!small_.empty() && !large_.empty()) {
+            auto less = small_.back();
+            small_.pop_back();
+            auto more = large_.back();
+            probabilities[less] = scaled_[less];
+            aliases[less] = more;
+            scaled_[more] = (scaled_[more] + scaled_[less]) - 1;
+            if (scaled_[more] < 1) {
+                large_.pop_back();
+                small_.push_back(more);
+            }
+        }
+        // Remaining values have probability one (up to rounding errors).
+        for (auto i : large_) {
+            probabilities[i] = 1;
+            aliases[i] = i;
+        }
+        for (auto i : small_) {
+            probabilities[i] = 1;
+            aliases[i] = i;
+        }
+    }
+
+private:
+    std::vector<double> scaled_;
+    std::vector<std::uint32_t> small_;
+    std::vector<std::uint32_t> large_;
+};
+
+/**
+ * @brief Pick a value using an alias table
+ *
+ * @param probabilities Probabilities of keeping the values
+ * @param aliases Aliases of the values
+ * @param n Number of values (greater than zero)
+ * @param generator Random number generator
+ * @return Index of the value
+ *
+ * @see AliasTableBuilder
+ */
+template<typename Generator>
+std::size_t sample_alias_table(
+    const double* probabilities,
+    const std::uint32_t* aliases,
+    std::size_t n,
+    Generator& generator)
+{
+    // One number gives both the value (integer part) and the test (fractional part).
+    std::uniform_real_distribution<double> distribution(0, double(n));
+    double number = distribution(generator);
+    auto index = std::min(static_cast<std::size_t>(number), n - 1);
+    if (number - double(index) < probabilities[index])
+        return index;
+    return aliases[index];
+}
+
+/**
+ * Set of values which stores a few values without allocating memory
+ *
+ * The values are stored in a fixed-size buffer and searched linearly. Only when
+ * the buffer is full, the values are moved to an ordered vector. This is meant for
+ * sets which are usually small and often created such as visited nodes in a walk.
+ *
+ * @tparam Value Type of values
+ * @tparam capacity Number of values stored without allocation
+ */
+template<typename Value, std::size_t capacity = 16>
+class SmallSet
+{
+public:
+    /** Return true if the value is in the set */
+    bool contains(const Value& value) const
+    {
+        if (values_.empty())
+            return std::find(buffer_.begin(), buffer_.begin() + size_, value)
+                   != buffer_.begin() + size_;
+        return std::binary_search(values_.begin(), values_.end(), value);
+    }
+
+    /** Add value to the set (no-op if the value is already in the set) */
+    void insert(const Value& value)
+    {
+        if (values_.empty()) {
+            if (contains(value))
+                return;
+            if (size_ < capacity) {
+                buffer_[size_++] = value;
+                return;
+            }
+            values_.assign(buffer_.begin(), buffer_.end());
+            std::sort(values_.begin(), values_.end());
+        }
+        auto position = std::lower_bound(values_.begin(), values_.end(), value);
+        if (position == values_.end() || *position != value)
+            values_.insert(position, value);
+    }
+
+private:
+    std::array<Value, capacity> buffer_;
+    std::size_t size_{0};
+    std::vector<Value> values_;  ///< All values when the buffer is full
 };
 
 /**
@@ -176,6 +413,15 @@ private:
  *
  * Only non-const (write) functions for network are those loading the network, so an
  * existing network can be shared by multiple kernel or model instances.
+ *
+ * Internally, the network is stored in a compact form with a dense index for each
+ * node (nodes ordered by ID) and with flat arrays instead of associative containers
+ * (compressed sparse row layout). Neighbors of each node, edge probabilities, and
+ * edges leading to the neighbors are stored in arrays with offsets for each node.
+ * Cells of all segments are stored in one array with offsets for each edge. Cells
+ * with nodes are stored in row-major order with offsets for each row and with node
+ * IDs for each cell, so nodes at a given cell are found without a search over the
+ * whole network.
  */
 template<typename RasterIndex>
 class Network
@@ -183,6 +429,7 @@ class Network
 public:
     using NodeId = int;  ///< Type for node IDs
     using Statistics = std::map<std::string, int>;  ///< Type for summary statistics
+    using NodeList = ArrayView<NodeId>;  ///< List of node IDs
 
     /**
      * @brief Construct empty network.
@@ -354,12 +601,15 @@ public:
      * internal representation of the network and handled
      * as no movement from the source cell, but the input always needs to contain an
      * edge.
+     *
+     * When a network is loaded into an object which already contains a network,
+     * the new segments are added to the existing ones.
      */
     template<typename InputStream>
     void load(InputStream& stream, bool allow_empty = false)
     {
         load_segments(stream);
-        if (node_matrix_.empty()) {
+        if (node_ids_.empty()) {
             if (allow_empty)
                 return;
             else
@@ -367,24 +617,307 @@ public:
         }
     }
 
+    /**
+     * @brief Load network from an input stream using multiple threads
+     *
+     * The input and the resulting network are the same as for load(), but the text
+     * is read at once, split into chunks at line boundaries, and the chunks are
+     * parsed in parallel. Numbers are parsed directly in the text without creating
+     * strings for individual values. The parsed segments are merged in the order of
+     * the chunks, so the result does not depend on the number of threads and, when
+     * the input contains an error, the error from the first wrong line is reported.
+     *
+     * @param stream Input stream containing text records for network
+     * @param threads Number of threads (0 for number of hardware threads)
+     * @param allow_empty True if the loaded network can be empty
+     *
+     * @see load()
+     */
+    template<typename InputStream>
+    void
+    load_parallel(InputStream& stream, unsigned threads = 0, bool allow_empty = false)
+    {
+        char delimeter{','};
+        bool has_cost{false};
+        bool has_probability{false};
+        std::tie(has_cost, has_probability) = stream_has_columns(stream, delimeter);
+        std::string text{
+            std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+
+        if (!threads)
+            threads = std::thread::hardware_concurrency();
+        if (!threads)
+            threads = 1;
+        // Each chunk starts at the beginning of a line.
+        std::vector<std::size_t> chunk_starts{0};
+        for (unsigned thread = 1; thread < threads; ++thread) {
+            std::size_t position = text.size() * thread / threads;
+            if (position <= chunk_starts.back())
+                continue;
+            auto newline = text.find('\n', position - 1);
+            if (newline == std::string::npos)
+                break;
+            if (newline + 1 > chunk_starts.back())
+                chunk_starts.push_back(newline + 1);
+        }
+        chunk_starts.push_back(text.size());
+        std::vector<ParsedChunk> chunks(chunk_starts.size() - 1);
+        auto parse = [&](std::size_t chunk) {
+            try {
+                parse_lines(
+                    text.data() + chunk_starts[chunk],
+                    text.data() + chunk_starts[chunk + 1],
+                    has_probability,
+                    has_cost,
+                    chunks[chunk]);
+            }
+            catch (...) {
+                chunks[chunk].error = std::current_exception();
+            }
+        };
+        std::vector<std::thread> workers;
+        workers.reserve(chunks.size() - 1);
+        for (std::size_t chunk = 1; chunk < chunks.size(); ++chunk)
+            workers.emplace_back(parse, chunk);
+        parse(0);
+        for (auto& worker : workers)
+            worker.join();
+
+        // Segments loaded previously are kept.
+        SegmentsByNodes segments_by_nodes = this->segments_by_nodes();
+        for (const auto& chunk : chunks) {
+            if (chunk.error)
+                std::rethrow_exception(chunk.error);
+            for (const auto& edge : chunk.edges) {
+                // Only the first segment for a pair of nodes is used as in load().
+                auto inserted = segments_by_nodes.emplace(
+                    std::make_pair(edge.node_1, edge.node_2), Segment());
+                if (!inserted.second)
+                    continue;
+                auto& segment = inserted.first->second;
+                segment.assign(
+                    chunk.cells.begin() + edge.first_cell,
+                    chunk.cells.begin() + edge.last_cell);
+                if (has_probability)
+                    segment.set_probability(edge.probability);
+                if (has_cost)
+                    segment.set_total_cost(edge.cost);
+                else
+                    segment.set_cost_per_cell(distance_per_cell_);
+            }
+        }
+        build_from_segments(
+            segments_by_nodes, has_probability || !neighbor_probabilities_.empty());
+        if (node_ids_.empty() && !allow_empty)
+            throw std::runtime_error("Network: No nodes within the extend");
+    }
+
+    /**
+     * @brief Save the loaded network to a binary file
+     *
+     * The file contains the network in the internal (compact) representation, so it
+     * can be loaded using load_binary() without parsing the text input again. The
+     * file starts with a header with format version, sizes of the used types, bounding
+     * box, and resolution followed by a table with the position and size of each
+     * array. The arrays are aligned, so they can be used directly from memory.
+     *
+     * The data are written in the byte order of the current platform and the file
+     * can be loaded only on a platform with the same byte order and type sizes.
+     *
+     * @param path Path to the file
+     * @throw std::runtime_error when the file cannot be written
+     */
+    void save_binary(const std::string& path) const
+    {
+        std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+        if (!stream)
+            throw std::runtime_error("Network: Cannot open file for writing: " + path);
+        std::vector<std::uint64_t> table;
+        std::uint64_t position = align_to_block(binary_header_size());
+        for_each_array(*this, [&table, &position](const auto& array) {
+            using Value = typename std::decay_t<decltype(array)>::value_type;
+            table.push_back(position);
+            table.push_back(array.size());
+            table.push_back(sizeof(Value));
+            position = align_to_block(position + array.size() * sizeof(Value));
+        });
+        std::vector<char> header;
+        auto append = [&header](const auto& value) {
+            const char* bytes = reinterpret_cast<const char*>(&value);
+            header.insert(header.end(), bytes, bytes + sizeof(value));
+        };
+        header.insert(header.end(), binary_magic, binary_magic + sizeof(binary_magic));
+        append(binary_version);
+        append(binary_byte_order);
+        append(std::uint32_t(sizeof(RasterIndex)));
+        append(std::uint32_t(sizeof(std::size_t)));
+        append(std::uint32_t(table.size() / 3));
+        append(std::uint32_t(0));
+        for (double value :
+             {bbox_.north, bbox_.south, bbox_.east, bbox_.west, ew_res_, ns_res_})
+            append(value);
+        for (auto value : table)
+            append(value);
+        stream.write(header.data(), header.size());
+        std::uint64_t written = header.size();
+        std::size_t array_number = 0;
+        for_each_array(*this, [&](const auto& array) {
+            using Value = typename std::decay_t<decltype(array)>::value_type;
+            std::vector<char> padding(table[3 * array_number] - written, 0);
+            stream.write(padding.data(), padding.size());
+            stream.write(
+                reinterpret_cast<const char*>(array.data()),
+                array.size() * sizeof(Value));
+            written = table[3 * array_number] + array.size() * sizeof(Value);
+            ++array_number;
+        });
+        if (!stream)
+            throw std::runtime_error("Network: Cannot write to file: " + path);
+    }
+
+    /**
+     * @brief Load network from a binary file
+     *
+     * Loads network saved using save_binary(). The file is mapped to memory and the
+     * network uses the data directly from the mapped file without copying them, so
+     * loading is fast and multiple processes loading the same file share the data.
+     * The file can be removed or replaced only after the network object is destroyed.
+     *
+     * Any existing network in the object is replaced. The bounding box and resolution
+     * of the network object needs to be the same as the one used to create the file.
+     *
+     * @param path Path to the file
+     * @param allow_empty True if the loaded network can be empty
+     *
+     * @throw std::runtime_error when the file cannot be read or it is not a network
+     * file with the same version, byte order, bounding box, and resolution
+     */
+    void load_binary(const std::string& path, bool allow_empty = false)
+    {
+        auto file = std::make_shared<MappedFile>(path);
+        const char* data = file->data();
+        std::size_t size = file->size();
+        auto fail = [&path](const std::string& message) {
+            throw std::runtime_error(
+                "Network: File " + path + " cannot be loaded: " + message);
+        };
+        if (size < binary_header_size()
+            || std::memcmp(data, binary_magic, sizeof(binary_magic)) != 0)
+            fail("Not a binary network file");
+        std::size_t position = sizeof(binary_magic);
+        auto read = [data, &position](auto& value) {
+            std::memcpy(&value, data + position, sizeof(value));
+            position += sizeof(value);
+        };
+        std::uint32_t version;
+        std::uint32_t byte_order;
+        std::uint32_t index_size;
+        std::uint32_t size_size;
+        std::uint32_t num_arrays;
+        std::uint32_t reserved;
+        read(version);
+        read(byte_order);
+        read(index_size);
+        read(size_size);
+        read(num_arrays);
+        read(reserved);
+        if (version != binary_version) {
+            fail(
+                "File version is " + std::to_string(version) + ", but version "
+                + std::to_string(binary_version) + " is required");
+        }
+        if (byte_order != binary_byte_order)
+            fail("Byte order of the file is different from this platform");
+        if (index_size != sizeof(RasterIndex) || size_size != sizeof(std::size_t)) {
+            fail(
+                "Sizes of index and size types are " + std::to_string(index_size)
+                + " and " + std::to_string(size_size) + " bytes, but "
+                + std::to_string(sizeof(RasterIndex)) + " and "
+                + std::to_string(sizeof(std::size_t)) + " are required");
+        }
+        if (num_arrays != binary_num_arrays)
+            fail("Unexpected number of arrays: " + std::to_string(num_arrays));
+        double north;
+        double south;
+        double east;
+        double west;
+        double ew_res;
+        double ns_res;
+        for (double* value : {&north, &south, &east, &west, &ew_res, &ns_res})
+            read(*value);
+        if (north != bbox_.north || south != bbox_.south || east != bbox_.east
+            || west != bbox_.west || ew_res != ew_res_ || ns_res != ns_res_) {
+            std::ostringstream message;
+            message << "Bounding box and resolution in the file (N: " << north
+                    << " S: " << south << " E: " << east << " W: " << west
+                    << " EW: " << ew_res << " NS: " << ns_res
+                    << ") are different from the network (N: " << bbox_.north
+                    << " S: " << bbox_.south << " E: " << bbox_.east
+                    << " W: " << bbox_.west << " EW: " << ew_res_ << " NS: " << ns_res_
+                    << ")";
+            fail(message.str());
+        }
+        // Loaded to a new object, so that this network is unchanged on failure.
+        Network loaded(bbox_, ew_res_, ns_res_);
+        loaded.max_teleport_steps_ = max_teleport_steps_;
+        for_each_array(loaded, [&](auto& array) {
+            using Value = typename std::decay_t<decltype(array)>::value_type;
+            std::uint64_t offset;
+            std::uint64_t count;
+            std::uint64_t item_size;
+            read(offset);
+            read(count);
+            read(item_size);
+            if (item_size != sizeof(Value) || offset % alignof(Value) != 0
+                || offset > size || count > (size - offset) / sizeof(Value))
+                fail("Array table is invalid or the file is truncated");
+            array = SharedArray<Value>(
+                reinterpret_cast<const Value*>(data + offset), count, file);
+        });
+        std::size_t num_nodes = loaded.node_ids_.size();
+        std::size_t num_edges = loaded.segment_costs_.size();
+        if (loaded.node_cells_.size() != num_nodes
+            || loaded.neighbor_offsets_.size() != num_nodes + 1
+            || loaded.neighbor_nodes_.size() != 2 * num_edges
+            || loaded.neighbor_edges_.size() != 2 * num_edges
+            || loaded.edge_nodes_.size() != 2 * num_edges
+            || loaded.segment_offsets_.size() != num_edges + 1
+            || loaded.segment_costs_per_cell_.size() != num_edges
+            || loaded.cell_node_offsets_.size() != loaded.cells_with_nodes_.size() + 1
+            || loaded.cell_node_offsets_.back() != loaded.cell_node_ids_.size()
+            || loaded.row_offsets_.empty()
+            || loaded.row_offsets_.back() != loaded.cells_with_nodes_.size()
+            || loaded.neighbor_offsets_.back() != loaded.neighbor_nodes_.size()
+            || loaded.segment_offsets_.back() != loaded.segment_cells_.size()
+            || (!loaded.neighbor_probabilities_.empty()
+                && (loaded.neighbor_probabilities_.size() != 2 * num_edges
+                    || loaded.neighbor_alias_probabilities_.size() != 2 * num_edges
+                    || loaded.neighbor_aliases_.size() != 2 * num_edges)))
+            fail("Sizes of arrays are inconsistent");
+        loaded.precompute_teleport_steps(max_teleport_steps_);
+        if (loaded.node_ids_.empty() && !allow_empty)
+            throw std::runtime_error("Network: No nodes within the extend");
+        *this = std::move(loaded);
+    }
+
     /**
      * @brief Get a list of nodes at a given cell
      *
-     * Returns a const reference to an internally stored set. If there are no nodes
-     * at a given cell, a reference to an empty set is returned.
+     * Returns a view of an internally stored list of node IDs ordered by ID. If there
+     * are no nodes at a given cell, an empty list is returned.
      *
      * @param row Row in the raster grid
      * @param col Column in the raster grid
-     * @return List of node IDs as a set
+     * @return List of node IDs
      */
-    const std::set<NodeId>& get_nodes_at(RasterIndex row, RasterIndex col) const
+    NodeList get_nodes_at(RasterIndex row, RasterIndex col) const
     {
-        auto it = nodes_by_row_col_.find(std::make_pair(row, col));
-        if (it != nodes_by_row_col_.end())
-            return it->second;
-        // If not found, return an empty set (const reference to local static).
-        static std::set<NodeId> empty;
-        return empty;
+        auto cell = find_cell(row, col);
+        if (cell == cells_with_nodes_.size())
+            return NodeList();
+        return NodeList(
+            cell_node_ids_.data() + cell_node_offsets_[cell],
+            cell_node_ids_.data() + cell_node_offsets_[cell + 1]);
     }
 
     /**
@@ -426,26 +959,21 @@ public:
      */
     bool has_node_at(RasterIndex row, RasterIndex col) const
     {
-        // Replace by contains in C++20.
-        // return nodes_by_row_col_.count(std::make_pair(row, col)) > 0;
-        auto it = nodes_by_row_col_.find(std::make_pair(row, col));
-        if (it == nodes_by_row_col_.end())
-            return false;
-        return true;
+        return find_cell(row, col) != cells_with_nodes_.size();
     }
 
     /**
      * @brief Get row and column for a node.
+     *
+     * If the node is at more than one cell (i.e., different segments have different
+     * coordinates for the node), the first cell in the row-major order is returned.
+     *
      * @param node Node id to get the coordinates for
      * @return Row and column pair
      */
     std::pair<RasterIndex, RasterIndex> get_node_row_col(NodeId node) const
     {
-        for (const auto& item : nodes_by_row_col_) {
-            if (container_contains(item.second, node))
-                return item.first;
-        }
-        throw std::invalid_argument("No node with a given id");
+        return node_cells_[node_index(node)];
     }
 
     /**
@@ -473,21 +1001,21 @@ public:
         Generator& generator,
         bool jump = false) const
     {
-        auto node_id = get_random_node_at(row, col, generator);
-        std::set<NodeId> visited_nodes;
+        auto node = node_index(get_random_node_at(row, col, generator));
+        SmallSet<NodeIndex> visited_nodes;
         while (distance >= 0) {
-            auto next_node_id = next_node(node_id, visited_nodes, generator);
+            auto position = next_neighbor(node, visited_nodes, generator);
             // We have visited the current node (initial start node or end node from
-            // last iteration. (There is no need to tell next_node that the current node
-            // is visited, but we need to tell it the next time because it won't be
+            // last iteration. (There is no need to tell next_neighbor that the current
+            // node is visited, but we need to tell it the next time because it won't be
             // current anymore.)
-            visited_nodes.insert(node_id);
+            visited_nodes.insert(node);
             // If there is no segment from the node, return the start cell.
-            if (next_node_id == node_id)
+            if (position == no_neighbor || neighbor_nodes_[position] == node)
                 return std::make_tuple(row, col);
-            auto segment = get_segment(node_id, next_node_id);
-            // Set node ID for the next iteration.
-            node_id = next_node_id;
+            auto segment = segment_to_neighbor(node, position);
+            // Set node for the next iteration.
+            node = neighbor_nodes_[position];
 
             if (distance > segment.cost()) {
                 // Go over the whole segment.
@@ -529,17 +1057,132 @@ public:
      * If there is more than one node at the given *row* and *column*, a random node is
      * picked and used.
      *
+     * Picking a node based on edge probabilities uses alias tables prepared when the
+     * network is loaded, so each step costs the same regardless of the number of
+     * connections. If the distributions for the given *num_steps* were prepared using
+     * precompute_teleport_steps(), the destination is picked directly without going
+     * through the intermediate nodes.
+     *
      * @returns Destination row and column pair
      */
     template<typename Generator>
     std::tuple<int, int> teleport(
         RasterIndex row, RasterIndex col, Generator& generator, int num_steps = 1) const
     {
-        auto node_id = get_random_node_at(row, col, generator);
+        auto node = node_index(get_random_node_at(row, col, generator));
+        if (num_steps > 1 && std::size_t(num_steps - 2) < teleport_tables_.size()) {
+            const auto& table = teleport_tables_[num_steps - 2];
+            auto first = table.offsets[node];
+            auto index = sample_alias_table(
+                table.alias_probabilities.data() + first,
+                table.aliases.data() + first,
+                table.offsets[node + 1] - first,
+                generator);
+            return node_cells_[table.targets[first + index]];
+        }
         for (int i = 0; i < num_steps; ++i) {
-            node_id = next_probable_node(node_id, generator);
+            node = next_probable_node(node, generator);
+        }
+        return node_cells_[node];
+    }
+
+    /**
+     * @brief Prepare distributions of destinations for teleporting in multiple steps
+     *
+     * For each number of steps from 2 to *max_steps*, the probability of reaching each
+     * node from each node is computed, so that teleport() can pick the destination
+     * using one random number. The probabilities are the same as when going step by
+     * step, i.e., a step uses edge probabilities if available and otherwise all
+     * connections have the same probability, and a node without connections is the
+     * destination of itself.
+     *
+     * The number of reachable nodes grows quickly with the number of steps, so this is
+     * meant only for a small number of steps.
+     *
+     * The distributions are kept when more segments are loaded.
+     *
+     * @param max_steps Maximum number of steps to prepare (1 or less to remove the
+     * prepared distributions)
+     */
+    void precompute_teleport_steps(int max_steps)
+    {
+        teleport_tables_.clear();
+        max_teleport_steps_ = max_steps;
+        if (max_steps < 2)
+            return;
+        // Probabilities of reaching each node in one step.
+        TransitionTable one_step;
+        one_step.offsets.assign(1, 0);
+        for (std::size_t node = 0; node < node_ids_.size(); ++node) {
+            auto first = neighbor_offsets_[node];
+            auto last = neighbor_offsets_[node + 1];
+            if (first == last) {
+                one_step.targets.push_back(static_cast<NodeIndex>(node));
+                one_step.probabilities.push_back(1);
+            }
+            else {
+                double sum = 0;
+                if (!neighbor_probabilities_.empty()) {
+                    for (auto i = first; i < last; ++i)
+                        sum += neighbor_probabilities_[i];
+                }
+                for (auto i = first; i < last; ++i) {
+                    one_step.targets.push_back(neighbor_nodes_[i]);
+                    // Same as in next_probable_node (equal for all zero probabilities).
+                    if (sum > 0)
+                        one_step.probabilities.push_back(
+                            neighbor_probabilities_[i] / sum);
+                    else
+                        one_step.probabilities.push_back(1.0 / (last - first));
+                }
+            }
+            one_step.offsets.push_back(one_step.targets.size());
+        }
+        // Each number of steps is one more step from the previous one.
+        std::vector<double> reached(node_ids_.size(), 0);
+        std::vector<NodeIndex> reached_nodes;
+        AliasTableBuilder builder;
+        teleport_tables_.reserve(max_steps - 1);
+        const TransitionTable* previous = &one_step;
+        for (int steps = 2; steps <= max_steps; ++steps) {
+            TransitionTable table;
+            table.offsets.assign(1, 0);
+            for (std::size_t node = 0; node < node_ids_.size(); ++node) {
+                for (auto i = previous->offsets[node]; i < previous->offsets[node + 1];
+                     ++i) {
+                    auto middle = previous->targets[i];
+                    for (auto j = one_step.offsets[middle];
+                         j < one_step.offsets[middle + 1];
+                         ++j) {
+                        auto target = one_step.targets[j];
+                        if (reached[target] == 0)
+                            reached_nodes.push_back(target);
+                        reached[target] +=
+                            previous->probabilities[i] * one_step.probabilities[j];
+                    }
+                }
+                std::sort(reached_nodes.begin(), reached_nodes.end());
+                for (auto target : reached_nodes) {
+                    table.targets.push_back(target);
+                    table.probabilities.push_back(reached[target]);
+                    reached[target] = 0;
+                }
+                reached_nodes.clear();
+                table.offsets.push_back(table.targets.size());
+            }
+            table.alias_probabilities.resize(table.targets.size());
+            table.aliases.resize(table.targets.size());
+            for (std::size_t node = 0; node < node_ids_.size(); ++node) {
+                auto first = table.offsets[node];
+                builder.build(
+                    table.probabilities.data() + first,
+                    table.offsets[node + 1] - first,
+                    table.alias_probabilities.data() + first,
+                    table.aliases.data() + first);
+            }
+            teleport_tables_.push_back(std::move(table));
+            previous = &teleport_tables_.back();
         }
-        return get_node_row_col(node_id);
     }
 
     /**
@@ -556,12 +1199,11 @@ public:
     get_all_nodes() const
     {
         std::vector<std::pair<NodeId, std::pair<RasterIndex, RasterIndex>>> nodes;
-        nodes.reserve(nodes_by_row_col_.size());  // It will be at least this big.
-        for (const auto& item : nodes_by_row_col_) {
-            RasterIndex row = item.first.first;
-            RasterIndex col = item.first.second;
-            for (const auto node_id : item.second) {
-                nodes.emplace_back(node_id, std::make_pair(row, col));
+        nodes.reserve(cell_node_ids_.size());
+        for (std::size_t cell = 0; cell < cells_with_nodes_.size(); ++cell) {
+            for (auto i = cell_node_offsets_[cell]; i < cell_node_offsets_[cell + 1];
+                 ++i) {
+                nodes.emplace_back(cell_node_ids_[i], cells_with_nodes_[cell]);
             }
         }
         return nodes;
@@ -577,34 +1219,28 @@ public:
     Statistics collect_statistics() const
     {
         std::map<std::string, int> stats;
-        std::set<NodeId> node_ids;
-        for (const auto& item : nodes_by_row_col_) {
-            for (const auto node_id : item.second) {
-                node_ids.insert(node_id);
-            }
-        }
-        stats["num_nodes"] = node_ids.size();
-        // We store segments in both directions, so each segment is stored twice.
-        stats["num_segments"] = node_matrix_.size() / 2;
-        std::set<NodeId> nodes_with_segments;
-        for (const auto& item : node_matrix_) {
-            nodes_with_segments.insert(item.first);
-        }
-        stats["num_nodes_with_segments"] = nodes_with_segments.size();
+        stats["num_nodes"] = node_ids_.size();
+        int num_nodes_with_segments = 0;
         // TODO: Only count the nodes here. Output them in the dump network output.
         int num_standalone_nodes = 0;
-        for (NodeId node_id : node_ids) {
-            if (nodes_with_segments.find(node_id) == nodes_with_segments.end()) {
+        for (std::size_t node = 0; node < node_ids_.size(); ++node) {
+            if (neighbor_offsets_[node] != neighbor_offsets_[node + 1]) {
+                ++num_nodes_with_segments;
+            }
+            else {
                 stats["standalone_node_" + std::to_string(++num_standalone_nodes)] =
-                    node_id;
+                    node_ids_[node];
             }
         }
+        // We store segments in both directions, so each segment is stored twice.
+        stats["num_segments"] = num_nodes_with_segments / 2;
+        stats["num_nodes_with_segments"] = num_nodes_with_segments;
         stats["num_standalone_nodes"] = num_standalone_nodes;
-        // TODO: This can be faster. The list is a ordered set and we iterate over
-        // elements above.
-        const auto minmax_node_id = minmax_element(node_ids.begin(), node_ids.end());
-        stats["min_node_id"] = *minmax_node_id.first;
-        stats["max_node_id"] = *minmax_node_id.second;
+        // Node IDs are ordered.
+        if (!node_ids_.empty()) {
+            stats["min_node_id"] = node_ids_.front();
+            stats["max_node_id"] = node_ids_.back();
+        }
         return stats;
     }
 
@@ -648,9 +1284,9 @@ public:
         stream << "  cost:\n";
         stream << "    distance_per_cell: " << distance_per_cell_ << "\n";
         std::set<std::pair<NodeId, NodeId>> edges;
-        for (const auto& item : node_matrix_) {
-            for (const auto& node_id : item.second.second) {
-                edges.emplace(item.first, node_id);
+        for (std::size_t node = 0; node < node_ids_.size(); ++node) {
+            for (auto neighbor : neighbors(node)) {
+                edges.emplace(node_ids_[node], node_ids_[neighbor]);
             }
         }
         stream << "  edges:\n";
@@ -658,21 +1294,19 @@ public:
             stream << "    - [" << item.first << ", " << item.second << "]\n";
         }
         stream << "  nodes:\n";
-        for (const auto& item : nodes_by_row_col_) {
-            auto row = item.first.first;
-            auto col = item.first.second;
-            for (const auto& node_id : item.second) {
-                stream << "    - id: " << node_id << "\n";
-                stream << "      row: " << row << "\n";
-                stream << "      col: " << col << "\n";
-            }
+        for (const auto& item : get_all_nodes()) {
+            stream << "    - id: " << item.first << "\n";
+            stream << "      row: " << item.second.first << "\n";
+            stream << "      col: " << item.second.second << "\n";
         }
         stream << "  segments:\n";
-        for (const auto& item : segments_by_nodes_) {
-            stream << "    - start_node: " << item.first.first << "\n";
-            stream << "      end_node: " << item.first.second << "\n";
+        for (std::size_t edge = 0; edge < segment_costs_.size(); ++edge) {
+            stream << "    - start_node: " << node_ids_[edge_nodes_[2 * edge]] << "\n";
+            stream << "      end_node: " << node_ids_[edge_nodes_[2 * edge + 1]]
+                   << "\n";
             stream << "      cells: [";
-            for (const auto& cell : item.second) {
+            for (auto i = segment_offsets_[edge]; i < segment_offsets_[edge + 1]; ++i) {
+                const auto& cell = segment_cells_[i];
                 stream << "[" << cell.first << ", " << cell.second << "], ";
             }
             stream << "]\n";
@@ -680,14 +1314,11 @@ public:
     }
 
 protected:
-    /** Node connections (edges)
-     *
-     * The matrix is sparse. One node can be connected to multiple nodes.
-     * Connection in both directions is stored explicitly (see load_segments() source
-     * code).
-     */
-    using NodeMatrix =
-        std::map<NodeId, std::pair<std::vector<double>, std::vector<NodeId>>>;
+    /** Dense index of a node (position of the node in the list of node IDs) */
+    using NodeIndex = std::uint32_t;
+
+    /** Index of an edge (position of the edge in the list of edges) */
+    using EdgeIndex = std::uint32_t;
 
     /** Smallest component of edge geometry */
     using Cell = std::pair<RasterIndex, RasterIndex>;
@@ -696,9 +1327,28 @@ protected:
     using Segment = EdgeGeometry<Cell>;
 
     /** Constant view of a segment (to iterate a segment in either direction) */
-    using SegmentView = EdgeGeometryView<Segment>;
+    using SegmentView = EdgeGeometryView<ArrayView<Cell>>;
 
-    /** Segments by nodes (edges) */
+    /**
+     * Probabilities of reaching nodes from each node (in a given number of steps)
+     *
+     * Targets with their probabilities and alias tables are stored with offsets for
+     * each node.
+     */
+    struct TransitionTable
+    {
+        std::vector<std::size_t> offsets;  ///< Start of targets (one more than nodes)
+        std::vector<NodeIndex> targets;  ///< Reachable nodes (ordered for each node)
+        std::vector<double> probabilities;  ///< Probability of reaching the target
+        std::vector<double> alias_probabilities;  ///< Alias table probabilities
+        std::vector<std::uint32_t> aliases;  ///< Alias table aliases
+    };
+
+    /** Segments by nodes (edges)
+     *
+     * Used while loading. The order of the segments determines the order of edges and
+     * neighbors in the compact representation.
+     */
     using SegmentsByNodes = std::map<std::pair<NodeId, NodeId>, Segment>;
 
     /**
@@ -869,6 +1519,8 @@ protected:
         bool has_probability{false};
         std::tie(has_cost, has_probability) = stream_has_columns(stream, delimeter);
 
+        // Segments loaded previously are kept.
+        SegmentsByNodes segments_by_nodes = this->segments_by_nodes();
         std::string line;
         while (std::getline(stream, line)) {
             std::istringstream line_stream{line};
@@ -947,24 +1599,443 @@ protected:
             // Cut to extend
             if (cell_out_of_bbox(segment.front()) || cell_out_of_bbox(segment.back()))
                 continue;
-            // We are done with the segment data, so we move them to the attribute.
-            segments_by_nodes_.emplace(
+            // We are done with the segment data, so we move them to the collection.
+            segments_by_nodes.emplace(
                 std::make_pair(node_1_id, node_2_id), std::move(segment));
         }
+        build_from_segments(
+            segments_by_nodes, has_probability || !neighbor_probabilities_.empty());
+    }
 
-        for (const auto& node_segment : segments_by_nodes_) {
-            const auto& start_node_id{node_segment.first.first};
-            const auto& end_node_id{node_segment.first.second};
-            const auto& segment{node_segment.second};
-            nodes_by_row_col_[segment.front()].insert(start_node_id);
-            nodes_by_row_col_[segment.back()].insert(end_node_id);
+    /** Segment parsed from a line of text with cells stored in a shared list */
+    struct ParsedEdge
+    {
+        NodeId node_1;
+        NodeId node_2;
+        double probability;
+        double cost;
+        std::size_t first_cell;  ///< Index of the first cell in the chunk cells
+        std::size_t last_cell;  ///< Index after the last cell in the chunk cells
+    };
+
+    /** Segments parsed from a chunk of text or the error from parsing */
+    struct ParsedChunk
+    {
+        std::vector<ParsedEdge> edges;
+        std::vector<Cell> cells;  ///< Cells of all segments in the chunk
+        std::exception_ptr error;
+    };
+
+    /** Part of a text given by pointers to the first and past the last character */
+    using TextField = std::pair<const char*, const char*>;
+
+    /**
+     * @brief Get next field in the text
+     *
+     * Fields are split in the same way as with std::getline with a delimiter, i.e.,
+     * a field is available when there is at least one character left. When the end
+     * of the text was reached without a delimiter, position is set to null and the
+     * field is left unchanged in the following calls (as std::getline does at the end
+     * of a stream).
+     *
+     * @param[in,out] position Start of the field, moved to the next field
+     * @param end End of the text
+     * @param delimeter Character separating the fields
+     * @param[out] field Field without the delimeter
+     * @return True if a field was available
+     */
+    static bool next_text_field(
+        const char*& position, const char* end, char delimeter, TextField& field)
+    {
+        if (!position)
+            return false;
+        if (position >= end) {
+            field = {end, end};
+            position = nullptr;
+            return false;
+        }
+        const char* found = std::find(position, end, delimeter);
+        field = {position, found};
+        position = found == end ? nullptr : found + 1;
+        return true;
+    }
+
+    static std::string field_text(const TextField& field)
+    {
+        return std::string(field.first, field.second);
+    }
+
+    /**
+     * @brief Parse a floating point number from a field without allocation
+     *
+     * The text after the field is a delimiter or the end of the text, so the number
+     * cannot continue after the end of the field. The same rules as for std::stod
+     * apply, but nothing is thrown and false is returned instead.
+     */
+    static bool parse_field(const TextField& field, double& value)
+    {
+        if (field.first == field.second)
+            return false;
+        char* parsed_end;
+        errno = 0;
+        value = std::strtod(field.first, &parsed_end);
+        return parsed_end != field.first && parsed_end <= field.second
+               && errno != ERANGE;
+    }
+
+    /** Parse node ID from a field with fallback to node_id_from_text() for errors */
+    static NodeId node_id_from_field(const TextField& field)
+    {
+        if (field.first != field.second) {
+            char* parsed_end;
+            errno = 0;
+            long value = std::strtol(field.first, &parsed_end, 10);
+            if (parsed_end != field.first && parsed_end <= field.second
+                && errno != ERANGE && value >= INT_MIN && value <= INT_MAX)
+                return static_cast<NodeId>(value);
+        }
+        // Generates the same error as when loading with strings.
+        return node_id_from_text(field_text(field));
+    }
+
+    /**
+     * @brief Parse lines of text with segments
+     *
+     * Lines are parsed in the same way as in load_segments(), but the segments are
+     * stored in a parsed chunk without creating the segment objects. Errors produce
+     * the same exceptions as load_segments().
+     *
+     * @param begin Start of the first line
+     * @param end End of the last line
+     * @param has_probability True if lines contain probability
+     * @param has_cost True if lines contain cost
+     * @param[out] chunk Parsed segments
+     */
+    void parse_lines(
+        const char* begin,
+        const char* end,
+        bool has_probability,
+        bool has_cost,
+        ParsedChunk& chunk) const
+    {
+        char delimeter{','};
+        char in_cell_delimeter{';'};
+        const char* line_begin = begin;
+        while (line_begin < end) {
+            const char* line_end = std::find(line_begin, end, '\n');
+            const char* position = line_begin;
+            TextField node_1_text{line_end, line_end};
+            TextField node_2_text{line_end, line_end};
+            next_text_field(position, line_end, delimeter, node_1_text);
+            next_text_field(position, line_end, delimeter, node_2_text);
+            auto node_1_id = node_id_from_field(node_1_text);
+            auto node_2_id = node_id_from_field(node_2_text);
+            if (node_1_id < 1 || node_2_id < 1) {
+                throw std::runtime_error(
+                    std::string("Node ID must be greater than zero (node 1, node 2): ")
+                    + field_text(node_1_text) + ", " + field_text(node_2_text)
+                    + ", line: " + std::string(line_begin, line_end));
+            }
+            ParsedEdge edge{node_1_id, node_2_id, 0, 0, chunk.cells.size(), 0};
             if (has_probability) {
-                node_matrix_[start_node_id].first.push_back(segment.probability());
-                node_matrix_[end_node_id].first.push_back(segment.probability());
+                TextField probability_text{line_end, line_end};
+                next_text_field(position, line_end, delimeter, probability_text);
+                if (!parse_field(probability_text, edge.probability)
+                    || !(edge.probability >= 0))
+                    edge.probability =
+                        probability_from_text(field_text(probability_text));
+            }
+            if (has_cost) {
+                TextField cost_text{line_end, line_end};
+                next_text_field(position, line_end, delimeter, cost_text);
+                if (!parse_field(cost_text, edge.cost))
+                    edge.cost = cost_from_text(field_text(cost_text));
+            }
+
+            TextField segment_text{line_end, line_end};
+            next_text_field(position, line_end, delimeter, segment_text);
+            const char* segment_position = segment_text.first;
+            TextField x_coord_text{segment_text.first, segment_text.first};
+            TextField y_coord_text{segment_text.first, segment_text.first};
+            long int loaded_coord_pairs = 0;
+            while (next_text_field(
+                       segment_position,
+                       segment_text.second,
+                       in_cell_delimeter,
+                       x_coord_text)
+                   && next_text_field(
+                       segment_position,
+                       segment_text.second,
+                       in_cell_delimeter,
+                       y_coord_text)) {
+                double x;
+                double y;
+                Cell new_point;
+                if (parse_field(x_coord_text, x) && parse_field(y_coord_text, y))
+                    new_point = xy_to_row_col(x, y);
+                else
+                    new_point = xy_to_row_col(
+                        field_text(x_coord_text), field_text(y_coord_text));
+                if (chunk.cells.size() == edge.first_cell
+                    || chunk.cells.back() != new_point)
+                    chunk.cells.push_back(new_point);
+                ++loaded_coord_pairs;
+            }
+
+            std::size_t num_cells = chunk.cells.size() - edge.first_cell;
+            if (!num_cells) {
+                throw std::runtime_error(
+                    std::string("Row for an edge between nodes ")
+                    + field_text(node_1_text) + " and " + field_text(node_2_text)
+                    + " does not have any node coordinates");
+            }
+            if (loaded_coord_pairs < 2) {
+                throw std::runtime_error(
+                    std::string("Row for an edge between nodes ")
+                    + field_text(node_1_text) + " and " + field_text(node_2_text)
+                    + " has only 1 coordinate pair "
+                    + "(at least two are needed, one for each node), "
+                    + "the one coordinate pair was: " + field_text(x_coord_text)
+                    + ", " + field_text(y_coord_text));
+            }
+            // Missing coordinates for the second node as in load_segments().
+            if (num_cells == 1)
+                chunk.cells.push_back(chunk.cells.back());
+            line_begin = line_end == end ? end : line_end + 1;
+            // Segments with a node out of the extent are skipped.
+            if (cell_out_of_bbox(chunk.cells[edge.first_cell])
+                || cell_out_of_bbox(chunk.cells.back())) {
+                chunk.cells.resize(edge.first_cell);
+                continue;
+            }
+            edge.last_cell = chunk.cells.size();
+            chunk.edges.push_back(edge);
+        }
+    }
+
+    /**
+     * @brief Create the compact representation from segments
+     *
+     * Replaces any existing nodes and edges. Edges are in the order of the segments.
+     * Both nodes of an edge are connected to each other and the neighbors of each
+     * node are in the order of the edges. Node indices are in the order of node IDs.
+     *
+     * @param segments_by_nodes Segments with start and end node IDs
+     * @param has_probability True if segment probabilities should be used
+     */
+    void
+    build_from_segments(const SegmentsByNodes& segments_by_nodes, bool has_probability)
+    {
+        // Nodes ordered by ID and the cells where they are.
+        std::vector<NodeId> node_ids;
+        std::vector<std::pair<Cell, NodeId>> node_locations;
+        node_ids.reserve(2 * segments_by_nodes.size());
+        node_locations.reserve(2 * segments_by_nodes.size());
+        for (const auto& node_segment : segments_by_nodes) {
+            const auto& segment{node_segment.second};
+            node_ids.push_back(node_segment.first.first);
+            node_ids.push_back(node_segment.first.second);
+            node_locations.emplace_back(segment.front(), node_segment.first.first);
+            node_locations.emplace_back(segment.back(), node_segment.first.second);
+        }
+        std::sort(node_ids.begin(), node_ids.end());
+        node_ids.erase(std::unique(node_ids.begin(), node_ids.end()), node_ids.end());
+        node_ids_ = std::move(node_ids);
+        std::sort(node_locations.begin(), node_locations.end());
+        node_locations.erase(
+            std::unique(node_locations.begin(), node_locations.end()),
+            node_locations.end());
+
+        // Node IDs for each cell (row-major order of cells, IDs ordered).
+        std::vector<Cell> cells_with_nodes;
+        std::vector<std::size_t> cell_node_offsets(1, 0);
+        std::vector<NodeId> cell_node_ids;
+        cell_node_ids.reserve(node_locations.size());
+        std::vector<Cell> node_cells(node_ids_.size());
+        std::vector<bool> node_has_cell(node_ids_.size(), false);
+        for (const auto& location : node_locations) {
+            if (cells_with_nodes.empty() || cells_with_nodes.back() != location.first) {
+                if (!cells_with_nodes.empty())
+                    cell_node_offsets.push_back(cell_node_ids.size());
+                cells_with_nodes.push_back(location.first);
+            }
+            cell_node_ids.push_back(location.second);
+            // The first cell of a node in the row-major order.
+            auto node = node_index(location.second);
+            if (!node_has_cell[node]) {
+                node_cells[node] = location.first;
+                node_has_cell[node] = true;
             }
-            node_matrix_[start_node_id].second.push_back(end_node_id);
-            node_matrix_[end_node_id].second.push_back(start_node_id);
         }
+        if (!cells_with_nodes.empty())
+            cell_node_offsets.push_back(cell_node_ids.size());
+        // Range of cells with nodes for each row.
+        std::size_t num_rows = 0;
+        if (!cells_with_nodes.empty())
+            num_rows = cells_with_nodes.back().first + 1;
+        std::vector<std::size_t> row_offsets(num_rows + 1, 0);
+        for (const auto& cell : cells_with_nodes)
+            ++row_offsets[cell.first + 1];
+        for (std::size_t row = 0; row < num_rows; ++row)
+            row_offsets[row + 1] += row_offsets[row];
+
+        // Edges with their segments.
+        std::size_t num_edges = segments_by_nodes.size();
+        std::size_t num_cells = 0;
+        for (const auto& node_segment : segments_by_nodes)
+            num_cells += node_segment.second.size();
+        std::vector<NodeIndex> edge_nodes;
+        edge_nodes.reserve(2 * num_edges);
+        std::vector<std::size_t> segment_offsets(1, 0);
+        segment_offsets.reserve(num_edges + 1);
+        std::vector<Cell> segment_cells;
+        segment_cells.reserve(num_cells);
+        std::vector<double> segment_costs;
+        segment_costs.reserve(num_edges);
+        std::vector<double> segment_costs_per_cell;
+        segment_costs_per_cell.reserve(num_edges);
+        std::vector<double> edge_probabilities;
+        for (const auto& node_segment : segments_by_nodes) {
+            const auto& segment{node_segment.second};
+            edge_nodes.push_back(node_index(node_segment.first.first));
+            edge_nodes.push_back(node_index(node_segment.first.second));
+            segment_cells.insert(segment_cells.end(), segment.begin(), segment.end());
+            segment_offsets.push_back(segment_cells.size());
+            segment_costs.push_back(segment.cost());
+            segment_costs_per_cell.push_back(segment.cost_per_cell());
+            edge_probabilities.push_back(segment.probability());
+        }
+
+        // Neighbors of each node (both directions of each edge).
+        std::vector<std::size_t> neighbor_offsets(node_ids_.size() + 1, 0);
+        for (auto node : edge_nodes)
+            ++neighbor_offsets[node + 1];
+        for (std::size_t node = 0; node < node_ids_.size(); ++node)
+            neighbor_offsets[node + 1] += neighbor_offsets[node];
+        std::vector<NodeIndex> neighbor_nodes(edge_nodes.size(), 0);
+        std::vector<EdgeIndex> neighbor_edges(edge_nodes.size(), 0);
+        std::vector<double> neighbor_probabilities;
+        if (has_probability)
+            neighbor_probabilities.assign(edge_nodes.size(), 0);
+        std::vector<std::size_t> next_neighbor(
+            neighbor_offsets.begin(), neighbor_offsets.end() - 1);
+        for (std::size_t edge = 0; edge < num_edges; ++edge) {
+            NodeIndex start = edge_nodes[2 * edge];
+            NodeIndex end = edge_nodes[2 * edge + 1];
+            for (const auto& nodes :
+                 {std::make_pair(start, end), std::make_pair(end, start)}) {
+                auto position = next_neighbor[nodes.first]++;
+                neighbor_nodes[position] = nodes.second;
+                neighbor_edges[position] = static_cast<EdgeIndex>(edge);
+                if (has_probability)
+                    neighbor_probabilities[position] = edge_probabilities[edge];
+            }
+        }
+        // Alias tables to pick neighbors based on probabilities.
+        std::vector<double> neighbor_alias_probabilities;
+        std::vector<std::uint32_t> neighbor_aliases;
+        if (has_probability) {
+            neighbor_alias_probabilities.resize(neighbor_nodes.size());
+            neighbor_aliases.resize(neighbor_nodes.size());
+            AliasTableBuilder builder;
+            for (std::size_t node = 0; node < node_ids_.size(); ++node) {
+                auto first = neighbor_offsets[node];
+                builder.build(
+                    neighbor_probabilities.data() + first,
+                    neighbor_offsets[node + 1] - first,
+                    neighbor_alias_probabilities.data() + first,
+                    neighbor_aliases.data() + first);
+            }
+        }
+        node_cells_ = std::move(node_cells);
+        cells_with_nodes_ = std::move(cells_with_nodes);
+        row_offsets_ = std::move(row_offsets);
+        cell_node_offsets_ = std::move(cell_node_offsets);
+        cell_node_ids_ = std::move(cell_node_ids);
+        neighbor_offsets_ = std::move(neighbor_offsets);
+        neighbor_nodes_ = std::move(neighbor_nodes);
+        neighbor_edges_ = std::move(neighbor_edges);
+        neighbor_probabilities_ = std::move(neighbor_probabilities);
+        neighbor_alias_probabilities_ = std::move(neighbor_alias_probabilities);
+        neighbor_aliases_ = std::move(neighbor_aliases);
+        edge_nodes_ = std::move(edge_nodes);
+        segment_offsets_ = std::move(segment_offsets);
+        segment_cells_ = std::move(segment_cells);
+        segment_costs_ = std::move(segment_costs);
+        segment_costs_per_cell_ = std::move(segment_costs_per_cell);
+        precompute_teleport_steps(max_teleport_steps_);
+    }
+
+    /**
+     * @brief Get segments of all edges
+     *
+     * This translates the internal representation and returns a new object.
+     */
+    SegmentsByNodes segments_by_nodes() const
+    {
+        SegmentsByNodes segments_by_nodes;
+        for (std::size_t edge = 0; edge < segment_costs_.size(); ++edge) {
+            Segment segment;
+            segment.assign(
+                segment_cells_.begin() + segment_offsets_[edge],
+                segment_cells_.begin() + segment_offsets_[edge + 1]);
+            segment.set_total_cost(segment_costs_[edge]);
+            segment.set_cost_per_cell(segment_costs_per_cell_[edge]);
+            if (!neighbor_probabilities_.empty())
+                segment.set_probability(edge_probability(edge));
+            segments_by_nodes.emplace_hint(
+                segments_by_nodes.end(),
+                std::make_pair(
+                    node_ids_[edge_nodes_[2 * edge]],
+                    node_ids_[edge_nodes_[2 * edge + 1]]),
+                std::move(segment));
+        }
+        return segments_by_nodes;
+    }
+
+    /** Get probability of an edge (requires edge probabilities) */
+    double edge_probability(std::size_t edge) const
+    {
+        NodeIndex start = edge_nodes_[2 * edge];
+        for (auto i = neighbor_offsets_[start]; i < neighbor_offsets_[start + 1]; ++i) {
+            if (neighbor_edges_[i] == edge)
+                return neighbor_probabilities_[i];
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Get dense index of a node
+     *
+     * @param node Node ID
+     * @return Index of the node
+     * @throws std::invalid_argument if there is no node with the given ID
+     */
+    NodeIndex node_index(NodeId node) const
+    {
+        auto it = std::lower_bound(node_ids_.begin(), node_ids_.end(), node);
+        if (it == node_ids_.end() || *it != node)
+            throw std::invalid_argument("No node with a given id");
+        return static_cast<NodeIndex>(it - node_ids_.begin());
+    }
+
+    /**
+     * @brief Find a cell with nodes
+     *
+     * @return Position of the cell in the list of cells with nodes or size of the list
+     * if there are no nodes at the cell
+     */
+    std::size_t find_cell(RasterIndex row, RasterIndex col) const
+    {
+        std::size_t not_found = cells_with_nodes_.size();
+        if (row < 0 || std::size_t(row) + 1 >= row_offsets_.size())
+            return not_found;
+        auto first = cells_with_nodes_.begin() + row_offsets_[row];
+        auto last = cells_with_nodes_.begin() + row_offsets_[row + 1];
+        auto it = std::lower_bound(first, last, Cell(row, col));
+        if (it == last || it->second != col)
+            return not_found;
+        return it - cells_with_nodes_.begin();
     }
 
     /**
@@ -980,73 +2051,151 @@ protected:
      */
     SegmentView get_segment(NodeId start, NodeId end) const
     {
-        auto it = segments_by_nodes_.find(std::make_pair(start, end));
-        if (it != segments_by_nodes_.end()) {
-            return SegmentView(it->second.cbegin(), it->second.cend(), it->second);
-        }
-        it = segments_by_nodes_.find(std::make_pair(end, start));
-        if (it != segments_by_nodes_.end()) {
-            return SegmentView(it->second.crbegin(), it->second.crend(), it->second);
+        return get_segment_by_index(node_index(start), node_index(end));
+    }
+
+    /**
+     * @brief Get a segment between the two given nodes using dense node indices
+     *
+     * The edge from start to end is used if it exists, otherwise the edge from end to
+     * start is used (as reversed).
+     *
+     * @see get_segment()
+     */
+    SegmentView get_segment_by_index(NodeIndex start, NodeIndex end) const
+    {
+        bool found = false;
+        EdgeIndex reversed_edge = 0;
+        for (auto i = neighbor_offsets_[start]; i < neighbor_offsets_[start + 1]; ++i) {
+            if (neighbor_nodes_[i] != end)
+                continue;
+            EdgeIndex edge = neighbor_edges_[i];
+            if (edge_nodes_[2 * edge] == start)
+                return segment_view(edge, false);
+            reversed_edge = edge;
+            found = true;
         }
+        if (found)
+            return segment_view(reversed_edge, true);
         throw std::invalid_argument(std::string(
-            "No segment for given nodes: " + std::to_string(start) + " "
-            + std::to_string(end)));
+            "No segment for given nodes: " + std::to_string(node_ids_[start]) + " "
+            + std::to_string(node_ids_[end])));
+    }
+
+    /** Get a view of the segment of an edge, possibly reversed */
+    SegmentView segment_view(EdgeIndex edge, bool reversed) const
+    {
+        auto first = segment_cells_.begin() + segment_offsets_[edge];
+        auto last = segment_cells_.begin() + segment_offsets_[edge + 1];
+        if (reversed) {
+            return SegmentView(
+                std::make_reverse_iterator(last),
+                std::make_reverse_iterator(first),
+                segment_costs_[edge],
+                segment_costs_per_cell_[edge]);
+        }
+        return SegmentView(
+            first, last, segment_costs_[edge], segment_costs_per_cell_[edge]);
     }
 
     /**
      * @brief Get nodes connected by an edge to a given node.
      *
-     * @param node Node to get connections from
-     * @return List of connected nodes
+     * @param node Index of the node to get connections from
+     * @return List of indices of connected nodes
      */
-    const std::vector<NodeId>& nodes_connected_to(NodeId node) const
+    ArrayView<NodeIndex> neighbors(NodeIndex node) const
     {
-        return node_matrix_.at(node).second;
+        return ArrayView<NodeIndex>(
+            neighbor_nodes_.data() + neighbor_offsets_[node],
+            neighbor_nodes_.data() + neighbor_offsets_[node + 1]);
     }
 
+    /** Position returned by next_neighbor() for a node without neighbors */
+    static constexpr std::size_t no_neighbor = std::size_t(-1);
+
     /**
      * @brief Pick a next node from the given node.
      *
      * If there is more than one edge leading from the given node, a random node is
-     * picked. If there are no edges leading from the given node, the node is returned.
+     * picked. If there are no edges leading from the given node, no_neighbor is
+     * returned.
      *
      * The random node is picked from candidate nodes which are nodes connected to
-     * a given node. The candidate nodes which are in the *ignore* list are excluded
-     * from the random selection. If all candidate nodes are in the *ignore* list,
-     * the *ignore* list is ignored and all candidate nodes are used.
+     * a given node. The candidate nodes which are in the *ignore* set are excluded
+     * from the random selection. If all candidate nodes are in the *ignore* set,
+     * the *ignore* set is ignored and all candidate nodes are used.
+     *
+     * The candidates are counted and picked directly in the list of neighbors, so
+     * no list of candidates is created.
      *
-     * The function always returns a node to go to even if it means going to an ignored
-     * node or returning the value of the *node* parameter.
+     * @return Position of the picked node in the list of neighbors (see
+     * neighbor_nodes_ and neighbor_edges_)
      */
     template<typename Generator>
-    NodeId
-    next_node(NodeId node, const std::set<NodeId>& ignore, Generator& generator) const
+    std::size_t next_neighbor(
+        NodeIndex node, const SmallSet<NodeIndex>& ignore, Generator& generator) const
     {
-        // Get all candidate nodes.
-        const auto& all_nodes = nodes_connected_to(node);
+        auto first = neighbor_offsets_[node];
+        auto last = neighbor_offsets_[node + 1];
 
         // Resolve disconnected node and dead end cases.
-        auto num_nodes = all_nodes.size();
+        auto num_nodes = last - first;
         if (!num_nodes)
-            return node;
+            return no_neighbor;
         else if (num_nodes == 1)
-            return all_nodes[0];
+            return first;
 
-        // Filter out the ignored nodes.
-        std::vector<int> nodes;
-        std::back_insert_iterator<std::vector<int>> back_it(nodes);
-        std::remove_copy_if(
-            all_nodes.begin(), all_nodes.end(), back_it, [&ignore](NodeId id) {
-                return container_contains(ignore, id);
-            });
+        // Count the candidates which are not ignored.
+        std::size_t num_candidates = 0;
+        for (auto i = first; i < last; ++i) {
+            if (!ignore.contains(neighbor_nodes_[i]))
+                ++num_candidates;
+        }
 
         // Pick a random node. Fallback to all candidate nodes if all are in ignore.
-        num_nodes = nodes.size();
-        if (!num_nodes)
-            return pick_random_item(all_nodes, generator);
-        else if (num_nodes == 1)
-            return nodes[0];
-        return pick_random_item(nodes, generator);
+        if (!num_candidates) {
+            std::uniform_int_distribution<std::size_t> distribution(0, num_nodes - 1);
+            return first + distribution(generator);
+        }
+        std::size_t index = 0;
+        if (num_candidates > 1) {
+            std::uniform_int_distribution<std::size_t> distribution(
+                0, num_candidates - 1);
+            index = distribution(generator);
+        }
+        for (auto i = first; i < last; ++i) {
+            if (ignore.contains(neighbor_nodes_[i]))
+                continue;
+            if (!index)
+                return i;
+            --index;
+        }
+        return no_neighbor;  // Not reached.
+    }
+
+    /**
+     * @brief Get segment leading from a node to its neighbor
+     *
+     * Gives the same segment as get_segment_by_index(), i.e., the edge from the node
+     * to the neighbor is preferred, but the edge of the neighbor is used directly
+     * and the other neighbors are checked only for an edge in the opposite direction.
+     *
+     * @param node Index of the node
+     * @param position Position of the neighbor in the list of neighbors
+     */
+    SegmentView segment_to_neighbor(NodeIndex node, std::size_t position) const
+    {
+        EdgeIndex edge = neighbor_edges_[position];
+        if (edge_nodes_[2 * edge] == node)
+            return segment_view(edge, false);
+        NodeIndex neighbor = neighbor_nodes_[position];
+        for (auto i = neighbor_offsets_[node]; i < neighbor_offsets_[node + 1]; ++i) {
+            if (neighbor_nodes_[i] == neighbor
+                && edge_nodes_[2 * neighbor_edges_[i]] == node)
+                return segment_view(neighbor_edges_[i], false);
+        }
+        return segment_view(edge, true);
     }
 
     /**
@@ -1058,12 +2207,10 @@ protected:
      * node itself is returned.
      */
     template<typename Generator>
-    NodeId next_probable_node(NodeId node, Generator& generator) const
+    NodeIndex next_probable_node(NodeIndex node, Generator& generator) const
     {
         // Get all candidate nodes.
-        const auto& record{node_matrix_.at(node)};
-        const auto& probabilities{record.first};
-        const auto& nodes{record.second};
+        auto nodes = neighbors(node);
 
         // Resolve disconnected node and dead end cases.
         auto num_nodes = nodes.size();
@@ -1073,25 +2220,110 @@ protected:
             return nodes[0];
 
         // Pick nodes based on edge probabilities if they are available.
-        if (!probabilities.empty()) {
-            std::discrete_distribution<int> dd{
-                probabilities.begin(), probabilities.end()};
-            return nodes.at(dd(generator));
+        if (!neighbor_probabilities_.empty()) {
+            auto first = neighbor_offsets_[node];
+            return nodes[sample_alias_table(
+                neighbor_alias_probabilities_.data() + first,
+                neighbor_aliases_.data() + first,
+                num_nodes,
+                generator)];
         }
         // Pick a connected node with equal edge probabilities.
         return pick_random_item(nodes, generator);
     }
 
+    /** Identification of the binary network file */
+    static constexpr char binary_magic[8] = {'P', 'O', 'P', 'S', 'N', 'E', 'T', 'W'};
+    /** Version of the binary network file format */
+    static constexpr std::uint32_t binary_version = 1;
+    /** Number written in the file to check the byte order */
+    static constexpr std::uint32_t binary_byte_order = 0x01020304;
+    /** Number of arrays stored in the binary file (see for_each_array()) */
+    static constexpr std::uint32_t binary_num_arrays = 17;
+    /** Alignment of arrays in the binary file */
+    static constexpr std::uint64_t binary_alignment = 64;
+
+    /** Size of the binary file header including the array table */
+    static constexpr std::size_t binary_header_size()
+    {
+        return sizeof(binary_magic) + 6 * sizeof(std::uint32_t) + 6 * sizeof(double)
+               + 3 * binary_num_arrays * sizeof(std::uint64_t);
+    }
+
+    /** Round position in the binary file up to the array alignment */
+    static std::uint64_t align_to_block(std::uint64_t position)
+    {
+        return (position + binary_alignment - 1) / binary_alignment * binary_alignment;
+    }
+
+    /**
+     * @brief Call function for each array of the network representation
+     *
+     * The arrays are always visited in the same order which is the order of arrays
+     * in the binary file.
+     *
+     * @param self Network object (const for reading, non-const for assigning)
+     * @param function Function taking the array (SharedArray) as a parameter
+     */
+    template<typename Self, typename Function>
+    static void for_each_array(Self& self, Function function)
+    {
+        static_assert(
+            sizeof(Cell) == 2 * sizeof(RasterIndex),
+            "Cells need to be stored without padding");
+        function(self.node_ids_);
+        function(self.node_cells_);
+        function(self.cells_with_nodes_);
+        function(self.row_offsets_);
+        function(self.cell_node_offsets_);
+        function(self.cell_node_ids_);
+        function(self.neighbor_offsets_);
+        function(self.neighbor_nodes_);
+        function(self.neighbor_edges_);
+        function(self.neighbor_probabilities_);
+        function(self.neighbor_alias_probabilities_);
+        function(self.neighbor_aliases_);
+        function(self.edge_nodes_);
+        function(self.segment_offsets_);
+        function(self.segment_cells_);
+        function(self.segment_costs_);
+        function(self.segment_costs_per_cell_);
+    }
+
     BBox<double> bbox_;  ///< Bounding box of the network grid in real world coordinates
     double ew_res_;  ///< East-west resolution of the grid
     double ns_res_;  ///< North-south resolution of the grid
     RasterIndex max_row_;  ///< Maximum row index in the grid
     RasterIndex max_col_;  ///< Maximum column index in the grid
     double distance_per_cell_;  ///< Distance (cost) to walk through one cell
-    /** Node IDs stored by row and column (multiple nodes per cell) */
-    std::map<std::pair<RasterIndex, RasterIndex>, std::set<NodeId>> nodes_by_row_col_;
-    NodeMatrix node_matrix_;  ///< List of node neighbors by node ID (edges)
-    SegmentsByNodes segments_by_nodes_;  ///< Lists of cells connecting nodes
+    SharedArray<NodeId> node_ids_;  ///< Node ID for each node index (ordered)
+    SharedArray<Cell> node_cells_;  ///< Row and column for each node index
+    /** Cells with nodes in row-major order */
+    SharedArray<Cell> cells_with_nodes_;
+    /** Start of cells of each row in cells with nodes (one more than rows) */
+    SharedArray<std::size_t> row_offsets_;
+    /** Start of node IDs of each cell with nodes (one more than cells) */
+    SharedArray<std::size_t> cell_node_offsets_;
+    SharedArray<NodeId> cell_node_ids_;  ///< Node IDs at cells (ordered for each cell)
+    /** Start of neighbors of each node (one more than nodes) */
+    SharedArray<std::size_t> neighbor_offsets_;
+    SharedArray<NodeIndex> neighbor_nodes_;  ///< Neighbors of nodes
+    SharedArray<EdgeIndex> neighbor_edges_;  ///< Edge leading to each neighbor
+    /** Probability of the edge leading to each neighbor (empty if not used) */
+    SharedArray<double> neighbor_probabilities_;
+    /** Alias table probabilities for neighbors of each node (empty if not used) */
+    SharedArray<double> neighbor_alias_probabilities_;
+    /** Alias table aliases for neighbors of each node (empty if not used) */
+    SharedArray<std::uint32_t> neighbor_aliases_;
+    /** Destinations for teleporting in 2, 3, ... steps */
+    std::vector<TransitionTable> teleport_tables_;
+    int max_teleport_steps_{1};  ///< Steps requested for teleport tables
+    SharedArray<NodeIndex> edge_nodes_;  ///< Start and end node of each edge
+    /** Start of cells of each segment (one more than edges) */
+    SharedArray<std::size_t> segment_offsets_;
+    SharedArray<Cell> segment_cells_;  ///< Cells of all segments
+    SharedArray<double> segment_costs_;  ///< Cost of each segment
+    SharedArray<double> segment_costs_per_cell_;  ///< Cost per cell for each segment
 };
 
 }  // namespace pops
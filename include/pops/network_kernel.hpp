@@ -21,6 +21,32 @@
 
 namespace pops {
 
+/** Type of movement over a network */
+enum class NetworkMovement
+{
+    Walk,  ///< Walk given distance (cost) over the network
+    Jump,  ///< Walk given distance, but end on the closest node
+    Teleport,  ///< Move from a node to a node
+};
+
+/*! Get a corresponding enum value for a string with network movement name.
+ *
+ * Empty string is walk which is the default.
+ *
+ * Throws an std::invalid_argument exception if the value is not supported.
+ */
+inline NetworkMovement network_movement_from_string(const std::string& text)
+{
+    if (text.empty() || text == "walk" || text == "Walk")
+        return NetworkMovement::Walk;
+    if (text == "jump" || text == "Jump")
+        return NetworkMovement::Jump;
+    if (text == "teleport" || text == "Teleport")
+        return NetworkMovement::Teleport;
+    throw std::invalid_argument(
+        "network_movement_from_string: Invalid value '" + text + "' provided");
+}
+
 /*!
  * @brief Dispersal kernel for dispersal over a network.
  *
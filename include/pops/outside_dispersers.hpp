@@ -0,0 +1,230 @@
+/*
+ * PoPS model - aggregated counts of dispersers which left the area
+ *
+ * Copyright (C) 2023 by the authors.
+ *
+ * Authors: Vaclav Petras <wenzeslaus gmail com>
+ *
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef POPS_OUTSIDE_DISPERSERS_HPP
+#define POPS_OUTSIDE_DISPERSERS_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace pops {
+
+/**
+ * Counts of dispersers which left the area
+ *
+ * This is an aggregated alternative to the list of destinations of dispersers
+ * which left the area (the list has one item for each disperser). The dispersers
+ * are counted either for each cell outside of the area, or in bins by direction
+ * and distance from the area. Memory used by the counts for cells grows with the
+ * number of distinct cells reached, while the memory used by the bins is fixed.
+ *
+ * Cells are given as row and column in the grid of the area, so values are negative
+ * or greater than the size of the area.
+ */
+class OutsideDispersers
+{
+public:
+    using Count = long long;
+    using Cell = std::pair<int, int>;
+
+    /** Count dispersers for each cell outside of the area */
+    OutsideDispersers() = default;
+
+    /**
+     * @brief Count dispersers in bins by direction and distance
+     *
+     * Direction is measured clockwise from north (up) from the center of the area.
+     * The first direction bin is centered on north, so with eight directions, the
+     * bins match the directions in Direction. Distance is measured in cells from the
+     * edge of the area. The last distance bin includes all larger distances.
+     *
+     * @param rows Number of rows of the area
+     * @param cols Number of columns of the area
+     * @param num_directions Number of direction bins
+     * @param distance_bin_size Size of one distance bin in cells
+     * @param num_distance_bins Number of distance bins
+     *
+     * @throw std::invalid_argument when number of bins is zero or bin size is not
+     * positive
+     */
+    OutsideDispersers(
+        int rows,
+        int cols,
+        unsigned num_directions,
+        double distance_bin_size,
+        unsigned num_distance_bins)
+        : binned_(true),
+          rows_(rows),
+          cols_(cols),
+          num_directions_(num_directions),
+          distance_bin_size_(distance_bin_size),
+          num_distance_bins_(num_distance_bins),
+          bins_(static_cast<std::size_t>(num_directions) * num_distance_bins, 0)
+    {
+        if (!num_directions_ || !num_distance_bins_) {
+            throw std::invalid_argument(
+                "OutsideDispersers: Number of direction and distance bins needs "
+                "to be at least one");
+        }
+        if (!(distance_bin_size_ > 0)) {
+            throw std::invalid_argument(
+                "OutsideDispersers: Distance bin size needs to be positive, not "
+                + std::to_string(distance_bin_size_));
+        }
+    }
+
+    /**
+     * @brief Add dispersers which left the area
+     * @param row Row number
+     * @param col Column number
+     * @param count Number of dispersers
+     */
+    void add(int row, int col, Count count = 1)
+    {
+        total_ += count;
+        if (binned_)
+            bins_[bin_index(direction_bin(row, col), distance_bin(row, col))] += count;
+        else
+            cells_[Cell(row, col)] += count;
+    }
+
+    /** Get total number of dispersers which left the area */
+    Count total() const
+    {
+        return total_;
+    }
+
+    /** Return true if dispersers are counted in bins, false if for each cell */
+    bool binned() const
+    {
+        return binned_;
+    }
+
+    /**
+     * @brief Get counts for each cell
+     *
+     * @return Counts by cell (row, col), empty when counting in bins
+     */
+    const std::map<Cell, Count>& cell_counts() const
+    {
+        return cells_;
+    }
+
+    /**
+     * @brief Get number of dispersers which reached a cell
+     *
+     * @throw std::logic_error when counting in bins
+     */
+    Count count_at(int row, int col) const
+    {
+        if (binned_) {
+            throw std::logic_error(
+                "OutsideDispersers: Counts for cells are not available with bins");
+        }
+        auto it = cells_.find(Cell(row, col));
+        if (it == cells_.end())
+            return 0;
+        return it->second;
+    }
+
+    /**
+     * @brief Get number of dispersers in a bin
+     *
+     * @throw std::logic_error when counting for each cell
+     * @throw std::out_of_range when bin does not exist
+     */
+    Count bin_count(unsigned direction, unsigned distance) const
+    {
+        if (!binned_) {
+            throw std::logic_error(
+                "OutsideDispersers: Bins are not available with counts for cells");
+        }
+        if (direction >= num_directions_ || distance >= num_distance_bins_) {
+            throw std::out_of_range(
+                "OutsideDispersers: Bin (" + std::to_string(direction) + ", "
+                + std::to_string(distance) + ") does not exist");
+        }
+        return bins_[bin_index(direction, distance)];
+    }
+
+    unsigned num_directions() const
+    {
+        return num_directions_;
+    }
+
+    unsigned num_distance_bins() const
+    {
+        return num_distance_bins_;
+    }
+
+    /** Get direction bin for a cell */
+    unsigned direction_bin(int row, int col) const
+    {
+        const double pi = std::acos(-1.0);
+        double east = col - (cols_ - 1) / 2.0;
+        double north = (rows_ - 1) / 2.0 - row;
+        double angle = std::atan2(east, north) * 180 / pi;
+        double sector = 360.0 / num_directions_;
+        // Shift by half of a sector, so that the first bin is centered on north.
+        double shifted = std::fmod(angle + sector / 2 + 360, 360);
+        return std::min(static_cast<unsigned>(shifted / sector), num_directions_ - 1);
+    }
+
+    /** Get distance bin for a cell */
+    unsigned distance_bin(int row, int col) const
+    {
+        int rows_beyond = row < 0 ? -row : std::max(row - rows_ + 1, 0);
+        int cols_beyond = col < 0 ? -col : std::max(col - cols_ + 1, 0);
+        double distance = std::sqrt(
+            double(rows_beyond) * rows_beyond + double(cols_beyond) * cols_beyond);
+        double bin = std::floor(distance / distance_bin_size_);
+        if (bin >= num_distance_bins_ - 1)
+            return num_distance_bins_ - 1;
+        return static_cast<unsigned>(bin);
+    }
+
+    /** Remove all counts */
+    void clear()
+    {
+        total_ = 0;
+        cells_.clear();
+        std::fill(bins_.begin(), bins_.end(), 0);
+    }
+
+private:
+    std::size_t bin_index(unsigned direction, unsigned distance) const
+    {
+        return static_cast<std::size_t>(direction) * num_distance_bins_ + distance;
+    }
+
+    bool binned_{false};
+    int rows_{0};
+    int cols_{0};
+    unsigned num_directions_{0};
+    double distance_bin_size_{1};
+    unsigned num_distance_bins_{0};
+    Count total_{0};
+    std::map<Cell, Count> cells_;  ///< Counts for cells when not binned
+    std::vector<Count> bins_;  ///< Counts by direction and distance when binned
+};
+
+}  // namespace pops
+
+#endif  // POPS_OUTSIDE_DISPERSERS_HPP
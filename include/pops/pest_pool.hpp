@@ -19,6 +19,8 @@
 #include <tuple>
 #include <vector>
 
+#include "outside_dispersers.hpp"
+
 namespace pops {
 
 /**
@@ -49,7 +51,27 @@ public:
         std::vector<std::tuple<int, int>>& outside_dispersers)
         : dispersers_(dispersers),
           established_dispersers_(established_dispersers),
-          outside_dispersers_(outside_dispersers)
+          outside_dispersers_(&outside_dispersers)
+    {}
+    /**
+     * @brief Create an object with linked data and aggregated outside dispersers
+     * @param dispersers Generated dispersers
+     * @param established_dispersers Established dispersers from a cell
+     * @param outside_dispersers Counts of dispersers which left the area
+     *
+     * Dispersers which left the area are counted instead of being listed one by
+     * one, so the memory does not grow with the number of dispersers.
+     *
+     * The object does not copy or take ownership of the objects passed in the
+     * constructor.
+     */
+    PestPool(
+        IntegerRaster& dispersers,
+        IntegerRaster& established_dispersers,
+        OutsideDispersers& outside_dispersers)
+        : dispersers_(dispersers),
+          established_dispersers_(established_dispersers),
+          outside_counts_(&outside_dispersers)
     {}
     /**
      * @brief Set number of dispersers
@@ -109,7 +131,10 @@ public:
      */
     void add_outside_disperser_at(RasterIndex row, RasterIndex col)
     {
-        outside_dispersers_.emplace_back(row, col);
+        if (outside_counts_)
+            outside_counts_->add(row, col);
+        else
+            outside_dispersers_->emplace_back(row, col);
     }
     /**
      * @brief Add a dispersers which left the study area
@@ -119,9 +144,13 @@ public:
      */
     void add_outside_dispersers_at(RasterIndex row, RasterIndex col, int count)
     {
-        outside_dispersers_.reserve(outside_dispersers_.size() + count);
+        if (outside_counts_) {
+            outside_counts_->add(row, col, count);
+            return;
+        }
+        outside_dispersers_->reserve(outside_dispersers_->size() + count);
         for (int pest = 0; pest < count; ++pest)
-            outside_dispersers_.emplace_back(row, col);
+            outside_dispersers_->emplace_back(row, col);
     }
 
 private:
@@ -129,8 +158,10 @@ private:
     IntegerRaster& dispersers_;
     /// Origins of established dispersers
     IntegerRaster& established_dispersers_;
-    /// Destinations of dispersers which left
-    std::vector<std::tuple<int, int>>& outside_dispersers_;
+    /// Destinations of dispersers which left (if listed)
+    std::vector<std::tuple<int, int>>* outside_dispersers_{nullptr};
+    /// Counts of dispersers which left (if aggregated)
+    OutsideDispersers* outside_counts_{nullptr};
 };
 
 }  // namespace pops
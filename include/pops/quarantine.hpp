@@ -18,13 +18,17 @@
 
 #include <tuple>
 #include <map>
+#include <array>
+#include <cstdint>
 #include <vector>
 #include <limits>
+#include <memory>
 #include <type_traits>
 #include <sstream>
 #include <iomanip>
 
 #include "utils.hpp"
+#include "infection_tracker.hpp"
 
 namespace pops {
 
@@ -73,8 +77,42 @@ Directions directions_from_string(const std::string& text, char delimiter = ',')
     return directions;
 }
 
+/**
+ * Type of distance from infection to quarantine area boundary
+ */
+enum class QuarantineDistance
+{
+    BoundingBox,  ///< Distance to the bounding box of the quarantine area
+    Boundary  ///< Distance to the area boundary along rows and columns
+};
+
+/*! Get quarantine distance type from a string
+ *
+ * Accepts "bbox" (or "bounding_box") and "boundary".
+ *
+ * Throws an std::invalid_argument exception if the value is not supported.
+ */
+inline QuarantineDistance quarantine_distance_from_string(const std::string& text)
+{
+    if (text == "bbox" || text == "bounding_box")
+        return QuarantineDistance::BoundingBox;
+    if (text == "boundary")
+        return QuarantineDistance::Boundary;
+    throw std::invalid_argument(
+        "quarantine_distance_from_string: Invalid value '" + text + "' provided");
+}
+
 /**
  * Class storing and computing quarantine escape metrics for one simulation.
+ *
+ * Distance and direction to the quarantine area boundary is precomputed for each cell
+ * when the object is created, so the computation in each step is only a minimum
+ * over the infected cells. Only the direction and the number of cells to the boundary
+ * are stored (4 bytes per cell). The quarantine areas raster passed to the methods
+ * needs to be the same as the one used to create the object.
+ *
+ * Copies of the object share the precomputed distances, so one object can be created
+ * for given quarantine areas and copied for each run, e.g., for each replicate.
  */
 template<typename IntegerRaster, typename RasterIndex = int>
 class QuarantineEscapeAction
@@ -92,6 +130,25 @@ private:
     // mapping between quarantine areas is from map and index
     std::map<int, int> boundary_id_idx_map;
     std::vector<EscapeDistDir> escape_dist_dirs;
+    // escape and distance collected cell by cell by action_at()
+    bool collected_escaped_{false};
+    DistDir collected_min_dist_dir_{
+        std::numeric_limits<double>::max(), Direction::None};
+    // optional tracker of infection in quarantine areas (non-owning)
+    const ZonalInfectionExtentTracker<IntegerRaster, RasterIndex>* tracker_{nullptr};
+    QuarantineDistance distance_type_;
+    // Closest direction to the boundary for each cell (row-major) stored in 4 bytes
+    // as the number of cells to the boundary in that direction (upper bits) and the
+    // direction (lowest two bits) or as one of the special values below.
+    using CellValue = std::uint32_t;
+    // shared by copies because it does not change after it is computed
+    std::shared_ptr<const std::vector<CellValue>> cell_values_;
+    // cell value for cells outside of quarantine areas
+    static constexpr CellValue outside_value_ = std::numeric_limits<CellValue>::max();
+    // cell value for cells which are not in any area and are ignored
+    static constexpr CellValue ignored_value_ = outside_value_ - 1;
+    // value of cell distance for cells outside of quarantine areas
+    static const int outside_distance_ = -1;
 
     /**
      * Computes bbox of each quarantine area.
@@ -141,39 +198,227 @@ private:
 
     DistDir
     closest_direction(RasterIndex i, RasterIndex j, const BBoxInt boundary) const
+    {
+        return closest_direction(std::make_tuple(i, i, j, j), boundary);
+    }
+
+    /**
+     * Computes minimum distance (in map units) and the associated direction
+     * from infected cells within a bbox to quarantine area boundary.
+     * @param infection bbox of infected cells
+     * @param boundary quarantine area boundary
+     */
+    DistDir closest_direction(const BBoxInt infection, const BBoxInt boundary) const
     {
         int n, s, e, w;
-        int mindist = std::numeric_limits<int>::max();
+        int in, is, ie, iw;
         std::tie(n, s, e, w) = boundary;
+        std::tie(in, is, ie, iw) = infection;
+        return closest_direction(
+            (in - n) * north_south_resolution_,
+            (s - is) * north_south_resolution_,
+            (e - ie) * west_east_resolution_,
+            (iw - w) * west_east_resolution_);
+    }
+
+    /**
+     * Picks the minimum distance (rounded) and the associated direction
+     * from distances in all allowed directions.
+     */
+    DistDir
+    closest_direction(double north, double south, double east, double west) const
+    {
+        int mindist = std::numeric_limits<int>::max();
         DistDir closest;
-        if (directions_.at(Direction::N)
-            && (i - n) * north_south_resolution_ < mindist) {
-            mindist = std::lround((i - n) * north_south_resolution_);
+        if (directions_.at(Direction::N) && north < mindist) {
+            mindist = std::lround(north);
             closest = std::make_tuple(mindist, Direction::N);
         }
-        if (directions_.at(Direction::S)
-            && (s - i) * north_south_resolution_ < mindist) {
-            mindist = std::lround((s - i) * north_south_resolution_);
+        if (directions_.at(Direction::S) && south < mindist) {
+            mindist = std::lround(south);
             closest = std::make_tuple(mindist, Direction::S);
         }
-        if (directions_.at(Direction::E) && (e - j) * west_east_resolution_ < mindist) {
-            mindist = std::lround((e - j) * west_east_resolution_);
+        if (directions_.at(Direction::E) && east < mindist) {
+            mindist = std::lround(east);
             closest = std::make_tuple(mindist, Direction::E);
         }
-        if (directions_.at(Direction::W) && (j - w) * west_east_resolution_ < mindist) {
-            mindist = std::lround((j - w) * west_east_resolution_);
+        if (directions_.at(Direction::W) && west < mindist) {
+            mindist = std::lround(west);
             closest = std::make_tuple(mindist, Direction::W);
         }
         return closest;
     }
 
+    /**
+     * Computes the closest distance and direction for each cell.
+     *
+     * With bbox distance, the distance is to the bbox of the cell's area. With boundary
+     * distance, the distance is to the last cell of the same area in each direction
+     * (i.e., an axis-aligned distance transform of each area).
+     *
+     * Cells outside of quarantine areas get a special value. Cells with negative values
+     * are not in any area and are ignored.
+     */
+    void precompute_distances(const IntegerRaster& quarantine_areas)
+    {
+        size_t size = static_cast<size_t>(width_) * height_;
+        auto cells = std::make_shared<std::vector<CellValue>>(size, ignored_value_);
+        std::vector<int> north;
+        std::vector<int> south;
+        std::vector<int> east;
+        std::vector<int> west;
+        if (distance_type_ == QuarantineDistance::Boundary) {
+            // Number of cells of the same area in each direction.
+            north.assign(size, 0);
+            south.assign(size, 0);
+            east.assign(size, 0);
+            west.assign(size, 0);
+            for (RasterIndex i = 1; i < height_; i++) {
+                for (RasterIndex j = 0; j < width_; j++) {
+                    if (quarantine_areas(i - 1, j) == quarantine_areas(i, j))
+                        north[cell_index(i, j)] = north[cell_index(i - 1, j)] + 1;
+                }
+            }
+            for (RasterIndex i = height_ - 2; i >= 0; i--) {
+                for (RasterIndex j = 0; j < width_; j++) {
+                    if (quarantine_areas(i + 1, j) == quarantine_areas(i, j))
+                        south[cell_index(i, j)] = south[cell_index(i + 1, j)] + 1;
+                }
+            }
+            for (RasterIndex i = 0; i < height_; i++) {
+                for (RasterIndex j = 1; j < width_; j++) {
+                    if (quarantine_areas(i, j - 1) == quarantine_areas(i, j))
+                        west[cell_index(i, j)] = west[cell_index(i, j - 1)] + 1;
+                }
+                for (RasterIndex j = width_ - 2; j >= 0; j--) {
+                    if (quarantine_areas(i, j + 1) == quarantine_areas(i, j))
+                        east[cell_index(i, j)] = east[cell_index(i, j + 1)] + 1;
+                }
+            }
+        }
+        for (RasterIndex i = 0; i < height_; i++) {
+            for (RasterIndex j = 0; j < width_; j++) {
+                size_t index = cell_index(i, j);
+                auto area = quarantine_areas(i, j);
+                if (area == 0) {
+                    (*cells)[index] = outside_value_;
+                    continue;
+                }
+                if (area < 0)
+                    continue;
+                // Number of cells to the boundary in N, E, S, W order.
+                std::array<int, 4> counts;
+                if (distance_type_ == QuarantineDistance::Boundary) {
+                    counts = {north[index], east[index], south[index], west[index]};
+                }
+                else {
+                    int n, s, e, w;
+                    int bindex = boundary_id_idx_map.at(area);
+                    std::tie(n, s, e, w) = boundaries.at(bindex);
+                    counts = {i - n, e - j, s - i, j - w};
+                }
+                DistDir dist_dir = closest_direction(
+                    counts[0] * north_south_resolution_,
+                    counts[2] * north_south_resolution_,
+                    counts[1] * west_east_resolution_,
+                    counts[3] * west_east_resolution_);
+                CellValue code = direction_code(std::get<1>(dist_dir));
+                (*cells)[index] = (static_cast<CellValue>(counts[code]) << 2) | code;
+            }
+        }
+        cell_values_ = cells;
+    }
+
+    /**
+     * Position of a cell in the precomputed arrays (computed in size type)
+     */
+    size_t cell_index(RasterIndex i, RasterIndex j) const
+    {
+        return static_cast<size_t>(i) * width_ + j;
+    }
+
+    /** Code of a direction stored in a cell value (N, E, S, W are 0 to 3) */
+    static CellValue direction_code(Direction direction)
+    {
+        switch (direction) {
+        case Direction::E:
+            return 1;
+        case Direction::S:
+            return 2;
+        case Direction::W:
+            return 3;
+        default:
+            return 0;
+        }
+    }
+
+    /**
+     * Distance to the boundary for a cell (rounded as the computed distance)
+     *
+     * Returns outside_distance_ for cells outside of quarantine areas and maximum
+     * for ignored cells.
+     */
+    int cell_distance(size_t index) const
+    {
+        CellValue value = (*cell_values_)[index];
+        if (value == outside_value_)
+            return outside_distance_;
+        if (value == ignored_value_)
+            return std::numeric_limits<int>::max();
+        CellValue code = value & 3;
+        double resolution = code % 2 ? west_east_resolution_ : north_south_resolution_;
+        return std::lround((value >> 2) * resolution);
+    }
+
+    /**
+     * Distance and direction for a cell with the given precomputed distance
+     *
+     * If there is no cell (distance is maximum), returns maximum and no direction.
+     */
+    DistDir cell_dist_dir(size_t index, int dist) const
+    {
+        static const std::array<Direction, 4> directions = {
+            Direction::N, Direction::E, Direction::S, Direction::W};
+        if (dist == std::numeric_limits<int>::max())
+            return std::make_tuple(std::numeric_limits<double>::max(), Direction::None);
+        return std::make_tuple(dist, directions[(*cell_values_)[index] & 3]);
+    }
+
+    /**
+     * Computes escape information from the infection tracker.
+     *
+     * The distance is the same as when computed from individual cells, but when
+     * multiple cells are at the same minimum distance, the direction may differ
+     * because the cells are not visited in the order of suitable cells.
+     */
+    EscapeDistDir tracked_escape() const
+    {
+        if (tracker_->infected_outside()) {
+            return std::make_tuple(
+                true, std::make_tuple(std::nan(""), Direction::None));
+        }
+        DistDir min_dist_dir =
+            std::make_tuple(std::numeric_limits<double>::max(), Direction::None);
+        for (const auto& item : boundary_id_idx_map) {
+            const auto& zone = tracker_->zone(item.first);
+            if (zone.empty())
+                continue;
+            DistDir dist_dir =
+                closest_direction(zone.boundary(), boundaries.at(item.second));
+            if (std::get<0>(dist_dir) < std::get<0>(min_dist_dir))
+                min_dist_dir = dist_dir;
+        }
+        return std::make_tuple(false, min_dist_dir);
+    }
+
 public:
     QuarantineEscapeAction(
         const IntegerRaster& quarantine_areas,
         double ew_res,
         double ns_res,
         unsigned num_steps,
-        std::string directions = "")
+        std::string directions = "",
+        QuarantineDistance distance = QuarantineDistance::BoundingBox)
         : width_(quarantine_areas.cols()),
           height_(quarantine_areas.rows()),
           west_east_resolution_(ew_res),
@@ -184,9 +429,12 @@ public:
               num_steps,
               std::make_tuple(
                   false,
-                  std::make_tuple(std::numeric_limits<double>::max(), Direction::None)))
+                  std::make_tuple(
+                      std::numeric_limits<double>::max(), Direction::None))),
+          distance_type_(distance)
     {
         quarantine_boundary(quarantine_areas);
+        precompute_distances(quarantine_areas);
     }
 
     QuarantineEscapeAction() = delete;
@@ -200,29 +448,103 @@ public:
     void
     action(const Hosts& hosts, const IntegerRaster& quarantine_areas, unsigned step)
     {
-
-        DistDir min_dist_dir =
-            std::make_tuple(std::numeric_limits<double>::max(), Direction::None);
-        for (auto indices : hosts.suitable_cells()) {
+        UNUSED(quarantine_areas);  // Precomputed in the constructor.
+        // Tracker provides only bbox of infection which is enough for bbox distance.
+        if (tracker_ && distance_type_ == QuarantineDistance::BoundingBox) {
+            escape_dist_dirs.at(step) = tracked_escape();
+            return;
+        }
+        if (tracker_ && tracker_->infected_outside()) {
+            escape_dist_dirs.at(step) =
+                std::make_tuple(true, std::make_tuple(std::nan(""), Direction::None));
+            return;
+        }
+        int min_dist = std::numeric_limits<int>::max();
+        size_t min_index = 0;
+        for (const auto& indices : hosts.suitable_cells()) {
             int i = indices[0];
             int j = indices[1];
             if (!hosts.infected_at(i, j))
                 continue;
-            int area = quarantine_areas(i, j);
-            if (area == 0) {
+            size_t index = cell_index(i, j);
+            int dist = cell_distance(index);
+            if (dist == outside_distance_) {
                 escape_dist_dirs.at(step) = std::make_tuple(
                     true, std::make_tuple(std::nan(""), Direction::None));
                 return;
             }
-            double dist;
-            Direction dir;
-            int bindex = boundary_id_idx_map[area];
-            std::tie(dist, dir) = closest_direction(i, j, boundaries.at(bindex));
-            if (dist < std::get<0>(min_dist_dir)) {
-                min_dist_dir = std::make_tuple(dist, dir);
+            if (dist < min_dist) {
+                min_dist = dist;
+                min_index = index;
             }
         }
-        escape_dist_dirs.at(step) = std::make_tuple(false, min_dist_dir);
+        escape_dist_dirs.at(step) =
+            std::make_tuple(false, cell_dist_dir(min_index, min_dist));
+    }
+
+    /**
+     * Use a tracker to get infected cells instead of going over all cells
+     *
+     * The tracker needs to be created for the same quarantine areas and it needs
+     * to be added as an observer to the hosts, so that it is updated as infection
+     * changes. Only a pointer to the tracker is stored, so the tracker needs to exist
+     * as long as this object is used.
+     */
+    void track_infection(
+        const ZonalInfectionExtentTracker<IntegerRaster, RasterIndex>& tracker)
+    {
+        tracker_ = &tracker;
+    }
+
+    /**
+     * Returns true if infected cells are taken from a tracker
+     */
+    bool tracks_infection() const
+    {
+        return tracker_ != nullptr;
+    }
+
+    /**
+     * Include one cell in the escape computation for the current step
+     *
+     * This is an alternative to action() which allows the escape to be evaluated
+     * cell by cell, e.g., as part of sweep_cells(). Call finish_action() once all
+     * suitable cells were processed.
+     */
+    template<typename Hosts>
+    void action_at(
+        const Hosts& hosts,
+        const IntegerRaster& quarantine_areas,
+        RasterIndex i,
+        RasterIndex j)
+    {
+        UNUSED(quarantine_areas);  // Precomputed in the constructor.
+        if (collected_escaped_ || !hosts.infected_at(i, j))
+            return;
+        size_t index = cell_index(i, j);
+        int dist = cell_distance(index);
+        if (dist == outside_distance_) {
+            collected_escaped_ = true;
+            return;
+        }
+        if (dist < std::get<0>(collected_min_dist_dir_)) {
+            collected_min_dist_dir_ = cell_dist_dir(index, dist);
+        }
+    }
+
+    /**
+     * Save escape information for a step from cells collected with action_at()
+     */
+    void finish_action(unsigned step)
+    {
+        if (collected_escaped_)
+            escape_dist_dirs.at(step) =
+                std::make_tuple(true, std::make_tuple(std::nan(""), Direction::None));
+        else
+            escape_dist_dirs.at(step) = std::make_tuple(false, collected_min_dist_dir_);
+        collected_escaped_ = false;
+        collected_min_dist_dir_ =
+            std::make_tuple(std::numeric_limits<double>::max(), Direction::None);
     }
     /**
      * Computes escape info (if escaped, distance and direction if not escaped)
@@ -23,8 +23,13 @@
 #include <algorithm>
 #include <stdexcept>
 #include <initializer_list>
+#include <memory>
+#include <string>
 #include <type_traits>
 
+#include "raster_allocator.hpp"
+#include "raster_expression.hpp"
+
 namespace pops {
 
 /*! Iterate over two ranges and apply a binary function which modifies
@@ -92,8 +97,27 @@ for_each_zip(InputIt1 first1, InputIt1 last1, InputIt2 first2, BinaryOperation f
  * The Index template parameter is an signed or unsigned integer used for
  * indexing of rows and columns. The default value is int because signed
  * indices is the modern C++ practice and int is used in Rcpp.
+ *
+ * Each operator above creates a new raster. To compute a compound expression
+ * in one loop without the temporary rasters, start it with lazy()
+ * (see RasterExpression):
+ *
+ * ```
+ * Raster<int> a = {{1, 2}, {3, 4}};
+ * Raster<int> b = 2 * (lazy(a) + 1);
+ * ```
+ *
+ * The Allocator template parameter is a standard allocator used for the
+ * cell values. The default is std::allocator. AlignedAllocator provides
+ * storage aligned to cache lines or huge pages and PooledAllocator reuses
+ * buffers from a RasterBufferPool, so rasters created and destroyed
+ * repeatedly, e.g., in each replicate, don't allocate memory each time.
+ * Copy assignment reuses the existing storage when the sizes match.
  */
-template<typename Number, typename Index = int>
+template<
+    typename Number,
+    typename Index = int,
+    typename Allocator = std::allocator<Number>>
 class Raster
 {
 protected:
@@ -102,10 +126,19 @@ protected:
     Number* data_;
     // owning is true for any state which is not using someone's data
     bool owns_;
+    Allocator allocator_;
 
 public:
     typedef Number NumberType;
     typedef Index IndexType;
+    typedef Allocator AllocatorType;
+    /*! Type for number of cells and for position of a cell in the underlying array
+     *
+     * The size type is separate from the index type, so that the number of cells can
+     * be larger than the maximum of the index type which is used only for rows and
+     * columns.
+     */
+    typedef typename std::allocator_traits<Allocator>::size_type SizeType;
 
     Raster() : owns_(true)
     {
@@ -114,27 +147,28 @@ public:
         data_ = NULL;
     }
 
-    Raster(const Raster& other) : owns_(true)
+    Raster(const Raster& other) : owns_(true), allocator_(other.allocator_)
     {
         cols_ = other.cols_;
         rows_ = other.rows_;
-        data_ = new Number[cols_ * rows_];
-        std::copy(other.data_, other.data_ + (cols_ * rows_), data_);
+        data_ = allocate_data();
+        std::copy(other.data_, other.data_ + size(), data_);
     }
 
     /*! Initialize size using another raster, but use given value
      *
      * The values in the other raster are not used.
      */
-    Raster(const Raster& other, Number value) : owns_(true)
+    Raster(const Raster& other, Number value)
+        : owns_(true), allocator_(other.allocator_)
     {
         cols_ = other.cols_;
         rows_ = other.rows_;
-        data_ = new Number[cols_ * rows_];
-        std::fill_n(data_, cols_ * rows_, value);
+        data_ = allocate_data();
+        std::fill_n(data_, size(), value);
     }
 
-    Raster(Raster&& other) : owns_(other.owns_)
+    Raster(Raster&& other) : owns_(other.owns_), allocator_(other.allocator_)
     {
         cols_ = other.cols_;
         rows_ = other.rows_;
@@ -142,19 +176,22 @@ public:
         other.data_ = nullptr;
     }
 
-    Raster(Index rows, Index cols) : owns_(true)
+    Raster(Index rows, Index cols, const Allocator& allocator = Allocator())
+        : owns_(true), allocator_(allocator)
     {
         this->cols_ = cols;
         this->rows_ = rows;
-        this->data_ = new Number[cols_ * rows_];
+        this->data_ = allocate_data();
     }
 
-    Raster(Index rows, Index cols, Number value) : owns_(true)
+    Raster(
+        Index rows, Index cols, Number value, const Allocator& allocator = Allocator())
+        : owns_(true), allocator_(allocator)
     {
         this->cols_ = cols;
         this->rows_ = rows;
-        this->data_ = new Number[cols_ * rows_];
-        std::fill_n(data_, cols_ * rows_, value);
+        this->data_ = allocate_data();
+        std::fill_n(data_, size(), value);
     }
 
     /*! Use existing data storage
@@ -177,7 +214,7 @@ public:
         Index j = 0;
         for (const auto& subl : l) {
             for (const auto& value : subl) {
-                data_[cols_ * i + j] = value;
+                data_[SizeType(cols_) * i + j] = value;
                 ++j;
             }
             j = 0;
@@ -185,11 +222,30 @@ public:
         }
     }
 
+    /*! Create a new raster by evaluating an expression
+     *
+     * The allocator is taken from a raster in the expression when possible
+     * (see RasterExpression::result_allocator()).
+     * See RasterExpression for details.
+     */
+    template<typename Expression>
+    Raster(const RasterExpression<Expression>& expression)
+        : owns_(true), allocator_(expression.derived().result_allocator(Allocator()))
+    {
+        const Expression& derived = expression.derived();
+        check_expression_type<Expression>();
+        rows_ = derived.rows();
+        cols_ = derived.cols();
+        data_ = allocate_data();
+        evaluate_raster_expression(
+            derived, data_, [](Number& a, const typename Expression::NumberType& b) {
+                a = static_cast<Number>(b);
+            });
+    }
+
     ~Raster()
     {
-        if (data_ && owns_) {
-            delete[] data_;
-        }
+        release_data();
     }
 
     Index cols() const
@@ -202,6 +258,18 @@ public:
         return rows_;
     }
 
+    /*! Returns number of cells, i.e., rows times columns */
+    SizeType size() const
+    {
+        return SizeType(rows_) * SizeType(cols_);
+    }
+
+    /*! Returns copy of the allocator used for the cell values */
+    Allocator get_allocator() const
+    {
+        return allocator_;
+    }
+
     /*! Returns pointer for direct access the underlying array.
      *
      * The values are stored in row-major order.
@@ -223,39 +291,47 @@ public:
 
     void fill(Number value)
     {
-        std::fill(data_, data_ + (cols_ * rows_), value);
+        std::fill(data_, data_ + size(), value);
     }
 
     void zero()
     {
-        std::fill(data_, data_ + (cols_ * rows_), 0);
+        std::fill(data_, data_ + size(), 0);
     }
 
     template<class UnaryOperation>
     void for_each(UnaryOperation op) const
     {
-        std::for_each(data_, data_ + (cols_ * rows_), op);
+        std::for_each(data_, data_ + size(), op);
     }
 
     const Number& operator()(Index row, Index col) const
     {
-        return data_[row * cols_ + col];
+        return data_[SizeType(row) * cols_ + col];
     }
 
     Number& operator()(Index row, Index col)
     {
-        return data_[row * cols_ + col];
+        return data_[SizeType(row) * cols_ + col];
     }
 
+    /*! Copy values of another raster
+     *
+     * When this raster owns its storage and the sizes are the same,
+     * the storage is reused. Otherwise, new storage is allocated.
+     * The allocator is not replaced.
+     */
     Raster& operator=(const Raster& other)
     {
         if (this != &other) {
-            if (data_ && owns_)
-                delete[] data_;
-            cols_ = other.cols_;
-            rows_ = other.rows_;
-            data_ = new Number[cols_ * rows_];
-            std::copy(other.data_, other.data_ + (cols_ * rows_), data_);
+            if (!(data_ && owns_ && rows_ == other.rows_ && cols_ == other.cols_)) {
+                release_data();
+                cols_ = other.cols_;
+                rows_ = other.rows_;
+                data_ = allocate_data();
+                owns_ = true;
+            }
+            std::copy(other.data_, other.data_ + size(), data_);
         }
         return *this;
     }
@@ -263,62 +339,133 @@ public:
     Raster& operator=(Raster&& other)
     {
         if (this != &other) {
-            if (data_ && owns_)
-                delete[] data_;
+            release_data();
             cols_ = other.cols_;
             rows_ = other.rows_;
             data_ = other.data_;
             owns_ = other.owns_;
+            allocator_ = other.allocator_;
             other.data_ = nullptr;
         }
         return *this;
     }
 
+    /*! Evaluate an expression and store the result in this raster
+     *
+     * When the size is the same, the values are written to the existing
+     * storage, so the expression may include this raster itself. Unlike with
+     * copy assignment, this applies also to rasters which don't own the
+     * storage, so the values can be written, e.g., to a mapped file.
+     * Otherwise, new storage is allocated.
+     */
+    template<typename Expression>
+    Raster& operator=(const RasterExpression<Expression>& expression)
+    {
+        const Expression& derived = expression.derived();
+        check_expression_type<Expression>();
+        if (!(data_ && rows_ == derived.rows() && cols_ == derived.cols())) {
+            release_data();
+            rows_ = derived.rows();
+            cols_ = derived.cols();
+            data_ = allocate_data();
+            owns_ = true;
+        }
+        evaluate_raster_expression(
+            derived, data_, [](Number& a, const typename Expression::NumberType& b) {
+                a = static_cast<Number>(b);
+            });
+        return *this;
+    }
+
+    template<typename Expression>
+    Raster& operator+=(const RasterExpression<Expression>& expression)
+    {
+        check_expression_size(expression.derived(), "+=");
+        evaluate_raster_expression(
+            expression.derived(),
+            data_,
+            [](Number& a, const typename Expression::NumberType& b) { a += b; });
+        return *this;
+    }
+
+    template<typename Expression>
+    Raster& operator-=(const RasterExpression<Expression>& expression)
+    {
+        check_expression_size(expression.derived(), "-=");
+        evaluate_raster_expression(
+            expression.derived(),
+            data_,
+            [](Number& a, const typename Expression::NumberType& b) { a -= b; });
+        return *this;
+    }
+
+    template<typename Expression>
+    Raster& operator*=(const RasterExpression<Expression>& expression)
+    {
+        check_expression_size(expression.derived(), "*=");
+        evaluate_raster_expression(
+            expression.derived(),
+            data_,
+            [](Number& a, const typename Expression::NumberType& b) { a *= b; });
+        return *this;
+    }
+
+    template<typename Expression>
+    Raster& operator/=(const RasterExpression<Expression>& expression)
+    {
+        check_expression_size(expression.derived(), "/=");
+        evaluate_raster_expression(
+            expression.derived(),
+            data_,
+            [](Number& a, const typename Expression::NumberType& b) { a /= b; });
+        return *this;
+    }
+
     template<typename OtherNumber>
     typename std::enable_if<
-        !(std::is_floating_point<OtherNumber>::value
-          && std::is_integral<Number>::value),
+        std::is_arithmetic<OtherNumber>::value
+            && !(std::is_floating_point<OtherNumber>::value
+                 && std::is_integral<Number>::value),
         Raster&>::type
     operator+=(OtherNumber value)
     {
-        std::for_each(
-            data_, data_ + (cols_ * rows_), [&value](Number& a) { a += value; });
+        std::for_each(data_, data_ + size(), [&value](Number& a) { a += value; });
         return *this;
     }
 
     template<typename OtherNumber>
     typename std::enable_if<
-        !(std::is_floating_point<OtherNumber>::value
-          && std::is_integral<Number>::value),
+        std::is_arithmetic<OtherNumber>::value
+            && !(std::is_floating_point<OtherNumber>::value
+                 && std::is_integral<Number>::value),
         Raster&>::type
     operator-=(OtherNumber value)
     {
-        std::for_each(
-            data_, data_ + (cols_ * rows_), [&value](Number& a) { a -= value; });
+        std::for_each(data_, data_ + size(), [&value](Number& a) { a -= value; });
         return *this;
     }
 
     template<typename OtherNumber>
     typename std::enable_if<
-        !(std::is_floating_point<OtherNumber>::value
-          && std::is_integral<Number>::value),
+        std::is_arithmetic<OtherNumber>::value
+            && !(std::is_floating_point<OtherNumber>::value
+                 && std::is_integral<Number>::value),
         Raster&>::type
     operator*=(OtherNumber value)
     {
-        std::for_each(
-            data_, data_ + (cols_ * rows_), [&value](Number& a) { a *= value; });
+        std::for_each(data_, data_ + size(), [&value](Number& a) { a *= value; });
         return *this;
     }
 
     template<typename OtherNumber>
     typename std::enable_if<
-        !(std::is_floating_point<OtherNumber>::value
-          && std::is_integral<Number>::value),
+        std::is_arithmetic<OtherNumber>::value
+            && !(std::is_floating_point<OtherNumber>::value
+                 && std::is_integral<Number>::value),
         Raster&>::type
     operator/=(OtherNumber value)
     {
-        std::for_each(
-            data_, data_ + (cols_ * rows_), [&value](Number& a) { a /= value; });
+        std::for_each(data_, data_ + size(), [&value](Number& a) { a /= value; });
         return *this;
     }
 
@@ -328,7 +475,7 @@ public:
         Raster&>::type
     operator+=(OtherNumber value)
     {
-        std::for_each(data_, data_ + (cols_ * rows_), [&value](Number& a) {
+        std::for_each(data_, data_ + size(), [&value](Number& a) {
             a += static_cast<int>(std::floor(value));
         });
         return *this;
@@ -340,7 +487,7 @@ public:
         Raster&>::type
     operator-=(OtherNumber value)
     {
-        std::for_each(data_, data_ + (cols_ * rows_), [&value](Number& a) {
+        std::for_each(data_, data_ + size(), [&value](Number& a) {
             a -= static_cast<int>(std::floor(value));
         });
         return *this;
@@ -352,7 +499,7 @@ public:
         Raster&>::type
     operator*=(OtherNumber value)
     {
-        std::for_each(data_, data_ + (cols_ * rows_), [&value](Number& a) {
+        std::for_each(data_, data_ + size(), [&value](Number& a) {
             a *= static_cast<int>(std::floor(value));
         });
         return *this;
@@ -364,67 +511,67 @@ public:
         Raster&>::type
     operator/=(OtherNumber value)
     {
-        std::for_each(data_, data_ + (cols_ * rows_), [&value](Number& a) {
+        std::for_each(data_, data_ + size(), [&value](Number& a) {
             a /= static_cast<int>(std::floor(value));
         });
         return *this;
     }
 
-    template<typename OtherNumber>
+    template<typename OtherNumber, typename OtherIndex, typename OtherAllocator>
     typename std::enable_if<
         std::is_floating_point<Number>::value
             || std::is_same<Number, OtherNumber>::value,
         Raster&>::type
-    operator+=(const Raster<OtherNumber>& image)
+    operator+=(const Raster<OtherNumber, OtherIndex, OtherAllocator>& image)
     {
         for_each_zip(
             data_,
-            data_ + (cols_ * rows_),
+            data_ + size(),
             image.data(),
             [](Number& a, const OtherNumber& b) { a += b; });
         return *this;
     }
 
-    template<typename OtherNumber>
+    template<typename OtherNumber, typename OtherIndex, typename OtherAllocator>
     typename std::enable_if<
         std::is_floating_point<Number>::value
             || std::is_same<Number, OtherNumber>::value,
         Raster&>::type
-    operator-=(const Raster<OtherNumber>& image)
+    operator-=(const Raster<OtherNumber, OtherIndex, OtherAllocator>& image)
     {
         for_each_zip(
             data_,
-            data_ + (cols_ * rows_),
+            data_ + size(),
             image.data(),
             [](Number& a, const OtherNumber& b) { a -= b; });
         return *this;
     }
 
-    template<typename OtherNumber>
+    template<typename OtherNumber, typename OtherIndex, typename OtherAllocator>
     typename std::enable_if<
         std::is_floating_point<Number>::value
             || std::is_same<Number, OtherNumber>::value,
         Raster&>::type
-    operator*=(const Raster<OtherNumber>& image)
+    operator*=(const Raster<OtherNumber, OtherIndex, OtherAllocator>& image)
     {
         for_each_zip(
             data_,
-            data_ + (cols_ * rows_),
+            data_ + size(),
             image.data(),
             [](Number& a, const OtherNumber& b) { a *= b; });
         return *this;
     }
 
-    template<typename OtherNumber>
+    template<typename OtherNumber, typename OtherIndex, typename OtherAllocator>
     typename std::enable_if<
         std::is_floating_point<Number>::value
             || std::is_same<Number, OtherNumber>::value,
         Raster&>::type
-    operator/=(const Raster<OtherNumber>& image)
+    operator/=(const Raster<OtherNumber, OtherIndex, OtherAllocator>& image)
     {
         for_each_zip(
             data_,
-            data_ + (cols_ * rows_),
+            data_ + size(),
             image.data(),
             [](Number& a, const OtherNumber& b) { a /= b; });
         return *this;
@@ -432,26 +579,14 @@ public:
 
     bool operator==(const Raster& other) const
     {
-        // TODO: assumes same sizes
-        for (Index i = 0; i < cols_; i++) {
-            for (Index j = 0; j < cols_; j++) {
-                if (this->data_[i * cols_ + j] != other.data_[i * cols_ + j])
-                    return false;
-            }
-        }
-        return true;
+        if (rows_ != other.rows_ || cols_ != other.cols_)
+            return false;
+        return std::equal(data_, data_ + size(), other.data_);
     }
 
     bool operator!=(const Raster& other) const
     {
-        // TODO: assumes same sizes
-        for (Index i = 0; i < cols_; i++) {
-            for (Index j = 0; j < cols_; j++) {
-                if (this->data_[i * cols_ + j] != other.data_[i * cols_ + j])
-                    return true;
-            }
-        }
-        return false;
+        return !(*this == other);
     }
 
     template<typename OtherNumber>
@@ -459,11 +594,11 @@ public:
         typename std::enable_if<std::is_arithmetic<OtherNumber>::value, Raster>::type
         operator+(const Raster& raster, OtherNumber value)
     {
-        auto out = Raster(raster.rows(), raster.cols());
+        auto out = Raster(raster.rows(), raster.cols(), raster.allocator_);
 
         std::transform(
             raster.data(),
-            raster.data() + (raster.cols() * raster.rows()),
+            raster.data() + raster.size(),
             out.data(),
             [&value](const Number& a) { return a + value; });
         return out;
@@ -474,11 +609,11 @@ public:
         typename std::enable_if<std::is_arithmetic<OtherNumber>::value, Raster>::type
         operator-(const Raster& raster, OtherNumber value)
     {
-        auto out = Raster(raster.rows(), raster.cols());
+        auto out = Raster(raster.rows(), raster.cols(), raster.allocator_);
 
         std::transform(
             raster.data(),
-            raster.data() + (raster.cols() * raster.rows()),
+            raster.data() + raster.size(),
             out.data(),
             [&value](const Number& a) { return a - value; });
         return out;
@@ -489,11 +624,11 @@ public:
         typename std::enable_if<std::is_arithmetic<OtherNumber>::value, Raster>::type
         operator*(const Raster& raster, OtherNumber value)
     {
-        auto out = Raster(raster.rows(), raster.cols());
+        auto out = Raster(raster.rows(), raster.cols(), raster.allocator_);
 
         std::transform(
             raster.data(),
-            raster.data() + (raster.cols() * raster.rows()),
+            raster.data() + raster.size(),
             out.data(),
             [&value](const Number& a) { return a * value; });
         return out;
@@ -504,11 +639,11 @@ public:
         typename std::enable_if<std::is_arithmetic<OtherNumber>::value, Raster>::type
         operator/(const Raster& raster, OtherNumber value)
     {
-        auto out = Raster(raster.rows(), raster.cols());
+        auto out = Raster(raster.rows(), raster.cols(), raster.allocator_);
 
         std::transform(
             raster.data(),
-            raster.data() + (raster.cols() * raster.rows()),
+            raster.data() + raster.size(),
             out.data(),
             [&value](const Number& a) { return a / value; });
         return out;
@@ -527,11 +662,11 @@ public:
         typename std::enable_if<std::is_arithmetic<OtherNumber>::value, Raster>::type
         operator-(OtherNumber value, const Raster& raster)
     {
-        auto out = Raster(raster.rows(), raster.cols());
+        auto out = Raster(raster.rows(), raster.cols(), raster.allocator_);
 
         std::transform(
             raster.data(),
-            raster.data() + (raster.cols() * raster.rows()),
+            raster.data() + raster.size(),
             out.data(),
             [&value](const Number& a) { return value - a; });
         return out;
@@ -550,11 +685,11 @@ public:
         typename std::enable_if<std::is_arithmetic<OtherNumber>::value, Raster>::type
         operator/(OtherNumber value, const Raster& raster)
     {
-        auto out = Raster(raster.rows(), raster.cols());
+        auto out = Raster(raster.rows(), raster.cols(), raster.allocator_);
 
         std::transform(
             raster.data(),
-            raster.data() + (raster.cols() * raster.rows()),
+            raster.data() + raster.size(),
             out.data(),
             [&value](const Number& a) { return value / a; });
         return out;
@@ -581,30 +716,79 @@ public:
             for (Index j = 0; j < image.cols_; j++) {
                 if (j != 0)
                     stream << ", ";
-                stream << image.data_[i * image.cols_ + j];
+                stream << image(i, j);
             }
         }
         stream << "]]\n";
         return stream;
     }
+
+private:
+    using AllocatorTraits = std::allocator_traits<Allocator>;
+
+    /*! Allocate storage for the current number of cells */
+    Number* allocate_data()
+    {
+        return AllocatorTraits::allocate(allocator_, size());
+    }
+
+    /*! Release storage if it is owned */
+    void release_data()
+    {
+        if (data_ && owns_)
+            AllocatorTraits::deallocate(allocator_, data_, size());
+        data_ = nullptr;
+    }
+
+    /*! Check that values of an expression can be stored in this raster
+     *
+     * Same as for the operators with two rasters, floating point values
+     * can't be stored in an integral raster.
+     */
+    template<typename Expression>
+    static void check_expression_type()
+    {
+        static_assert(
+            std::is_floating_point<Number>::value
+                || !std::is_floating_point<typename Expression::NumberType>::value,
+            "Floating point expression can't be stored in an integral raster");
+    }
+
+    template<typename Expression>
+    void check_expression_size(const Expression& expression, const char* name) const
+    {
+        check_expression_type<Expression>();
+        if (rows_ != expression.rows() || cols_ != expression.cols()) {
+            throw std::invalid_argument(
+                std::string("Raster::operator") + name
+                + ": The number of rows or columns does not match");
+        }
+    }
 };
 
 template<
     typename LeftNumber,
     typename RightNumber,
-    typename ResultNumber = typename std::common_type<LeftNumber, RightNumber>::type>
-Raster<ResultNumber>
-operator+(const Raster<LeftNumber>& lhs, const Raster<RightNumber>& rhs)
+    typename Index,
+    typename LeftAllocator,
+    typename RightAllocator,
+    typename ResultNumber = typename std::common_type<LeftNumber, RightNumber>::type,
+    typename ResultAllocator = typename std::allocator_traits<
+        LeftAllocator>::template rebind_alloc<ResultNumber>>
+Raster<ResultNumber, Index, ResultAllocator> operator+(
+    const Raster<LeftNumber, Index, LeftAllocator>& lhs,
+    const Raster<RightNumber, Index, RightAllocator>& rhs)
 {
     if (lhs.cols() != rhs.cols() || lhs.rows() != rhs.rows()) {
         throw std::invalid_argument(
             "Raster::operator+: The number of rows or columns does not match");
     }
-    auto out = Raster<ResultNumber>(lhs.rows(), lhs.cols());
+    auto out = Raster<ResultNumber, Index, ResultAllocator>(
+        lhs.rows(), lhs.cols(), ResultAllocator(lhs.get_allocator()));
 
     std::transform(
         lhs.data(),
-        lhs.data() + (lhs.cols() * lhs.rows()),
+        lhs.data() + lhs.size(),
         rhs.data(),
         out.data(),
         [](const LeftNumber& a, const RightNumber& b) { return a + b; });
@@ -614,19 +798,26 @@ operator+(const Raster<LeftNumber>& lhs, const Raster<RightNumber>& rhs)
 template<
     typename LeftNumber,
     typename RightNumber,
-    typename ResultNumber = typename std::common_type<LeftNumber, RightNumber>::type>
-Raster<ResultNumber>
-operator-(const Raster<LeftNumber>& lhs, const Raster<RightNumber>& rhs)
+    typename Index,
+    typename LeftAllocator,
+    typename RightAllocator,
+    typename ResultNumber = typename std::common_type<LeftNumber, RightNumber>::type,
+    typename ResultAllocator = typename std::allocator_traits<
+        LeftAllocator>::template rebind_alloc<ResultNumber>>
+Raster<ResultNumber, Index, ResultAllocator> operator-(
+    const Raster<LeftNumber, Index, LeftAllocator>& lhs,
+    const Raster<RightNumber, Index, RightAllocator>& rhs)
 {
     if (lhs.cols() != rhs.cols() || lhs.rows() != rhs.rows()) {
         throw std::invalid_argument(
             "Raster::operator-: The number of rows or columns does not match");
     }
-    auto out = Raster<ResultNumber>(lhs.rows(), lhs.cols());
+    auto out = Raster<ResultNumber, Index, ResultAllocator>(
+        lhs.rows(), lhs.cols(), ResultAllocator(lhs.get_allocator()));
 
     std::transform(
         lhs.data(),
-        lhs.data() + (lhs.cols() * lhs.rows()),
+        lhs.data() + lhs.size(),
         rhs.data(),
         out.data(),
         [](const LeftNumber& a, const RightNumber& b) { return a - b; });
@@ -636,19 +827,26 @@ operator-(const Raster<LeftNumber>& lhs, const Raster<RightNumber>& rhs)
 template<
     typename LeftNumber,
     typename RightNumber,
-    typename ResultNumber = typename std::common_type<LeftNumber, RightNumber>::type>
-Raster<ResultNumber>
-operator*(const Raster<LeftNumber>& lhs, const Raster<RightNumber>& rhs)
+    typename Index,
+    typename LeftAllocator,
+    typename RightAllocator,
+    typename ResultNumber = typename std::common_type<LeftNumber, RightNumber>::type,
+    typename ResultAllocator = typename std::allocator_traits<
+        LeftAllocator>::template rebind_alloc<ResultNumber>>
+Raster<ResultNumber, Index, ResultAllocator> operator*(
+    const Raster<LeftNumber, Index, LeftAllocator>& lhs,
+    const Raster<RightNumber, Index, RightAllocator>& rhs)
 {
     if (lhs.cols() != rhs.cols() || lhs.rows() != rhs.rows()) {
         throw std::invalid_argument(
             "Raster::operator*: The number of rows or columns does not match");
     }
-    auto out = Raster<ResultNumber>(lhs.rows(), lhs.cols());
+    auto out = Raster<ResultNumber, Index, ResultAllocator>(
+        lhs.rows(), lhs.cols(), ResultAllocator(lhs.get_allocator()));
 
     std::transform(
         lhs.data(),
-        lhs.data() + (lhs.cols() * lhs.rows()),
+        lhs.data() + lhs.size(),
         rhs.data(),
         out.data(),
         [](const LeftNumber& a, const RightNumber& b) { return a * b; });
@@ -658,19 +856,26 @@ operator*(const Raster<LeftNumber>& lhs, const Raster<RightNumber>& rhs)
 template<
     typename LeftNumber,
     typename RightNumber,
-    typename ResultNumber = typename std::common_type<LeftNumber, RightNumber>::type>
-Raster<ResultNumber>
-operator/(const Raster<LeftNumber>& lhs, const Raster<RightNumber>& rhs)
+    typename Index,
+    typename LeftAllocator,
+    typename RightAllocator,
+    typename ResultNumber = typename std::common_type<LeftNumber, RightNumber>::type,
+    typename ResultAllocator = typename std::allocator_traits<
+        LeftAllocator>::template rebind_alloc<ResultNumber>>
+Raster<ResultNumber, Index, ResultAllocator> operator/(
+    const Raster<LeftNumber, Index, LeftAllocator>& lhs,
+    const Raster<RightNumber, Index, RightAllocator>& rhs)
 {
     if (lhs.cols() != rhs.cols() || lhs.rows() != rhs.rows()) {
         throw std::invalid_argument(
             "Raster::operator/: The number of rows or columns does not match");
     }
-    auto out = Raster<ResultNumber>(lhs.rows(), lhs.cols());
+    auto out = Raster<ResultNumber, Index, ResultAllocator>(
+        lhs.rows(), lhs.cols(), ResultAllocator(lhs.get_allocator()));
 
     std::transform(
         lhs.data(),
-        lhs.data() + (lhs.cols() * lhs.rows()),
+        lhs.data() + lhs.size(),
         rhs.data(),
         out.data(),
         [](const LeftNumber& a, const RightNumber& b) { return a / b; });
@@ -0,0 +1,310 @@
+/*
+ * PoPS model - memory allocation for rasters
+ *
+ * Copyright (C) 2023 by the authors.
+ *
+ * Authors: Vaclav Petras <wenzeslaus gmail com>
+ *
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef POPS_RASTER_ALLOCATOR_HPP
+#define POPS_RASTER_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace pops {
+
+/*! Size of a huge memory page (2 MiB on common architectures) */
+const std::size_t huge_page_size = 2 * 1024 * 1024;
+
+/*! Allocate memory aligned to a given boundary
+ *
+ * The memory needs to be released using aligned_free().
+ *
+ * The allocation is implemented using the standard operator new, so it works with
+ * any standard version. The pointer returned by operator new is stored just before
+ * the aligned block.
+ *
+ * When the alignment and size are at least the size of a huge page, the operating
+ * system is advised to back the memory with huge pages (on Linux only).
+ *
+ * @param bytes Number of bytes to allocate
+ * @param alignment Alignment in bytes (power of two)
+ *
+ * @throw std::bad_alloc when the memory cannot be allocated
+ */
+inline void* aligned_malloc(std::size_t bytes, std::size_t alignment)
+{
+    if (alignment < sizeof(void*))
+        alignment = sizeof(void*);
+    void* original = ::operator new(bytes + alignment + sizeof(void*));
+    std::uintptr_t start = reinterpret_cast<std::uintptr_t>(original) + sizeof(void*);
+    std::uintptr_t aligned = (start + alignment - 1) & ~std::uintptr_t(alignment - 1);
+    void* result = reinterpret_cast<void*>(aligned);
+    static_cast<void**>(result)[-1] = original;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (alignment >= huge_page_size && bytes >= huge_page_size) {
+        // The hint is optional, so the result is ignored.
+        madvise(result, bytes - bytes % huge_page_size, MADV_HUGEPAGE);
+    }
+#endif
+    return result;
+}
+
+/*! Free memory allocated by aligned_malloc() */
+inline void aligned_free(void* pointer) noexcept
+{
+    if (pointer)
+        ::operator delete(static_cast<void**>(pointer)[-1]);
+}
+
+/*! Allocator with storage aligned to a given boundary
+ *
+ * The default alignment is 64 bytes which is the cache line size on common
+ * architectures and sufficient for any vector instructions, so operations over
+ * whole rasters can use aligned loads and stores.
+ *
+ * Use HugePageAllocator for large rasters which benefit from huge memory pages.
+ */
+template<typename T, std::size_t Alignment = 64>
+class AlignedAllocator
+{
+public:
+    static_assert(
+        Alignment && !(Alignment & (Alignment - 1)),
+        "Alignment needs to be a power of two");
+
+    using value_type = T;
+
+    template<typename U>
+    struct rebind
+    {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() noexcept {}
+
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept
+    {}
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(aligned_malloc(n * sizeof(T), Alignment));
+    }
+
+    void deallocate(T* pointer, std::size_t) noexcept
+    {
+        aligned_free(pointer);
+    }
+
+    template<typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept
+    {
+        return true;
+    }
+
+    template<typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept
+    {
+        return false;
+    }
+};
+
+/*! Allocator with storage aligned to huge memory pages */
+template<typename T>
+using HugePageAllocator = AlignedAllocator<T, huge_page_size>;
+
+/*! Pool of memory buffers which are reused instead of being freed
+ *
+ * Buffers released to the pool are kept and given out again when a buffer of
+ * the same size is requested. When the same rasters are created and destroyed
+ * repeatedly, e.g., in each step or in each replicate, only the first round
+ * actually allocates memory.
+ *
+ * The buffers are aligned to 64 bytes. The pool is thread-safe.
+ *
+ * The pool needs to exist as long as any buffer acquired from it is in use.
+ * Buffers in the pool are freed when the pool is destroyed or cleared.
+ *
+ * Use PooledAllocator to use the pool with Raster.
+ */
+class RasterBufferPool
+{
+public:
+    static const std::size_t alignment = 64;
+
+    RasterBufferPool() {}
+    RasterBufferPool(const RasterBufferPool&) = delete;
+    RasterBufferPool& operator=(const RasterBufferPool&) = delete;
+
+    ~RasterBufferPool()
+    {
+        clear();
+    }
+
+    /*! Get a buffer of a given size in bytes
+     *
+     * Reuses a buffer from the pool if there is one with the same size,
+     * otherwise allocates a new buffer.
+     */
+    void* acquire(std::size_t bytes)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto search = free_buffers_.find(bytes);
+            if (search != free_buffers_.end() && !search->second.empty()) {
+                void* buffer = search->second.back();
+                search->second.pop_back();
+                --cached_buffers_;
+                return buffer;
+            }
+            ++allocated_buffers_;
+        }
+        return aligned_malloc(bytes, alignment);
+    }
+
+    /*! Return a buffer acquired using acquire() back to the pool
+     *
+     * @param buffer Pointer to the buffer
+     * @param bytes Size of the buffer in bytes as used with acquire()
+     */
+    void release(void* buffer, std::size_t bytes)
+    {
+        if (!buffer)
+            return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_buffers_[bytes].push_back(buffer);
+        ++cached_buffers_;
+    }
+
+    /*! Free all buffers in the pool
+     *
+     * Buffers which are in use are not affected.
+     */
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& item : free_buffers_) {
+            for (void* buffer : item.second)
+                aligned_free(buffer);
+        }
+        free_buffers_.clear();
+        cached_buffers_ = 0;
+    }
+
+    /*! Number of buffers currently in the pool waiting to be reused */
+    std::size_t cached_buffers() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return cached_buffers_;
+    }
+
+    /*! Number of buffers the pool allocated since its creation */
+    std::size_t allocated_buffers() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return allocated_buffers_;
+    }
+
+    /*! Pool shared by the whole program
+     *
+     * Used by default-constructed PooledAllocator. The pool is never destroyed,
+     * so rasters with static storage duration can still return their buffers
+     * at the program exit.
+     */
+    static RasterBufferPool& default_pool()
+    {
+        static RasterBufferPool* pool = new RasterBufferPool();
+        return *pool;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::map<std::size_t, std::vector<void*>> free_buffers_;
+    std::size_t cached_buffers_{0};
+    std::size_t allocated_buffers_{0};
+};
+
+/*! Allocator which takes memory from a RasterBufferPool
+ *
+ * ```
+ * RasterBufferPool pool;
+ * using PooledRaster = Raster<double, int, PooledAllocator<double>>;
+ * PooledRaster raster(rows, cols, PooledAllocator<double>(pool));
+ * ```
+ *
+ * The pool is referenced, so it needs to exist as long as any raster uses it.
+ * A default-constructed allocator uses RasterBufferPool::default_pool(), so
+ * rasters created without an explicit allocator, e.g., by the library itself,
+ * still reuse buffers.
+ */
+template<typename T>
+class PooledAllocator
+{
+public:
+    using value_type = T;
+
+    template<typename U>
+    struct rebind
+    {
+        using other = PooledAllocator<U>;
+    };
+
+    PooledAllocator() noexcept : pool_(&RasterBufferPool::default_pool()) {}
+
+    explicit PooledAllocator(RasterBufferPool& pool) noexcept : pool_(&pool) {}
+
+    template<typename U>
+    PooledAllocator(const PooledAllocator<U>& other) noexcept : pool_(other.pool())
+    {}
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(pool_->acquire(n * sizeof(T)));
+    }
+
+    void deallocate(T* pointer, std::size_t n) noexcept
+    {
+        pool_->release(pointer, n * sizeof(T));
+    }
+
+    RasterBufferPool* pool() const noexcept
+    {
+        return pool_;
+    }
+
+    template<typename U>
+    bool operator==(const PooledAllocator<U>& other) const noexcept
+    {
+        return pool_ == other.pool();
+    }
+
+    template<typename U>
+    bool operator!=(const PooledAllocator<U>& other) const noexcept
+    {
+        return pool_ != other.pool();
+    }
+
+private:
+    RasterBufferPool* pool_;
+};
+
+}  // namespace pops
+
+#endif  // POPS_RASTER_ALLOCATOR_HPP
@@ -0,0 +1,537 @@
+/*
+ * PoPS model - lazily evaluated raster expressions
+ *
+ * Copyright (C) 2023 by the authors.
+ *
+ * Authors: Vaclav Petras <wenzeslaus gmail com>
+ *
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef POPS_RASTER_EXPRESSION_HPP
+#define POPS_RASTER_EXPRESSION_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace pops {
+
+template<typename Number, typename Index, typename Allocator>
+class Raster;
+
+template<typename Allocator, typename Other>
+Allocator convert_allocator(const Other& other, const Allocator&, std::true_type)
+{
+    return Allocator(other);
+}
+
+template<typename Allocator, typename Other>
+Allocator convert_allocator(const Other&, const Allocator& fallback, std::false_type)
+{
+    return fallback;
+}
+
+/*! Convert allocator to another allocator type if possible
+ *
+ * Returns *fallback* if the allocator cannot be converted.
+ */
+template<typename Allocator, typename Other>
+Allocator convert_allocator(const Other& other, const Allocator& fallback)
+{
+    return convert_allocator(
+        other, fallback, std::is_constructible<Allocator, const Other&>());
+}
+
+/*! Base class of all lazily evaluated raster expressions.
+ *
+ * An expression represents a cell-by-cell computation with one or more
+ * rasters without computing it. The computation happens when the
+ * expression is assigned to a raster (or used with one of the in-place
+ * operators) and it is done in one loop over all cells, so no temporary
+ * rasters are created for intermediate results.
+ *
+ * Expressions are created from rasters using lazy() and combined with
+ * other expressions, rasters, or scalars using the arithmetic operators:
+ *
+ * ```
+ * Raster<int> a = {{1, 2}, {3, 4}};
+ * Raster<int> b = {{5, 6}, {7, 8}};
+ * Raster<int> c = 2 * (lazy(a) + b) - 1;
+ * ```
+ *
+ * The expressions only reference the rasters, so the rasters need to
+ * exist until the expression is evaluated. Expressions are meant to be
+ * evaluated right away and not stored for later use.
+ *
+ * The types of results are the same as for the eagerly evaluated
+ * operators of Raster, i.e., each operation converts its result to the
+ * type the eager operation would produce, so the evaluated expression is
+ * the same as the result of the same operations without lazy().
+ *
+ * Derived classes provide rows(), cols(), and operator[] which
+ * computes value of a cell given by its index in the row-major order.
+ */
+template<typename Derived>
+class RasterExpression
+{
+public:
+    const Derived& derived() const
+    {
+        return static_cast<const Derived&>(*this);
+    }
+
+    /*! Number of threads to use for evaluation of the expression
+     *
+     * Only ParallelRasterExpression uses more than one thread.
+     */
+    unsigned evaluation_threads() const
+    {
+        return 1;
+    }
+
+    /*! Allocator for the result of the expression
+     *
+     * Gives allocator of the first raster in the expression which has an
+     * allocator convertible to *Allocator*, so that, e.g., rasters using a pool
+     * create the result from the same pool. Returns *fallback* otherwise.
+     */
+    template<typename Allocator>
+    Allocator result_allocator(const Allocator& fallback) const
+    {
+        return fallback;
+    }
+};
+
+/*! Expression which gives values of an existing raster.
+ *
+ * The raster is referenced, not copied.
+ */
+template<typename RasterType>
+class RasterReferenceExpression
+    : public RasterExpression<RasterReferenceExpression<RasterType>>
+{
+public:
+    using NumberType = typename RasterType::NumberType;
+    using IndexType = typename RasterType::IndexType;
+
+    explicit RasterReferenceExpression(const RasterType& raster) : raster_(raster) {}
+
+    IndexType rows() const
+    {
+        return raster_.rows();
+    }
+
+    IndexType cols() const
+    {
+        return raster_.cols();
+    }
+
+    NumberType operator[](std::size_t index) const
+    {
+        return raster_.data()[index];
+    }
+
+    template<typename Allocator>
+    Allocator result_allocator(const Allocator& fallback) const
+    {
+        return convert_allocator(raster_.get_allocator(), fallback);
+    }
+
+private:
+    const RasterType& raster_;
+};
+
+/*! Expression combining values of two expressions cell by cell.
+ *
+ * The resulting type is the common type of the two expressions.
+ */
+template<typename Left, typename Right, typename Operation>
+class BinaryRasterExpression
+    : public RasterExpression<BinaryRasterExpression<Left, Right, Operation>>
+{
+public:
+    using NumberType = typename std::
+        common_type<typename Left::NumberType, typename Right::NumberType>::type;
+    using IndexType = typename Left::IndexType;
+
+    /*! Combine two expressions.
+     *
+     * @throw std::invalid_argument if the number of rows or columns differs
+     */
+    BinaryRasterExpression(const Left& left, const Right& right)
+        : left_(left), right_(right)
+    {
+        if (left.rows() != right.rows() || left.cols() != right.cols()) {
+            throw std::invalid_argument(
+                "BinaryRasterExpression: The number of rows or columns does not "
+                "match: "
+                + std::to_string(left.rows()) + "x" + std::to_string(left.cols())
+                + " versus " + std::to_string(right.rows()) + "x"
+                + std::to_string(right.cols()));
+        }
+    }
+
+    IndexType rows() const
+    {
+        return left_.rows();
+    }
+
+    IndexType cols() const
+    {
+        return left_.cols();
+    }
+
+    NumberType operator[](std::size_t index) const
+    {
+        return static_cast<NumberType>(Operation()(left_[index], right_[index]));
+    }
+
+    template<typename Allocator>
+    Allocator result_allocator(const Allocator& fallback) const
+    {
+        return left_.result_allocator(right_.result_allocator(fallback));
+    }
+
+private:
+    Left left_;
+    Right right_;
+};
+
+/*! Expression combining values of an expression with a scalar.
+ *
+ * Same as for Raster, the type of the expression is preserved regardless
+ * of the scalar type.
+ */
+template<typename Expression, typename Scalar, typename Operation>
+class ScalarRasterExpression
+    : public RasterExpression<ScalarRasterExpression<Expression, Scalar, Operation>>
+{
+public:
+    using NumberType = typename Expression::NumberType;
+    using IndexType = typename Expression::IndexType;
+
+    ScalarRasterExpression(const Expression& expression, Scalar value)
+        : expression_(expression), value_(value)
+    {}
+
+    IndexType rows() const
+    {
+        return expression_.rows();
+    }
+
+    IndexType cols() const
+    {
+        return expression_.cols();
+    }
+
+    NumberType operator[](std::size_t index) const
+    {
+        return static_cast<NumberType>(Operation()(expression_[index], value_));
+    }
+
+    template<typename Allocator>
+    Allocator result_allocator(const Allocator& fallback) const
+    {
+        return expression_.result_allocator(fallback);
+    }
+
+private:
+    Expression expression_;
+    Scalar value_;
+};
+
+/*! Expression which is evaluated using multiple threads.
+ *
+ * The cells are split into contiguous chunks, one for each thread. Rasters
+ * with fewer cells than the given minimum are evaluated in the calling
+ * thread only because starting the threads would cost more than the
+ * computation itself.
+ *
+ * Use parallel() to create the expression.
+ */
+template<typename Expression>
+class ParallelRasterExpression
+    : public RasterExpression<ParallelRasterExpression<Expression>>
+{
+public:
+    using NumberType = typename Expression::NumberType;
+    using IndexType = typename Expression::IndexType;
+
+    ParallelRasterExpression(
+        const Expression& expression, unsigned threads, std::size_t min_cells)
+        : expression_(expression), threads_(threads), min_cells_(min_cells)
+    {}
+
+    IndexType rows() const
+    {
+        return expression_.rows();
+    }
+
+    IndexType cols() const
+    {
+        return expression_.cols();
+    }
+
+    NumberType operator[](std::size_t index) const
+    {
+        return expression_[index];
+    }
+
+    template<typename Allocator>
+    Allocator result_allocator(const Allocator& fallback) const
+    {
+        return expression_.result_allocator(fallback);
+    }
+
+    unsigned evaluation_threads() const
+    {
+        std::size_t cells = std::size_t(rows()) * std::size_t(cols());
+        if (cells < min_cells_)
+            return 1;
+        unsigned threads = threads_;
+        if (!threads)
+            threads = std::thread::hardware_concurrency();
+        if (!threads)
+            threads = 1;
+        if (threads > cells)
+            threads = static_cast<unsigned>(cells);
+        return threads;
+    }
+
+private:
+    Expression expression_;
+    unsigned threads_;
+    std::size_t min_cells_;
+};
+
+/*! Operation object with operands in reversed order
+ *
+ * Used for scalar-raster operations such as `1 - raster`.
+ */
+template<typename Operation>
+struct ReversedOperands
+{
+    template<typename First, typename Second>
+    auto operator()(const First& first, const Second& second) const
+        -> decltype(Operation()(second, first))
+    {
+        return Operation()(second, first);
+    }
+};
+
+/*! Evaluate expression and apply the values to an array
+ *
+ * For each cell, calls *operation* with the value in the array as the first
+ * parameter and value of the expression as the second parameter.
+ * The expression determines the number of threads to use.
+ */
+template<typename Expression, typename Number, typename Operation>
+void evaluate_raster_expression(
+    const Expression& expression, Number* data, Operation operation)
+{
+    std::size_t cells = std::size_t(expression.rows()) * std::size_t(expression.cols());
+    auto evaluate_range = [&expression, data, operation](
+                              std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+            operation(data[i], expression[i]);
+    };
+    unsigned threads = expression.evaluation_threads();
+    if (threads <= 1) {
+        evaluate_range(0, cells);
+        return;
+    }
+    std::size_t chunk = (cells + threads - 1) / threads;
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (unsigned thread = 1; thread < threads; ++thread) {
+        std::size_t begin = std::min(cells, thread * chunk);
+        std::size_t end = std::min(cells, begin + chunk);
+        workers.emplace_back(evaluate_range, begin, end);
+    }
+    evaluate_range(0, std::min(cells, chunk));
+    for (auto& worker : workers)
+        worker.join();
+}
+
+template<typename Type>
+struct is_raster_expression
+    : std::is_base_of<RasterExpression<Type>, typename std::decay<Type>::type>
+{};
+
+/*! Convert raster or expression to an expression
+ *
+ * Expressions are returned as is, rasters are wrapped in a reference.
+ */
+template<typename Expression>
+const Expression& as_raster_expression(const RasterExpression<Expression>& expression)
+{
+    return expression.derived();
+}
+
+template<typename Number, typename Index, typename Allocator>
+RasterReferenceExpression<Raster<Number, Index, Allocator>>
+as_raster_expression(const Raster<Number, Index, Allocator>& raster)
+{
+    return RasterReferenceExpression<Raster<Number, Index, Allocator>>(raster);
+}
+
+/*! Type of expression created by as_raster_expression() */
+template<typename Type>
+using AsRasterExpression = typename std::decay<decltype(
+    as_raster_expression(std::declval<const Type&>()))>::type;
+
+/*! Start a lazily evaluated expression with a raster
+ *
+ * See RasterExpression for details.
+ */
+template<typename Number, typename Index, typename Allocator>
+RasterReferenceExpression<Raster<Number, Index, Allocator>>
+lazy(const Raster<Number, Index, Allocator>& raster)
+{
+    return RasterReferenceExpression<Raster<Number, Index, Allocator>>(raster);
+}
+
+/*! Lazy evaluation of a temporary raster is not allowed
+ *
+ * The temporary would not exist anymore when the expression is evaluated.
+ */
+template<typename Number, typename Index, typename Allocator>
+void lazy(const Raster<Number, Index, Allocator>&& raster) = delete;
+
+/*! Evaluate expression in multiple threads if the raster is large enough
+ *
+ * ```
+ * Raster<double> sum = parallel(lazy(a) + b + c, 4);
+ * ```
+ *
+ * @param expression Expression to evaluate
+ * @param threads Number of threads (0 to use the number of hardware threads)
+ * @param min_cells Minimum number of cells to use more than one thread
+ */
+template<typename Expression>
+ParallelRasterExpression<Expression> parallel(
+    const RasterExpression<Expression>& expression,
+    unsigned threads = 0,
+    std::size_t min_cells = 100000)
+{
+    return ParallelRasterExpression<Expression>(
+        expression.derived(), threads, min_cells);
+}
+
+/*! Type of expression created by an operator with two operands
+ *
+ * At least one operand needs to be an expression, the other can be an
+ * expression or a raster. Operations with two rasters are eager.
+ */
+template<typename Left, typename Right, typename Operation>
+using BinaryRasterExpressionFor = typename std::enable_if<
+    is_raster_expression<Left>::value || is_raster_expression<Right>::value,
+    BinaryRasterExpression<
+        AsRasterExpression<Left>,
+        AsRasterExpression<Right>,
+        Operation>>::type;
+
+/*! Type of expression created by an operator with an expression and a scalar */
+template<typename Expression, typename Scalar, typename Operation>
+using ScalarRasterExpressionFor = typename std::enable_if<
+    is_raster_expression<Expression>::value && std::is_arithmetic<Scalar>::value,
+    ScalarRasterExpression<Expression, Scalar, Operation>>::type;
+
+template<typename Left, typename Right>
+BinaryRasterExpressionFor<Left, Right, std::plus<>>
+operator+(const Left& left, const Right& right)
+{
+    return {as_raster_expression(left), as_raster_expression(right)};
+}
+
+template<typename Left, typename Right>
+BinaryRasterExpressionFor<Left, Right, std::minus<>>
+operator-(const Left& left, const Right& right)
+{
+    return {as_raster_expression(left), as_raster_expression(right)};
+}
+
+template<typename Left, typename Right>
+BinaryRasterExpressionFor<Left, Right, std::multiplies<>>
+operator*(const Left& left, const Right& right)
+{
+    return {as_raster_expression(left), as_raster_expression(right)};
+}
+
+template<typename Left, typename Right>
+BinaryRasterExpressionFor<Left, Right, std::divides<>>
+operator/(const Left& left, const Right& right)
+{
+    return {as_raster_expression(left), as_raster_expression(right)};
+}
+
+template<typename Expression, typename Scalar>
+ScalarRasterExpressionFor<Expression, Scalar, std::plus<>>
+operator+(const Expression& expression, Scalar value)
+{
+    return {expression, value};
+}
+
+template<typename Expression, typename Scalar>
+ScalarRasterExpressionFor<Expression, Scalar, std::minus<>>
+operator-(const Expression& expression, Scalar value)
+{
+    return {expression, value};
+}
+
+template<typename Expression, typename Scalar>
+ScalarRasterExpressionFor<Expression, Scalar, std::multiplies<>>
+operator*(const Expression& expression, Scalar value)
+{
+    return {expression, value};
+}
+
+template<typename Expression, typename Scalar>
+ScalarRasterExpressionFor<Expression, Scalar, std::divides<>>
+operator/(const Expression& expression, Scalar value)
+{
+    return {expression, value};
+}
+
+template<typename Scalar, typename Expression>
+ScalarRasterExpressionFor<Expression, Scalar, std::plus<>>
+operator+(Scalar value, const Expression& expression)
+{
+    return {expression, value};
+}
+
+template<typename Scalar, typename Expression>
+ScalarRasterExpressionFor<Expression, Scalar, ReversedOperands<std::minus<>>>
+operator-(Scalar value, const Expression& expression)
+{
+    return {expression, value};
+}
+
+template<typename Scalar, typename Expression>
+ScalarRasterExpressionFor<Expression, Scalar, std::multiplies<>>
+operator*(Scalar value, const Expression& expression)
+{
+    return {expression, value};
+}
+
+template<typename Scalar, typename Expression>
+ScalarRasterExpressionFor<Expression, Scalar, ReversedOperands<std::divides<>>>
+operator/(Scalar value, const Expression& expression)
+{
+    return {expression, value};
+}
+
+}  // namespace pops
+
+#endif  // POPS_RASTER_EXPRESSION_HPP
@@ -0,0 +1,242 @@
+/*
+ * PoPS model - run plan compiled from configuration
+ *
+ * Copyright (C) 2023 by the authors.
+ *
+ * Authors: Vaclav Petras <wenzeslaus gmail com>
+ *
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef POPS_RUN_PLAN_HPP
+#define POPS_RUN_PLAN_HPP
+
+#include "config.hpp"
+#include "environment.hpp"
+#include "kernel_types.hpp"
+#include "model_type.hpp"
+#include "network_kernel.hpp"
+#include "radial_kernel.hpp"
+#include "scheduling.hpp"
+#include "spatial_decomposition.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace pops {
+
+/**
+ * Run plan compiled from configuration
+ *
+ * Configuration stores the options as text and schedules as flags for each step.
+ * The plan resolves all the text options to enum values and validates them when it
+ * is created, so the values are not parsed repeatedly during the simulation and
+ * an invalid value is reported before the simulation starts. Schedules are stored
+ * as ActionSchedule objects, so both testing if an action is scheduled and getting
+ * the action step (e.g., index of a temperature raster) for a simulation step take
+ * constant time.
+ *
+ * The plan is a snapshot of the configuration. It does not change when the
+ * configuration changes.
+ */
+class RunPlan
+{
+public:
+    /**
+     * @brief Compile plan from configuration
+     *
+     * Schedules are taken from the configuration only if Config::create_schedules()
+     * was called before.
+     *
+     * @param config Configuration
+     *
+     * @throw std::invalid_argument when any of the text options has invalid value
+     */
+    explicit RunPlan(const Config& config)
+        : model_type_(model_type_from_string(config.model_type)),
+          natural_kernel_type_(kernel_type_from_string(config.natural_kernel_type)),
+          anthro_kernel_type_(kernel_type_from_string(config.anthro_kernel_type)),
+          natural_direction_(direction_from_string(config.natural_direction)),
+          anthro_direction_(direction_from_string(config.anthro_direction)),
+          network_movement_(network_movement_from_string(config.network_movement)),
+          arrival_behavior_(arrival_behavior_from_string(config.arrival_behavior())),
+          spread_random_streams_(
+              random_streams_from_string(config.spread_random_streams)),
+          weather_type_(weather_type_from_string(config.weather_type)),
+          schedules_created_(config.schedules_created())
+    {
+        if (!schedules_created_)
+            return;
+        num_steps_ = config.scheduler().get_num_steps();
+        spread_ = ActionSchedule(config.spread_schedule());
+        output_ = ActionSchedule(config.output_schedule());
+        if (config.use_mortality)
+            mortality_ = ActionSchedule(config.mortality_schedule());
+        if (config.use_lethal_temperature)
+            lethal_temperature_ = ActionSchedule(config.lethal_schedule());
+        if (config.use_survival_rate)
+            survival_rate_ = ActionSchedule(config.survival_rate_schedule());
+        if (config.use_spreadrates)
+            spread_rate_ = ActionSchedule(config.spread_rate_schedule());
+        if (config.use_quarantine)
+            quarantine_ = ActionSchedule(config.quarantine_schedule());
+        if (config.weather_size)
+            weather_steps_ = config.weather_table();
+    }
+
+    ModelType model_type() const
+    {
+        return model_type_;
+    }
+
+    DispersalKernelType natural_kernel_type() const
+    {
+        return natural_kernel_type_;
+    }
+
+    DispersalKernelType anthro_kernel_type() const
+    {
+        return anthro_kernel_type_;
+    }
+
+    Direction natural_direction() const
+    {
+        return natural_direction_;
+    }
+
+    Direction anthro_direction() const
+    {
+        return anthro_direction_;
+    }
+
+    NetworkMovement network_movement() const
+    {
+        return network_movement_;
+    }
+
+    ArrivalBehavior arrival_behavior() const
+    {
+        return arrival_behavior_;
+    }
+
+    RandomStreams spread_random_streams() const
+    {
+        return spread_random_streams_;
+    }
+
+    WeatherType weather_type() const
+    {
+        return weather_type_;
+    }
+
+    /** Get number of simulation steps */
+    unsigned num_steps() const
+    {
+        check_schedules("num_steps");
+        return num_steps_;
+    }
+
+    const ActionSchedule& spread_schedule() const
+    {
+        check_schedules("spread_schedule");
+        return spread_;
+    }
+
+    const ActionSchedule& output_schedule() const
+    {
+        check_schedules("output_schedule");
+        return output_;
+    }
+
+    /** Get mortality schedule (empty if mortality is not used) */
+    const ActionSchedule& mortality_schedule() const
+    {
+        check_schedules("mortality_schedule");
+        return mortality_;
+    }
+
+    /** Get lethal temperature schedule (empty if lethal temperature is not used) */
+    const ActionSchedule& lethal_schedule() const
+    {
+        check_schedules("lethal_schedule");
+        return lethal_temperature_;
+    }
+
+    /** Get survival rate schedule (empty if survival rate is not used) */
+    const ActionSchedule& survival_rate_schedule() const
+    {
+        check_schedules("survival_rate_schedule");
+        return survival_rate_;
+    }
+
+    /** Get spread rate schedule (empty if spread rates are not used) */
+    const ActionSchedule& spread_rate_schedule() const
+    {
+        check_schedules("spread_rate_schedule");
+        return spread_rate_;
+    }
+
+    /** Get quarantine schedule (empty if quarantine is not used) */
+    const ActionSchedule& quarantine_schedule() const
+    {
+        check_schedules("quarantine_schedule");
+        return quarantine_;
+    }
+
+    /**
+     * @brief Convert simulation step to weather step
+     *
+     * @param step Simulation step
+     * @return Weather step (usable as an index of the weather array)
+     *
+     * @see Config::simulation_step_to_weather_step()
+     */
+    unsigned weather_step(unsigned step) const
+    {
+        check_schedules("weather_step");
+        if (weather_steps_.empty())
+            throw std::logic_error(
+                "RunPlan: weather_step() is not available when weather_size is zero");
+        return weather_steps_.at(step);
+    }
+
+private:
+    void check_schedules(const char* name) const
+    {
+        if (!schedules_created_)
+            throw std::logic_error(
+                std::string("RunPlan: Schedules were not created before the plan "
+                            "was compiled, so ")
+                + name + "() is not available");
+    }
+
+    ModelType model_type_;
+    DispersalKernelType natural_kernel_type_;
+    DispersalKernelType anthro_kernel_type_;
+    Direction natural_direction_;
+    Direction anthro_direction_;
+    NetworkMovement network_movement_;
+    ArrivalBehavior arrival_behavior_;
+    RandomStreams spread_random_streams_;
+    WeatherType weather_type_;
+    bool schedules_created_;
+    unsigned num_steps_{0};
+    ActionSchedule spread_;
+    ActionSchedule output_;
+    ActionSchedule mortality_;
+    ActionSchedule lethal_temperature_;
+    ActionSchedule survival_rate_;
+    ActionSchedule spread_rate_;
+    ActionSchedule quarantine_;
+    std::vector<unsigned> weather_steps_;  ///< Weather step for each simulation step
+};
+
+}  // namespace pops
+
+#endif  // POPS_RUN_PLAN_HPP
@@ -23,6 +23,7 @@
 #include <tuple>
 #include <string>
 #include <algorithm>
+#include <stdexcept>
 
 #include "date.hpp"
 
@@ -103,6 +104,10 @@ public:
      * That means the entire interval is contained in the simulation steps
      * even when only part of it was requested.
      *
+     * The steps are stored as day numbers (see days_from_civil()) of their
+     * boundaries, so a step takes only one integer and a step for a date is found
+     * using binary search.
+     *
      * @param start simulation start date
      * @param end simulation end date
      * @param simulation_unit simulation unit
@@ -134,16 +139,13 @@ public:
                 "month");
 
         Date date(start_);
-        unsigned step = 0;
         while (date <= end_) {
-            Date start(date);
+            step_starts_.push_back(date.day_number());
             increase_date(date);
-            Date end(date);
-            end.subtract_day();
-            steps.push_back(Step(start, end));
-            step++;
         }
-        num_steps = step;
+        num_steps = static_cast<unsigned>(step_starts_.size());
+        // The start of the next step after the last one closes the last step.
+        step_starts_.push_back(date.day_number());
     }
 
     /**
@@ -159,7 +161,13 @@ public:
      */
     Step get_step(unsigned index) const
     {
-        return steps.at(index);
+        if (index >= num_steps)
+            throw std::out_of_range(
+                "Scheduler::get_step: Step " + std::to_string(index)
+                + " is outside of schedule");
+        return Step(
+            Date::from_day_number(step_starts_[index]),
+            Date::from_day_number(step_last_day(index)));
     }
 
     /**
@@ -179,9 +187,9 @@ public:
     {
         std::vector<bool> schedule;
         schedule.reserve(num_steps);
-        for (const Step& step : steps) {
-            if (season.month_in_season(step.start_date().month())
-                || season.month_in_season(step.end_date().month()))
+        for (unsigned i = 0; i < num_steps; i++) {
+            if (season.month_in_season(civil_from_days(step_starts_[i]).month)
+                || season.month_in_season(civil_from_days(step_last_day(i)).month))
                 schedule.push_back(true);
             else
                 schedule.push_back(false);
@@ -204,11 +212,13 @@ public:
     {
         std::vector<bool> schedule;
         schedule.reserve(num_steps);
-        for (const Step& step : steps) {
-            Date st = step.start_date();
-            Date end = step.end_date();
-            Date test(st.year(), month, day);
-            if ((test >= st && test <= end))
+        for (unsigned i = 0; i < num_steps; i++) {
+            CivilDate st = civil_from_days(step_starts_[i]);
+            CivilDate end = civil_from_days(step_last_day(i));
+            // Comparing keys instead of day numbers keeps dates which do not exist
+            // in a given year (February 29) ordered as in Date comparison.
+            int test = order_key(st.year, month, day);
+            if (test >= order_key(st) && test <= order_key(end))
                 schedule.push_back(true);
             else
                 schedule.push_back(false);
@@ -225,8 +235,9 @@ public:
     {
         std::vector<bool> schedule;
         schedule.reserve(num_steps);
-        for (const Step& step : steps) {
-            if (step.end_date().is_last_day_of_year())
+        for (unsigned i = 0; i < num_steps; i++) {
+            CivilDate end = civil_from_days(step_last_day(i));
+            if (end.month == 12 && end.day == 31)
                 schedule.push_back(true);
             else
                 schedule.push_back(false);
@@ -279,10 +290,10 @@ public:
     {
         std::vector<bool> schedule;
         schedule.reserve(num_steps);
-        for (const Step& step : steps) {
-            Date st = step.start_date();
-            Date end = step.end_date();
-            if (st.month() != end.month() || end.is_last_day_of_month())
+        for (unsigned i = 0; i < num_steps; i++) {
+            CivilDate st = civil_from_days(step_starts_[i]);
+            CivilDate end = civil_from_days(step_last_day(i));
+            if (st.month != end.month || end.day == days_in_month(end.year, end.month))
                 schedule.push_back(true);
             else
                 schedule.push_back(false);
@@ -295,16 +306,33 @@ public:
      *
      * Should be used within Treatments class.
      *
+     * The step is found using binary search over the step boundaries.
+     * A date which does not exist (e.g., February 29 in a common year) is placed
+     * after the last day of the month as in Date comparison, so it belongs to
+     * a step only if the step contains both the last day of the month and the next
+     * day.
+     *
      * @param date date to schedule action
      * @return index of step
      */
     unsigned schedule_action_date(const Date& date) const
     {
-        for (unsigned i = 0; i < num_steps; i++) {
-            if (date >= steps[i].start_date() && date <= steps[i].end_date())
-                return i;
+        int day = date.day_number();
+        bool between_days = false;
+        if (date.day() < 1) {
+            day = days_from_civil(date.year(), date.month(), 1) - 1;
+            between_days = true;
         }
-        throw std::invalid_argument("Date is outside of schedule");
+        else if (date.day() > days_in_month(date.year(), date.month())) {
+            day = days_from_civil(
+                date.year(), date.month(), days_in_month(date.year(), date.month()));
+            between_days = true;
+        }
+        auto next = std::upper_bound(step_starts_.begin(), step_starts_.end(), day);
+        if (next == step_starts_.begin() || next == step_starts_.end()
+            || (between_days && *next == day + 1))
+            throw std::invalid_argument("Date is outside of schedule");
+        return static_cast<unsigned>(next - step_starts_.begin() - 1);
     }
 
     /**
@@ -341,18 +369,19 @@ public:
     void debug_schedule(const std::vector<bool>& schedule) const
     {
         for (unsigned i = 0; i < num_steps; i++)
-            std::cout << steps[i] << ": " << (schedule.at(i) ? "true" : "false")
+            std::cout << get_step(i) << ": " << (schedule.at(i) ? "true" : "false")
                       << std::endl;
     }
     void debug_schedule(unsigned n) const
     {
         for (unsigned i = 0; i < num_steps; i++)
-            std::cout << steps[i] << ": " << (n == i ? "true" : "false") << std::endl;
+            std::cout << get_step(i) << ": " << (n == i ? "true" : "false")
+                      << std::endl;
     }
     void debug_schedule() const
     {
         for (unsigned i = 0; i < num_steps; i++)
-            std::cout << steps[i] << std::endl;
+            std::cout << get_step(i) << std::endl;
     }
 
 private:
@@ -360,9 +389,30 @@ private:
     Date end_;
     StepUnit simulation_unit_;
     unsigned simulation_num_units_;
-    std::vector<Step> steps;
+    /** Day number of the first day of each step and of the day after the last step */
+    std::vector<int> step_starts_;
     unsigned num_steps;
 
+    /** Get day number of the last day of a step */
+    int step_last_day(unsigned index) const
+    {
+        return step_starts_[index + 1] - 1;
+    }
+
+    /**
+     * @brief Get key which orders dates as Date comparison
+     *
+     * Unlike day numbers, the keys order also dates which do not exist.
+     */
+    static int order_key(int year, int month, int day)
+    {
+        return (year * 16 + month) * 32 + day;
+    }
+    static int order_key(const CivilDate& date)
+    {
+        return order_key(date.year, date.month, date.day);
+    }
+
     /**
      * @brief Increse date by simulation step
      * @param date date
@@ -396,20 +446,82 @@ private:
  *
  * Result for input step any other then 1 and 5 in this case
  * returns valid number but has no particular meaning.
+ *
+ * The scheduled actions are counted for each call. Use ActionSchedule to get the
+ * action steps repeatedly.
  */
-unsigned
+inline unsigned
 simulation_step_to_action_step(const std::vector<bool>& action_schedule, unsigned step)
 {
-    std::vector<unsigned> indices(action_schedule.size());
-    unsigned idx = 0;
-    for (unsigned i = 0; i < action_schedule.size(); i++) {
-        indices[i] = idx;
-        if (action_schedule[i])
-            ++idx;
-    }
-    return indices.at(step);
+    if (step >= action_schedule.size())
+        throw std::out_of_range(
+            "simulation_step_to_action_step: Step " + std::to_string(step)
+            + " is outside of schedule");
+    return static_cast<unsigned>(
+        std::count(action_schedule.begin(), action_schedule.begin() + step, true));
 }
 
+/**
+ * Schedule of an action with precomputed action steps
+ *
+ * The schedule stores the number of actions scheduled before each simulation step,
+ * so both the test if the action is scheduled and the conversion of simulation step
+ * to action step (see simulation_step_to_action_step()) take constant time.
+ */
+class ActionSchedule
+{
+public:
+    /** Create an empty schedule (no steps) */
+    ActionSchedule() : counts_(1, 0) {}
+
+    /** Create schedule from a list of flags for each simulation step */
+    explicit ActionSchedule(const std::vector<bool>& schedule)
+    {
+        counts_.reserve(schedule.size() + 1);
+        counts_.push_back(0);
+        for (bool scheduled : schedule)
+            counts_.push_back(counts_.back() + (scheduled ? 1 : 0));
+    }
+
+    /** Return true if the action is scheduled for a step (false if out of range) */
+    bool is_scheduled(unsigned step) const
+    {
+        return step + 1 < counts_.size() && counts_[step + 1] != counts_[step];
+    }
+
+    /**
+     * @brief Get action step for a simulation step
+     *
+     * The result is the same as simulation_step_to_action_step().
+     *
+     * @throw std::out_of_range if the step is outside of schedule
+     */
+    unsigned action_step(unsigned step) const
+    {
+        if (step + 1 >= counts_.size())
+            throw std::out_of_range(
+                "ActionSchedule: Step " + std::to_string(step)
+                + " is outside of schedule");
+        return counts_[step];
+    }
+
+    /** Get number of scheduled actions */
+    unsigned num_actions() const
+    {
+        return counts_.back();
+    }
+
+    /** Get number of simulation steps */
+    unsigned num_steps() const
+    {
+        return static_cast<unsigned>(counts_.size() - 1);
+    }
+
+private:
+    /** Number of actions before each step (one more than steps) */
+    std::vector<unsigned> counts_;
+};
+
 /**
  * Returns how many actions are scheduled.
  *
@@ -16,8 +16,10 @@
 #ifndef POPS_SOILS_HPP
 #define POPS_SOILS_HPP
 
+#include <algorithm>
 #include <cmath>
 #include <memory>
+#include <mutex>
 #include <tuple>
 #include <vector>
 #include <random>
@@ -32,6 +34,18 @@ namespace pops {
 /** Handles disperser (pathogen) storage in soils.
  *
  * Takes care of adding dispersers to the pool and of taking them out.
+ *
+ * The dispersers are stored either in rasters provided by the caller (one raster
+ * for each cohort) or in a sparse storage owned by the pool. The sparse storage
+ * keeps the cohorts only for cells which have dispersers, so many cohorts do not
+ * require many rasters, and the cohorts age in constant time. With the sparse
+ * storage, dispersers are added in a batch using one binomial draw and released
+ * using one Poisson draw for all dispersers in a cell instead of one draw for each
+ * disperser. The results are the same in distribution, but the random numbers are
+ * different than with the rasters.
+ *
+ * Dispersers in different cells can be added and released from multiple threads
+ * with both storages.
  */
 template<
     typename IntegerRaster,
@@ -70,6 +84,45 @@ public:
             throw std::logic_error(
                 "List of rasters of SoilPool needs to have at least one item");
         }
+        num_cohorts_ = static_cast<int>(rasters.size());
+    }
+
+    /**
+     * @brief Create a soil pool with sparse storage.
+     *
+     * The cohorts are stored only for cells where dispersers were added.
+     *
+     * @param rows Number of rows
+     * @param cols Number of columns
+     * @param num_cohorts Number of simulation steps the dispersers persist in the soil
+     * @param environment Surrounding environment (weather)
+     * @param generate_stochasticity Use stochasticity when releasing from the pool
+     * @param establishment_stochasticity Use stochasticity when adding to the pool
+     * @param fixed_establishment_probability Non-stochastic establishment probability
+     */
+    SoilPool(
+        RasterIndex rows,
+        RasterIndex cols,
+        int num_cohorts,
+        const Environment<IntegerRaster, FloatRaster, RasterIndex, GeneratorProvider>&
+            environment,
+        bool generate_stochasticity = true,
+        bool establishment_stochasticity = true,
+        double fixed_establishment_probability = 0)
+        : environment_(&environment),
+          generate_stochasticity_(generate_stochasticity),
+          establishment_stochasticity_(establishment_stochasticity),
+          fixed_establishment_probability_(fixed_establishment_probability),
+          num_cohorts_(num_cohorts),
+          cols_(cols),
+          cell_slots_(static_cast<std::size_t>(rows) * cols, -1),
+          slot_chunks_(
+              (static_cast<std::size_t>(rows) * cols + slot_chunk_size_ - 1)
+              / slot_chunk_size_)
+    {
+        if (num_cohorts < 1) {
+            throw std::logic_error("SoilPool needs to have at least one cohort");
+        }
     }
 
     /**
@@ -80,6 +133,8 @@ public:
     template<typename Generator>
     int dispersers_from(RasterIndex row, RasterIndex col, Generator& generator)
     {
+        if (!rasters_)
+            return sparse_dispersers_from(row, col, generator);
         auto count = this->total_at(row, col);
         double lambda = environment_->weather_coefficient_at(row, col);
         int dispersers = 0;
@@ -129,6 +184,10 @@ public:
     void dispersers_to(
         int dispersers, RasterIndex row, RasterIndex col, Generator& generator)
     {
+        if (!rasters_) {
+            sparse_dispersers_to(dispersers, row, col, generator);
+            return;
+        }
         for (int i = 0; i < dispersers; i++)
             this->disperser_to(row, col, generator);
     }
@@ -141,12 +200,49 @@ public:
     int total_at(RasterIndex row, RasterIndex col) const
     {
         int total = 0;
+        if (!rasters_) {
+            const auto* cohorts = stored_cohorts(row, col);
+            if (cohorts) {
+                for (const auto& cohort : *cohorts) {
+                    if (!is_expired(cohort))
+                        total += cohort.count;
+                }
+            }
+            return total;
+        }
         for (const auto& raster : *rasters_) {
             total += raster(row, col);
         }
         return total;
     }
 
+    /**
+     * Get number of dispersers in one cohort at a specific location
+     *
+     * Cohorts are ordered from the oldest (0) to the youngest (number of cohorts
+     * minus one) as the rasters.
+     */
+    int cohort_at(int index, RasterIndex row, RasterIndex col) const
+    {
+        if (rasters_)
+            return (*rasters_)[index](row, col);
+        const auto* cohorts = stored_cohorts(row, col);
+        if (!cohorts)
+            return 0;
+        int cohort_step = age_step_ - (num_cohorts_ - 1 - index);
+        for (const auto& cohort : *cohorts) {
+            if (cohort.step == cohort_step)
+                return cohort.count;
+        }
+        return 0;
+    }
+
+    /** Get number of cohorts (steps the dispersers persist in the soil) */
+    int num_cohorts() const
+    {
+        return num_cohorts_;
+    }
+
     /**
      * Advance to the next simulation step
      *
@@ -155,10 +251,17 @@ public:
      * raster vector.
      *
      * Internally, this rotates the cohorts and clears what becomes the youngest cohort.
+     * With the sparse storage, the cohorts are marked with the step when they were
+     * added, so only the step is advanced here and the expired cohorts are removed
+     * later when the cell is accessed.
      */
     void next_step(int step)
     {
         UNUSED(step);
+        if (!rasters_) {
+            ++age_step_;
+            return;
+        }
         rotate_left_by_one(*rasters_);
         rasters_->back().fill(0);
     }
@@ -188,7 +291,164 @@ protected:
      */
     void add_at(RasterIndex row, RasterIndex col, int value = 1)
     {
-        rasters_->back()(row, col) += value;
+        if (rasters_) {
+            rasters_->back()(row, col) += value;
+            return;
+        }
+        auto& cohorts = active_cohorts(row, col);
+        remove_expired(cohorts);
+        if (!cohorts.empty() && cohorts.back().step == age_step_)
+            cohorts.back().count += value;
+        else
+            cohorts.push_back({age_step_, value});
+    }
+
+private:
+    /** Dispersers added to a cell in one step (sparse storage) */
+    struct Cohort
+    {
+        int step;  ///< Value of age_step_ when the dispersers were added
+        int count;  ///< Number of dispersers
+    };
+    using Cohorts = std::vector<Cohort>;
+
+    /** Number of cohort lists allocated at once (sparse storage) */
+    static constexpr std::size_t slot_chunk_size_ = 1024;
+
+    int num_cohorts_{0};  ///< Number of steps the dispersers persist
+    int age_step_{0};  ///< Number of steps advanced (sparse storage)
+    RasterIndex cols_{0};  ///< Number of columns (sparse storage)
+    /** Index of cohort list for each cell, -1 if there is none (sparse storage) */
+    std::vector<int> cell_slots_;
+    /**
+     * Cohort lists for cells with dispersers allocated in chunks (sparse storage)
+     *
+     * The number of chunks is fixed, so the lists don't move when new lists are
+     * created by another thread.
+     */
+    std::vector<std::unique_ptr<Cohorts[]>> slot_chunks_;
+    int num_slots_{0};  ///< Number of used cohort lists (sparse storage)
+    std::mutex slots_mutex_;  ///< Guards creation of cohort lists
+
+    /** Add dispersers in a batch with one binomial draw */
+    template<typename Generator>
+    void sparse_dispersers_to(
+        int dispersers, RasterIndex row, RasterIndex col, Generator& generator)
+    {
+        if (dispersers <= 0)
+            return;
+        double probability = environment_->weather_coefficient_at(row, col);
+        int established = 0;
+        if (!establishment_stochasticity_) {
+            if (1 - fixed_establishment_probability_ < probability)
+                established = dispersers;
+        }
+        else if (probability >= 1) {
+            established = dispersers;
+        }
+        else if (probability > 0) {
+            std::binomial_distribution<int> distribution(dispersers, probability);
+            established = distribution(generator);
+        }
+        if (established > 0)
+            this->add_at(row, col, established);
+    }
+
+    /**
+     * Release dispersers with one Poisson draw for all stored dispersers
+     *
+     * The released dispersers are taken from the cohorts randomly (without
+     * replacement) drawing the number taken from each cohort.
+     */
+    template<typename Generator>
+    int sparse_dispersers_from(RasterIndex row, RasterIndex col, Generator& generator)
+    {
+        Cohorts* cohorts = stored_cohorts(row, col);
+        if (!cohorts)
+            return 0;
+        remove_expired(*cohorts);
+        int count = 0;
+        for (const auto& cohort : *cohorts)
+            count += cohort.count;
+        double lambda = environment_->weather_coefficient_at(row, col);
+        if (count <= 0 || lambda <= 0)
+            return 0;
+        int dispersers = 0;
+        if (this->generate_stochasticity_) {
+            std::poisson_distribution<int> distribution(lambda * count);
+            dispersers = distribution(generator);
+        }
+        else {
+            dispersers = static_cast<int>(std::floor(lambda * count));
+        }
+        int remaining = std::min(dispersers, count);
+        for (auto& cohort : *cohorts) {
+            if (remaining <= 0)
+                break;
+            int drawn = cohort.count;
+            if (remaining < count)
+                drawn = draw_hypergeometric(count, cohort.count, remaining, generator);
+            count -= cohort.count;
+            cohort.count -= drawn;
+            remaining -= drawn;
+        }
+        cohorts->erase(
+            std::remove_if(
+                cohorts->begin(),
+                cohorts->end(),
+                [](const Cohort& cohort) { return cohort.count <= 0; }),
+            cohorts->end());
+        return dispersers;
+    }
+
+    /** Return true if the cohort is older than the number of cohorts */
+    bool is_expired(const Cohort& cohort) const
+    {
+        return age_step_ - cohort.step >= num_cohorts_;
+    }
+
+    /** Remove expired cohorts (which are at the front of the list) */
+    void remove_expired(Cohorts& cohorts) const
+    {
+        auto first =
+            std::find_if(cohorts.begin(), cohorts.end(), [this](const Cohort& cohort) {
+                return !is_expired(cohort);
+            });
+        cohorts.erase(cohorts.begin(), first);
+    }
+
+    /** Get cohort list of a cell or null if there is none */
+    Cohorts* stored_cohorts(RasterIndex row, RasterIndex col)
+    {
+        int slot = cell_slots_[static_cast<std::size_t>(row) * cols_ + col];
+        if (slot < 0)
+            return nullptr;
+        return &slot_chunks_[slot / slot_chunk_size_][slot % slot_chunk_size_];
+    }
+
+    const Cohorts* stored_cohorts(RasterIndex row, RasterIndex col) const
+    {
+        int slot = cell_slots_[static_cast<std::size_t>(row) * cols_ + col];
+        if (slot < 0)
+            return nullptr;
+        return &slot_chunks_[slot / slot_chunk_size_][slot % slot_chunk_size_];
+    }
+
+    /** Get cohort list of a cell creating it if needed */
+    Cohorts& active_cohorts(RasterIndex row, RasterIndex col)
+    {
+        Cohorts* cohorts = stored_cohorts(row, col);
+        if (cohorts)
+            return *cohorts;
+        // Each cell is accessed by one thread only, but a list for a new cell may
+        // be created by multiple threads at once.
+        std::lock_guard<std::mutex> lock(slots_mutex_);
+        int slot = num_slots_++;
+        auto& chunk = slot_chunks_[slot / slot_chunk_size_];
+        if (!chunk)
+            chunk.reset(new Cohorts[slot_chunk_size_]);
+        cell_slots_[static_cast<std::size_t>(row) * cols_ + col] = slot;
+        return chunk[slot % slot_chunk_size_];
     }
 };
 
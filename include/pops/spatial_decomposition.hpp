@@ -0,0 +1,740 @@
+/*
+ * PoPS model - spread in parallel using spatial domain decomposition
+ *
+ * Copyright (C) 2023 by the authors.
+ *
+ * Authors: Vaclav Petras <wenzeslaus gmail com>
+ *
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef POPS_SPATIAL_DECOMPOSITION_HPP
+#define POPS_SPATIAL_DECOMPOSITION_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "generator_provider.hpp"
+#include "outside_dispersers.hpp"
+#include "soils.hpp"
+#include "utils.hpp"
+
+namespace pops {
+
+/*! Derive a 64-bit seed for an independent random number stream
+ *
+ * The values are mixed using the SplitMix64 finalizer, so seeds for neighboring
+ * values (e.g., neighboring tiles or consecutive steps) are unrelated.
+ *
+ * @param seed Base seed
+ * @param first First value identifying the stream (e.g., step)
+ * @param second Second value identifying the stream (e.g., tile)
+ */
+inline std::uint64_t
+derive_stream_seed(unsigned seed, std::uint64_t first, std::uint64_t second = 0)
+{
+    std::uint64_t value = seed;
+    for (std::uint64_t item : {first, second}) {
+        value ^= item + 0x9E3779B97F4A7C15ULL + (value << 6) + (value >> 2);
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+        value ^= value >> 31;
+    }
+    return value;
+}
+
+/*! Derive a seed for an independent random number stream
+ *
+ * Same as derive_stream_seed(), but folded to the size of a seed.
+ */
+inline unsigned
+derive_seed(unsigned seed, std::uint64_t first, std::uint64_t second = 0)
+{
+    std::uint64_t value = derive_stream_seed(seed, first, second);
+    return static_cast<unsigned>(value ^ (value >> 32));
+}
+
+/*! Select an independent random number stream in a generator provider
+ *
+ * The generators are re-seeded using a seed derived from the seed, step, and
+ * stream number (see derive_seed()). Providers which can select streams in a
+ * cheaper way overload this function (see RandomNumberGeneratorProvider below and
+ * CounterBasedGeneratorProvider).
+ *
+ * @param generator Generator provider with a seed() function
+ * @param seed Base seed
+ * @param step Step in the simulation
+ * @param stream Stream number (e.g., index of a cell)
+ * @param purposes Generators which will be used from the stream
+ */
+template<typename GeneratorProvider>
+void select_random_stream(
+    GeneratorProvider& generator,
+    unsigned seed,
+    unsigned step,
+    std::uint64_t stream,
+    std::initializer_list<GeneratorPurpose> purposes)
+{
+    UNUSED(purposes);
+    generator.seed(derive_seed(seed, step, stream));
+}
+
+/*! Select an independent random number stream in a generator provider
+ *
+ * Only the generators for the given purposes are re-seeded and they are seeded
+ * using all 64 bits of the derived seed (see derive_stream_seed() and
+ * RandomNumberGeneratorProvider::seed_purposes()).
+ */
+template<typename Generator>
+void select_random_stream(
+    RandomNumberGeneratorProvider<Generator>& generator,
+    unsigned seed,
+    unsigned step,
+    std::uint64_t stream,
+    std::initializer_list<GeneratorPurpose> purposes)
+{
+    generator.seed_purposes(derive_stream_seed(seed, step, stream), purposes);
+}
+
+/*! True if the generator provider takes a replicate number in the constructor
+ *
+ * Such providers (e.g., CounterBasedGeneratorProvider) keep streams of different
+ * replicates apart by themselves.
+ */
+template<typename GeneratorProvider>
+constexpr bool provider_takes_replicate()
+{
+    return std::is_constructible<GeneratorProvider, unsigned, bool, unsigned>::value;
+}
+
+/*! Get base seed for random number streams of a replicate
+ *
+ * For providers which don't take a replicate number, the replicate number is
+ * mixed into the seed, so that the streams differ across replicates. Replicate
+ * zero uses the seed as is.
+ */
+template<typename GeneratorProvider>
+unsigned replicate_stream_seed(unsigned seed, unsigned replicate)
+{
+    if (provider_takes_replicate<GeneratorProvider>() || !replicate)
+        return seed;
+    // Stream numbers are smaller than 2^40, so this does not match any stream.
+    return derive_seed(seed, replicate, ~std::uint64_t(0));
+}
+
+/*! Create generator provider for random number streams of a replicate
+ *
+ * @param seed Base seed from replicate_stream_seed()
+ * @param multiple Use multiple generators
+ * @param replicate Replicate number
+ */
+template<typename GeneratorProvider>
+GeneratorProvider
+create_stream_provider(unsigned seed, bool multiple, unsigned replicate)
+{
+    if constexpr (provider_takes_replicate<GeneratorProvider>()) {
+        return GeneratorProvider(seed, multiple, replicate);
+    }
+    else {
+        UNUSED(replicate);
+        return GeneratorProvider(seed, multiple);
+    }
+}
+
+/*! Call a function for each index from 0 to count using multiple threads
+ *
+ * The indices are given to the threads one by one as the threads become available,
+ * so the assignment of indices to threads is not fixed. The function is called with
+ * the index and with the number of the thread (from 0 to number of threads minus
+ * one) which can be used to access per-thread data.
+ *
+ * The calling thread is used as one of the threads. If the function throws an
+ * exception, the remaining indices are skipped and the first exception is rethrown
+ * after all threads finish.
+ *
+ * @param count Number of indices
+ * @param threads Number of threads
+ * @param function Function taking index and thread number
+ */
+template<typename Function>
+void parallel_for_each_index(std::size_t count, unsigned threads, Function function)
+{
+    if (threads > count)
+        threads = static_cast<unsigned>(count);
+    if (threads <= 1) {
+        for (std::size_t index = 0; index < count; ++index)
+            function(index, 0u);
+        return;
+    }
+    std::atomic<std::size_t> next{0};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto work = [&](unsigned thread) {
+        try {
+            for (std::size_t index = next++; index < count; index = next++)
+                function(index, thread);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error)
+                error = std::current_exception();
+            next = count;
+        }
+    };
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (unsigned thread = 1; thread < threads; ++thread)
+        workers.emplace_back(work, thread);
+    work(0);
+    for (auto& worker : workers)
+        worker.join();
+    if (error)
+        std::rethrow_exception(error);
+}
+
+/*! Get the actual number of threads to use (0 means all hardware threads) */
+inline unsigned effective_thread_count(unsigned threads)
+{
+    if (!threads)
+        threads = std::thread::hardware_concurrency();
+    if (!threads)
+        threads = 1;
+    return threads;
+}
+
+/** Random number streams used for spread in parallel */
+enum class RandomStreams
+{
+    Tile,  ///< One stream for each tile (result depends on the tile size)
+    Cell,  ///< One stream for each cell (result depends only on the seed)
+};
+
+/*! Get a corresponding enum value for a string with random streams name.
+ *
+ * Throws an std::invalid_argument exception if the value is not supported.
+ */
+inline RandomStreams random_streams_from_string(const std::string& text)
+{
+    if (text == "tile" || text == "Tile")
+        return RandomStreams::Tile;
+    else if (text == "cell" || text == "Cell")
+        return RandomStreams::Cell;
+    throw std::invalid_argument(
+        "random_streams_from_string: Invalid value '" + text + "' provided");
+}
+
+/**
+ * Rectangular part of the raster and the suitable cells in it
+ *
+ * The extent is given by the first row and column and by the row and column just
+ * after the tile (exclusive).
+ */
+template<typename RasterIndex>
+struct SpatialTile
+{
+    RasterIndex row_begin;  ///< First row of the tile
+    RasterIndex row_end;  ///< Row after the last row of the tile
+    RasterIndex col_begin;  ///< First column of the tile
+    RasterIndex col_end;  ///< Column after the last column of the tile
+    std::vector<std::vector<int>> cells;  ///< Suitable cells in the tile
+};
+
+/**
+ * Decomposition of the raster into square tiles
+ *
+ * The tiles are ordered by rows of tiles and each tile owns the cells in its
+ * extent. Tiles at the last row and column of tiles may be smaller than the others.
+ *
+ * The suitable cells are assigned to the tiles using assign_cells(). The order of
+ * the cells in the tile is the same as in the original list.
+ */
+template<typename RasterIndex>
+class SpatialDecomposition
+{
+public:
+    /**
+     * @brief Create tiles covering the whole raster
+     *
+     * @param rows Number of rows in the raster
+     * @param cols Number of columns in the raster
+     * @param tile_size Number of rows and columns in one tile
+     *
+     * @throw std::invalid_argument when the tile size is not positive
+     */
+    SpatialDecomposition(RasterIndex rows, RasterIndex cols, RasterIndex tile_size)
+        : rows_(rows), cols_(cols), tile_size_(tile_size)
+    {
+        if (tile_size <= 0) {
+            throw std::invalid_argument(
+                "SpatialDecomposition: Tile size needs to be positive, not "
+                + std::to_string(tile_size));
+        }
+        tile_rows_ = (rows + tile_size - 1) / tile_size;
+        tile_cols_ = (cols + tile_size - 1) / tile_size;
+        tiles_.reserve(std::size_t(tile_rows_) * std::size_t(tile_cols_));
+        for (RasterIndex tile_row = 0; tile_row < tile_rows_; ++tile_row) {
+            for (RasterIndex tile_col = 0; tile_col < tile_cols_; ++tile_col) {
+                SpatialTile<RasterIndex> tile;
+                tile.row_begin = tile_row * tile_size;
+                tile.row_end = std::min(rows, tile.row_begin + tile_size);
+                tile.col_begin = tile_col * tile_size;
+                tile.col_end = std::min(cols, tile.col_begin + tile_size);
+                tiles_.push_back(tile);
+            }
+        }
+    }
+
+    /**
+     * @brief Assign cells to tiles which own them
+     *
+     * Cells previously assigned are removed from the tiles.
+     *
+     * @param cells List of row and column indices (e.g., suitable cells)
+     */
+    void assign_cells(const std::vector<std::vector<int>>& cells)
+    {
+        for (auto& tile : tiles_)
+            tile.cells.clear();
+        for (const auto& cell : cells)
+            tiles_[tile_at(cell[0], cell[1])].cells.push_back(cell);
+    }
+
+    /** Get index of the tile which owns the cell */
+    std::size_t tile_at(RasterIndex row, RasterIndex col) const
+    {
+        return std::size_t(row / tile_size_) * std::size_t(tile_cols_)
+               + std::size_t(col / tile_size_);
+    }
+
+    /** Get all tiles */
+    const std::vector<SpatialTile<RasterIndex>>& tiles() const
+    {
+        return tiles_;
+    }
+
+    /** Get number of tiles */
+    std::size_t num_tiles() const
+    {
+        return tiles_.size();
+    }
+
+    /** Get number of rows and columns in one tile */
+    RasterIndex tile_size() const
+    {
+        return tile_size_;
+    }
+
+    /** Get number of rows in the raster */
+    RasterIndex rows() const
+    {
+        return rows_;
+    }
+
+    /** Get number of columns in the raster */
+    RasterIndex cols() const
+    {
+        return cols_;
+    }
+
+private:
+    RasterIndex rows_;
+    RasterIndex cols_;
+    RasterIndex tile_size_;
+    RasterIndex tile_rows_;
+    RasterIndex tile_cols_;
+    std::vector<SpatialTile<RasterIndex>> tiles_;
+};
+
+/**
+ * Spread of pest or pathogens done in parallel by tiles
+ *
+ * This does the same as SpreadAction, i.e., generation of dispersers, dispersal,
+ * and establishment, but the raster is decomposed into tiles (see
+ * SpatialDecomposition) and the tiles are processed using multiple threads.
+ *
+ * The step is done in two phases:
+ *
+ * 1. For each tile, dispersers are generated in the suitable cells of the tile and
+ *    moved using the dispersal kernel. Landings are collected as messages for the
+ *    tile which owns the target cell. Dispersers leaving the soil are landings in
+ *    the same cell. Dispersers leaving the area are only counted for each target
+ *    cell and added to the pest pool ordered by cell.
+ * 2. Messages are exchanged in one batch, ordered by the source tile. Then, for
+ *    each tile, the landings in the tile are established in the host pool. With
+ *    random streams for cells, the landings are first ordered by the target cell
+ *    and then by the source cell.
+ *
+ * Host pool is only read in the first phase and each tile writes only to its own
+ * cells in the second phase, so the tiles don't need halos with copies of
+ * neighboring cells and there is no locking. The second phase runs in parallel only
+ * when the host pool has no infection observers (which are not thread-safe),
+ * otherwise the tiles are processed one by one in a fixed order.
+ *
+ * The random number generators are seeded for each source cell in the first phase
+ * and for each target cell in the second phase using seeds derived from the seed,
+ * step, and cell index (RandomStreams::Cell). Consequently, the result does not
+ * depend on the number of threads, tile size, or order of suitable cells. It
+ * differs from the result of SpreadAction with the same seed. Only the generators
+ * used in the phase are seeded (see select_random_stream()).
+ * CounterBasedGeneratorProvider selects the streams without seeding, so it is the
+ * fastest option for streams for cells.
+ *
+ * Alternatively, the generators can be seeded only for each tile
+ * (RandomStreams::Tile). This is cheaper when seeding is costly (e.g., with
+ * multiple generators), but the result depends on the tile size (and still not on
+ * the number of threads).
+ *
+ * The dispersal kernel is created once for each thread using a function provided
+ * in the constructor because kernels can have internal state. The kernel state
+ * needs to depend only on the current source cell (as it is for all kernels in the
+ * library). Kernels are not reused across steps because their parameters can
+ * change between steps. Creating a kernel is cheap when the expensive parts are
+ * computed before and shared read-only, e.g., Model computes the probability
+ * windows of DeterministicDispersalKernel once for each step and passes them to
+ * the kernel factory (see create_deterministic_windows()).
+ *
+ * GeneratorProvider needs to be constructible from a seed and a flag for multiple
+ * generators (as RandomNumberGeneratorProvider and CounterBasedGeneratorProvider
+ * are). The streams are selected using select_random_stream(). The streams differ
+ * for each replicate number: CounterBasedGeneratorProvider is created with the
+ * replicate number, other providers use a seed derived from the replicate number
+ * (see create_stream_provider()).
+ */
+template<
+    typename Hosts,
+    typename Pests,
+    typename IntegerRaster,
+    typename FloatRaster,
+    typename RasterIndex,
+    typename DispersalKernel,
+    typename GeneratorProvider>
+class DecomposedSpreadAction
+{
+public:
+    /**
+     * @brief Create the object with tiles of a given size
+     *
+     * @param create_kernel Function creating the dispersal kernel
+     * @param rows Number of rows in the raster
+     * @param cols Number of columns in the raster
+     * @param tile_size Number of rows and columns in one tile
+     * @param seed Seed used to derive seeds for tiles
+     * @param multiple_seeds Use multiple generators in each tile (see
+     * RandomNumberGeneratorProvider)
+     * @param threads Number of threads (0 to use the number of hardware threads)
+     * @param streams Random number streams for cells or for tiles
+     * @param replicate Replicate number (streams differ across replicates)
+     */
+    DecomposedSpreadAction(
+        std::function<DispersalKernel()> create_kernel,
+        RasterIndex rows,
+        RasterIndex cols,
+        RasterIndex tile_size,
+        unsigned seed,
+        bool multiple_seeds = false,
+        unsigned threads = 0,
+        RandomStreams streams = RandomStreams::Cell,
+        unsigned replicate = 0)
+        : create_kernel_(create_kernel),
+          decomposition_(rows, cols, tile_size),
+          seed_(replicate_stream_seed<GeneratorProvider>(seed, replicate)),
+          replicate_(replicate),
+          multiple_seeds_(multiple_seeds),
+          threads_(effective_thread_count(threads)),
+          streams_(streams)
+    {}
+
+    /**
+     * @brief Perform the generation and spread
+     *
+     * Dispersers and established dispersers in the pest pool are reset for all
+     * suitable cells.
+     *
+     * @param host_pool Host pool
+     * @param pests Pest pool
+     * @param step Step in the simulation (used to derive seeds)
+     */
+    void action(Hosts& host_pool, Pests& pests, unsigned step)
+    {
+        decomposition_.assign_cells(host_pool.suitable_cells());
+        std::size_t num_tiles = decomposition_.num_tiles();
+        outboxes_.resize(num_tiles);
+        unsigned threads =
+            static_cast<unsigned>(std::min<std::size_t>(threads_, num_tiles));
+        // Kernels and generators have state, so each thread has its own.
+        std::vector<DispersalKernel> kernels;
+        std::vector<GeneratorProvider> generators;
+        kernels.reserve(threads);
+        generators.reserve(threads);
+        for (unsigned thread = 0; thread < std::max(threads, 1u); ++thread) {
+            kernels.push_back(create_kernel_());
+            generators.push_back(create_stream_provider<GeneratorProvider>(
+                seed_, multiple_seeds_, replicate_));
+        }
+        parallel_for_each_index(
+            num_tiles, threads, [&](std::size_t tile, unsigned thread) {
+                disperse_from_tile(
+                    host_pool, pests, kernels[thread], generators[thread], step, tile);
+            });
+        exchange_landings();
+        unsigned establishment_threads =
+            host_pool.has_infection_observers() ? 1 : threads;
+        parallel_for_each_index(
+            num_tiles, establishment_threads, [&](std::size_t tile, unsigned thread) {
+                establish_in_tile(host_pool, generators[thread], step, tile);
+            });
+        for (const auto& landing : inbox_) {
+            if (landing.established && !landing.from_soil) {
+                pests.add_established_dispersers_at(
+                    landing.source_row, landing.source_col, 1);
+            }
+        }
+        // Counts are merged and added ordered by cell, so the order does not
+        // depend on the tiles.
+        outside_.clear();
+        for (const auto& outbox : outboxes_) {
+            for (const auto& item : outbox.outside.cell_counts())
+                outside_.add(item.first.first, item.first.second, item.second);
+        }
+        for (const auto& item : outside_.cell_counts()) {
+            pests.add_outside_dispersers_at(
+                item.first.first, item.first.second, static_cast<int>(item.second));
+        }
+    }
+
+    /**
+     * @brief Activate storage of dispersers in soil
+     *
+     * @see SpreadAction::activate_soils()
+     */
+    void activate_soils(
+        std::shared_ptr<
+            SoilPool<IntegerRaster, FloatRaster, RasterIndex, GeneratorProvider>>
+            soil_pool,
+        double dispersers_percentage)
+    {
+        this->soil_pool_ = soil_pool;
+        this->to_soil_percentage_ = dispersers_percentage;
+    }
+
+    /** Get the decomposition into tiles */
+    const SpatialDecomposition<RasterIndex>& decomposition() const
+    {
+        return decomposition_;
+    }
+
+private:
+    /** Disperser landing in a cell (message from the source to the target tile) */
+    struct Landing
+    {
+        RasterIndex source_row;
+        RasterIndex source_col;
+        RasterIndex row;
+        RasterIndex col;
+        std::size_t tile;  ///< Tile owning the target cell
+        bool from_soil;  ///< Disperser released from soil
+        bool established;  ///< Result of the establishment
+    };
+
+    /** Messages produced by one tile */
+    struct Outbox
+    {
+        std::vector<Landing> landings;
+        OutsideDispersers outside;  ///< Counts of landings outside of the raster
+    };
+
+    /** Get index of a cell in a row-major order */
+    std::size_t cell_index(RasterIndex row, RasterIndex col) const
+    {
+        return std::size_t(row) * std::size_t(decomposition_.cols()) + std::size_t(col);
+    }
+
+    /** Get index of the source cell of a landing */
+    std::size_t source_index(const Landing& landing) const
+    {
+        return cell_index(landing.source_row, landing.source_col);
+    }
+
+    /** Get index of the target cell of a landing */
+    std::size_t target_index(const Landing& landing) const
+    {
+        return cell_index(landing.row, landing.col);
+    }
+
+    /** Generate and move dispersers from one tile (first phase) */
+    void disperse_from_tile(
+        Hosts& host_pool,
+        Pests& pests,
+        DispersalKernel& kernel,
+        GeneratorProvider& generator,
+        unsigned step,
+        std::size_t tile_index)
+    {
+        Outbox& outbox = outboxes_[tile_index];
+        outbox.landings.clear();
+        outbox.outside.clear();
+        const auto& cells = decomposition_.tiles()[tile_index].cells;
+        if (cells.empty())
+            return;
+        // Only generators used in this phase are selected (with a single generator,
+        // soils use the single generator).
+        if (streams_ == RandomStreams::Tile) {
+            select_random_stream(
+                generator,
+                seed_,
+                step,
+                2 * tile_index,
+                {GeneratorPurpose::DisperserGeneration,
+                 GeneratorPurpose::NaturalDispersal,
+                 GeneratorPurpose::AnthropogenicDispersal,
+                 GeneratorPurpose::Soil});
+        }
+        int row;
+        int col;
+        for (const auto& indices : cells) {
+            RasterIndex i = indices[0];
+            RasterIndex j = indices[1];
+            if (streams_ == RandomStreams::Cell) {
+                select_random_stream(
+                    generator,
+                    seed_,
+                    step,
+                    2 * cell_index(i, j),
+                    {GeneratorPurpose::DisperserGeneration,
+                     GeneratorPurpose::NaturalDispersal,
+                     GeneratorPurpose::AnthropogenicDispersal,
+                     GeneratorPurpose::Soil});
+            }
+            int dispersers =
+                host_pool.dispersers_from(i, j, generator.disperser_generation());
+            if (dispersers > 0 && soil_pool_) {
+                auto dispersers_to_soil = std::lround(to_soil_percentage_ * dispersers);
+                soil_pool_->dispersers_to(dispersers_to_soil, i, j, generator);
+                dispersers -= dispersers_to_soil;
+            }
+            pests.set_dispersers_at(i, j, dispersers, 0);
+            for (int k = 0; k < dispersers; k++) {
+                std::tie(row, col) = kernel(generator, i, j);
+                if (host_pool.is_outside(row, col)) {
+                    outbox.outside.add(row, col);
+                    continue;
+                }
+                outbox.landings.push_back(
+                    {i, j, row, col, decomposition_.tile_at(row, col), false, false});
+            }
+            if (soil_pool_) {
+                int from_soil = soil_pool_->dispersers_from(i, j, generator);
+                for (int k = 0; k < from_soil; k++)
+                    outbox.landings.push_back({i, j, i, j, tile_index, true, false});
+            }
+        }
+    }
+
+    /** Sort landings by target tile, keeping the order of source tiles */
+    void exchange_landings()
+    {
+        std::size_t num_tiles = decomposition_.num_tiles();
+        offsets_.assign(num_tiles + 1, 0);
+        for (const auto& outbox : outboxes_) {
+            for (const auto& landing : outbox.landings)
+                ++offsets_[landing.tile + 1];
+        }
+        for (std::size_t tile = 0; tile < num_tiles; ++tile)
+            offsets_[tile + 1] += offsets_[tile];
+        inbox_.resize(offsets_[num_tiles]);
+        std::vector<std::size_t> positions(offsets_.begin(), offsets_.end() - 1);
+        for (const auto& outbox : outboxes_) {
+            for (const auto& landing : outbox.landings)
+                inbox_[positions[landing.tile]++] = landing;
+        }
+    }
+
+    /** Establish landings in one tile (second phase) */
+    void establish_in_tile(
+        Hosts& host_pool,
+        GeneratorProvider& generator,
+        unsigned step,
+        std::size_t tile_index)
+    {
+        std::size_t begin = offsets_[tile_index];
+        std::size_t end = offsets_[tile_index + 1];
+        if (begin == end)
+            return;
+        if (streams_ == RandomStreams::Tile) {
+            select_random_stream(
+                generator,
+                seed_,
+                step,
+                2 * tile_index + 1,
+                {GeneratorPurpose::Establishment});
+        }
+        else {
+            // Canonical order: by target cell, then by source cell, then as drawn.
+            std::stable_sort(
+                inbox_.begin() + begin,
+                inbox_.begin() + end,
+                [this](const Landing& a, const Landing& b) {
+                    if (target_index(a) != target_index(b))
+                        return target_index(a) < target_index(b);
+                    return source_index(a) < source_index(b);
+                });
+        }
+        std::size_t previous_target = std::size_t(-1);
+        for (std::size_t index = begin; index < end; ++index) {
+            Landing& landing = inbox_[index];
+            if (streams_ == RandomStreams::Cell
+                && target_index(landing) != previous_target) {
+                previous_target = target_index(landing);
+                select_random_stream(
+                    generator,
+                    seed_,
+                    step,
+                    2 * previous_target + 1,
+                    {GeneratorPurpose::Establishment});
+            }
+            landing.established =
+                host_pool.disperser_to(
+                    landing.row, landing.col, generator.establishment())
+                > 0;
+        }
+    }
+
+    std::function<DispersalKernel()> create_kernel_;
+    SpatialDecomposition<RasterIndex> decomposition_;
+    unsigned seed_;
+    unsigned replicate_;
+    bool multiple_seeds_;
+    unsigned threads_;
+    RandomStreams streams_;
+    std::vector<Outbox> outboxes_;
+    std::vector<Landing> inbox_;
+    OutsideDispersers outside_;
+    std::vector<std::size_t> offsets_;
+    std::shared_ptr<
+        SoilPool<IntegerRaster, FloatRaster, RasterIndex, GeneratorProvider>>
+        soil_pool_{nullptr};
+    double to_soil_percentage_{0};
+};
+
+}  // namespace pops
+
+#endif  // POPS_SPATIAL_DECOMPOSITION_HPP
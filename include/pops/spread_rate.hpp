@@ -17,6 +17,7 @@
 #define POPS_SPREAD_RATE_HPP
 
 #include "utils.hpp"
+#include "infection_tracker.hpp"
 
 #include <tuple>
 #include <vector>
@@ -46,7 +47,8 @@ public:
           boundaries_(num_steps + 1, std::make_tuple(0, 0, 0, 0)),
           rates_(
               num_steps,
-              std::make_tuple(std::nan(""), std::nan(""), std::nan(""), std::nan("")))
+              std::make_tuple(std::nan(""), std::nan(""), std::nan(""), std::nan(""))),
+          collected_boundary_(empty_boundary())
     {
         boundaries_.at(0) = infection_boundary(hosts);
     }
@@ -69,7 +71,79 @@ public:
      */
     void action(const Hosts& hosts, unsigned step)
     {
-        BBoxInt bbox = infection_boundary(hosts);
+        if (tracker_)
+            set_step_boundary(tracker_->boundary(), step);
+        else
+            set_step_boundary(infection_boundary(hosts), step);
+    }
+
+    /**
+     * Use a tracker to get the infection boundary instead of going over all cells
+     *
+     * The tracker needs to be added as an observer to the hosts, so that it is
+     * updated as infection changes. Only a pointer to the tracker is stored, so the
+     * tracker needs to exist as long as this object is used.
+     */
+    void track_infection(const InfectionExtentTracker<RasterIndex>& tracker)
+    {
+        tracker_ = &tracker;
+    }
+
+    /**
+     * Returns true if the infection boundary is taken from a tracker
+     */
+    bool tracks_infection() const
+    {
+        return tracker_ != nullptr;
+    }
+
+    /**
+     * Include one cell in the infection boundary for the current step
+     *
+     * This is an alternative to action() which allows the boundary to be collected
+     * cell by cell, e.g., as part of sweep_cells(). Call finish_action() once all
+     * suitable cells were processed.
+     */
+    void action_at(const Hosts& hosts, RasterIndex i, RasterIndex j)
+    {
+        if (hosts.infected_at(i, j) > 0)
+            extend_boundary(collected_boundary_, collected_found_, i, j);
+    }
+
+    /**
+     * Compute the spread rate from cells collected with action_at()
+     */
+    void finish_action(unsigned step)
+    {
+        if (collected_found_)
+            set_step_boundary(collected_boundary_, step);
+        else
+            set_step_boundary(std::make_tuple(-1, -1, -1, -1), step);
+        collected_boundary_ = empty_boundary();
+        collected_found_ = false;
+    }
+
+private:
+    int width_;
+    int height_;
+    // the west-east resolution of the pixel
+    double west_east_resolution_;
+    // the north-south resolution of the pixel
+    double north_south_resolution_;
+    unsigned num_steps_;
+    std::vector<BBoxInt> boundaries_;
+    std::vector<BBoxFloat> rates_;
+    // boundary collected cell by cell by action_at()
+    BBoxInt collected_boundary_;
+    bool collected_found_{false};
+    // optional tracker of infection (non-owning)
+    const InfectionExtentTracker<RasterIndex>* tracker_{nullptr};
+
+    /**
+     * Store the boundary for a step and compute the rate from the previous one.
+     */
+    void set_step_boundary(const BBoxInt& bbox, unsigned step)
+    {
         boundaries_.at(step + 1) = bbox;
         if (!is_boundary_valid(bbox)) {
             rates_.at(step) =
@@ -98,17 +172,6 @@ public:
         rates_.at(step) = std::make_tuple(n_rate, s_rate, e_rate, w_rate);
     }
 
-private:
-    int width_;
-    int height_;
-    // the west-east resolution of the pixel
-    double west_east_resolution_;
-    // the north-south resolution of the pixel
-    double north_south_resolution_;
-    unsigned num_steps_;
-    std::vector<BBoxInt> boundaries_;
-    std::vector<BBoxFloat> rates_;
-
     /**
      * Return tuple of booleans indicating
      * wheather the infection touched the edge cells
@@ -138,33 +201,48 @@ private:
      */
     BBoxInt infection_boundary(const Hosts& hosts)
     {
-        int n = height_ - 1;
-        int s = 0;
-        int e = 0;
-        int w = width_ - 1;
+        BBoxInt bbox = empty_boundary();
         bool found = false;
         for (const auto& indices : hosts.suitable_cells()) {
             int i = indices[0];
             int j = indices[1];
             auto value = hosts.infected_at(i, j);
-            if (value > 0) {
-                found = true;
-                if (i < n)
-                    n = i;
-                if (i > s)
-                    s = i;
-                if (j > e)
-                    e = j;
-                if (j < w)
-                    w = j;
-            }
+            if (value > 0)
+                extend_boundary(bbox, found, i, j);
         }
         if (found)
-            return std::make_tuple(n, s, e, w);
+            return bbox;
         else
             return std::make_tuple(-1, -1, -1, -1);
     }
 
+    /**
+     * Initial value of a boundary before any cells are added to it
+     */
+    BBoxInt empty_boundary() const
+    {
+        return std::make_tuple(height_ - 1, 0, 0, width_ - 1);
+    }
+
+    /**
+     * Extend boundary with a cell with infection
+     */
+    static void extend_boundary(BBoxInt& bbox, bool& found, int i, int j)
+    {
+        int n, s, e, w;
+        std::tie(n, s, e, w) = bbox;
+        found = true;
+        if (i < n)
+            n = i;
+        if (i > s)
+            s = i;
+        if (j > e)
+            e = j;
+        if (j < w)
+            w = j;
+        bbox = std::make_tuple(n, s, e, w);
+    }
+
     /**
      * Checks if boundary is valid, if not,
      * it means there is no infection at all.
@@ -16,6 +16,10 @@
 #ifndef POPS_STATISTICS_HPP
 #define POPS_STATISTICS_HPP
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 namespace pops {
 
 /**
@@ -55,5 +59,48 @@ double area_of_infected(
     return cells * ew_res * ns_res;
 }
 
+/**
+ * Summary statistics of values, e.g., results of replicates of a simulation
+ */
+struct ValueSummary
+{
+    unsigned count{0};  ///< Number of values
+    double mean{0};
+    double stddev{0};  ///< Sample standard deviation (zero for fewer than two values)
+    double min{0};
+    double max{0};
+
+    /** Get standard error of the mean */
+    double standard_error() const
+    {
+        return count ? stddev / std::sqrt(count) : 0;
+    }
+};
+
+/**
+ * Computes summary statistics of values.
+ */
+inline ValueSummary summarize_values(const std::vector<double>& values)
+{
+    ValueSummary summary;
+    if (values.empty())
+        return summary;
+    summary.count = static_cast<unsigned>(values.size());
+    double sum = 0;
+    for (double value : values)
+        sum += value;
+    summary.mean = sum / values.size();
+    if (values.size() > 1) {
+        double squares = 0;
+        for (double value : values)
+            squares += (value - summary.mean) * (value - summary.mean);
+        summary.stddev = std::sqrt(squares / (values.size() - 1));
+    }
+    auto range = std::minmax_element(values.begin(), values.end());
+    summary.min = *range.first;
+    summary.max = *range.second;
+    return summary;
+}
+
 }  // namespace pops
 #endif  // POPS_STATISTICS_HPP
@@ -0,0 +1,496 @@
+/*
+ * PoPS model - raster stored in square tiles
+ *
+ * Copyright (C) 2023 by the authors.
+ *
+ * Authors: Vaclav Petras <wenzeslaus gmail com>
+ *
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef POPS_TILED_RASTER_HPP
+#define POPS_TILED_RASTER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "raster.hpp"
+
+namespace pops {
+
+/*! Raster with cells stored in square tiles.
+ *
+ * Cells of one tile are stored together in row-major order and tiles are
+ * stored in row-major order, too. Compared to Raster which stores whole
+ * rows, cells which are close to each other in any direction are likely
+ * close in memory, so, e.g., dispersers landing a few cells north or south
+ * of the source cell don't need to load a distant part of the memory.
+ *
+ * The class provides the interface HostPool, Environment, Model, and the
+ * actions need from the IntegerRaster and FloatRaster types, i.e., access
+ * to cells using operator(), number of rows and columns, fill(), and
+ * element-wise operators with rasters of the same type and with scalars.
+ * Unlike Raster, it does not provide direct access to the underlying
+ * array because the order of cells is not row-major.
+ *
+ * The storage is allocated in chunks, one for each row of tiles, so even
+ * rasters with more than 2^31 cells don't need one contiguous allocation.
+ * Positions of cells are computed using the size type (std::size_t), so
+ * the index type needs to hold only the number of rows and columns.
+ *
+ * The TileSize template parameter is the number of rows and columns in a
+ * tile. It needs to be a power of two. Tiles at the last row and column of
+ * tiles may be only partially used by the cells.
+ */
+template<typename Number, typename Index = int, int TileSize = 64>
+class TiledRaster
+{
+    static_assert(
+        TileSize > 0 && !(TileSize & (TileSize - 1)),
+        "TileSize needs to be a power of two");
+
+    /*! Result type for operations with scalars (and not other types) */
+    template<typename OtherNumber, typename Result>
+    using ScalarResult =
+        typename std::enable_if<std::is_arithmetic<OtherNumber>::value, Result>::type;
+
+public:
+    typedef Number NumberType;
+    typedef Index IndexType;
+    typedef std::size_t SizeType;
+
+    TiledRaster() : rows_(0), cols_(0), chunk_size_(0) {}
+
+    TiledRaster(Index rows, Index cols)
+        : rows_(rows),
+          cols_(cols),
+          chunk_size_(tiles_for(cols) * tile_cells),
+          chunks_(tiles_for(rows), std::vector<Number>(chunk_size_, Number(0)))
+    {}
+
+    TiledRaster(Index rows, Index cols, Number value) : TiledRaster(rows, cols)
+    {
+        fill(value);
+    }
+
+    TiledRaster(std::initializer_list<std::initializer_list<Number>> l)
+        : TiledRaster(l.size(), l.begin()->size())
+    {
+        Index i = 0;
+        for (const auto& subl : l) {
+            Index j = 0;
+            for (const auto& value : subl) {
+                (*this)(i, j) = value;
+                ++j;
+            }
+            ++i;
+        }
+    }
+
+    /*! Create tiled raster with values from a row-major raster */
+    template<typename OtherIndex, typename Allocator>
+    explicit TiledRaster(const Raster<Number, OtherIndex, Allocator>& raster)
+        : TiledRaster(raster.rows(), raster.cols())
+    {
+        for (Index i = 0; i < rows_; ++i)
+            for (Index j = 0; j < cols_; ++j)
+                (*this)(i, j) = raster(i, j);
+    }
+
+    /*! Create row-major raster with values of this raster */
+    Raster<Number, Index> to_raster() const
+    {
+        Raster<Number, Index> raster(rows_, cols_);
+        for (Index i = 0; i < rows_; ++i)
+            for (Index j = 0; j < cols_; ++j)
+                raster(i, j) = (*this)(i, j);
+        return raster;
+    }
+
+    Index rows() const
+    {
+        return rows_;
+    }
+
+    Index cols() const
+    {
+        return cols_;
+    }
+
+    /*! Returns number of cells, i.e., rows times columns */
+    SizeType size() const
+    {
+        return SizeType(rows_) * SizeType(cols_);
+    }
+
+    const Number& operator()(Index row, Index col) const
+    {
+        return chunks_[SizeType(row) / TileSize][offset(row, col)];
+    }
+
+    Number& operator()(Index row, Index col)
+    {
+        return chunks_[SizeType(row) / TileSize][offset(row, col)];
+    }
+
+    /*! Position of a cell in the storage if all chunks were put together */
+    SizeType index(Index row, Index col) const
+    {
+        return SizeType(row) / TileSize * chunk_size_ + offset(row, col);
+    }
+
+    void fill(Number value)
+    {
+        for (auto& chunk : chunks_)
+            std::fill(chunk.begin(), chunk.end(), value);
+    }
+
+    void zero()
+    {
+        fill(0);
+    }
+
+    template<typename OtherNumber>
+    ScalarResult<OtherNumber, TiledRaster&>
+    operator+=(OtherNumber value)
+    {
+        auto converted = scalar_value(value);
+        for (auto& chunk : chunks_)
+            for (auto& a : chunk)
+                a += converted;
+        return *this;
+    }
+
+    template<typename OtherNumber>
+    ScalarResult<OtherNumber, TiledRaster&>
+    operator-=(OtherNumber value)
+    {
+        auto converted = scalar_value(value);
+        for (auto& chunk : chunks_)
+            for (auto& a : chunk)
+                a -= converted;
+        return *this;
+    }
+
+    template<typename OtherNumber>
+    ScalarResult<OtherNumber, TiledRaster&>
+    operator*=(OtherNumber value)
+    {
+        auto converted = scalar_value(value);
+        for (auto& chunk : chunks_)
+            for (auto& a : chunk)
+                a *= converted;
+        return *this;
+    }
+
+    template<typename OtherNumber>
+    ScalarResult<OtherNumber, TiledRaster&>
+    operator/=(OtherNumber value)
+    {
+        auto converted = scalar_value(value);
+        for (auto& chunk : chunks_)
+            for (auto& a : chunk)
+                a /= converted;
+        return *this;
+    }
+
+    TiledRaster& operator+=(const TiledRaster& other)
+    {
+        check_size(other, "+=");
+        for (SizeType i = 0; i < chunks_.size(); ++i)
+            for (SizeType j = 0; j < chunk_size_; ++j)
+                chunks_[i][j] += other.chunks_[i][j];
+        return *this;
+    }
+
+    TiledRaster& operator-=(const TiledRaster& other)
+    {
+        check_size(other, "-=");
+        for (SizeType i = 0; i < chunks_.size(); ++i)
+            for (SizeType j = 0; j < chunk_size_; ++j)
+                chunks_[i][j] -= other.chunks_[i][j];
+        return *this;
+    }
+
+    TiledRaster& operator*=(const TiledRaster& other)
+    {
+        check_size(other, "*=");
+        for (SizeType i = 0; i < chunks_.size(); ++i)
+            for (SizeType j = 0; j < chunk_size_; ++j)
+                chunks_[i][j] *= other.chunks_[i][j];
+        return *this;
+    }
+
+    /*! Divide cell values by values in the other raster
+     *
+     * Unused parts of tiles are not divided to avoid division by zero.
+     */
+    TiledRaster& operator/=(const TiledRaster& other)
+    {
+        check_size(other, "/=");
+        for (Index i = 0; i < rows_; ++i)
+            for (Index j = 0; j < cols_; ++j)
+                (*this)(i, j) /= other(i, j);
+        return *this;
+    }
+
+    friend TiledRaster operator+(TiledRaster raster, const TiledRaster& other)
+    {
+        raster += other;
+        return raster;
+    }
+
+    friend TiledRaster operator-(TiledRaster raster, const TiledRaster& other)
+    {
+        raster -= other;
+        return raster;
+    }
+
+    friend TiledRaster operator*(TiledRaster raster, const TiledRaster& other)
+    {
+        raster *= other;
+        return raster;
+    }
+
+    friend TiledRaster operator/(TiledRaster raster, const TiledRaster& other)
+    {
+        raster /= other;
+        return raster;
+    }
+
+    template<typename OtherNumber>
+    friend ScalarResult<OtherNumber, TiledRaster>
+        operator+(TiledRaster raster, OtherNumber value)
+    {
+        raster += value;
+        return raster;
+    }
+
+    template<typename OtherNumber>
+    friend ScalarResult<OtherNumber, TiledRaster>
+        operator-(TiledRaster raster, OtherNumber value)
+    {
+        raster -= value;
+        return raster;
+    }
+
+    template<typename OtherNumber>
+    friend ScalarResult<OtherNumber, TiledRaster>
+        operator*(TiledRaster raster, OtherNumber value)
+    {
+        raster *= value;
+        return raster;
+    }
+
+    template<typename OtherNumber>
+    friend ScalarResult<OtherNumber, TiledRaster>
+        operator/(TiledRaster raster, OtherNumber value)
+    {
+        raster /= value;
+        return raster;
+    }
+
+    template<typename OtherNumber>
+    friend ScalarResult<OtherNumber, TiledRaster>
+        operator+(OtherNumber value, TiledRaster raster)
+    {
+        raster += value;
+        return raster;
+    }
+
+    template<typename OtherNumber>
+    friend ScalarResult<OtherNumber, TiledRaster>
+        operator*(OtherNumber value, TiledRaster raster)
+    {
+        raster *= value;
+        return raster;
+    }
+
+    template<typename OtherNumber>
+    friend ScalarResult<OtherNumber, TiledRaster>
+        operator-(OtherNumber value, TiledRaster raster)
+    {
+        auto converted = scalar_value(value);
+        for (auto& chunk : raster.chunks_)
+            for (auto& a : chunk)
+                a = static_cast<Number>(converted - a);
+        return raster;
+    }
+
+    /*! Divide a scalar by cell values
+     *
+     * Unused parts of tiles are not used as divisors to avoid division by zero.
+     */
+    template<typename OtherNumber>
+    friend ScalarResult<OtherNumber, TiledRaster>
+        operator/(OtherNumber value, TiledRaster raster)
+    {
+        auto converted = scalar_value(value);
+        for (Index i = 0; i < raster.rows_; ++i)
+            for (Index j = 0; j < raster.cols_; ++j)
+                raster(i, j) = static_cast<Number>(converted / raster(i, j));
+        return raster;
+    }
+
+    bool operator==(const TiledRaster& other) const
+    {
+        if (rows_ != other.rows_ || cols_ != other.cols_)
+            return false;
+        for (Index i = 0; i < rows_; ++i)
+            for (Index j = 0; j < cols_; ++j)
+                if ((*this)(i, j) != other(i, j))
+                    return false;
+        return true;
+    }
+
+    bool operator!=(const TiledRaster& other) const
+    {
+        return !(*this == other);
+    }
+
+    friend std::ostream& operator<<(std::ostream& stream, const TiledRaster& image)
+    {
+        return stream << image.to_raster();
+    }
+
+private:
+    static const SizeType tile_cells = SizeType(TileSize) * TileSize;
+
+    Index rows_;
+    Index cols_;
+    SizeType chunk_size_;
+    std::vector<std::vector<Number>> chunks_;
+
+    /*! Position of a cell within its chunk */
+    SizeType offset(Index row, Index col) const
+    {
+        SizeType r = static_cast<SizeType>(row);
+        SizeType c = static_cast<SizeType>(col);
+        return c / TileSize * tile_cells + r % TileSize * TileSize + c % TileSize;
+    }
+
+    /*! Convert floating point scalar for use with integral values
+     *
+     * Same as in Raster, the value is rounded down for integral rasters.
+     */
+    template<typename OtherNumber>
+    static typename std::enable_if<
+        std::is_floating_point<OtherNumber>::value && std::is_integral<Number>::value,
+        Number>::type
+    scalar_value(OtherNumber value)
+    {
+        return static_cast<Number>(std::floor(value));
+    }
+
+    template<typename OtherNumber>
+    static typename std::enable_if<
+        !(std::is_floating_point<OtherNumber>::value
+          && std::is_integral<Number>::value),
+        OtherNumber>::type
+    scalar_value(OtherNumber value)
+    {
+        return value;
+    }
+
+    static std::size_t tiles_for(Index cells)
+    {
+        return (static_cast<std::size_t>(cells) + TileSize - 1) / TileSize;
+    }
+
+    void check_size(const TiledRaster& other, const char* name) const
+    {
+        if (rows_ != other.rows_ || cols_ != other.cols_) {
+            throw std::invalid_argument(
+                std::string("TiledRaster::operator") + name
+                + ": The number of rows or columns does not match");
+        }
+    }
+};
+
+/*! Interleave bits of row and column to get position on the Morton (Z-order) curve
+ *
+ * Cells with close Morton codes are close in space, so processing cells in the
+ * order of the codes accesses the memory of both row-major and tiled rasters
+ * in small, compact areas.
+ *
+ * @param row Row index (lower 32 bits are used)
+ * @param col Column index (lower 32 bits are used)
+ */
+inline std::uint64_t morton_code(std::uint32_t row, std::uint32_t col)
+{
+    auto spread_bits = [](std::uint64_t value) {
+        value = (value | (value << 16)) & 0x0000FFFF0000FFFFull;
+        value = (value | (value << 8)) & 0x00FF00FF00FF00FFull;
+        value = (value | (value << 4)) & 0x0F0F0F0F0F0F0F0Full;
+        value = (value | (value << 2)) & 0x3333333333333333ull;
+        value = (value | (value << 1)) & 0x5555555555555555ull;
+        return value;
+    };
+    return (spread_bits(row) << 1) | spread_bits(col);
+}
+
+/*! Sort cells (e.g., suitable cells) in the Morton (Z-order) curve order
+ *
+ * The cells are given as row and column indices as used for the suitable cells.
+ *
+ * The order of the cells determines the order in which random numbers are used,
+ * so the sorting changes the stochastic results of a simulation (but not their
+ * distribution).
+ */
+template<typename Cells>
+void sort_cells_in_morton_order(Cells& cells)
+{
+    using Cell = typename Cells::value_type;
+    std::stable_sort(
+        cells.begin(), cells.end(), [](const Cell& first, const Cell& second) {
+            return morton_code(first[0], first[1]) < morton_code(second[0], second[1]);
+        });
+}
+
+/*! Sort cells (e.g., suitable cells) tile by tile
+ *
+ * Cells are ordered by tiles (tiles in row-major order) and by row and column
+ * within a tile. This is the order in which TiledRaster with the same tile size
+ * stores cells.
+ *
+ * Same as for sort_cells_in_morton_order(), the sorting changes the stochastic
+ * results of a simulation.
+ *
+ * @param cells Cells to sort
+ * @param tile_size Number of rows and columns in one tile
+ */
+template<typename Cells>
+void sort_cells_in_tile_order(Cells& cells, int tile_size = 64)
+{
+    if (tile_size <= 0) {
+        throw std::invalid_argument(
+            "sort_cells_in_tile_order: Tile size needs to be positive, not "
+            + std::to_string(tile_size));
+    }
+    using Cell = typename Cells::value_type;
+    auto key = [tile_size](const Cell& cell) {
+        return std::make_tuple(
+            cell[0] / tile_size, cell[1] / tile_size, cell[0], cell[1]);
+    };
+    std::stable_sort(
+        cells.begin(), cells.end(), [&key](const Cell& first, const Cell& second) {
+            return key(first) < key(second);
+        });
+}
+
+}  // namespace pops
+
+#endif  // POPS_TILED_RASTER_HPP
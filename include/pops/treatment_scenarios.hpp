@@ -0,0 +1,373 @@
+/*
+ * PoPS model - evaluation of alternative treatment plans
+ *
+ * Copyright (C) 2023 by the authors.
+ *
+ * Authors: Vaclav Petras <wenzeslaus gmail com>
+ *
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef POPS_TREATMENT_SCENARIOS_HPP
+#define POPS_TREATMENT_SCENARIOS_HPP
+
+#include "config.hpp"
+#include "model.hpp"
+#include "network.hpp"
+#include "quarantine.hpp"
+#include "run_plan.hpp"
+#include "spatial_decomposition.hpp"
+#include "spread_rate.hpp"
+#include "statistics.hpp"
+#include "treatments.hpp"
+
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace pops {
+
+/**
+ * State of a simulation between two steps
+ *
+ * Holds the rasters which change during the simulation, i.e., the rasters
+ * Model::run_step() takes as input and output. Rasters which are only output of
+ * a step (dispersers, died) are not part of the state.
+ */
+template<typename IntegerRaster>
+struct SimulationState
+{
+    IntegerRaster infected;
+    IntegerRaster susceptible;
+    IntegerRaster total_populations;
+    IntegerRaster total_hosts;
+    IntegerRaster total_exposed;
+    std::vector<IntegerRaster> exposed;
+    std::vector<IntegerRaster> mortality_tracker;
+    IntegerRaster resistant;
+    std::vector<std::vector<int>> suitable_cells;
+};
+
+/**
+ * Results of all replicates of one treatment plan
+ *
+ * The differences are computed against the first plan in the same replicate.
+ * Because the replicates use common random numbers, the differences have much lower
+ * variance than the difference of the means from independent runs.
+ */
+struct TreatmentScenarioSummary
+{
+    ValueSummary infected;  ///< Number of infected hosts at the end
+    ValueSummary infected_area;  ///< Infected area at the end
+    ValueSummary infected_difference;  ///< Difference in infected from the first plan
+    ValueSummary area_difference;  ///< Difference in infected area from the first plan
+    std::vector<double> infected_by_replicate;  ///< Infected hosts in each replicate
+    std::vector<double> area_by_replicate;  ///< Infected area in each replicate
+};
+
+/**
+ * Evaluation of alternative treatment plans from a shared state
+ *
+ * Each plan (a set of treatments) is simulated from the same state to the end of the
+ * simulation in a given number of replicates. Replicates run in parallel, each with
+ * its own model and its own copy of the state.
+ *
+ * The replicates are matched across plans using common random numbers: replicate
+ * *r* of each plan uses the same seeds derived from the seeds in the configuration
+ * and *r*, so that the plans are compared under the same conditions and the
+ * difference between plans is mostly caused by the treatments. The random numbers
+ * stay aligned best when spread uses a random stream for each cell
+ * (Config::spread_tile_size with Config::spread_random_streams set to cell), so that
+ * a treatment in one cell does not shift the random numbers used in other cells.
+ * The result does not depend on the number of threads.
+ *
+ * The treatments are not modified by the evaluation (see Treatments::manage()), so
+ * one Treatments object is used by all replicates of a plan. Similarly, distances to
+ * quarantine boundaries are computed once and shared by all runs.
+ *
+ * Soils and host movements are not supported because their state is kept outside of
+ * the simulation state.
+ */
+template<
+    typename IntegerRaster,
+    typename FloatRaster,
+    typename RasterIndex,
+    typename Generator = std::default_random_engine>
+class TreatmentScenarios
+{
+public:
+    using SimulationModel = Model<IntegerRaster, FloatRaster, RasterIndex, Generator>;
+    using ScenarioTreatments =
+        Treatments<typename SimulationModel::StandardSingleHostPool, FloatRaster>;
+
+    /**
+     * @brief Set up evaluation from a given state
+     *
+     * @param config Configuration (schedules need to be created)
+     * @param state State before the first step to simulate (copied for each run)
+     * @param first_step First step to simulate (simulation continues to the end)
+     *
+     * @throw std::invalid_argument when the configuration is not supported or
+     * the step is outside of the simulation
+     */
+    TreatmentScenarios(
+        const Config& config,
+        const SimulationState<IntegerRaster>& state,
+        unsigned first_step)
+        : config_(config),
+          state_(state),
+          first_step_(first_step),
+          zeros_(config.rows, config.cols, 0),
+          null_network_(Network<RasterIndex>::null_network()),
+          quarantine_(create_quarantine(zeros_))
+    {
+        if (config_.use_movements)
+            throw std::invalid_argument(
+                "TreatmentScenarios: Host movements are not supported");
+        if (config_.dispersers_to_soils_percentage > 0)
+            throw std::invalid_argument("TreatmentScenarios: Soils are not supported");
+        if (first_step_ >= config_.scheduler().get_num_steps())
+            throw std::invalid_argument(
+                "TreatmentScenarios: First step " + std::to_string(first_step_)
+                + " is outside of the simulation");
+    }
+
+    /** Set temperatures for lethal temperature (indexed by lethal temperature step) */
+    void set_temperatures(const std::vector<FloatRaster>& temperatures)
+    {
+        temperatures_ = &temperatures;
+    }
+
+    /** Set pest survival rates (indexed by survival rate step) */
+    void set_survival_rates(const std::vector<FloatRaster>& survival_rates)
+    {
+        survival_rates_ = &survival_rates;
+    }
+
+    /** Set weather coefficients (indexed by weather step, deterministic weather) */
+    void set_weather_coefficients(const std::vector<FloatRaster>& coefficients)
+    {
+        weather_coefficients_ = &coefficients;
+    }
+
+    /** Set quarantine areas (all zeros by default) */
+    void set_quarantine_areas(const IntegerRaster& areas)
+    {
+        quarantine_areas_ = &areas;
+        quarantine_ = create_quarantine(areas);
+    }
+
+    /** Set network (Network::null_network() by default) */
+    void set_network(const Network<RasterIndex>& network)
+    {
+        network_ = &network;
+    }
+
+    /**
+     * @brief Evaluate treatment plans
+     *
+     * @param plans Treatment plans (the first one is the reference for differences)
+     * @param replicates Number of replicates for each plan
+     * @param threads Number of threads (0 for all hardware threads)
+     * @return Summary for each plan in the order of plans
+     *
+     * @throw std::invalid_argument when weather is used, but it is not deterministic
+     * or the coefficients were not set, or when lethal temperature or survival rate
+     * is used, but temperatures or survival rates were not set for all its steps
+     */
+    std::vector<TreatmentScenarioSummary> evaluate(
+        const std::vector<const ScenarioTreatments*>& plans,
+        unsigned replicates,
+        unsigned threads = 0) const
+    {
+        if (config_.weather
+            && (weather_type_from_string(config_.weather_type)
+                    != WeatherType::Deterministic
+                || !weather_coefficients_))
+            throw std::invalid_argument(
+                "TreatmentScenarios: Weather needs to be deterministic with "
+                "coefficients set");
+        RunPlan plan(config_);
+        auto lethal_steps = plan.lethal_schedule().num_actions();
+        auto survival_steps = plan.survival_rate_schedule().num_actions();
+        if (config_.use_lethal_temperature
+            && (!temperatures_ || temperatures_->size() < lethal_steps))
+            throw std::invalid_argument(
+                "TreatmentScenarios: Temperatures need to be set for each lethal "
+                "temperature step");
+        if (config_.use_survival_rate
+            && (!survival_rates_ || survival_rates_->size() < survival_steps))
+            throw std::invalid_argument(
+                "TreatmentScenarios: Survival rates need to be set for each survival "
+                "rate step");
+        std::vector<TreatmentScenarioSummary> summaries(plans.size());
+        for (auto& summary : summaries) {
+            summary.infected_by_replicate.resize(replicates);
+            summary.area_by_replicate.resize(replicates);
+        }
+        // Each run writes only its own item, so no locking is needed.
+        parallel_for_each_index(
+            plans.size() * replicates,
+            effective_thread_count(threads),
+            [&](std::size_t index, unsigned) {
+                std::size_t plan = index / replicates;
+                unsigned replicate = static_cast<unsigned>(index % replicates);
+                auto result = run(*plans[plan], replicate);
+                summaries[plan].infected_by_replicate[replicate] = result.first;
+                summaries[plan].area_by_replicate[replicate] = result.second;
+            });
+        for (auto& summary : summaries) {
+            summary.infected = summarize_values(summary.infected_by_replicate);
+            summary.infected_area = summarize_values(summary.area_by_replicate);
+            std::vector<double> infected_difference(replicates);
+            std::vector<double> area_difference(replicates);
+            for (unsigned i = 0; i < replicates; ++i) {
+                infected_difference[i] = summary.infected_by_replicate[i]
+                                         - summaries[0].infected_by_replicate[i];
+                area_difference[i] =
+                    summary.area_by_replicate[i] - summaries[0].area_by_replicate[i];
+            }
+            summary.infected_difference = summarize_values(infected_difference);
+            summary.area_difference = summarize_values(area_difference);
+        }
+        return summaries;
+    }
+
+    /**
+     * @brief Get configuration for a replicate
+     *
+     * All seeds are replaced by seeds derived from the original seed and the
+     * replicate number, so that the same replicate of all plans uses the same
+     * random numbers. The replicate number is also set for selection of random
+     * number streams in spread in tiles.
+     *
+     * Replicates already run in parallel, so spread in tiles uses only one thread.
+     * The result does not depend on the number of threads.
+     */
+    Config replicate_config(unsigned replicate) const
+    {
+        Config config = config_;
+        config.spread_threads = 1;
+        config.random_seed = static_cast<int>(
+            derive_seed(static_cast<unsigned>(config_.random_seed), replicate));
+        for (auto& item : config.random_seeds)
+            item.second = derive_seed(item.second, replicate);
+        config.replicate = replicate;
+        return config;
+    }
+
+private:
+    /**
+     * @brief Create quarantine escape action for given quarantine areas
+     *
+     * Distances to the quarantine boundaries are computed here and copies of the
+     * action used in the runs share them.
+     */
+    QuarantineEscapeAction<IntegerRaster>
+    create_quarantine(const IntegerRaster& areas) const
+    {
+        RunPlan plan(config_);
+        return QuarantineEscapeAction<IntegerRaster>(
+            areas,
+            config_.ew_res,
+            config_.ns_res,
+            config_.use_quarantine ? plan.quarantine_schedule().num_actions() : 0,
+            config_.quarantine_directions);
+    }
+
+    /**
+     * @brief Simulate one replicate of one plan
+     * @return Number of infected hosts and infected area at the end
+     */
+    std::pair<double, double>
+    run(const ScenarioTreatments& treatments, unsigned replicate) const
+    {
+        using StandardSingleHostPool = typename SimulationModel::StandardSingleHostPool;
+        using StandardMultiHostPool = typename SimulationModel::StandardMultiHostPool;
+        using StandardPestPool = typename SimulationModel::StandardPestPool;
+
+        Config config = replicate_config(replicate);
+        SimulationModel model(config);
+        const RunPlan& plan = model.run_plan();
+        SimulationState<IntegerRaster> state = state_;
+        IntegerRaster died(config.rows, config.cols, 0);
+        IntegerRaster dispersers(config.rows, config.cols, 0);
+        IntegerRaster established_dispersers(config.rows, config.cols, 0);
+        std::vector<std::tuple<int, int>> outside_dispersers;
+        StandardSingleHostPool host_pool(
+            config,
+            state.susceptible,
+            state.exposed,
+            state.infected,
+            state.total_exposed,
+            state.resistant,
+            state.mortality_tracker,
+            died,
+            state.total_hosts,
+            model.environment(),
+            state.suitable_cells);
+        std::vector<StandardSingleHostPool*> host_pools = {&host_pool};
+        StandardMultiHostPool multi_host_pool(host_pools, config);
+        StandardPestPool pest_pool{
+            dispersers, established_dispersers, outside_dispersers};
+        SpreadRateAction<StandardMultiHostPool, RasterIndex> spread_rate(
+            multi_host_pool,
+            config.rows,
+            config.cols,
+            config.ew_res,
+            config.ns_res,
+            config.use_spreadrates ? plan.spread_rate_schedule().num_actions() : 0);
+        const IntegerRaster& quarantine_areas =
+            quarantine_areas_ ? *quarantine_areas_ : zeros_;
+        const Network<RasterIndex>& network = network_ ? *network_ : null_network_;
+        QuarantineEscapeAction<IntegerRaster> quarantine = quarantine_;
+        std::vector<FloatRaster> no_rasters;
+        std::vector<std::vector<int>> no_movements;
+        for (unsigned step = first_step_; step < plan.num_steps(); ++step) {
+            if (config.weather) {
+                model.environment().update_weather_coefficient(
+                    weather_coefficients_->at(plan.weather_step(step)));
+            }
+            model.run_step(
+                step,
+                multi_host_pool,
+                pest_pool,
+                state.total_populations,
+                treatments,
+                temperatures_ ? *temperatures_ : no_rasters,
+                survival_rates_ ? *survival_rates_ : no_rasters,
+                spread_rate,
+                quarantine,
+                quarantine_areas,
+                no_movements,
+                network);
+        }
+        return std::make_pair(
+            static_cast<double>(sum_of_infected(state.infected, state.suitable_cells)),
+            area_of_infected(
+                state.infected, config.ew_res, config.ns_res, state.suitable_cells));
+    }
+
+    Config config_;
+    SimulationState<IntegerRaster> state_;
+    unsigned first_step_;
+    IntegerRaster zeros_;
+    Network<RasterIndex> null_network_;
+    QuarantineEscapeAction<IntegerRaster> quarantine_;
+    const std::vector<FloatRaster>* temperatures_{nullptr};
+    const std::vector<FloatRaster>* survival_rates_{nullptr};
+    const std::vector<FloatRaster>* weather_coefficients_{nullptr};
+    const IntegerRaster* quarantine_areas_{nullptr};
+    const Network<RasterIndex>* network_{nullptr};
+};
+
+}  // namespace pops
+
+#endif  // POPS_TREATMENT_SCENARIOS_HPP
@@ -28,6 +28,9 @@
 #include <string>
 #include <functional>
 #include <stdexcept>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
 
 // only temporarily for direct host pool creation
 #include <random>
@@ -95,14 +98,31 @@ public:
 /*!
  * Base treatment class.
  * Holds functions common between all treatment classes.
+ *
+ * The treatment map is stored only as a list of treated cells, i.e., cells with
+ * non-zero value, so a treatment takes memory and time proportional to the treated
+ * area, not to the whole raster.
  */
 template<typename HostPool, typename FloatRaster>
 class BaseTreatment : public AbstractTreatment<HostPool, FloatRaster>
 {
+public:
+    /** Type of values in the treatment map */
+    using Value = typename std::decay<decltype(std::declval<const FloatRaster&>()(
+        0, 0))>::type;
+
+    /** Treated cell with its value from the treatment map */
+    struct TreatedCell
+    {
+        int row;
+        int col;
+        Value value;
+    };
+
 protected:
     unsigned start_step_;
     unsigned end_step_;
-    FloatRaster map_;
+    std::vector<TreatedCell> cells_;  ///< Treated cells in row-major order
     TreatmentApplication application_;
 
 public:
@@ -110,11 +130,15 @@ public:
         const FloatRaster& map,
         unsigned start,
         TreatmentApplication treatment_application)
-        : start_step_(start),
-          end_step_(start),
-          map_(map),
-          application_(treatment_application)
-    {}
+        : start_step_(start), end_step_(start), application_(treatment_application)
+    {
+        for (int i = 0; i < map.rows(); i++) {
+            for (int j = 0; j < map.cols(); j++) {
+                if (map(i, j) != 0)
+                    cells_.push_back({i, j, map(i, j)});
+            }
+        }
+    }
     unsigned get_start() override
     {
         return start_step_;
@@ -124,6 +148,27 @@ public:
         return end_step_;
     }
 
+    /** Get treated cells with their values in row-major order */
+    const std::vector<TreatedCell>& treated_cells() const
+    {
+        return cells_;
+    }
+
+    /** Get value of the treatment map at a cell (zero if the cell is not treated) */
+    Value value_at(int i, int j) const
+    {
+        auto cell = std::lower_bound(
+            cells_.begin(),
+            cells_.end(),
+            std::make_pair(i, j),
+            [](const TreatedCell& cell, const std::pair<int, int>& index) {
+                return std::make_pair(cell.row, cell.col) < index;
+            });
+        if (cell != cells_.end() && cell->row == i && cell->col == j)
+            return cell->value;
+        return 0;
+    }
+
     // returning double allows identical results with the previous version
     int get_treated(int i, int j, int count)
     {
@@ -131,12 +176,19 @@ public:
     }
 
     int get_treated(int i, int j, int count, TreatmentApplication application)
+    {
+        return treated_count(value_at(i, j), count, application);
+    }
+
+    /** Get number of treated individuals for a given value of the treatment map */
+    static int
+    treated_count(Value value, int count, TreatmentApplication application)
     {
         if (application == TreatmentApplication::Ratio) {
-            return std::lround(count * this->map_(i, j));
+            return std::lround(count * value);
         }
         else if (application == TreatmentApplication::AllInfectedInCell) {
-            return static_cast<bool>(this->map_(i, j)) ? count : 0;
+            return static_cast<bool>(value) ? count : 0;
         }
         throw std::runtime_error(
             "BaseTreatment::get_treated: unknown TreatmentApplication");
@@ -152,6 +204,8 @@ template<typename HostPool, typename FloatRaster>
 class SimpleTreatment : public BaseTreatment<HostPool, FloatRaster>
 {
 public:
+    using Value = typename BaseTreatment<HostPool, FloatRaster>::Value;
+
     SimpleTreatment(
         const FloatRaster& map,
         unsigned start,
@@ -170,32 +224,9 @@ public:
     }
     void apply_treatment(HostPool& host_pool) override
     {
-        for (const auto& indices : host_pool.suitable_cells()) {
-            int i = indices[0];
-            int j = indices[1];
-            int remove_susceptible = this->get_treated(
-                i, j, host_pool.susceptible_at(i, j), TreatmentApplication::Ratio);
-            // Treated infected are computed as a sum of treated in mortality groups.
-            int remove_infected = 0;
-            std::vector<int> remove_mortality;
-            for (int count : host_pool.mortality_by_group_at(i, j)) {
-                int remove = this->get_treated(i, j, count);
-                remove_mortality.push_back(remove);
-                remove_infected += remove;
-            }
-            // Will need to use infected directly if not mortality.
-
-            std::vector<int> remove_exposed;
-            for (int count : host_pool.exposed_by_group_at(i, j)) {
-                remove_exposed.push_back(this->get_treated(i, j, count));
-            }
-            host_pool.completely_remove_hosts_at(
-                i,
-                j,
-                remove_susceptible,
-                remove_exposed,
-                remove_infected,
-                remove_mortality);
+        // Treatment in untreated cells would remove nothing.
+        for (const auto& cell : this->cells_) {
+            treat_cell(host_pool, cell.row, cell.col, cell.value);
         }
     }
     void end_treatment(HostPool& host_pool) override
@@ -203,6 +234,36 @@ public:
         UNUSED(host_pool);
         return;
     }
+
+protected:
+    /** Remove treated hosts in one cell */
+    void treat_cell(HostPool& host_pool, int i, int j, Value value)
+    {
+        auto application = this->application_;
+        int remove_susceptible = this->treated_count(
+            value, host_pool.susceptible_at(i, j), TreatmentApplication::Ratio);
+        // Treated infected are computed as a sum of treated in mortality groups.
+        // The counts are replaced by treated counts in place.
+        int remove_infected = 0;
+        std::vector<int> remove_mortality = host_pool.mortality_by_group_at(i, j);
+        for (int& count : remove_mortality) {
+            count = this->treated_count(value, count, application);
+            remove_infected += count;
+        }
+        // Will need to use infected directly if not mortality.
+
+        std::vector<int> remove_exposed = host_pool.exposed_by_group_at(i, j);
+        for (int& count : remove_exposed) {
+            count = this->treated_count(value, count, application);
+        }
+        host_pool.completely_remove_hosts_at(
+            i,
+            j,
+            remove_susceptible,
+            std::move(remove_exposed),
+            remove_infected,
+            remove_mortality);
+    }
 };
 
 /*!
@@ -215,6 +276,8 @@ template<typename HostPool, typename FloatRaster>
 class PesticideTreatment : public BaseTreatment<HostPool, FloatRaster>
 {
 public:
+    using Value = typename BaseTreatment<HostPool, FloatRaster>::Value;
+
     PesticideTreatment(
         const FloatRaster& map,
         unsigned start,
@@ -238,41 +301,47 @@ public:
     }
     void apply_treatment(HostPool& host_pool) override
     {
-        for (const auto& indices : host_pool.suitable_cells()) {
-            int i = indices[0];
-            int j = indices[1];
-            int susceptible_resistant = this->get_treated(
-                i, j, host_pool.susceptible_at(i, j), TreatmentApplication::Ratio);
-            std::vector<int> resistant_exposed_list;
-            for (const auto& number : host_pool.exposed_by_group_at(i, j)) {
-                resistant_exposed_list.push_back(this->get_treated(i, j, number));
-            }
-            int infected = 0;
-            std::vector<int> resistant_mortality_list;
-            for (const auto& number : host_pool.mortality_by_group_at(i, j)) {
-                int remove = this->get_treated(i, j, number);
-                resistant_mortality_list.push_back(remove);
-                infected += remove;
-            }
-            host_pool.make_resistant_at(
-                i,
-                j,
-                susceptible_resistant,
-                resistant_exposed_list,
-                infected,
-                resistant_mortality_list);
+        // Treatment in untreated cells would make nothing resistant.
+        for (const auto& cell : this->cells_) {
+            treat_cell(host_pool, cell.row, cell.col, cell.value);
         }
     }
     void end_treatment(HostPool& host_pool) override
     {
-        for (const auto& indices : host_pool.suitable_cells()) {
-            int i = indices[0];
-            int j = indices[1];
-            if (this->map_(i, j) > 0) {
-                host_pool.remove_resistance_at(i, j);
+        for (const auto& cell : this->cells_) {
+            if (cell.value > 0) {
+                host_pool.remove_resistance_at(cell.row, cell.col);
             }
         }
     }
+
+protected:
+    /** Make treated hosts in one cell resistant */
+    void treat_cell(HostPool& host_pool, int i, int j, Value value)
+    {
+        auto application = this->application_;
+        int susceptible_resistant = this->treated_count(
+            value, host_pool.susceptible_at(i, j), TreatmentApplication::Ratio);
+        // The counts are replaced by treated counts in place.
+        std::vector<int> resistant_exposed_list = host_pool.exposed_by_group_at(i, j);
+        for (int& number : resistant_exposed_list) {
+            number = this->treated_count(value, number, application);
+        }
+        int infected = 0;
+        std::vector<int> resistant_mortality_list =
+            host_pool.mortality_by_group_at(i, j);
+        for (int& number : resistant_mortality_list) {
+            number = this->treated_count(value, number, application);
+            infected += number;
+        }
+        host_pool.make_resistant_at(
+            i,
+            j,
+            susceptible_resistant,
+            resistant_exposed_list,
+            infected,
+            resistant_mortality_list);
+    }
 };
 
 /*!
@@ -291,11 +360,41 @@ template<typename HostPool, typename FloatRaster>
 class Treatments
 {
 private:
+    /**
+     * List of treatments starting or ending at a given step
+     *
+     * Each item is a (non-owning) pointer to the treatment and true if the treatment
+     * should be applied or false if the treatment should be ended.
+     */
+    using ScheduledTreatments =
+        std::vector<std::pair<AbstractTreatment<HostPool, FloatRaster>*, bool>>;
     std::vector<AbstractTreatment<HostPool, FloatRaster>*> treatments;
     Scheduler scheduler_;
+    /**
+     * Treatments starting or ending at each step
+     *
+     * The treatments are in the order in which they were added, so only the
+     * treatments active at a given step are visited and they are applied
+     * in the same order as when all treatments are checked.
+     */
+    std::vector<ScheduledTreatments> scheduled_;
+
+    /**
+     * Add treatment to the steps where it starts and ends
+     *
+     * Treatment which ends in the same step as it starts is only applied.
+     */
+    void schedule(AbstractTreatment<HostPool, FloatRaster>* treatment)
+    {
+        scheduled_[treatment->get_start()].emplace_back(treatment, true);
+        if (treatment->get_end() != treatment->get_start())
+            scheduled_[treatment->get_end()].emplace_back(treatment, false);
+    }
 
 public:
-    Treatments(const Scheduler& scheduler) : scheduler_(scheduler) {}
+    Treatments(const Scheduler& scheduler)
+        : scheduler_(scheduler), scheduled_(scheduler.get_num_steps())
+    {}
     ~Treatments()
     {
         for (auto item : treatments) {
@@ -333,6 +432,7 @@ public:
             treatments.push_back(new PesticideTreatment<HostPool, FloatRaster>(
                 map, start, end, treatment_application));
         }
+        schedule(treatments.back());
     }
     /*!
      * \brief Do management if needed.
@@ -340,25 +440,26 @@ public:
      * Decides internally whether any treatment needs to be
      * activated/deactivated.
      *
+     * Only treatments starting or ending at the current step are visited
+     * and only the treated cells are changed. The treatments themselves are not
+     * modified, so one object can be used for multiple host pools at the same time.
+     *
      * \param current simulation step
      * \param host_pool Host
      *
      * \return true if any management action was necessary
      */
-    bool manage(unsigned current, HostPool& host_pool)
+    bool manage(unsigned current, HostPool& host_pool) const
     {
-        bool changed = false;
-        for (unsigned i = 0; i < treatments.size(); i++) {
-            if (treatments[i]->should_start(current)) {
-                treatments[i]->apply_treatment(host_pool);
-                changed = true;
-            }
-            else if (treatments[i]->should_end(current)) {
-                treatments[i]->end_treatment(host_pool);
-                changed = true;
-            }
+        if (current >= scheduled_.size())
+            return false;
+        for (const auto& item : scheduled_[current]) {
+            if (item.second)
+                item.first->apply_treatment(host_pool);
+            else
+                item.first->end_treatment(host_pool);
         }
-        return changed;
+        return !scheduled_[current].empty();
     }
     /*!
      * \brief Used to remove treatments after certain step.
@@ -376,6 +477,10 @@ public:
         treatments.erase(
             std::remove(treatments.begin(), treatments.end(), nullptr),
             treatments.end());
+        for (auto& scheduled : scheduled_)
+            scheduled.clear();
+        for (auto treatment : treatments)
+            schedule(treatment);
     }
 };
 
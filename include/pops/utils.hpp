@@ -48,8 +48,10 @@
 
 #include <algorithm>
 #include <array>
+#include <cmath>
 #include <vector>
 #include <map>
+#include <random>
 
 /**
  * Return true if _container_ contains _value_.
@@ -155,6 +157,82 @@ std::vector<int> draw_n_from_cohorts(
     return cohort_counts;
 }
 
+/** Logarithm of factorial of *n*.
+ *
+ *  Uses Stirling series for larger values. Not using std::lgamma which is not
+ *  thread-safe with some C libraries.
+ */
+inline double log_factorial(int n)
+{
+    if (n < 16) {
+        double value = 0;
+        for (int i = 2; i <= n; ++i)
+            value += std::log(double(i));
+        return value;
+    }
+    const double pi = std::acos(-1.0);
+    double x = n;
+    double x2 = x * x;
+    return x * std::log(x) - x + 0.5 * std::log(2 * pi * x)
+           + 1 / (12 * x) * (1 - 1 / (30 * x2) * (1 - 2 / (7 * x2)));
+}
+
+/** Draws number of successes when drawing without replacement.
+ *
+ *  Draws from the hypergeometric distribution, i.e., gives the number of successes
+ *  in *draws* items drawn without replacement from *total* items out of which
+ *  *successes* items are successes. The value is found by inversion of the
+ *  cumulative distribution starting at the mode and alternating between values
+ *  below and above it, so the probabilities do not underflow for large counts and
+ *  the time is proportional to the standard deviation.
+ */
+template<typename Generator>
+int draw_hypergeometric(int total, int successes, int draws, Generator& generator)
+{
+    int failures = total - successes;
+    int low = std::max(0, draws - failures);
+    int high = std::min(draws, successes);
+    if (low >= high)
+        return high;
+    auto log_choose = [](int n, int k) {
+        return log_factorial(n) - log_factorial(k) - log_factorial(n - k);
+    };
+    int mode = static_cast<int>(
+        (double(draws) + 1) * (double(successes) + 1) / (double(total) + 2));
+    mode = std::min(std::max(mode, low), high);
+    double mode_probability = std::exp(
+        log_choose(successes, mode) + log_choose(failures, draws - mode)
+        - log_choose(total, draws));
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    double remaining = distribution(generator) - mode_probability;
+    if (remaining < 0)
+        return mode;
+    int lower = mode;
+    int upper = mode;
+    double lower_probability = mode_probability;
+    double upper_probability = mode_probability;
+    while (lower > low || upper < high) {
+        if (lower > low) {
+            lower_probability *= double(lower) * (failures - draws + lower)
+                                 / ((successes - lower + 1.0) * (draws - lower + 1.0));
+            --lower;
+            remaining -= lower_probability;
+            if (remaining < 0)
+                return lower;
+        }
+        if (upper < high) {
+            upper_probability *= double(successes - upper) * (draws - upper)
+                                 / ((upper + 1.0) * (failures - draws + upper + 1.0));
+            ++upper;
+            remaining -= upper_probability;
+            if (remaining < 0)
+                return upper;
+        }
+    }
+    // Only rounding errors remain, so the mode is the most likely value.
+    return mode;
+}
+
 /**
  * \brief A const iterator which encapsulates either forward or reverse iterator.
  *
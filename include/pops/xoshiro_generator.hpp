@@ -0,0 +1,138 @@
+/*
+ * PoPS model - xoshiro random number generator
+ *
+ * Copyright (C) 2023 by the authors.
+ *
+ * Authors: Vaclav Petras <wenzeslaus gmail com>
+ *
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef POPS_XOSHIRO_GENERATOR_HPP
+#define POPS_XOSHIRO_GENERATOR_HPP
+
+#include <array>
+#include <cstdint>
+
+namespace pops {
+
+/**
+ * Get next value of SplitMix64 sequence and advance the state
+ *
+ * Used to expand one seed into the state of a xoshiro generator as recommended by
+ * the authors of xoshiro.
+ */
+inline std::uint64_t splitmix64_next(std::uint64_t& state)
+{
+    std::uint64_t value = (state += 0x9E3779B97F4A7C15ull);
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+/** Rotate 64-bit value left */
+inline std::uint64_t rotate_left(std::uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+/**
+ * Random number generator xoshiro256++
+ *
+ * Fast generator with 256 bits of state and 64-bit output by Blackman and Vigna
+ * (2021) Scrambled linear pseudorandom number generators. It is faster and has
+ * better statistical properties than std::default_random_engine (minstd) and a
+ * much smaller state than std::mt19937.
+ *
+ * Satisfies UniformRandomBitGenerator and it can be seeded with one number as the
+ * standard engines, so it can be used as the Generator in
+ * RandomNumberGeneratorProvider and Model.
+ */
+class Xoshiro256PlusPlus
+{
+public:
+    using result_type = std::uint64_t;
+    using State = std::array<std::uint64_t, 4>;
+
+    static constexpr result_type min()
+    {
+        return 0;
+    }
+
+    static constexpr result_type max()
+    {
+        return ~result_type(0);
+    }
+
+    /** Create generator with seed zero */
+    Xoshiro256PlusPlus()
+    {
+        seed(0);
+    }
+
+    /** Create generator with a given seed */
+    explicit Xoshiro256PlusPlus(unsigned seed)
+    {
+        this->seed(seed);
+    }
+
+    /** Create generator with a given state (which cannot be all zeros) */
+    explicit Xoshiro256PlusPlus(const State& state) : state_(state) {}
+
+    /** Set the state using SplitMix64 sequence started from the seed */
+    void seed(unsigned seed)
+    {
+        std::uint64_t sequence = seed;
+        for (auto& word : state_)
+            word = splitmix64_next(sequence);
+    }
+
+    /** Get the current state */
+    const State& state() const
+    {
+        return state_;
+    }
+
+    /** Get the next random number */
+    result_type operator()()
+    {
+        std::uint64_t result = rotate_left(state_[0] + state_[3], 23) + state_[0];
+        std::uint64_t shifted = state_[1] << 17;
+        state_[2] ^= state_[0];
+        state_[3] ^= state_[1];
+        state_[1] ^= state_[2];
+        state_[0] ^= state_[3];
+        state_[2] ^= shifted;
+        state_[3] = rotate_left(state_[3], 45);
+        return result;
+    }
+
+    /** Skip the given number of random numbers */
+    void discard(unsigned long long n)
+    {
+        for (unsigned long long i = 0; i < n; ++i)
+            this->operator()();
+    }
+
+    bool operator==(const Xoshiro256PlusPlus& other) const
+    {
+        return state_ == other.state_;
+    }
+
+    bool operator!=(const Xoshiro256PlusPlus& other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    State state_;
+};
+
+}  // namespace pops
+
+#endif  // POPS_XOSHIRO_GENERATOR_HPP
@@ -0,0 +1,226 @@
+#ifdef POPS_TEST
+
+/*
+ * Tests for the PoPS counter-based random number generator and provider.
+ *
+ * Copyright (C) 2023 by the authors.
+ *
+ * Authors: Vaclav Petras <wenzeslaus gmail com>
+ *
+ * This file is part of PoPS.
+
+ * PoPS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+
+ * PoPS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PoPS. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <pops/counter_based_generator.hpp>
+#include <pops/generator_provider.hpp>
+
+using namespace pops;
+using std::cout;
+
+/**
+ * Compare with known answers of the reference implementation (Random123)
+ */
+int test_philox_known_answers()
+{
+    int ret = 0;
+    struct KnownAnswer
+    {
+        Philox4x32::Counter counter;
+        Philox4x32::Key key;
+        Philox4x32::Counter expected;
+    };
+    std::vector<KnownAnswer> answers = {
+        {{0, 0, 0, 0}, {0, 0}, {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}},
+        {{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+         {0xffffffff, 0xffffffff},
+         {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}},
+        {{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344},
+         {0xa4093822, 0x299f31d0},
+         {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}}};
+    for (const auto& answer : answers) {
+        auto result = Philox4x32::block(answer.counter, answer.key);
+        Philox4x32 generator(answer.key, answer.counter);
+        for (std::size_t i = 0; i < 4; ++i) {
+            auto value = generator();
+            if (result[i] != answer.expected[i] || value != answer.expected[i]) {
+                cout << "philox_known_answers: Value " << i << " is " << std::hex
+                     << result[i] << " (block) and " << value << " (generator), not "
+                     << answer.expected[i] << std::dec << "\n";
+                ++ret;
+            }
+        }
+    }
+    return ret;
+}
+
+int test_philox_discard()
+{
+    int ret = 0;
+    for (unsigned long long skip : {0ull, 1ull, 3ull, 4ull, 5ull, 11ull, 100ull}) {
+        Philox4x32 generator1(7);
+        Philox4x32 generator2(7);
+        generator1();
+        generator2();
+        for (unsigned long long i = 0; i < skip; ++i)
+            generator1();
+        generator2.discard(skip);
+        for (int i = 0; i < 9; ++i) {
+            if (generator1() != generator2()) {
+                cout << "philox_discard: Different values after discarding " << skip
+                     << " values\n";
+                ++ret;
+                break;
+            }
+        }
+    }
+    return ret;
+}
+
+int test_philox_uniform()
+{
+    int ret = 0;
+    Philox4x32 generator(42);
+    std::uniform_real_distribution<double> distribution(0, 1);
+    int count = 100000;
+    double sum = 0;
+    for (int i = 0; i < count; ++i)
+        sum += distribution(generator);
+    double mean = sum / count;
+    if (mean < 0.49 || mean > 0.51) {
+        cout << "philox_uniform: Mean of uniform values is " << mean << "\n";
+        ++ret;
+    }
+    // Works as generator of the standard provider.
+    RandomNumberGeneratorProvider<Philox4x32> provider(42, true);
+    if (provider.weather()() == provider.establishment()()) {
+        cout << "philox_uniform: Same values for different purposes\n";
+        ++ret;
+    }
+    return ret;
+}
+
+/** Draw a few numbers from each purpose */
+std::vector<unsigned> draw_from_streams(CounterBasedGeneratorProvider& generator)
+{
+    std::vector<unsigned> values;
+    for (int i = 0; i < 3; ++i) {
+        values.push_back(generator.disperser_generation()());
+        values.push_back(generator.natural_dispersal()());
+        values.push_back(generator.establishment()());
+        values.push_back(generator.soil()());
+    }
+    return values;
+}
+
+int test_streams_independent_of_order()
+{
+    int ret = 0;
+    CounterBasedGeneratorProvider generator1(42);
+    CounterBasedGeneratorProvider generator2(42);
+    generator1.select_stream(3, 10);
+    auto expected = draw_from_streams(generator1);
+    // Other streams are used before the stream is selected.
+    generator2.select_stream(3, 9);
+    draw_from_streams(generator2);
+    generator2.select_stream(2, 10);
+    draw_from_streams(generator2);
+    generator2.select_stream(3, 10);
+    if (draw_from_streams(generator2) != expected) {
+        cout << "streams_independent_of_order: Values differ for the same stream\n";
+        ++ret;
+    }
+    generator2.select_stream(3, 11);
+    if (draw_from_streams(generator2) == expected) {
+        cout << "streams_independent_of_order: Same values for other cell\n";
+        ++ret;
+    }
+    generator2.select_stream(4, 10);
+    if (draw_from_streams(generator2) == expected) {
+        cout << "streams_independent_of_order: Same values for other step\n";
+        ++ret;
+    }
+    CounterBasedGeneratorProvider generator3(42, true, 1);
+    generator3.select_stream(3, 10);
+    if (draw_from_streams(generator3) == expected) {
+        cout << "streams_independent_of_order: Same values for other replicate\n";
+        ++ret;
+    }
+    generator3.set_replicate(0);
+    generator3.select_stream(3, 10);
+    if (draw_from_streams(generator3) != expected) {
+        cout << "streams_independent_of_order: Replicate not reset\n";
+        ++ret;
+    }
+    if (expected[0] == expected[1] || expected[1] == expected[2]) {
+        cout << "streams_independent_of_order: Same values for other purpose\n";
+        ++ret;
+    }
+    return ret;
+}
+
+int test_single_stream()
+{
+    int ret = 0;
+    CounterBasedGeneratorProvider generator1(42, false);
+    CounterBasedGeneratorProvider generator2(42, false);
+    generator1.select_stream(1, 2);
+    generator2.select_stream(1, 2);
+    // All purposes and the provider itself use the same generator.
+    std::vector<unsigned> values1 = {
+        generator1.weather()(), generator1.soil()(), generator1()};
+    std::vector<unsigned> values2 = {generator2(), generator2(), generator2()};
+    if (values1 != values2) {
+        cout << "single_stream: Purposes don't share the same stream\n";
+        ++ret;
+    }
+    CounterBasedGeneratorProvider multiple(42);
+    try {
+        multiple();
+        cout << "single_stream: No exception for multiple streams\n";
+        ++ret;
+    }
+    catch (const std::runtime_error&) {
+    }
+    try {
+        multiple.select_stream(0, 1ull << 40);
+        cout << "single_stream: No exception for too large stream number\n";
+        ++ret;
+    }
+    catch (const std::out_of_range&) {
+    }
+    return ret;
+}
+
+int main()
+{
+    int ret = 0;
+
+    ret += test_philox_known_answers();
+    ret += test_philox_discard();
+    ret += test_philox_uniform();
+    ret += test_streams_independent_of_order();
+    ret += test_single_stream();
+
+    std::cout << "Test counter-based generator number of errors: " << ret
+              << std::endl;
+    return ret;
+}
+
+#endif  // POPS_TEST
@@ -173,6 +173,37 @@ int test_to_string()
     return num_errors;
 }
 
+int test_day_number()
+{
+    int num_errors = 0;
+    if (Date(1970, 1, 1).day_number() != 0) {
+        num_errors++;
+        cout << "Day number of 1970-01-01: " << Date(1970, 1, 1).day_number() << endl;
+    }
+    if (Date(2000, 3, 1).day_number() - Date(2000, 2, 28).day_number() != 2) {
+        num_errors++;
+        cout << "Day number does not count leap day in 2000" << endl;
+    }
+    if (Date(1900, 3, 1).day_number() - Date(1900, 2, 28).day_number() != 1) {
+        num_errors++;
+        cout << "Day number counts leap day in 1900" << endl;
+    }
+    // Day numbers need to agree with adding days one by one.
+    Date d("1899-12-25");
+    int expected = d.day_number();
+    for (int i = 0; i < 3 * 365; i++) {
+        d.add_days(37);
+        expected += 37;
+        if (d.day_number() != expected || Date::from_day_number(expected) != d) {
+            num_errors++;
+            cout << "Wrong day number for " << d << ": " << d.day_number()
+                 << " (expected " << expected << ")" << endl;
+            break;
+        }
+    }
+    return num_errors;
+}
+
 int main()
 {
     int num_errors = 0;
@@ -183,6 +214,7 @@ int main()
     num_errors += test_add_days();
     num_errors += test_subtract_days();
     num_errors += test_to_string();
+    num_errors += test_day_number();
     cout << "Test Date class: number of errors: " << num_errors << endl;
 
     return 0;
@@ -24,6 +24,7 @@
  */
 
 #include <pops/deterministic_kernel.hpp>
+#include <pops/kernel.hpp>
 #include <pops/cauchy_kernel.hpp>
 #include <pops/exponential_kernel.hpp>
 #include <pops/exponential_power_kernel.hpp>
@@ -1079,6 +1080,116 @@ int test_log_normal_distribution_functions()
     return 1;
 }
 
+/**
+ * Test that kernels created repeatedly (e.g., in each step) reuse the storage
+ */
+int test_kernel_storage_reuse()
+{
+    int ret = 0;
+    Raster<int> dispersers = {{5, 0, 0}, {0, 5, 0}, {0, 0, 2}};
+    std::default_random_engine generator(42);
+    RasterBufferPool& pool = RasterBufferPool::default_pool();
+    std::size_t allocated = 0;
+    for (int step = 0; step < 3; ++step) {
+        DeterministicDispersalKernel<Raster<int>> kernel(
+            DispersalKernelType::Cauchy, dispersers, 0.9, 30, 30, 1);
+        kernel(generator, 1, 1);
+        if (step == 0)
+            allocated = pool.allocated_buffers();
+    }
+    if (pool.allocated_buffers() != allocated) {
+        cout << "Deterministic kernel storage not reused: " << allocated
+             << " buffers allocated in the first step, "
+             << pool.allocated_buffers() << " after three steps\n";
+        ++ret;
+    }
+    return ret;
+}
+
+int test_kernels_share_window()
+{
+    int ret = 0;
+    Raster<int> dispersers = {{5, 0, 0}, {0, 5, 0}, {0, 0, 2}};
+    std::default_random_engine generator(42);
+    // Both kernels exist at the same time as when each thread has its own kernel.
+    DeterministicDispersalKernel<Raster<int>> first(
+        DispersalKernelType::Exponential, dispersers, 0.99, 30, 30, 10);
+    DeterministicDispersalKernel<Raster<int>> second(
+        DispersalKernelType::Exponential,
+        dispersers,
+        0.99,
+        30,
+        30,
+        10,
+        1.0,
+        first.probability_window());
+    if (second.probability_window() != first.probability_window()) {
+        cout << "Kernel does not use the window passed to it\n";
+        ++ret;
+    }
+    std::vector<std::tuple<int, int>> first_cells;
+    for (int i = 0; i < 5; ++i)
+        first_cells.push_back(first(generator, 1, 1));
+    for (int i = 0; i < 5; ++i) {
+        auto cell = second(generator, 1, 1);
+        if (cell != first_cells[i]) {
+            cout << "Kernels with shared window differ in dispersal " << i
+                 << ": (" << std::get<0>(cell) << ", " << std::get<1>(cell)
+                 << ") versus (" << std::get<0>(first_cells[i]) << ", "
+                 << std::get<1>(first_cells[i]) << ")\n";
+            ++ret;
+        }
+    }
+    try {
+        DeterministicDispersalKernel<Raster<int>> other(
+            DispersalKernelType::Exponential,
+            dispersers,
+            0.99,
+            30,
+            30,
+            20,
+            1.0,
+            first.probability_window());
+        cout << "Kernel accepted window of a different size\n";
+        ++ret;
+    }
+    catch (const std::invalid_argument&) {
+    }
+    return ret;
+}
+
+int test_deterministic_windows_from_config()
+{
+    int ret = 0;
+    Raster<int> dispersers = {{5, 0, 0}, {0, 5, 0}, {0, 0, 2}};
+    Config config;
+    config.dispersal_stochasticity = false;
+    config.dispersal_percentage = 0.99;
+    config.ew_res = 30;
+    config.ns_res = 30;
+    config.natural_kernel_type = "exponential";
+    config.natural_scale = 10;
+    config.anthro_kernel_type = "network";
+    auto windows = create_deterministic_windows(config, dispersers);
+    if (!windows.natural || windows.anthro) {
+        cout << "Windows from config: Expected only natural window\n";
+        ++ret;
+    }
+    DeterministicDispersalKernel<Raster<int>> kernel(
+        DispersalKernelType::Exponential, dispersers, 0.99, 30, 30, 10);
+    if (windows.natural && *windows.natural != *kernel.probability_window()) {
+        cout << "Windows from config: Natural window differs from kernel window\n";
+        ++ret;
+    }
+    config.dispersal_stochasticity = true;
+    windows = create_deterministic_windows(config, dispersers);
+    if (windows.natural) {
+        cout << "Windows from config: Window created for stochastic kernel\n";
+        ++ret;
+    }
+    return ret;
+}
+
 int main()
 {
     int ret = 0;
@@ -1095,6 +1206,9 @@ int main()
     ret += test_with_logistic_deterministic_kernel();
     ret += test_with_gamma_deterministic_kernel();
     ret += test_with_exponential_power_deterministic_kernel();
+    ret += test_kernel_storage_reuse();
+    ret += test_kernels_share_window();
+    ret += test_deterministic_windows_from_config();
     // ret += test_gamma_distribution_functions();
     // ret += test_exponential_power_distribution_functions();
     // ret += test_log_normal_distribution_functions();
@@ -21,6 +21,7 @@
  * along with PoPS. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <cstdint>
 #include <random>
 
 #include <pops/generator_provider.hpp>
@@ -203,6 +204,93 @@ int test_multiple_generator_results_same()
     return ret;
 }
 
+/**
+ * Check that re-seeded provider gives the same results as a new provider.
+ */
+int test_reseeded_generator_results_same()
+{
+    int ret = 0;
+    RandomNumberGeneratorProvider<std::default_random_engine> generator1(3, true);
+    std::uniform_int_distribution<int> distribution(1, 1000);
+    for (int i = 0; i < 5; ++i) {
+        distribution(generator1.establishment());
+        distribution(generator1.natural_dispersal());
+    }
+    generator1.seed(42);
+    RandomNumberGeneratorProvider<std::default_random_engine> generator2(42, true);
+    for (int i = 0; i < 10; ++i) {
+        ret += assert_pair_equals(
+            "test_reseeded_generator_results_same",
+            i,
+            distribution(generator1.establishment()),
+            distribution(generator2.establishment()),
+            "establishment 1",
+            "establishment 2");
+        ret += assert_pair_equals(
+            "test_reseeded_generator_results_same",
+            i,
+            distribution(generator1.soil()),
+            distribution(generator2.soil()),
+            "soil 1",
+            "soil 2");
+    }
+    return ret;
+}
+
+/**
+ * Check that re-seeding for purposes changes only the given generators and uses
+ * all bits of the seed.
+ */
+int test_seed_purposes()
+{
+    int ret = 0;
+    using Provider = RandomNumberGeneratorProvider<std::mt19937>;
+    std::uniform_int_distribution<int> distribution(1, 1000000);
+    Provider generator1(3, true);
+    Provider generator2(3, true);
+    std::uint64_t low = 42;
+    std::uint64_t high = low | (std::uint64_t(1) << 40);
+    generator1.seed_purposes(low, {GeneratorPurpose::Establishment});
+    generator2.seed_purposes(low, {GeneratorPurpose::Establishment});
+    ret += assert_pair_equals(
+        "test_seed_purposes",
+        1,
+        distribution(generator1.establishment()),
+        distribution(generator2.establishment()),
+        "establishment 1",
+        "establishment 2");
+    // Generator not selected keeps its state.
+    Provider original(3, true);
+    ret += assert_pair_equals(
+        "test_seed_purposes",
+        2,
+        distribution(generator1.soil()),
+        distribution(original.soil()),
+        "soil",
+        "original soil");
+    // Seeds differing only in the upper 32 bits give different streams.
+    generator2.seed_purposes(high, {GeneratorPurpose::Establishment});
+    generator1.seed_purposes(low, {GeneratorPurpose::Establishment});
+    ret += assert_pair_not_equals(
+        "test_seed_purposes",
+        3,
+        distribution(generator1.establishment()),
+        distribution(generator2.establishment()),
+        "low seed",
+        "high seed");
+    // Different purposes give different streams from the same seed.
+    generator1.seed_purposes(
+        low, {GeneratorPurpose::NaturalDispersal, GeneratorPurpose::Soil});
+    ret += assert_pair_not_equals(
+        "test_seed_purposes",
+        4,
+        distribution(generator1.natural_dispersal()),
+        distribution(generator1.soil()),
+        "natural dispersal",
+        "soil");
+    return ret;
+}
+
 /**
  * Check that accessing different generators gives the same result as accesing
  * a single one when the seed is the same when one is used differently.
@@ -454,6 +542,8 @@ int run_tests()
     ret += test_single_generator_results_same();
     ret += test_multiple_generator_results_same();
     ret += test_multiple_generator_results_independent();
+    ret += test_reseeded_generator_results_same();
+    ret += test_seed_purposes();
     ret += test_multiple_seeds();
     ret += test_seed_config_parameter_style();
     ret += test_seed_config_yaml_style();
@@ -0,0 +1,239 @@
+#ifdef POPS_TEST
+
+/*
+ * Tests for the PoPS HostPool class with different count types.
+ *
+ * Copyright (C) 2023 by the authors.
+ *
+ * Authors: Vaclav Petras <wenzeslaus gmail com>
+ *
+ * This file is part of PoPS.
+
+ * PoPS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+
+ * PoPS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PoPS. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include <pops/model.hpp>
+#include <pops/raster.hpp>
+
+using namespace pops;
+using std::cout;
+
+/**
+ * Run SEI model with mortality and treatments and return infected as int raster
+ */
+template<typename Count>
+Raster<int> run_model_with_count_type()
+{
+    using IntegerRaster = Raster<Count>;
+    int size = 7;
+    IntegerRaster infected(size, size, 0);
+    infected(3, 3) = 15;
+    IntegerRaster susceptible(size, size, 40);
+    IntegerRaster total_hosts = susceptible + infected;
+    IntegerRaster total_populations = total_hosts;
+    IntegerRaster zeros(size, size, 0);
+    IntegerRaster dispersers(size, size);
+    IntegerRaster established_dispersers(size, size);
+    std::vector<std::tuple<int, int>> outside_dispersers;
+    std::vector<std::vector<int>> suitable_cells;
+    for (int row = 0; row < size; ++row)
+        for (int col = 0; col < size; ++col)
+            suitable_cells.push_back({row, col});
+
+    Config config;
+    config.random_seed = 42;
+    config.reproductive_rate = 1.5;
+    config.natural_kernel_type = "cauchy";
+    config.natural_direction = "none";
+    config.natural_scale = 10;
+    config.anthro_scale = 10;
+    config.use_anthropogenic_kernel = false;
+    config.rows = size;
+    config.cols = size;
+    config.ew_res = 10;
+    config.ns_res = 10;
+    config.model_type = "SEI";
+    config.latency_period_steps = 1;
+    config.set_date_start(2020, 1, 1);
+    config.set_date_end(2020, 12, 31);
+    config.set_step_unit(StepUnit::Month);
+    config.set_step_num_units(1);
+    config.use_mortality = true;
+    config.mortality_frequency = "month";
+    config.mortality_frequency_n = 3;
+    config.use_treatments = true;
+    config.use_spreadrates = false;
+    config.create_schedules();
+
+    using TestModel = Model<IntegerRaster, Raster<double>, int>;
+    TestModel model{config};
+
+    std::vector<IntegerRaster> mortality_tracker(3, IntegerRaster(size, size, 0));
+    IntegerRaster died(size, size, 0);
+    IntegerRaster total_exposed(size, size, 0);
+    IntegerRaster resistant(size, size, 0);
+    std::vector<IntegerRaster> exposed(
+        config.latency_period_steps + 1, IntegerRaster(size, size, 0));
+    std::vector<Raster<double>> empty_floats;
+    std::vector<std::vector<int>> movements;
+
+    typename TestModel::StandardSingleHostPool host_pool(
+        config,
+        susceptible,
+        exposed,
+        infected,
+        total_exposed,
+        resistant,
+        mortality_tracker,
+        died,
+        total_hosts,
+        model.environment(),
+        suitable_cells);
+    std::vector<typename TestModel::StandardSingleHostPool*> host_pools = {
+        &host_pool};
+    typename TestModel::StandardMultiHostPool multi_host_pool(host_pools, config);
+    PestHostTable<typename TestModel::StandardSingleHostPool> pest_host_table(
+        model.environment());
+    pest_host_table.add_host_info(1, 0.5, 1);
+    multi_host_pool.set_pest_host_table(pest_host_table);
+    typename TestModel::StandardPestPool pest_pool{
+        dispersers, established_dispersers, outside_dispersers};
+    SpreadRateAction<typename TestModel::StandardMultiHostPool, int> spread_rate(
+        multi_host_pool, size, size, config.ew_res, config.ns_res, 0);
+    QuarantineEscapeAction<IntegerRaster> quarantine(
+        zeros, config.ew_res, config.ns_res, 0);
+    Treatments<typename TestModel::StandardSingleHostPool, Raster<double>> treatments(
+        config.scheduler());
+    Raster<double> treatment(size, size, 0);
+    treatment(3, 4) = 1;
+    treatments.add_treatment(
+        treatment, Date(2020, 5, 1), 0, TreatmentApplication::AllInfectedInCell);
+
+    for (unsigned step = 0; step < config.scheduler().get_num_steps(); ++step) {
+        model.run_step(
+            step,
+            multi_host_pool,
+            pest_pool,
+            total_populations,
+            treatments,
+            empty_floats,
+            empty_floats,
+            spread_rate,
+            quarantine,
+            zeros,
+            movements,
+            Network<int>::null_network());
+    }
+    Raster<int> result(size, size);
+    for (int row = 0; row < size; ++row)
+        for (int col = 0; col < size; ++col)
+            result(row, col) = infected(row, col);
+    return result;
+}
+
+int test_compact_count_types()
+{
+    int ret = 0;
+    auto expected = run_model_with_count_type<int>();
+    auto with_int16 = run_model_with_count_type<std::int16_t>();
+    if (with_int16 != expected) {
+        cout << "compact_count_types: int16 (actual, expected):\n"
+             << with_int16 << "  !=\n"
+             << expected << "\n";
+        ++ret;
+    }
+    auto with_uint16 = run_model_with_count_type<std::uint16_t>();
+    if (with_uint16 != expected) {
+        cout << "compact_count_types: uint16 (actual, expected):\n"
+             << with_uint16 << "  !=\n"
+             << expected << "\n";
+        ++ret;
+    }
+    return ret;
+}
+
+int test_count_overflow()
+{
+    int ret = 0;
+    using IntegerRaster = Raster<std::uint16_t>;
+    using TestModel = Model<IntegerRaster, Raster<double>, int>;
+    IntegerRaster infected = {{65530, 10}, {0, 0}};
+    IntegerRaster susceptible = {{5, 65530}, {10, 10}};
+    IntegerRaster total_hosts = {{65535, 65535}, {10, 10}};
+    IntegerRaster zeros(2, 2, 0);
+    IntegerRaster resistant(2, 2, 0);
+    IntegerRaster died(2, 2, 0);
+    std::vector<IntegerRaster> exposed;
+    std::vector<IntegerRaster> mortality_tracker;
+    std::vector<std::vector<int>> suitable_cells = {{0, 0}, {0, 1}, {1, 0}, {1, 1}};
+    Config config;
+    config.model_type = "SI";
+    config.rows = 2;
+    config.cols = 2;
+    config.use_mortality = false;
+    TestModel model{config};
+    TestModel::StandardSingleHostPool host_pool(
+        config,
+        susceptible,
+        exposed,
+        infected,
+        zeros,
+        resistant,
+        mortality_tracker,
+        died,
+        total_hosts,
+        model.environment(),
+        suitable_cells);
+    std::default_random_engine generator(42);
+
+    host_pool.pests_to(0, 0, 5, generator);
+    if (infected(0, 0) != 65535 || susceptible(0, 0) != 0) {
+        cout << "count_overflow: Counts at maximum are wrong: " << infected(0, 0)
+             << " " << susceptible(0, 0) << "\n";
+        ++ret;
+    }
+    try {
+        host_pool.pests_from(0, 1, 10, generator);
+        cout << "count_overflow: Overflow of susceptible was not detected\n";
+        ++ret;
+    }
+    catch (const std::overflow_error&) {
+    }
+    try {
+        host_pool.pests_from(1, 1, 1, generator);
+        cout << "count_overflow: Negative unsigned count was not detected\n";
+        ++ret;
+    }
+    catch (const std::overflow_error&) {
+    }
+    return ret;
+}
+
+int main()
+{
+    int ret = 0;
+
+    ret += test_compact_count_types();
+    ret += test_count_overflow();
+
+    std::cout << "Test host pool number of errors: " << ret << std::endl;
+    return ret;
+}
+
+#endif  // POPS_TEST
@@ -0,0 +1,522 @@
+#ifdef POPS_TEST
+
+/*
+ * Tests for incremental tracking of infected cells.
+ *
+ * Copyright (C) 2023 by the authors.
+ *
+ * Authors: Vaclav Petras <wenzeslaus gmail com>
+ *
+ * This file is part of PoPS.
+
+ * PoPS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+
+ * PoPS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PoPS. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include <pops/infection_tracker.hpp>
+#include <pops/model.hpp>
+#include <pops/quarantine.hpp>
+#include <pops/raster.hpp>
+#include <pops/spread_rate.hpp>
+
+using namespace pops;
+using std::cout;
+
+/**
+ * Get bbox of infected cells by going over the whole raster
+ */
+BBoxInt scan_boundary(const Raster<int>& infected)
+{
+    int n = infected.rows();
+    int s = -1;
+    int e = -1;
+    int w = infected.cols();
+    for (int i = 0; i < infected.rows(); ++i) {
+        for (int j = 0; j < infected.cols(); ++j) {
+            if (infected(i, j) > 0) {
+                n = std::min(n, i);
+                s = std::max(s, i);
+                e = std::max(e, j);
+                w = std::min(w, j);
+            }
+        }
+    }
+    if (s < 0)
+        return std::make_tuple(-1, -1, -1, -1);
+    return std::make_tuple(n, s, e, w);
+}
+
+std::ostream& operator<<(std::ostream& os, const BBoxInt& bbox)
+{
+    os << std::get<0>(bbox) << ", " << std::get<1>(bbox) << ", " << std::get<2>(bbox)
+       << ", " << std::get<3>(bbox);
+    return os;
+}
+
+/**
+ * Compare rates treating NaNs as equal
+ */
+bool same_rates(const BBoxFloat& a, const BBoxFloat& b)
+{
+    auto same = [](double x, double y) {
+        return (std::isnan(x) && std::isnan(y)) || x == y;
+    };
+    return same(std::get<0>(a), std::get<0>(b)) && same(std::get<1>(a), std::get<1>(b))
+           && same(std::get<2>(a), std::get<2>(b))
+           && same(std::get<3>(a), std::get<3>(b));
+}
+
+int test_extent_tracker()
+{
+    int ret = 0;
+    InfectionExtentTracker<int> tracker(5, 4);
+    if (!tracker.empty() || tracker.boundary() != std::make_tuple(-1, -1, -1, -1)) {
+        cout << "extent_tracker: New tracker is not empty: " << tracker.boundary()
+             << "\n";
+        ++ret;
+    }
+    tracker.infection_changed(1, 2, true);
+    tracker.infection_changed(3, 0, true);
+    tracker.infection_changed(3, 1, true);
+    BBoxInt expected = std::make_tuple(1, 3, 2, 0);
+    if (tracker.boundary() != expected) {
+        cout << "extent_tracker: Wrong boundary (actual, expected): "
+             << tracker.boundary() << " != " << expected << "\n";
+        ++ret;
+    }
+    tracker.infection_changed(3, 0, false);
+    expected = std::make_tuple(1, 3, 2, 1);
+    if (tracker.boundary() != expected) {
+        cout << "extent_tracker: Wrong boundary after removal (actual, expected): "
+             << tracker.boundary() << " != " << expected << "\n";
+        ++ret;
+    }
+    tracker.infection_changed(1, 2, false);
+    tracker.infection_changed(3, 1, false);
+    if (!tracker.empty()) {
+        cout << "extent_tracker: Tracker is not empty after all removals\n";
+        ++ret;
+    }
+    return ret;
+}
+
+int test_host_pool_notifications()
+{
+    int ret = 0;
+    Raster<int> infected = {{0, 0, 0}, {0, 2, 0}, {0, 0, 0}};
+    Raster<int> susceptible = {{10, 10, 10}, {10, 8, 10}, {10, 10, 10}};
+    Raster<int> total_hosts = susceptible + infected;
+    Raster<int> zeros(3, 3, 0);
+    Raster<int> resistant(3, 3, 0);
+    Raster<int> died(3, 3, 0);
+    std::vector<Raster<int>> exposed;
+    std::vector<Raster<int>> mortality_tracker;
+    std::vector<std::vector<int>> suitable_cells = {
+        {0, 0}, {0, 1}, {0, 2}, {1, 0}, {1, 1}, {1, 2}, {2, 0}, {2, 1}, {2, 2}};
+    Config config;
+    config.model_type = "SI";
+    config.rows = 3;
+    config.cols = 3;
+    config.generate_stochasticity = false;
+    config.establishment_stochasticity = false;
+    config.establishment_probability = 1;
+    config.use_mortality = false;
+    using TestModel = Model<Raster<int>, Raster<double>, Raster<double>::IndexType>;
+    TestModel model{config};
+    TestModel::StandardSingleHostPool host_pool(
+        config,
+        susceptible,
+        exposed,
+        infected,
+        zeros,
+        resistant,
+        mortality_tracker,
+        died,
+        total_hosts,
+        model.environment(),
+        suitable_cells);
+    std::default_random_engine generator(42);
+
+    InfectionExtentTracker<int> tracker(3, 3);
+    host_pool.add_infection_observer(tracker);
+    if (tracker.boundary() != scan_boundary(infected)) {
+        cout << "host_pool_notifications: Initial state not reported: "
+             << tracker.boundary() << "\n";
+        ++ret;
+    }
+    host_pool.add_disperser_at(0, 2);
+    host_pool.add_disperser_at(0, 2);
+    host_pool.pests_to(2, 0, 3, generator);
+    if (tracker.count() != 3 || tracker.boundary() != scan_boundary(infected)) {
+        cout << "host_pool_notifications: Wrong after adding (actual, expected): "
+             << tracker.boundary() << " != " << scan_boundary(infected) << "\n";
+        ++ret;
+    }
+    host_pool.remove_all_infected_at(1, 1, generator);
+    host_pool.pests_from(2, 0, 3, generator);
+    if (tracker.count() != 1 || tracker.boundary() != scan_boundary(infected)) {
+        cout << "host_pool_notifications: Wrong after removing (actual, expected): "
+             << tracker.boundary() << " != " << scan_boundary(infected) << "\n";
+        ++ret;
+    }
+    host_pool.remove_infection_observer(tracker);
+    host_pool.add_disperser_at(2, 2);
+    if (tracker.count() != 1) {
+        cout << "host_pool_notifications: Removed observer was notified\n";
+        ++ret;
+    }
+    return ret;
+}
+
+/**
+ * Tracked spread rate and quarantine escape are the same as computed from all cells.
+ */
+int test_tracked_model()
+{
+    int ret = 0;
+    int size = 12;
+    Raster<int> infected(size, size, 0);
+    infected(5, 5) = 20;
+    infected(6, 7) = 5;
+    Raster<int> susceptible(size, size, 30);
+    Raster<int> total_hosts = susceptible + infected;
+    Raster<int> total_populations = total_hosts;
+    Raster<int> quarantine_areas(size, size, 0);
+    for (int row = 1; row < 11; ++row) {
+        for (int col = 2; col < 11; ++col) {
+            quarantine_areas(row, col) = col < 6 ? 1 : 2;
+        }
+    }
+    Raster<int> dispersers(size, size);
+    Raster<int> established_dispersers(size, size);
+    std::vector<std::tuple<int, int>> outside_dispersers;
+    std::vector<std::vector<int>> suitable_cells;
+    for (int row = 0; row < size; ++row)
+        for (int col = 0; col < size; ++col)
+            suitable_cells.push_back({row, col});
+
+    Config config;
+    config.random_seed = 42;
+    config.reproductive_rate = 0.8;
+    config.natural_kernel_type = "cauchy";
+    config.natural_direction = "none";
+    config.natural_scale = 5;
+    config.anthro_scale = 5;
+    config.use_anthropogenic_kernel = false;
+    config.rows = size;
+    config.cols = size;
+    config.ew_res = 10;
+    config.ns_res = 15;
+    config.model_type = "SEI";
+    config.latency_period_steps = 2;
+    config.set_date_start(2020, 1, 1);
+    config.set_date_end(2021, 12, 31);
+    config.set_step_unit(StepUnit::Month);
+    config.set_step_num_units(1);
+    config.use_mortality = true;
+    config.mortality_frequency = "month";
+    config.mortality_frequency_n = 4;
+    config.use_treatments = true;
+    config.use_spreadrates = true;
+    config.spreadrate_frequency = "month";
+    config.spreadrate_frequency_n = 1;
+    config.use_quarantine = true;
+    config.quarantine_frequency = "month";
+    config.quarantine_frequency_n = 1;
+    config.create_schedules();
+
+    using TestModel = Model<Raster<int>, Raster<double>, Raster<double>::IndexType>;
+    TestModel model{config};
+
+    std::vector<Raster<int>> mortality_tracker(3, Raster<int>(size, size, 0));
+    Raster<int> died(size, size, 0);
+    Raster<int> total_exposed(size, size, 0);
+    Raster<int> resistant(size, size, 0);
+    std::vector<Raster<int>> exposed(
+        config.latency_period_steps + 1, Raster<int>(size, size, 0));
+    std::vector<Raster<double>> empty_floats;
+    std::vector<std::vector<int>> movements;
+
+    TestModel::StandardSingleHostPool host_pool(
+        config,
+        susceptible,
+        exposed,
+        infected,
+        total_exposed,
+        resistant,
+        mortality_tracker,
+        died,
+        total_hosts,
+        model.environment(),
+        suitable_cells);
+    std::vector<TestModel::StandardSingleHostPool*> host_pools = {&host_pool};
+    TestModel::StandardMultiHostPool multi_host_pool(host_pools, config);
+    PestHostTable<TestModel::StandardSingleHostPool> pest_host_table(
+        model.environment());
+    pest_host_table.add_host_info(1, 0.5, 1);
+    multi_host_pool.set_pest_host_table(pest_host_table);
+    TestModel::StandardPestPool pest_pool{
+        dispersers, established_dispersers, outside_dispersers};
+
+    unsigned num_steps = config.scheduler().get_num_steps();
+    SpreadRateAction<TestModel::StandardMultiHostPool, int> spread_rate(
+        multi_host_pool, size, size, config.ew_res, config.ns_res, num_steps);
+    SpreadRateAction<TestModel::StandardMultiHostPool, int> scanned_spread_rate(
+        spread_rate);
+    QuarantineEscapeAction<Raster<int>> quarantine(
+        quarantine_areas, config.ew_res, config.ns_res, num_steps);
+    QuarantineEscapeAction<Raster<int>> scanned_quarantine(quarantine);
+
+    InfectionExtentTracker<int> extent_tracker(size, size);
+    ZonalInfectionExtentTracker<Raster<int>, int> zonal_tracker(quarantine_areas);
+    multi_host_pool.add_infection_observer(extent_tracker);
+    multi_host_pool.add_infection_observer(zonal_tracker);
+    spread_rate.track_infection(extent_tracker);
+    quarantine.track_infection(zonal_tracker);
+
+    Treatments<TestModel::StandardSingleHostPool, Raster<double>> treatments(
+        config.scheduler());
+    Raster<double> simple_treatment(size, size, 0);
+    for (int col = 0; col < 6; ++col)
+        simple_treatment(5, col) = 1;
+    treatments.add_treatment(
+        simple_treatment, Date(2020, 4, 1), 0, TreatmentApplication::AllInfectedInCell);
+    Raster<double> resistance_treatment(size, size, 0);
+    resistance_treatment(6, 7) = 1;
+    treatments.add_treatment(
+        resistance_treatment, Date(2020, 7, 1), 60, TreatmentApplication::Ratio);
+
+    for (unsigned step = 0; step < num_steps; ++step) {
+        model.run_step(
+            step,
+            multi_host_pool,
+            pest_pool,
+            total_populations,
+            treatments,
+            empty_floats,
+            empty_floats,
+            spread_rate,
+            quarantine,
+            quarantine_areas,
+            movements,
+            Network<int>::null_network());
+        scanned_spread_rate.action(multi_host_pool, step);
+        scanned_quarantine.action(multi_host_pool, quarantine_areas, step);
+        if (extent_tracker.boundary() != scan_boundary(infected)) {
+            cout << "tracked_model: Boundary in step " << step
+                 << " differs (tracked, scanned): " << extent_tracker.boundary()
+                 << " != " << scan_boundary(infected) << "\n";
+            ++ret;
+        }
+        if (!same_rates(
+                spread_rate.step_rate(step), scanned_spread_rate.step_rate(step))) {
+            cout << "tracked_model: Spread rate in step " << step << " differs\n";
+            ++ret;
+        }
+        if (quarantine.escaped(step) != scanned_quarantine.escaped(step)
+            || (!quarantine.escaped(step)
+                && quarantine.distance(step) != scanned_quarantine.distance(step))) {
+            cout << "tracked_model: Quarantine escape in step " << step
+                 << " differs (tracked, scanned): " << quarantine.escaped(step) << " "
+                 << quarantine.distance(step)
+                 << " != " << scanned_quarantine.escaped(step) << " "
+                 << scanned_quarantine.distance(step) << "\n";
+            ++ret;
+        }
+    }
+    if (!quarantine.escaped(num_steps - 1)) {
+        cout << "tracked_model: Infection was expected to escape quarantine\n";
+        ++ret;
+    }
+    return ret;
+}
+
+/**
+ * Raster state for the model run_step() overload which takes rasters
+ */
+struct RasterState
+{
+    RasterState(int size, int latency_period_steps)
+        : infected(size, size, 0),
+          susceptible(size, size, 30),
+          dispersers(size, size),
+          established_dispersers(size, size),
+          mortality_tracker(3, Raster<int>(size, size, 0)),
+          died(size, size, 0),
+          total_exposed(size, size, 0),
+          resistant(size, size, 0),
+          exposed(latency_period_steps + 1, Raster<int>(size, size, 0))
+    {
+        infected(5, 5) = 20;
+        infected(6, 7) = 5;
+        total_hosts = susceptible + infected;
+        total_populations = total_hosts;
+        for (int row = 0; row < size; ++row)
+            for (int col = 0; col < size; ++col)
+                suitable_cells.push_back({row, col});
+    }
+
+    template<typename TestModel>
+    void run_step(
+        TestModel& model,
+        unsigned step,
+        QuarantineEscapeAction<Raster<int>>& quarantine,
+        const Raster<int>& quarantine_areas)
+    {
+        std::vector<Raster<double>> empty_floats;
+        std::vector<std::vector<int>> movements;
+        model.run_step(
+            step,
+            infected,
+            susceptible,
+            total_populations,
+            total_hosts,
+            dispersers,
+            established_dispersers,
+            total_exposed,
+            exposed,
+            mortality_tracker,
+            died,
+            empty_floats,
+            empty_floats,
+            resistant,
+            outside_dispersers,
+            quarantine,
+            quarantine_areas,
+            movements,
+            Network<int>::null_network(),
+            suitable_cells);
+    }
+
+    Raster<int> infected;
+    Raster<int> susceptible;
+    Raster<int> total_hosts;
+    Raster<int> total_populations;
+    Raster<int> dispersers;
+    Raster<int> established_dispersers;
+    std::vector<Raster<int>> mortality_tracker;
+    Raster<int> died;
+    Raster<int> total_exposed;
+    Raster<int> resistant;
+    std::vector<Raster<int>> exposed;
+    std::vector<std::tuple<int, int>> outside_dispersers;
+    std::vector<std::vector<int>> suitable_cells;
+};
+
+int test_tracked_model_with_rasters()
+{
+    int ret = 0;
+    int size = 12;
+    Raster<int> quarantine_areas(size, size, 0);
+    for (int row = 1; row < 11; ++row) {
+        for (int col = 2; col < 11; ++col) {
+            quarantine_areas(row, col) = col < 6 ? 1 : 2;
+        }
+    }
+
+    Config config;
+    config.random_seed = 42;
+    config.reproductive_rate = 0.8;
+    config.natural_kernel_type = "cauchy";
+    config.natural_direction = "none";
+    config.natural_scale = 5;
+    config.anthro_scale = 5;
+    config.use_anthropogenic_kernel = false;
+    config.rows = size;
+    config.cols = size;
+    config.ew_res = 10;
+    config.ns_res = 15;
+    config.model_type = "SEI";
+    config.latency_period_steps = 2;
+    config.set_date_start(2020, 1, 1);
+    config.set_date_end(2021, 12, 31);
+    config.set_step_unit(StepUnit::Month);
+    config.set_step_num_units(1);
+    config.use_mortality = false;
+    config.use_quarantine = true;
+    config.quarantine_frequency = "month";
+    config.quarantine_frequency_n = 1;
+    config.create_schedules();
+
+    using TestModel = Model<Raster<int>, Raster<double>, Raster<double>::IndexType>;
+    TestModel model{config};
+    TestModel scanned_model{config};
+    RasterState state(size, config.latency_period_steps);
+    RasterState scanned_state(size, config.latency_period_steps);
+
+    unsigned num_steps = config.scheduler().get_num_steps();
+    QuarantineEscapeAction<Raster<int>> quarantine(
+        quarantine_areas, config.ew_res, config.ns_res, num_steps);
+    QuarantineEscapeAction<Raster<int>> scanned_quarantine(quarantine);
+    ZonalInfectionExtentTracker<Raster<int>, int> zonal_tracker(quarantine_areas);
+    model.add_infection_observer(zonal_tracker);
+    quarantine.track_infection(zonal_tracker);
+
+    for (unsigned step = 0; step < num_steps; ++step) {
+        state.run_step(model, step, quarantine, quarantine_areas);
+        scanned_state.run_step(
+            scanned_model, step, scanned_quarantine, quarantine_areas);
+        if (quarantine.escaped(step) != scanned_quarantine.escaped(step)
+            || (!quarantine.escaped(step)
+                && quarantine.distance(step) != scanned_quarantine.distance(step))) {
+            cout << "tracked_model_with_rasters: Quarantine escape in step " << step
+                 << " differs (tracked, scanned): " << quarantine.escaped(step) << " "
+                 << quarantine.distance(step)
+                 << " != " << scanned_quarantine.escaped(step) << " "
+                 << scanned_quarantine.distance(step) << "\n";
+            ++ret;
+        }
+    }
+    if (!quarantine.escaped(num_steps - 1)) {
+        cout << "tracked_model_with_rasters: Infection was expected to escape\n";
+        ++ret;
+    }
+    // Infected cells are counted only once even though a new host pool is
+    // created in each step.
+    ZonalInfectionExtentTracker<Raster<int>, int> expected(quarantine_areas);
+    for (int row = 0; row < size; ++row)
+        for (int col = 0; col < size; ++col)
+            if (state.infected(row, col) > 0)
+                expected.infection_changed(row, col, true);
+    for (int zone : {1, 2}) {
+        if (zonal_tracker.zone(zone).count() != expected.zone(zone).count()
+            || zonal_tracker.zone(zone).boundary() != expected.zone(zone).boundary()) {
+            cout << "tracked_model_with_rasters: Zone " << zone << " has "
+                 << zonal_tracker.zone(zone).count() << " infected cells ("
+                 << zonal_tracker.zone(zone).boundary() << ") instead of "
+                 << expected.zone(zone).count() << " ("
+                 << expected.zone(zone).boundary() << ")\n";
+            ++ret;
+        }
+    }
+    return ret;
+}
+
+int main()
+{
+    int ret = 0;
+
+    ret += test_extent_tracker();
+    ret += test_host_pool_notifications();
+    ret += test_tracked_model();
+    ret += test_tracked_model_with_rasters();
+
+    std::cout << "Test infection tracker number of errors: " << ret << std::endl;
+    return ret;
+}
+
+#endif  // POPS_TEST
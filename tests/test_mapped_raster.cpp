@@ -0,0 +1,169 @@
+#ifdef POPS_TEST
+
+/*
+ * Tests for the PoPS MappedRaster class.
+ *
+ * Copyright (C) 2023 by the authors.
+ *
+ * Authors: Vaclav Petras <wenzeslaus gmail com>
+ *
+ * This file is part of PoPS.
+
+ * PoPS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+
+ * PoPS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PoPS. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <pops/mapped_raster.hpp>
+#include <pops/raster.hpp>
+
+using namespace pops;
+using std::cout;
+
+int test_create_and_read()
+{
+    int ret = 0;
+    std::string path = "test_mapped_raster_values.bin";
+    Raster<int> expected = {{1, 2, 3}, {4, 5, 6}};
+    {
+        MappedRaster<int> created(path, 2, 3, MappingMode::Create);
+        created.raster() = lazy(expected) * 1;
+        created.sync();
+    }
+    {
+        const MappedRaster<int> mapped(path, 2, 3);
+        if (mapped.raster() != expected) {
+            cout << "create_and_read: Read values differ:\n"
+                 << mapped.raster() << expected;
+            ++ret;
+        }
+        Raster<int> doubled = lazy(mapped.raster()) * 2;
+        if (doubled != expected * 2) {
+            cout << "create_and_read: Mapped raster does not work in expressions\n";
+            ++ret;
+        }
+    }
+    {
+        MappedRaster<int> mapped(path, 2, 3, MappingMode::ReadOnly);
+        try {
+            mapped.raster()(0, 0) = 10;
+            cout << "create_and_read: Writable access to read-only file allowed\n";
+            ++ret;
+        }
+        catch (const std::logic_error&) {
+        }
+    }
+    std::remove(path.c_str());
+    return ret;
+}
+
+int test_write_modes()
+{
+    int ret = 0;
+    std::string path = "test_mapped_raster_modes.bin";
+    {
+        MappedRaster<double> created(path, 2, 2, MappingMode::Create);
+        created.raster().fill(1.5);
+    }
+    {
+        MappedRaster<double> private_copy(path, 2, 2, MappingMode::CopyOnWrite);
+        private_copy.raster()(0, 0) = 10;
+        if (private_copy.raster()(0, 0) != 10) {
+            cout << "write_modes: Copy-on-write mapping not writable\n";
+            ++ret;
+        }
+    }
+    {
+        MappedRaster<double> shared(path, 2, 2, MappingMode::ReadWrite);
+        if (shared.raster()(0, 0) != 1.5) {
+            cout << "write_modes: Copy-on-write mapping changed the file\n";
+            ++ret;
+        }
+        shared.raster()(1, 1) = 7;
+    }
+    {
+        const MappedRaster<double> mapped(path, 2, 2);
+        Raster<double> expected = {{1.5, 1.5}, {1.5, 7}};
+        if (mapped.raster() != expected) {
+            cout << "write_modes: Read-write mapping did not change the file:\n"
+                 << mapped.raster();
+            ++ret;
+        }
+    }
+    std::remove(path.c_str());
+    return ret;
+}
+
+int test_offset_and_size()
+{
+    int ret = 0;
+    std::string path = "test_mapped_raster_offset.bin";
+    std::size_t header = 12;
+    {
+        MappedRaster<short> created(path, 4, 5, MappingMode::Create, header);
+        for (int i = 0; i < 4; ++i)
+            for (int j = 0; j < 5; ++j)
+                created.raster()(i, j) = static_cast<short>(i * 10 + j);
+    }
+    {
+        const MappedRaster<short> mapped(path, 4, 5, MappingMode::ReadOnly, header);
+        if (mapped.raster()(3, 4) != 34 || mapped.raster()(0, 0) != 0) {
+            cout << "offset_and_size: Wrong values with offset:\n" << mapped.raster();
+            ++ret;
+        }
+        // Hints should not change anything.
+        MappedRaster<short> hinted(path, 4, 5, MappingMode::CopyOnWrite, header);
+        std::vector<std::vector<int>> cells = {{0, 1}, {2, 3}, {3, 4}};
+        hinted.advise_cells(cells);
+        hinted.advise(MappingAccess::Random);
+        if (hinted.raster() != mapped.raster()) {
+            cout << "offset_and_size: Values changed after hints\n";
+            ++ret;
+        }
+    }
+    try {
+        MappedRaster<short> too_large(path, 5, 5, MappingMode::ReadOnly, header);
+        cout << "offset_and_size: Too small file not detected\n";
+        ++ret;
+    }
+    catch (const std::runtime_error&) {
+    }
+    std::remove(path.c_str());
+    try {
+        MappedRaster<short> missing(path, 5, 5);
+        cout << "offset_and_size: Missing file not detected\n";
+        ++ret;
+    }
+    catch (const std::runtime_error&) {
+    }
+    return ret;
+}
+
+int main()
+{
+    int ret = 0;
+
+    ret += test_create_and_read();
+    ret += test_write_modes();
+    ret += test_offset_and_size();
+
+    std::cout << "Test mapped raster number of errors: " << ret << std::endl;
+    return ret;
+}
+
+#endif  // POPS_TEST
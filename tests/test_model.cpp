@@ -20,6 +20,8 @@
  * along with PoPS. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <sstream>
+#include <string>
 #include <vector>
 
 #include <pops/model.hpp>
@@ -747,6 +749,358 @@ int test_model_sei_deterministic_with_treatments()
     return ret;
 }
 
+/**
+ * Results of one model run used to compare fused and separate cell actions
+ */
+struct CellActionsRunResult
+{
+    Raster<int> infected;
+    Raster<int> susceptible;
+    Raster<int> died;
+    std::vector<BBoxFloat> rates;
+    std::vector<EscapeDistDir> escapes;
+};
+
+/**
+ * Run a stochastic model with all per-cell actions active
+ */
+CellActionsRunResult run_model_with_cell_actions(bool fuse_cell_actions)
+{
+    int size = 9;
+    Raster<int> infected(size, size, 0);
+    infected(4, 4) = 20;
+    infected(3, 5) = 7;
+    Raster<int> susceptible(size, size, 100);
+    susceptible(0, 8) = 0;
+    Raster<int> total_hosts = susceptible + infected;
+    Raster<int> total_populations = total_hosts;
+    Raster<int> quarantine_areas(size, size, 0);
+    for (int row = 2; row < 7; ++row)
+        for (int col = 2; col < 7; ++col)
+            quarantine_areas(row, col) = 1;
+
+    Raster<int> dispersers(size, size);
+    Raster<int> established_dispersers(size, size);
+    std::vector<std::tuple<int, int>> outside_dispersers;
+
+    std::vector<std::vector<int>> suitable_cells;
+    for (int row = 0; row < size; ++row)
+        for (int col = 0; col < size; ++col)
+            if (total_hosts(row, col) > 0)
+                suitable_cells.push_back({row, col});
+
+    Config config;
+    config.reproductive_rate = 2;
+    config.natural_kernel_type = "cauchy";
+    config.natural_direction = "none";
+    config.natural_scale = 0.9;
+    config.anthro_scale = 0.9;
+    config.use_anthropogenic_kernel = false;
+    config.read_seeds({1, 2, 3, 4, 5, 6, 7, 8, 9, 10});
+    config.rows = size;
+    config.cols = size;
+    config.ew_res = 1;
+    config.ns_res = 1;
+    config.model_type = "SI";
+    config.set_date_start(2020, 1, 1);
+    config.set_date_end(2021, 12, 31);
+    config.set_step_unit(StepUnit::Month);
+    config.set_step_num_units(1);
+    config.use_lethal_temperature = true;
+    config.lethal_temperature = -5;
+    config.lethal_temperature_month = 1;
+    config.use_survival_rate = true;
+    config.survival_rate_month = 6;
+    config.survival_rate_day = 1;
+    config.use_mortality = true;
+    config.mortality_frequency = "month";
+    config.mortality_frequency_n = 3;
+    config.use_treatments = true;
+    config.use_spreadrates = true;
+    config.spreadrate_frequency = "month";
+    config.spreadrate_frequency_n = 1;
+    config.use_quarantine = true;
+    config.quarantine_frequency = "month";
+    config.quarantine_frequency_n = 1;
+    config.fuse_cell_actions = fuse_cell_actions;
+    config.create_schedules();
+
+    using TestModel = Model<Raster<int>, Raster<double>, Raster<double>::IndexType>;
+    TestModel model{config};
+
+    std::vector<Raster<int>> mortality_tracker(3, Raster<int>(size, size, 0));
+    Raster<int> died(size, size, 0);
+    Raster<int> total_exposed(size, size, 0);
+    Raster<int> resistant(size, size, 0);
+    std::vector<Raster<int>> exposed;
+    std::vector<std::vector<int>> movements;
+
+    std::vector<Raster<double>> temperatures(config.num_lethal(), {size, size, 0});
+    for (auto& temperature : temperatures)
+        for (int col = 0; col < size; ++col)
+            temperature(4, col) = -10;
+    std::vector<Raster<double>> survival_rates(
+        config.num_survival_rate(), {size, size, 0.7});
+
+    TestModel::StandardSingleHostPool host_pool(
+        config,
+        susceptible,
+        exposed,
+        infected,
+        total_exposed,
+        resistant,
+        mortality_tracker,
+        died,
+        total_hosts,
+        model.environment(),
+        suitable_cells);
+    std::vector<TestModel::StandardSingleHostPool*> host_pools = {&host_pool};
+    TestModel::StandardMultiHostPool multi_host_pool(host_pools, config);
+    PestHostTable<TestModel::StandardSingleHostPool> pest_host_table(
+        model.environment());
+    pest_host_table.add_host_info(1, 0.5, 1);
+    multi_host_pool.set_pest_host_table(pest_host_table);
+    TestModel::StandardPestPool pest_pool{
+        dispersers, established_dispersers, outside_dispersers};
+    unsigned num_rate_steps = config.rate_num_steps();
+    SpreadRateAction<TestModel::StandardMultiHostPool, int> spread_rate(
+        multi_host_pool,
+        config.rows,
+        config.cols,
+        config.ew_res,
+        config.ns_res,
+        num_rate_steps);
+    QuarantineEscapeAction<Raster<int>> quarantine(
+        quarantine_areas, config.ew_res, config.ns_res, config.quarantine_num_steps());
+
+    Treatments<TestModel::StandardSingleHostPool, Raster<double>> treatments(
+        config.scheduler());
+    Raster<double> simple_treatment(size, size, 0);
+    simple_treatment(3, 3) = 1;
+    treatments.add_treatment(
+        simple_treatment, Date(2020, 3, 1), 0, TreatmentApplication::AllInfectedInCell);
+    Raster<double> pesticide_treatment(size, size, 0);
+    pesticide_treatment(4, 4) = 0.5;
+    pesticide_treatment(5, 5) = 0.2;
+    treatments.add_treatment(
+        pesticide_treatment, Date(2020, 6, 1), 90, TreatmentApplication::Ratio);
+
+    for (unsigned step = 0; step < config.scheduler().get_num_steps(); ++step) {
+        model.run_step(
+            step,
+            multi_host_pool,
+            pest_pool,
+            total_populations,
+            treatments,
+            temperatures,
+            survival_rates,
+            spread_rate,
+            quarantine,
+            quarantine_areas,
+            movements,
+            Network<int>::null_network());
+    }
+    CellActionsRunResult result{infected, susceptible, died, {}, {}};
+    for (unsigned i = 0; i < num_rate_steps; ++i)
+        result.rates.push_back(spread_rate.step_rate(i));
+    for (unsigned i = 0; i < config.quarantine_num_steps(); ++i)
+        result.escapes.push_back(quarantine.escape_info(i));
+    return result;
+}
+
+/**
+ * Fused sweep over cells gives the same result as applying actions one by one.
+ */
+int test_fused_cell_actions()
+{
+    int ret = 0;
+    auto fused = run_model_with_cell_actions(true);
+    auto separate = run_model_with_cell_actions(false);
+    if (fused.infected != separate.infected) {
+        cout << "fused_cell_actions: infected (fused, separate):\n"
+             << fused.infected << "  !=\n"
+             << separate.infected << "\n";
+        ++ret;
+    }
+    if (fused.susceptible != separate.susceptible) {
+        cout << "fused_cell_actions: susceptible (fused, separate):\n"
+             << fused.susceptible << "  !=\n"
+             << separate.susceptible << "\n";
+        ++ret;
+    }
+    if (fused.died != separate.died) {
+        cout << "fused_cell_actions: died (fused, separate):\n"
+             << fused.died << "  !=\n"
+             << separate.died << "\n";
+        ++ret;
+    }
+    for (size_t i = 0; i < fused.rates.size(); ++i) {
+        // NaN rates compare unequal, so compare the text representation.
+        std::ostringstream fused_rate;
+        std::ostringstream separate_rate;
+        fused_rate << std::get<0>(fused.rates[i]) << " " << std::get<1>(fused.rates[i])
+                   << " " << std::get<2>(fused.rates[i]) << " "
+                   << std::get<3>(fused.rates[i]);
+        separate_rate << std::get<0>(separate.rates[i]) << " "
+                      << std::get<1>(separate.rates[i]) << " "
+                      << std::get<2>(separate.rates[i]) << " "
+                      << std::get<3>(separate.rates[i]);
+        if (fused_rate.str() != separate_rate.str()) {
+            cout << "fused_cell_actions: spread rate in step " << i
+                 << " differs (fused, separate): " << fused_rate.str()
+                 << " != " << separate_rate.str() << "\n";
+            ++ret;
+        }
+    }
+    for (size_t i = 0; i < fused.escapes.size(); ++i) {
+        bool fused_escaped = std::get<0>(fused.escapes[i]);
+        bool separate_escaped = std::get<0>(separate.escapes[i]);
+        double fused_distance = std::get<0>(std::get<1>(fused.escapes[i]));
+        double separate_distance = std::get<0>(std::get<1>(separate.escapes[i]));
+        if (fused_escaped != separate_escaped
+            || (!fused_escaped && fused_distance != separate_distance)) {
+            cout << "fused_cell_actions: quarantine escape in step " << i
+                 << " differs (fused, separate): " << fused_escaped << " "
+                 << fused_distance << " != " << separate_escaped << " "
+                 << separate_distance << "\n";
+            ++ret;
+        }
+    }
+    return ret;
+}
+
+/** Hosts with only suitable cells for a sweep over cells */
+struct SweepTestHosts
+{
+    std::vector<std::vector<int>> cells;
+
+    const std::vector<std::vector<int>>& suitable_cells() const
+    {
+        return cells;
+    }
+};
+
+int test_sweep_cells()
+{
+    int ret = 0;
+    SweepTestHosts hosts{{{0, 0}, {0, 1}, {2, 1}}};
+    std::vector<std::string> calls;
+    auto record = [&calls](std::string name) {
+        return [&calls, name](int i, int j) {
+            calls.push_back(name + std::to_string(i) + std::to_string(j));
+        };
+    };
+    sweep_cells<int>(
+        hosts,
+        swept_cell_action(true, record("a"), [&calls]() { calls.push_back("A"); }),
+        swept_cell_action(false, record("b"), [&calls]() { calls.push_back("B"); }),
+        swept_cell_action(true, record("c")),
+        swept_cell_action(
+            true, record("d"), [&calls]() { calls.push_back("D"); }, false));
+    std::vector<std::string> expected = {
+        "a00", "c00", "a01", "c01", "a21", "c21", "A", "D"};
+    if (calls != expected) {
+        cout << "sweep_cells: Wrong order of calls:";
+        for (const auto& call : calls)
+            cout << " " << call;
+        cout << "\n";
+        ++ret;
+    }
+    // Only final actions, so no cells are visited.
+    calls.clear();
+    sweep_cells<int>(
+        hosts,
+        swept_cell_action(false, record("a")),
+        swept_cell_action(
+            true, record("b"), [&calls]() { calls.push_back("B"); }, false));
+    if (calls != std::vector<std::string>{"B"}) {
+        cout << "sweep_cells: Cells visited without cell actions\n";
+        ++ret;
+    }
+    return ret;
+}
+
+int test_run_plan()
+{
+    int ret = 0;
+    Config config;
+    config.model_type = "SEI";
+    config.natural_kernel_type = "cauchy";
+    config.natural_direction = "E";
+    config.anthro_kernel_type = "network";
+    config.network_movement = "jump";
+    config.set_arrival_behavior("land");
+    config.spread_random_streams = "tile";
+    config.weather_type = "deterministic";
+    config.weather_size = 12;
+    config.use_lethal_temperature = true;
+    config.lethal_temperature_month = 2;
+    config.use_quarantine = false;
+    config.use_spreadrates = true;
+    config.spreadrate_frequency = "month";
+    config.output_frequency = "year";
+    config.set_date_start(2020, 1, 1);
+    config.set_date_end(2021, 12, 31);
+    config.set_step_unit(StepUnit::Month);
+    config.set_step_num_units(1);
+
+    RunPlan unscheduled_plan(config);
+    try {
+        unscheduled_plan.spread_schedule();
+        cout << "run_plan: No exception for schedules which were not created\n";
+        ret += 1;
+    }
+    catch (const std::logic_error&) {
+    }
+
+    config.create_schedules();
+    RunPlan plan(config);
+    if (plan.model_type() != ModelType::SusceptibleExposedInfected
+        || plan.natural_kernel_type() != DispersalKernelType::Cauchy
+        || plan.anthro_kernel_type() != DispersalKernelType::Network
+        || plan.natural_direction() != Direction::E
+        || plan.anthro_direction() != Direction::None
+        || plan.network_movement() != NetworkMovement::Jump
+        || plan.arrival_behavior() != ArrivalBehavior::Land
+        || plan.spread_random_streams() != RandomStreams::Tile
+        || plan.weather_type() != WeatherType::Deterministic) {
+        cout << "run_plan: Options not resolved correctly\n";
+        ret += 1;
+    }
+    if (plan.num_steps() != config.scheduler().get_num_steps()) {
+        cout << "run_plan: Number of steps is " << plan.num_steps() << "\n";
+        ret += 1;
+    }
+    for (unsigned step = 0; step < plan.num_steps(); ++step) {
+        if (plan.spread_schedule().is_scheduled(step) != config.spread_schedule()[step]
+            || plan.output_schedule().is_scheduled(step)
+                   != config.output_schedule()[step]
+            || plan.lethal_schedule().is_scheduled(step)
+                   != config.lethal_schedule()[step]
+            || plan.lethal_schedule().action_step(step)
+                   != simulation_step_to_action_step(config.lethal_schedule(), step)
+            || plan.spread_rate_schedule().action_step(step)
+                   != simulation_step_to_action_step(
+                       config.spread_rate_schedule(), step)
+            || plan.quarantine_schedule().is_scheduled(step)
+            || plan.weather_step(step)
+                   != config.simulation_step_to_weather_step(step)) {
+            cout << "run_plan: Schedules differ at step " << step << "\n";
+            ret += 1;
+        }
+    }
+
+    config.network_movement = "run";
+    try {
+        RunPlan wrong_plan(config);
+        cout << "run_plan: No exception for invalid network movement\n";
+        ret += 1;
+    }
+    catch (const std::invalid_argument&) {
+    }
+    return ret;
+}
+
 int main()
 {
     int ret = 0;
@@ -756,6 +1110,9 @@ int main()
     ret += test_deterministic_exponential();
     ret += test_model_sei_deterministic();
     ret += test_model_sei_deterministic_with_treatments();
+    ret += test_fused_cell_actions();
+    ret += test_sweep_cells();
+    ret += test_run_plan();
     std::cout << "Test model number of errors: " << ret << std::endl;
 
     return ret;
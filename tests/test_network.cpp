@@ -1,3 +1,4 @@
+#include <cstdio>
 #include <fstream>
 #include <regex>
 #include <random>
@@ -843,6 +844,452 @@ int create_network_from_files(int argc, char** argv)
     return 0;
 }
 
+int test_network_nodes_at_cells()
+{
+    int ret = 0;
+    BBox<double> bbox;
+    bbox.north = 10;
+    bbox.south = 0;
+    bbox.east = 10;
+    bbox.west = 0;
+    Network<int> network{bbox, 1, 1};
+    // Node 5 is at two different cells.
+    std::stringstream network_stream{
+        "7,5,1.5;8.5;2.5;8.5;3.5;8.5\n"
+        "5,2,6.5;4.5;3.5;8.5\n"};
+    network.load(network_stream);
+    ret += test_node_status_at(network, 1, 3, 2);
+    ret += test_node_status_at(network, 5, 6, 1);
+    ret += test_node_status_at(network, 1, 1, 1);
+    auto nodes = network.get_nodes_at(1, 3);
+    if (nodes.size() != 2 || nodes[0] != 2 || nodes[1] != 5) {
+        std::cerr << "Nodes at a cell should be ordered by ID\n";
+        ret += 1;
+    }
+    if (network.get_node_row_col(5) != std::make_pair(1, 3)) {
+        std::cerr << "Node at two cells should be at the first cell (row-major), not "
+                  << network.get_node_row_col(5).first << ", "
+                  << network.get_node_row_col(5).second << "\n";
+        ret += 1;
+    }
+    for (const auto& cell :
+         {std::make_pair(1, 2), std::make_pair(-1, 3), std::make_pair(20, 3)}) {
+        if (network.has_node_at(cell.first, cell.second)
+            || !network.get_nodes_at(cell.first, cell.second).empty()) {
+            std::cerr << "There should be no node at " << cell.first << ", "
+                      << cell.second << "\n";
+            ret += 1;
+        }
+    }
+    try {
+        network.get_node_row_col(3);
+        std::cerr << "No exception for node which is not in the network\n";
+        ret += 1;
+    }
+    catch (const std::invalid_argument&) {
+    }
+    // Loading more segments keeps the existing ones.
+    std::stringstream more_network_stream{"9,7,8.5;1.5;1.5;8.5\n"};
+    network.load(more_network_stream);
+    ret += test_node_status_at(network, 8, 8, 1);
+    ret += test_node_status_at(network, 1, 3, 2);
+    Network<int>::Statistics expected_stats{
+        {"num_nodes", 4}, {"min_node_id", 2}, {"max_node_id", 9}};
+    ret += compare_network_statistics(expected_stats, network.collect_statistics());
+    int row;
+    int col;
+    std::default_random_engine generator;
+    std::tie(row, col) = network.teleport(8, 8, generator);
+    if (row != 1 || col != 1) {
+        std::cerr << "Teleport from node 9 should end at node 7 (1, 1), not " << row
+                  << ", " << col << "\n";
+        ret += 1;
+    }
+    if (ret) {
+        network.dump_yaml(std::cerr);
+    }
+    return ret;
+}
+
+/** Teleport from a cell many times and check frequencies of destinations */
+int check_teleport_frequencies(
+    const Network<int>& network,
+    int num_steps,
+    const std::map<std::pair<int, int>, double>& expected)
+{
+    int ret = 0;
+    std::default_random_engine generator(42);
+    std::map<std::pair<int, int>, int> counts;
+    int count = 20000;
+    for (int i = 0; i < count; ++i) {
+        int row;
+        int col;
+        std::tie(row, col) = network.teleport(4, 5, generator, num_steps);
+        ++counts[std::make_pair(row, col)];
+    }
+    for (const auto& item : counts) {
+        if (expected.find(item.first) == expected.end()) {
+            std::cerr << "Teleport in " << num_steps
+                      << " steps reached unexpected cell " << item.first.first << ", "
+                      << item.first.second << "\n";
+            ret += 1;
+        }
+    }
+    for (const auto& item : expected) {
+        double frequency = double(counts[item.first]) / count;
+        if (std::abs(frequency - item.second) > 0.02) {
+            std::cerr << "Teleport in " << num_steps << " steps reached cell "
+                      << item.first.first << ", " << item.first.second << " with "
+                      << "frequency " << frequency << " instead of " << item.second
+                      << "\n";
+            ret += 1;
+        }
+    }
+    return ret;
+}
+
+int test_teleport_probabilities()
+{
+    int ret = 0;
+    BBox<double> bbox;
+    bbox.north = 10;
+    bbox.south = 0;
+    bbox.east = 10;
+    bbox.west = 0;
+    Network<int> network{bbox, 1, 1};
+    // Star with node 1 in the middle.
+    std::stringstream network_stream{
+        "node_1,node_2,probability,geometry\n"
+        "1,2,0.1,5.5;5.5;1.5;5.5\n"
+        "1,3,0.3,5.5;5.5;8.5;5.5\n"
+        "1,4,0.6,5.5;5.5;5.5;1.5\n"
+        "1,5,0,5.5;5.5;5.5;8.5\n"};
+    network.load(network_stream);
+    std::map<std::pair<int, int>, double> one_step{
+        {{4, 1}, 0.1}, {{4, 8}, 0.3}, {{8, 5}, 0.6}};
+    std::map<std::pair<int, int>, double> back{{{4, 5}, 1}};
+    ret += check_teleport_frequencies(network, 1, one_step);
+    ret += check_teleport_frequencies(network, 2, back);
+    ret += check_teleport_frequencies(network, 3, one_step);
+    // Same distributions with precomputed steps.
+    network.precompute_teleport_steps(3);
+    ret += check_teleport_frequencies(network, 1, one_step);
+    ret += check_teleport_frequencies(network, 2, back);
+    ret += check_teleport_frequencies(network, 3, one_step);
+    ret += check_teleport_frequencies(network, 5, one_step);
+    return ret;
+}
+
+/** Write a byte at a given position to a file */
+void overwrite_file_byte(const std::string& path, std::streamoff position, char value)
+{
+    std::fstream stream(path, std::ios::binary | std::ios::in | std::ios::out);
+    stream.seekp(position);
+    stream.put(value);
+}
+
+int test_network_binary_cache()
+{
+    int ret = 0;
+    BBox<double> bbox;
+    bbox.north = 10;
+    bbox.south = 0;
+    bbox.east = 30;
+    bbox.west = 20;
+    Network<int> network{bbox, 1, 1};
+    std::stringstream network_stream{
+        "node_1,node_2,probability,cost,geometry\n"
+        "1,2,0.2,111.5,21.4;7.5;22.3;7.2\n"
+        "1,4,0.8,112.6,21.4;7.5;21.9;8.0;22.5;8.6\n"
+        "2,8,0.5,214.6,22.3;7.2;23.2;7.1;24.0;6.9;24.8;6.7;25.7;6.6;26.5;6.4\n"
+        "8,10,0.3,126.4,26.5;6.4;26.8;5.7;27.2;4.9;27.5;4.2;27.9;3.5;28.2;2.7\n"
+        "5,8,0.2,129.7,27.5;1.5;26.7;1.8;26.0;2.0;26.1;2.9;26.2;3.8;26.5;6.4\n"};
+    network.load(network_stream);
+    std::string path = "test_network_cache.bin";
+    network.save_binary(path);
+
+    Network<int> loaded{bbox, 1, 1};
+    loaded.load_binary(path);
+    std::stringstream expected_yaml;
+    network.dump_yaml(expected_yaml);
+    std::stringstream loaded_yaml;
+    loaded.dump_yaml(loaded_yaml);
+    if (expected_yaml.str() != loaded_yaml.str()) {
+        std::cerr << "Network loaded from binary file differs:\n"
+                  << loaded_yaml.str() << "\ninstead of:\n"
+                  << expected_yaml.str() << "\n";
+        ret += 1;
+    }
+    std::default_random_engine generator1(42);
+    std::default_random_engine generator2(42);
+    for (int i = 0; i < 50; ++i) {
+        double distance = 10 * (i + 1);
+        int steps = 1 + i % 5;
+        if (network.walk(8, 7, distance, generator1)
+                != loaded.walk(8, 7, distance, generator2)
+            || network.teleport(8, 7, generator1, steps)
+                   != loaded.teleport(8, 7, generator2, steps)) {
+            std::cerr << "Trip " << i << " differs for network from binary file\n";
+            ret += 1;
+        }
+    }
+    // A copy of the network uses the same data.
+    Network<int> copy = loaded;
+    std::stringstream copy_yaml;
+    copy.dump_yaml(copy_yaml);
+    if (copy_yaml.str() != expected_yaml.str()) {
+        std::cerr << "Copy of network loaded from binary file differs\n";
+        ret += 1;
+    }
+
+    BBox<double> other_bbox = bbox;
+    other_bbox.east = 40;
+    Network<int> other{other_bbox, 1, 1};
+    try {
+        other.load_binary(path);
+        std::cerr << "Exception not thrown for different bounding box\n";
+        ret += 1;
+    }
+    catch (const std::runtime_error&) {
+    }
+
+    std::string text;
+    {
+        std::ifstream stream(path, std::ios::binary);
+        text.assign(std::istreambuf_iterator<char>(stream), {});
+    }
+    // Truncated file (last array is cut)
+    {
+        std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+        stream.write(text.data(), text.size() - 4);
+    }
+    try {
+        loaded.load_binary(path);
+        std::cerr << "Exception not thrown for truncated file\n";
+        ret += 1;
+    }
+    catch (const std::runtime_error&) {
+    }
+    // Network is unchanged when loading fails.
+    std::stringstream after_failure_yaml;
+    loaded.dump_yaml(after_failure_yaml);
+    if (after_failure_yaml.str() != expected_yaml.str()) {
+        std::cerr << "Network changed by failed load from binary file\n";
+        ret += 1;
+    }
+    // Different version of the format (version is right after 8 byte magic)
+    {
+        std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+        stream.write(text.data(), text.size());
+    }
+    overwrite_file_byte(path, 8, 99);
+    try {
+        loaded.load_binary(path);
+        std::cerr << "Exception not thrown for different format version\n";
+        ret += 1;
+    }
+    catch (const std::runtime_error&) {
+    }
+    // Not a network file
+    overwrite_file_byte(path, 0, 'X');
+    try {
+        loaded.load_binary(path);
+        std::cerr << "Exception not thrown for file which is not a network\n";
+        ret += 1;
+    }
+    catch (const std::runtime_error&) {
+    }
+    std::remove(path.c_str());
+    try {
+        loaded.load_binary(path);
+        std::cerr << "Exception not thrown for non-existent file\n";
+        ret += 1;
+    }
+    catch (const std::runtime_error&) {
+    }
+    return ret;
+}
+
+/** Create text with many segments including duplicate and out of extent ones */
+std::string create_network_text(int num_segments)
+{
+    std::ostringstream text;
+    text << "node_1,node_2,probability,cost,geometry\n";
+    std::default_random_engine generator(7);
+    std::uniform_real_distribution<double> coordinate(-2, 12);
+    std::uniform_int_distribution<int> node(1, num_segments / 2);
+    for (int i = 0; i < num_segments; ++i) {
+        text << node(generator) << "," << node(generator) << ","
+             << (i % 10) / 10. << "," << 100 + i << ",";
+        int num_points = 2 + i % 6;
+        for (int j = 0; j < num_points; ++j) {
+            if (j)
+                text << ";";
+            text << coordinate(generator) << ";" << coordinate(generator);
+        }
+        // Trailing delimiter is allowed.
+        if (i % 7 == 0)
+            text << ";";
+        text << "\n";
+    }
+    return text.str();
+}
+
+/** Load text with load() and load_parallel() and compare errors or results */
+int compare_parallel_load(const std::string& text, unsigned threads)
+{
+    BBox<double> bbox;
+    bbox.north = 10;
+    bbox.south = 0;
+    bbox.east = 10;
+    bbox.west = 0;
+    Network<int> network{bbox, 1, 1};
+    Network<int> parallel_network{bbox, 1, 1};
+    std::string error;
+    std::string parallel_error;
+    try {
+        std::stringstream stream{text};
+        network.load(stream);
+    }
+    catch (const std::exception& exception) {
+        error = exception.what();
+    }
+    try {
+        std::stringstream stream{text};
+        parallel_network.load_parallel(stream, threads);
+    }
+    catch (const std::exception& exception) {
+        parallel_error = exception.what();
+    }
+    if (error != parallel_error) {
+        std::cerr << "Parallel loading with " << threads << " threads failed with '"
+                  << parallel_error << "' instead of '" << error << "'\n";
+        return 1;
+    }
+    std::stringstream yaml;
+    network.dump_yaml(yaml);
+    std::stringstream parallel_yaml;
+    parallel_network.dump_yaml(parallel_yaml);
+    if (yaml.str() != parallel_yaml.str()) {
+        std::cerr << "Network loaded with " << threads << " threads differs:\n"
+                  << parallel_yaml.str() << "\ninstead of:\n"
+                  << yaml.str() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+int test_load_network_parallel()
+{
+    int ret = 0;
+    std::string text = create_network_text(300);
+    for (unsigned threads : {1u, 2u, 3u, 8u, 1000u})
+        ret += compare_parallel_load(text, threads);
+    // Without header and columns for probability and cost.
+    ret += compare_parallel_load(
+        "1,2,1.2;7.1;2.5;8.6\n3,4,1.1;7.5;1.1;7.6;2.5;8.6\n1,2,5;5;6;6", 2);
+    ret += compare_parallel_load("", 2);
+    // Errors (the first wrong line is reported).
+    std::string wrong_line = "3,4,x;7.5;2.5;8.6\n";
+    ret += compare_parallel_load(text + wrong_line + text + "0,1,1;1;2;2\n", 4);
+    for (const auto& wrong_segment : {"21;7", "21;7;", "21;7;22", "", "a;b;1;1"})
+        ret += compare_parallel_load(
+            text + "5,6,0.5,10," + wrong_segment + "\n" + text, 3);
+    ret += compare_parallel_load(text + "\n" + text, 3);
+    ret += compare_parallel_load(text + "5,6,-1,10,1;1;2;2\n", 3);
+    ret += compare_parallel_load(text + "5,6,0.5,cost,1;1;2;2\n", 3);
+    ret += compare_parallel_load(text + "5,99999999999,0.5,1,1;1;2;2\n", 3);
+
+    // Segments are added to existing ones.
+    BBox<double> bbox;
+    bbox.north = 10;
+    bbox.south = 0;
+    bbox.east = 10;
+    bbox.west = 0;
+    Network<int> network{bbox, 1, 1};
+    Network<int> parallel_network{bbox, 1, 1};
+    std::stringstream first_stream{text};
+    network.load(first_stream);
+    std::stringstream second_stream{text};
+    parallel_network.load(second_stream);
+    std::string more_text = create_network_text(50);
+    std::stringstream more_stream{more_text};
+    network.load(more_stream);
+    std::stringstream more_parallel_stream{more_text};
+    parallel_network.load_parallel(more_parallel_stream, 3);
+    std::stringstream yaml;
+    network.dump_yaml(yaml);
+    std::stringstream parallel_yaml;
+    parallel_network.dump_yaml(parallel_yaml);
+    if (yaml.str() != parallel_yaml.str()) {
+        std::cerr << "Parallel loading into existing network differs\n";
+        ret += 1;
+    }
+    return ret;
+}
+
+int test_small_set()
+{
+    int ret = 0;
+    SmallSet<int, 4> set;
+    for (int value : {5, 3, 5, 8, 1, 9, 3, 2, 7})
+        set.insert(value);
+    for (int value = 0; value < 12; ++value) {
+        bool expected = value == 1 || value == 2 || value == 3 || value == 5
+                        || value == 7 || value == 8 || value == 9;
+        if (set.contains(value) != expected) {
+            std::cerr << "SmallSet contains " << value << " is " << set.contains(value)
+                      << "\n";
+            ret += 1;
+        }
+    }
+    return ret;
+}
+
+int test_walk_long_ring()
+{
+    int ret = 0;
+    BBox<double> bbox;
+    bbox.north = 10;
+    bbox.south = 0;
+    bbox.east = 10;
+    bbox.west = 0;
+    Network<int> network{bbox, 1, 1};
+    // Ring of nodes along the edge of the grid (more than fits the visited buffer).
+    std::vector<std::pair<int, int>> cells;
+    for (int col = 0; col < 10; ++col)
+        cells.emplace_back(0, col);
+    for (int row = 1; row < 10; ++row)
+        cells.emplace_back(row, 9);
+    for (int col = 8; col >= 0; --col)
+        cells.emplace_back(9, col);
+    for (int row = 8; row > 0; --row)
+        cells.emplace_back(row, 0);
+    std::stringstream network_stream;
+    int num_nodes = static_cast<int>(cells.size());
+    for (int i = 0; i < num_nodes; ++i) {
+        const auto& start = cells[i];
+        const auto& end = cells[(i + 1) % num_nodes];
+        network_stream << i + 1 << "," << (i + 1) % num_nodes + 1 << ","
+                       << start.second + 0.5 << ";" << 9.5 - start.first << ";"
+                       << end.second + 0.5 << ";" << 9.5 - end.first << "\n";
+    }
+    network.load(network_stream);
+    std::default_random_engine generator(42);
+    for (int i = 0; i < 10; ++i) {
+        auto end = network.walk(0, 0, 30, generator);
+        auto forward = cells[30];
+        auto backward = cells[num_nodes - 30];
+        if (end != std::make_tuple(forward.first, forward.second)
+            && end != std::make_tuple(backward.first, backward.second)) {
+            std::cerr << "Walk over the ring ended at (" << std::get<0>(end) << ", "
+                      << std::get<1>(end) << ")\n";
+            ret += 1;
+        }
+    }
+    return ret;
+}
+
 int run_tests()
 {
     int ret = 0;
@@ -860,6 +1307,12 @@ int run_tests()
     ret += test_network_cost_before_probability();
     ret += test_network_cost_last();
     ret += test_network_probability_last();
+    ret += test_network_nodes_at_cells();
+    ret += test_teleport_probabilities();
+    ret += test_network_binary_cache();
+    ret += test_load_network_parallel();
+    ret += test_small_set();
+    ret += test_walk_long_ring();
 
     if (ret)
         std::cerr << "Number of errors in the network test: " << ret << "\n";
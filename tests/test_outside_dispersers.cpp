@@ -0,0 +1,240 @@
+#ifdef POPS_TEST
+
+/*
+ * Tests for aggregated counts of dispersers which left the area.
+ *
+ * Copyright (C) 2023 by the authors.
+ *
+ * Authors: Vaclav Petras <wenzeslaus gmail com>
+ *
+ * This file is part of PoPS.
+
+ * PoPS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+
+ * PoPS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PoPS. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#include <pops/model.hpp>
+#include <pops/outside_dispersers.hpp>
+#include <pops/raster.hpp>
+
+using namespace pops;
+
+using TestModel = Model<Raster<int>, Raster<double>, Raster<double>::IndexType>;
+
+int test_cell_counts()
+{
+    int ret = 0;
+    OutsideDispersers outside;
+    outside.add(-1, 2);
+    outside.add(-1, 2, 4);
+    outside.add(10, -3, 2);
+    if (outside.total() != 7 || outside.count_at(-1, 2) != 5
+        || outside.count_at(10, -3) != 2 || outside.count_at(0, 0) != 0
+        || outside.cell_counts().size() != 2) {
+        std::cout << "test_cell_counts: Wrong counts (total " << outside.total()
+                  << ")\n";
+        ++ret;
+    }
+    try {
+        outside.bin_count(0, 0);
+        std::cout << "test_cell_counts: No exception for bins\n";
+        ++ret;
+    }
+    catch (const std::logic_error&) {
+    }
+    outside.clear();
+    if (outside.total() != 0 || !outside.cell_counts().empty()) {
+        std::cout << "test_cell_counts: Counts not cleared\n";
+        ++ret;
+    }
+    return ret;
+}
+
+int test_binned_counts()
+{
+    int ret = 0;
+    // Area 5x5 with center at (2, 2), 8 directions, bins by 2 cells up to 6 cells
+    OutsideDispersers outside(5, 5, 8, 2, 3);
+    outside.add(-1, 2);  // north, 1 cell away
+    outside.add(2, 7, 3);  // east, 3 cells away
+    outside.add(8, 2);  // south, 4 cells away
+    outside.add(2, -100);  // west, far away
+    outside.add(-3, 8);  // northeast, 5 cells away
+    std::vector<std::tuple<unsigned, unsigned, OutsideDispersers::Count>> expected = {
+        {0, 0, 1}, {2, 1, 3}, {4, 2, 1}, {6, 2, 1}, {1, 2, 1}};
+    OutsideDispersers::Count sum = 0;
+    for (const auto& item : expected) {
+        unsigned direction = std::get<0>(item);
+        unsigned distance = std::get<1>(item);
+        if (outside.bin_count(direction, distance) != std::get<2>(item)) {
+            std::cout << "test_binned_counts: Bin (" << direction << ", "
+                      << distance << ") has " << outside.bin_count(direction, distance)
+                      << " (expected " << std::get<2>(item) << ")\n";
+            ++ret;
+        }
+    }
+    for (unsigned direction = 0; direction < outside.num_directions(); ++direction)
+        for (unsigned distance = 0; distance < outside.num_distance_bins(); ++distance)
+            sum += outside.bin_count(direction, distance);
+    if (sum != 7 || outside.total() != 7 || !outside.cell_counts().empty()) {
+        std::cout << "test_binned_counts: Sum of bins is " << sum << ", total is "
+                  << outside.total() << " (expected 7)\n";
+        ++ret;
+    }
+    try {
+        outside.bin_count(8, 0);
+        std::cout << "test_binned_counts: No exception for bin outside\n";
+        ++ret;
+    }
+    catch (const std::out_of_range&) {
+    }
+    try {
+        OutsideDispersers wrong(5, 5, 0, 1, 1);
+        std::cout << "test_binned_counts: No exception for no directions\n";
+        ++ret;
+    }
+    catch (const std::invalid_argument&) {
+    }
+    return ret;
+}
+
+/**
+ * Test that counts from a simulation match the list of outside dispersers
+ */
+int test_counts_with_model()
+{
+    int ret = 0;
+    Config config;
+    config.model_type = "SI";
+    config.reproductive_rate = 10;
+    config.natural_kernel_type = "cauchy";
+    config.natural_direction = "none";
+    config.natural_scale = 2;
+    config.anthro_scale = 0.9;
+    config.use_anthropogenic_kernel = false;
+    config.random_seed = 42;
+    config.rows = 5;
+    config.cols = 5;
+    config.ew_res = 10;
+    config.ns_res = 10;
+    config.set_date_start(2020, 1, 1);
+    config.set_date_end(2020, 12, 31);
+    config.set_step_unit(StepUnit::Month);
+    config.set_step_num_units(1);
+    config.use_spreadrates = false;
+    config.create_schedules();
+
+    Raster<int> zeros(config.rows, config.cols, 0);
+    Raster<int> total_populations(config.rows, config.cols, 100);
+    std::vector<Raster<int>> empty_integer;
+    std::vector<Raster<double>> empty_floats;
+    std::vector<std::vector<int>> movements;
+    QuarantineEscapeAction<Raster<int>> quarantine(
+        zeros, config.ew_res, config.ns_res, 0);
+    Treatments<TestModel::StandardSingleHostPool, Raster<double>> treatments(
+        config.scheduler());
+
+    // Runs the model with the given outside dispersers (list or counts).
+    auto run = [&](auto& outside_dispersers) {
+        TestModel model(config);
+        Raster<int> infected(config.rows, config.cols, 0);
+        infected(2, 2) = 50;
+        Raster<int> susceptible(config.rows, config.cols, 50);
+        Raster<int> total_hosts = susceptible + infected;
+        Raster<int> total_exposed(config.rows, config.cols, 0);
+        Raster<int> resistant(config.rows, config.cols, 0);
+        Raster<int> died(config.rows, config.cols, 0);
+        Raster<int> dispersers(config.rows, config.cols, 0);
+        Raster<int> established_dispersers(config.rows, config.cols, 0);
+        std::vector<Raster<int>> mortality_tracker;
+        std::vector<std::vector<int>> suitable_cells =
+            find_suitable_cells<int, Raster<int>>(total_hosts);
+        TestModel::StandardSingleHostPool host_pool(
+            config,
+            susceptible,
+            empty_integer,
+            infected,
+            total_exposed,
+            resistant,
+            mortality_tracker,
+            died,
+            total_hosts,
+            model.environment(),
+            suitable_cells);
+        std::vector<TestModel::StandardSingleHostPool*> host_pools = {&host_pool};
+        TestModel::StandardMultiHostPool multi_host_pool(host_pools, config);
+        TestModel::StandardPestPool pest_pool(
+            dispersers, established_dispersers, outside_dispersers);
+        SpreadRateAction<TestModel::StandardMultiHostPool, int> spread_rate(
+            multi_host_pool, config.rows, config.cols, config.ew_res, config.ns_res, 0);
+        for (unsigned step = 0; step < 3; ++step) {
+            model.run_step(
+                step,
+                multi_host_pool,
+                pest_pool,
+                total_populations,
+                treatments,
+                empty_floats,
+                empty_floats,
+                spread_rate,
+                quarantine,
+                zeros,
+                movements,
+                Network<int>::null_network());
+        }
+    };
+
+    std::vector<std::tuple<int, int>> outside_list;
+    run(outside_list);
+    OutsideDispersers outside_counts;
+    run(outside_counts);
+    OutsideDispersers outside_bins(config.rows, config.cols, 4, 3, 5);
+    run(outside_bins);
+
+    std::map<OutsideDispersers::Cell, OutsideDispersers::Count> expected;
+    for (const auto& item : outside_list)
+        expected[{std::get<0>(item), std::get<1>(item)}] += 1;
+    if (outside_list.empty()) {
+        std::cout << "test_counts_with_model: No dispersers left the area\n";
+        ++ret;
+    }
+    if (outside_counts.cell_counts() != expected
+        || outside_counts.total() != OutsideDispersers::Count(outside_list.size())
+        || outside_bins.total() != outside_counts.total()) {
+        std::cout << "test_counts_with_model: Counts (" << outside_counts.total()
+                  << ", binned " << outside_bins.total()
+                  << ") differ from the list (" << outside_list.size() << ")\n";
+        ++ret;
+    }
+    return ret;
+}
+
+int main()
+{
+    int ret = 0;
+
+    ret += test_cell_counts();
+    ret += test_binned_counts();
+    ret += test_counts_with_model();
+
+    std::cout << "Test outside dispersers number of errors: " << ret << std::endl;
+    return ret;
+}
+
+#endif  // POPS_TEST
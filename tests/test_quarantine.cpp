@@ -191,11 +191,106 @@ int test_quarantine()
     return err;
 }
 
+int test_quarantine_boundary_distance()
+{
+    int err = 0;
+    // L-shaped area where bbox is far from the actual boundary.
+    Raster<int> areas = {
+        {1, 1, 1, 1, 1},
+        {1, 1, 1, 1, 1},
+        {1, 1, 0, 0, 0},
+        {1, 1, 0, 0, 0},
+        {1, 1, 0, 0, 0}};
+    Raster<int> infected = {
+        {0, 0, 0, 0, 0},
+        {0, 0, 0, 1, 0},
+        {0, 0, 0, 0, 0},
+        {0, 0, 0, 0, 0},
+        {0, 0, 0, 0, 0}};
+    std::vector<std::vector<int>> suitable_cells;
+    for (int i = 0; i < areas.rows(); ++i)
+        for (int j = 0; j < areas.cols(); ++j)
+            suitable_cells.push_back({i, j});
+    QuarantineTestHostPool host_pool(infected, suitable_cells);
+
+    QuarantineEscapeAction<Raster<int>> bbox(
+        areas, 10, 10, 1, "", quarantine_distance_from_string("bbox"));
+    bbox.action(host_pool, areas, 0);
+    if (bbox.escaped(0) || bbox.distance(0) != 10
+        || bbox.direction(0) != Direction::N) {
+        std::cout << "Distance to bbox fails: " << bbox.distance(0) << " "
+                  << bbox.direction(0) << std::endl;
+        err++;
+    }
+    QuarantineEscapeAction<Raster<int>> boundary(
+        areas, 10, 10, 1, "", quarantine_distance_from_string("boundary"));
+    boundary.action(host_pool, areas, 0);
+    if (boundary.escaped(0) || boundary.distance(0) != 0
+        || boundary.direction(0) != Direction::S) {
+        std::cout << "Distance to boundary fails: " << boundary.distance(0) << " "
+                  << boundary.direction(0) << std::endl;
+        err++;
+    }
+    QuarantineEscapeAction<Raster<int>> boundary_ew(
+        areas, 10, 10, 1, "E,W", QuarantineDistance::Boundary);
+    boundary_ew.action(host_pool, areas, 0);
+    if (boundary_ew.escaped(0) || boundary_ew.distance(0) != 10
+        || boundary_ew.direction(0) != Direction::E) {
+        std::cout << "Distance to boundary in E and W fails: "
+                  << boundary_ew.distance(0) << " " << boundary_ew.direction(0)
+                  << std::endl;
+        err++;
+    }
+    try {
+        quarantine_distance_from_string("nearest");
+        std::cout << "Invalid distance type did not throw" << std::endl;
+        err++;
+    }
+    catch (const std::invalid_argument&) {
+    }
+    return err;
+}
+
+/**
+ * Copies of the action share precomputed distances, but keep their own results
+ */
+int test_quarantine_copy()
+{
+    int err = 0;
+    Raster<int> areas = {{1, 1, 1, 0}, {1, 1, 1, 0}, {1, 1, 1, 0}, {0, 0, 0, 0}};
+    Raster<int> infected(4, 4, 0);
+    infected(1, 1) = 1;
+    std::vector<std::vector<int>> suitable_cells;
+    for (int i = 0; i < areas.rows(); ++i)
+        for (int j = 0; j < areas.cols(); ++j)
+            suitable_cells.push_back({i, j});
+    QuarantineTestHostPool host_pool(infected, suitable_cells);
+
+    QuarantineEscapeAction<Raster<int>> original(areas, 10, 10, 2);
+    original.action(host_pool, areas, 0);
+    QuarantineEscapeAction<Raster<int>> copy = original;
+    infected(3, 3) = 1;
+    host_pool.set_infected(infected);
+    copy.action(host_pool, areas, 1);
+    if (!copy.escaped(1) || copy.escaped(0) || copy.distance(0) != 10) {
+        std::cout << "Copy of quarantine action fails: " << copy.escaped(1) << " "
+                  << copy.escaped(0) << " " << copy.distance(0) << std::endl;
+        err++;
+    }
+    if (original.escaped(1) || original.distance(0) != 10) {
+        std::cout << "Original quarantine action changed by the copy" << std::endl;
+        err++;
+    }
+    return err;
+}
+
 int main()
 {
     int num_errors = 0;
 
     num_errors += test_quarantine();
+    num_errors += test_quarantine_boundary_distance();
+    num_errors += test_quarantine_copy();
     std::cout << "Quarantine number of errors: " << num_errors << std::endl;
     return num_errors;
 }
@@ -26,6 +26,7 @@
 #include <pops/raster.hpp>
 #include <pops/simulation.hpp>
 
+#include <cstdint>
 #include <map>
 #include <iostream>
 #include <memory>
@@ -40,6 +41,11 @@ using std::cout;
 using std::cerr;
 using std::endl;
 
+using pops::AlignedAllocator;
+using pops::lazy;
+using pops::PooledAllocator;
+using pops::RasterBufferPool;
+using pops::parallel;
 using pops::Raster;
 
 static void test_constructor_by_type()
@@ -470,6 +476,256 @@ int test_return_from_function_non_owner()
     return errors;
 }
 
+template<typename T, typename U>
+static int test_lazy_same_as_eager()
+{
+    int errors = 0;
+    Raster<T> a = {{1, 2, 3}, {4, 5, 6}};
+    Raster<U> b = {{7, 8, 9}, {10, 11, 12}};
+    Raster<T> c = {{2, 3, 4}, {5, 6, 7}};
+    Raster<typename std::common_type<T, U>::type> eager =
+        2 * (a + b) - c / 2 + 1 - 0.5 * c;
+    Raster<typename std::common_type<T, U>::type> lazy_result =
+        2 * (lazy(a) + b) - lazy(c) / 2 + 1 - 0.5 * lazy(c);
+    if (lazy_result != eager) {
+        std::cout << "Lazy expression differs from eager one:\n"
+                  << lazy_result << eager << std::endl;
+        ++errors;
+    }
+    Raster<T> eager_reversed = 10 - a / 3 * c;
+    Raster<T> lazy_reversed = 10 - lazy(a) / 3 * c;
+    if (lazy_reversed != eager_reversed) {
+        std::cout << "Lazy expression with reversed operands differs from eager one:\n"
+                  << lazy_reversed << eager_reversed << std::endl;
+        ++errors;
+    }
+    return errors;
+}
+
+static int test_lazy_in_place()
+{
+    int errors = 0;
+    Raster<int> a = {{1, 2}, {3, 4}};
+    Raster<int> b = {{5, 6}, {7, 8}};
+    const int* data = a.data();
+    a = lazy(a) * 2 + b;
+    Raster<int> expected = {{7, 10}, {13, 16}};
+    if (a != expected || a.data() != data) {
+        std::cout << "Lazy assignment to the same raster does not work:\n"
+                  << a << expected << std::endl;
+        ++errors;
+    }
+    a -= lazy(b) * 2 - 1;
+    expected = {{-2, -1}, {0, 1}};
+    if (a != expected) {
+        std::cout << "Lazy -= does not work:\n" << a << expected << std::endl;
+        ++errors;
+    }
+    a += lazy(b) * 0;
+    a *= lazy(b) - b + 3;
+    expected = {{-6, -3}, {0, 3}};
+    if (a != expected) {
+        std::cout << "Lazy += or *= does not work:\n" << a << expected << std::endl;
+        ++errors;
+    }
+    Raster<int> c(3, 2, 0);
+    try {
+        c += lazy(a) + b;
+        std::cout << "Lazy += with different sizes did not throw" << std::endl;
+        ++errors;
+    }
+    catch (const std::invalid_argument&) {
+    }
+    try {
+        c = lazy(a) + c;
+        std::cout << "Lazy + with different sizes did not throw" << std::endl;
+        ++errors;
+    }
+    catch (const std::invalid_argument&) {
+    }
+    c = lazy(a) + b;
+    if (c.rows() != 2 || c.cols() != 2) {
+        std::cout << "Lazy assignment did not resize the raster" << std::endl;
+        ++errors;
+    }
+    return errors;
+}
+
+static int test_lazy_parallel()
+{
+    int errors = 0;
+    int rows = 101;
+    int cols = 37;
+    Raster<double> a(rows, cols);
+    Raster<double> b(rows, cols);
+    for (int i = 0; i < rows; ++i) {
+        for (int j = 0; j < cols; ++j) {
+            a(i, j) = i * 0.5 + j;
+            b(i, j) = i - j * 0.25;
+        }
+    }
+    Raster<double> expected = a * b + 2 * a - b / 3;
+    for (unsigned threads : {1u, 2u, 3u, 8u}) {
+        Raster<double> result =
+            parallel(lazy(a) * b + 2 * lazy(a) - lazy(b) / 3, threads, 0);
+        if (result != expected) {
+            std::cout << "Parallel lazy expression with " << threads
+                      << " threads differs from eager one" << std::endl;
+            ++errors;
+        }
+        result = parallel(lazy(result) * 2, threads, 10);
+        result -= parallel(lazy(expected) * 1, threads, 10);
+        if (result != expected) {
+            std::cout << "Parallel lazy in-place evaluation with " << threads
+                      << " threads does not work" << std::endl;
+            ++errors;
+        }
+    }
+    return errors;
+}
+
+static int test_copy_assignment_reuses_storage()
+{
+    int errors = 0;
+    Raster<double> a = {{1, 2}, {3, 4}};
+    Raster<double> b = {{5, 6}, {7, 8}};
+    const double* data = a.data();
+    a = b;
+    if (a != b || a.data() != data) {
+        std::cout << "Copy assignment of same size did not reuse storage" << std::endl;
+        ++errors;
+    }
+    Raster<double> c = {{1, 2, 3}};
+    a = c;
+    if (a != c || a.rows() != 1 || a.cols() != 3) {
+        std::cout << "Copy assignment of different size does not work" << std::endl;
+        ++errors;
+    }
+    return errors;
+}
+
+static int test_aligned_allocator()
+{
+    int errors = 0;
+    using AlignedRaster = Raster<double, int, AlignedAllocator<double>>;
+    for (int size : {1, 3, 17, 100}) {
+        AlignedRaster a(size, size, 1);
+        AlignedRaster b = a * 2;
+        AlignedRaster c = lazy(a) + b;
+        for (const AlignedRaster* raster : {&a, &b, &c}) {
+            if (reinterpret_cast<std::uintptr_t>(raster->data()) % 64) {
+                std::cout << "Raster storage is not aligned to 64 bytes" << std::endl;
+                ++errors;
+            }
+        }
+        if (c != AlignedRaster(size, size, 3)) {
+            std::cout << "Operations with aligned rasters do not work" << std::endl;
+            ++errors;
+        }
+    }
+    return errors;
+}
+
+static int test_pooled_allocator()
+{
+    int errors = 0;
+    RasterBufferPool pool;
+    using PooledRaster = Raster<int, int, PooledAllocator<int>>;
+    PooledAllocator<int> allocator(pool);
+    PooledRaster total(10, 20, 0, allocator);
+    for (int replicate = 0; replicate < 5; ++replicate) {
+        PooledRaster infected(10, 20, replicate, allocator);
+        PooledRaster susceptible(10, 20, 10, allocator);
+        PooledRaster hosts = infected + susceptible;
+        total += hosts;
+    }
+    // Three rasters in the first replicate, one for total, none afterwards.
+    if (pool.allocated_buffers() != 4) {
+        std::cout << "Pool allocated " << pool.allocated_buffers()
+                  << " buffers instead of 4" << std::endl;
+        ++errors;
+    }
+    if (pool.cached_buffers() != 3) {
+        std::cout << "Pool has " << pool.cached_buffers()
+                  << " buffers cached instead of 3" << std::endl;
+        ++errors;
+    }
+    if (total != PooledRaster(10, 20, 60, allocator)) {
+        std::cout << "Operations with pooled rasters do not work:\n" << total;
+        ++errors;
+    }
+    pool.clear();
+    if (pool.cached_buffers() != 0) {
+        std::cout << "Pool not empty after clear" << std::endl;
+        ++errors;
+    }
+    return errors;
+}
+
+static int test_pooled_allocator_construction()
+{
+    int errors = 0;
+    RasterBufferPool pool;
+    using PooledRaster = Raster<double, int, PooledAllocator<double>>;
+    PooledAllocator<double> allocator(pool);
+    PooledRaster a(4, 5, 1.5, allocator);
+    // Result of an expression uses the pool of a raster in the expression.
+    PooledRaster b = lazy(a) + a;
+    PooledRaster c = 2 * lazy(a) - 1;
+    if (b.get_allocator() != allocator || c.get_allocator() != allocator) {
+        std::cout << "Expression result does not use pool of its operand" << std::endl;
+        ++errors;
+    }
+    if (b != PooledRaster(4, 5, 3, allocator)
+        || c != PooledRaster(4, 5, 2, allocator)) {
+        std::cout << "Expressions with pooled rasters do not work:\n" << b << c;
+        ++errors;
+    }
+    // Pool of a raster with a different type is used too.
+    Raster<int, int, PooledAllocator<int>> counts(4, 5, 2, PooledAllocator<int>(pool));
+    PooledRaster d = lazy(counts) * 0.5;
+    if (d.get_allocator() != allocator) {
+        std::cout << "Expression result does not use pool of other type" << std::endl;
+        ++errors;
+    }
+    // Default-constructed rasters use the default pool.
+    PooledRaster e;
+    e = a;
+    if (e != a
+        || e.get_allocator()
+               != PooledAllocator<double>(RasterBufferPool::default_pool())) {
+        std::cout << "Copy to default-constructed pooled raster does not work:\n"
+                  << e;
+        ++errors;
+    }
+    double values[] = {1, 2, 3, 4};
+    PooledRaster f(values, 2, 2);
+    PooledRaster g = lazy(f) + f;
+    if (g(1, 1) != 8) {
+        std::cout << "Non-owning pooled raster does not work:\n" << g;
+        ++errors;
+    }
+    return errors;
+}
+
+static int test_size_type()
+{
+    int errors = 0;
+    // Non-owning raster, so no memory is allocated.
+    char value = 0;
+    Raster<char> a(&value, 50000, 60000);
+    if (a.size() != Raster<char>::SizeType(3000000000ull)) {
+        std::cout << "Size of a large raster overflows: " << a.size() << std::endl;
+        ++errors;
+    }
+    Raster<int> b(3, 4);
+    if (b.size() != 12) {
+        std::cout << "Wrong raster size: " << b.size() << std::endl;
+        ++errors;
+    }
+    return errors;
+}
+
 int main()
 {
     test_constructor_by_type();
@@ -540,7 +796,20 @@ int main()
     test_return_from_function_non_owner<float, long>();
     test_return_from_function_non_owner<double, int>();
 
-    return 0;
+    int ret = 0;
+    ret += test_lazy_same_as_eager<int, int>();
+    ret += test_lazy_same_as_eager<double, int>();
+    ret += test_lazy_same_as_eager<int, double>();
+    ret += test_lazy_in_place();
+    ret += test_lazy_parallel();
+    ret += test_copy_assignment_reuses_storage();
+    ret += test_aligned_allocator();
+    ret += test_pooled_allocator();
+    ret += test_pooled_allocator_construction();
+    ret += test_size_type();
+
+    std::cout << "Test raster number of errors: " << ret << std::endl;
+    return ret;
 }
 
 #endif  // POPS_TEST
@@ -244,6 +244,65 @@ int test_schedule_action_date()
     return num_errors;
 }
 
+int test_schedule_action_date_daily()
+{
+    int num_errors = 0;
+
+    Date st(2000, 1, 1);
+    Date end(2039, 12, 31);
+
+    for (unsigned num_days : {1, 5, 23}) {
+        Scheduler scheduler(st, end, StepUnit::Day, num_days);
+        unsigned step = 0;
+        for (Date date(st); date <= end; date.add_day()) {
+            if (date > scheduler.get_step(step).end_date())
+                ++step;
+            unsigned n = scheduler.schedule_action_date(date);
+            if (n != step) {
+                std::cout << "Failed scheduling of date action for " << date
+                          << " with " << num_days << " days step: " << n
+                          << " (expected " << step << ")" << std::endl;
+                num_errors++;
+                break;
+            }
+        }
+        try {
+            scheduler.schedule_action_date(Date(1999, 12, 31));
+            std::cout << "Date before simulation was scheduled" << std::endl;
+            num_errors++;
+        }
+        catch (const std::invalid_argument&) {
+        }
+        Date after = scheduler.get_step(scheduler.get_num_steps() - 1).end_date();
+        after.add_day();
+        try {
+            scheduler.schedule_action_date(after);
+            std::cout << "Date after simulation was scheduled" << std::endl;
+            num_errors++;
+        }
+        catch (const std::invalid_argument&) {
+        }
+    }
+    // February 29 in a common year is after February 28 and before March 1.
+    Scheduler monthly(st, end, StepUnit::Month, 1);
+    try {
+        monthly.schedule_action_date(Date(2001, 2, 29));
+        std::cout << "Non-existent date was scheduled" << std::endl;
+        num_errors++;
+    }
+    catch (const std::invalid_argument&) {
+    }
+    Scheduler weekly(st, end, StepUnit::Week, 1);
+    unsigned n = weekly.schedule_action_date(Date(2001, 2, 29));
+    if (n != weekly.schedule_action_date(Date(2001, 2, 28))) {
+        std::cout << "Failed scheduling of non-existent date" << std::endl;
+        weekly.debug_schedule(n);
+        num_errors++;
+    }
+
+    return num_errors;
+}
+
 int test_schedule_end_of_simulation()
 {
     int num_errors = 0;
@@ -282,6 +341,56 @@ int test_simulation_step_to_action_step()
     return num_errors;
 }
 
+int test_action_schedule()
+{
+    int num_errors = 0;
+
+    Date st(2020, 1, 1);
+    Date end(2021, 12, 31);
+
+    Scheduler scheduler(st, end, StepUnit::Month, 1);
+    for (const auto& schedule :
+         {scheduler.schedule_action_yearly(4, 5),
+          scheduler.schedule_action_nsteps(5),
+          scheduler.schedule_action_end_of_simulation()}) {
+        ActionSchedule action_schedule(schedule);
+        if (action_schedule.num_steps() != schedule.size()
+            || action_schedule.num_actions()
+                   != get_number_of_scheduled_actions(schedule)) {
+            std::cout << "Failed ActionSchedule number of steps or actions"
+                      << std::endl;
+            num_errors++;
+        }
+        for (unsigned step = 0; step < schedule.size(); ++step) {
+            if (action_schedule.is_scheduled(step) != schedule[step]
+                || action_schedule.action_step(step)
+                       != simulation_step_to_action_step(schedule, step)) {
+                std::cout << "Failed ActionSchedule at step " << step << std::endl;
+                num_errors++;
+            }
+        }
+        if (action_schedule.is_scheduled(unsigned(schedule.size()))) {
+            std::cout << "Failed ActionSchedule after last step" << std::endl;
+            num_errors++;
+        }
+        try {
+            action_schedule.action_step(unsigned(schedule.size()));
+            std::cout << "Failed ActionSchedule no exception after last step"
+                      << std::endl;
+            num_errors++;
+        }
+        catch (const std::out_of_range&) {
+        }
+    }
+    ActionSchedule empty;
+    if (empty.is_scheduled(0) || empty.num_actions() || empty.num_steps()) {
+        std::cout << "Failed empty ActionSchedule" << std::endl;
+        num_errors++;
+    }
+
+    return num_errors;
+}
+
 int test_get_number_of_scheduled_actions()
 {
     int num_errors = 0;
@@ -436,9 +545,11 @@ int main()
     num_errors += test_schedule_action_end_of_year();
     num_errors += test_schedule_action_nsteps();
     num_errors += test_schedule_action_date();
+    num_errors += test_schedule_action_date_daily();
     num_errors += test_schedule_end_of_simulation();
     num_errors += test_schedule_action_monthly();
     num_errors += test_simulation_step_to_action_step();
+    num_errors += test_action_schedule();
     num_errors += test_get_number_of_scheduled_actions();
     num_errors += test_unit_enum_from_string();
     num_errors += test_get_step_length();
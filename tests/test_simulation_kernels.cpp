@@ -517,8 +517,14 @@ int test_simulation_with_kernels(
             create_static_kernel<Raster<int>, int>, steps, kernel_type);
     }
     else if (command == "dynamic") {
+        // Kernels are created without shared windows of deterministic kernels.
         ret += test_simulation_with_kernels_generic(
-            create_dynamic_kernel<std::default_random_engine, Raster<int>, int>,
+            [](const Config& config,
+               const Raster<int>& dispersers,
+               const Network<int>& network) {
+                return create_dynamic_kernel<std::default_random_engine>(
+                    config, dispersers, network);
+            },
             steps,
             kernel_type);
     }
@@ -23,6 +23,8 @@
  * along with PoPS. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <array>
+
 #include "pops/model.hpp"
 
 using namespace pops;
@@ -119,6 +121,279 @@ int test_soils_weather()
     return ret;
 }
 
+using TestSoilPool = SoilPool<
+    Raster<int>,
+    Raster<double>,
+    Raster<double>::IndexType,
+    DefaultSingleGeneratorProvider>;
+using TestEnvironment = Environment<
+    Raster<int>,
+    Raster<double>,
+    Raster<double>::IndexType,
+    DefaultSingleGeneratorProvider>;
+
+/**
+ * Compare all cohorts of a sparse pool with a pool using rasters
+ */
+int compare_soil_pools(
+    const TestSoilPool& sparse, const TestSoilPool& dense, const std::string& name)
+{
+    int ret = 0;
+    for (int row = 0; row < 3; ++row) {
+        for (int col = 0; col < 3; ++col) {
+            for (int index = 0; index < dense.num_cohorts(); ++index) {
+                if (sparse.cohort_at(index, row, col)
+                    != dense.cohort_at(index, row, col)) {
+                    std::cerr << name << ": cohort " << index << " at (" << row
+                              << ", " << col << ") is "
+                              << sparse.cohort_at(index, row, col) << " (expected "
+                              << dense.cohort_at(index, row, col) << ")\n";
+                    ++ret;
+                }
+            }
+            if (sparse.total_at(row, col) != dense.total_at(row, col)) {
+                std::cerr << name << ": total at (" << row << ", " << col << ") is "
+                          << sparse.total_at(row, col) << " (expected "
+                          << dense.total_at(row, col) << ")\n";
+                ++ret;
+            }
+        }
+    }
+    return ret;
+}
+
+/**
+ * Test that sparse storage ages cohorts as the rasters
+ */
+int test_sparse_soils_aging()
+{
+    int ret = 0;
+    std::vector<Raster<int>> rasters(3, Raster<int>(3, 3, 0));
+    TestEnvironment environment;
+    TestSoilPool dense{rasters, environment, false, false, 1};
+    TestSoilPool sparse{3, 3, 3, environment, false, false, 1};
+    std::default_random_engine generator;
+    Raster<double> weather(3, 3, 1);
+    environment.update_weather_coefficient(weather);
+
+    int step = 0;
+    for (auto pool : {&dense, &sparse}) {
+        pool->dispersers_to(5, 1, 2, generator);
+        pool->next_step(step);
+        pool->dispersers_to(3, 1, 2, generator);
+        pool->dispersers_to(2, 0, 0, generator);
+        pool->next_step(step);
+        pool->dispersers_to(4, 1, 2, generator);
+    }
+    ret += compare_soil_pools(sparse, dense, "test_sparse_soils_aging");
+    if (sparse.total_at(1, 2) != 12) {
+        std::cerr << "test_sparse_soils_aging: total is " << sparse.total_at(1, 2)
+                  << " (expected 12)\n";
+        ++ret;
+    }
+    // The oldest cohort disappears.
+    dense.next_step(step);
+    sparse.next_step(step);
+    ret += compare_soil_pools(sparse, dense, "test_sparse_soils_aging (aged)");
+    for (int i = 0; i < 3; ++i) {
+        dense.next_step(step);
+        sparse.next_step(step);
+    }
+    ret += compare_soil_pools(sparse, dense, "test_sparse_soils_aging (expired)");
+    if (sparse.total_at(1, 2) != 0 || sparse.dispersers_from(1, 2, generator) != 0) {
+        std::cerr << "test_sparse_soils_aging: dispersers after all expired\n";
+        ++ret;
+    }
+    // Dispersers are added to the youngest cohort again.
+    sparse.dispersers_to(7, 1, 2, generator);
+    if (sparse.cohort_at(2, 1, 2) != 7) {
+        std::cerr << "test_sparse_soils_aging: youngest cohort is "
+                  << sparse.cohort_at(2, 1, 2) << " (expected 7)\n";
+        ++ret;
+    }
+    return ret;
+}
+
+/**
+ * Test release of dispersers from sparse storage
+ */
+int test_sparse_soils_release()
+{
+    int ret = 0;
+    TestEnvironment environment;
+    TestSoilPool soils{3, 3, 4, environment, false, false, 1};
+    std::default_random_engine generator;
+    Raster<double> weather(3, 3, 1);
+    Raster<double> half_weather(3, 3, 0.5);
+    environment.update_weather_coefficient(weather);
+
+    int step = 0;
+    for (int dispersers : {10, 6, 8}) {
+        soils.dispersers_to(dispersers, 2, 1, generator);
+        soils.next_step(step);
+    }
+    environment.update_weather_coefficient(half_weather);
+    int released = soils.dispersers_from(2, 1, generator);
+    if (released != 12 || soils.total_at(2, 1) != 12) {
+        std::cerr << "test_sparse_soils_release: released " << released << " and kept "
+                  << soils.total_at(2, 1) << " (expected 12 and 12)\n";
+        ++ret;
+    }
+    int sum = 0;
+    for (int index = 0; index < soils.num_cohorts(); ++index) {
+        int count = soils.cohort_at(index, 2, 1);
+        if (count < 0) {
+            std::cerr << "test_sparse_soils_release: cohort " << index << " is "
+                      << count << "\n";
+            ++ret;
+        }
+        sum += count;
+    }
+    if (sum != soils.total_at(2, 1)) {
+        std::cerr << "test_sparse_soils_release: sum of cohorts is " << sum
+                  << " (expected " << soils.total_at(2, 1) << ")\n";
+        ++ret;
+    }
+    environment.update_weather_coefficient(weather);
+    released = soils.dispersers_from(2, 1, generator);
+    if (released != 12 || soils.total_at(2, 1) != 0) {
+        std::cerr << "test_sparse_soils_release: released " << released << " and kept "
+                  << soils.total_at(2, 1) << " (expected 12 and 0)\n";
+        ++ret;
+    }
+    return ret;
+}
+
+/**
+ * Test that batch establishment and release have the expected means
+ */
+int test_sparse_soils_stochastic()
+{
+    int ret = 0;
+    int size = 40;
+    TestEnvironment environment;
+    TestSoilPool soils{size, size, 2, environment};
+    std::default_random_engine generator(42);
+    double probability = 0.3;
+    Raster<double> weather(size, size, probability);
+    environment.update_weather_coefficient(weather);
+
+    int dispersers = 100;
+    double established = 0;
+    for (int row = 0; row < size; ++row) {
+        for (int col = 0; col < size; ++col) {
+            soils.dispersers_to(dispersers, row, col, generator);
+            established += soils.total_at(row, col);
+        }
+    }
+    double cells = size * size;
+    double expected = dispersers * probability;
+    if (std::abs(established / cells - expected) > 0.5) {
+        std::cerr << "test_sparse_soils_stochastic: mean established is "
+                  << established / cells << " (expected " << expected << ")\n";
+        ++ret;
+    }
+    double released = 0;
+    for (int row = 0; row < size; ++row) {
+        for (int col = 0; col < size; ++col) {
+            int before = soils.total_at(row, col);
+            int count = soils.dispersers_from(row, col, generator);
+            if (soils.total_at(row, col) != std::max(before - count, 0)) {
+                std::cerr << "test_sparse_soils_stochastic: " << before << " - "
+                          << count << " gives " << soils.total_at(row, col) << "\n";
+                return ++ret;
+            }
+            released += count;
+        }
+    }
+    expected = established * probability;
+    if (std::abs(released - expected) > 0.02 * expected) {
+        std::cerr << "test_sparse_soils_stochastic: released " << released
+                  << " (expected " << expected << ")\n";
+        ++ret;
+    }
+    return ret;
+}
+
+/**
+ * Test drawing of hypergeometric distribution
+ */
+int test_draw_hypergeometric()
+{
+    int ret = 0;
+    std::default_random_engine generator(42);
+    if (draw_hypergeometric(10, 4, 10, generator) != 4
+        || draw_hypergeometric(10, 4, 0, generator) != 0
+        || draw_hypergeometric(10, 0, 5, generator) != 0
+        || draw_hypergeometric(10, 8, 5, generator) < 3) {
+        std::cerr << "test_draw_hypergeometric: Wrong value in limit cases\n";
+        ++ret;
+    }
+    int total = 50;
+    int successes = 20;
+    int draws = 10;
+    int repetitions = 20000;
+    double sum = 0;
+    for (int i = 0; i < repetitions; ++i) {
+        int value = draw_hypergeometric(total, successes, draws, generator);
+        if (value < 0 || value > draws) {
+            std::cerr << "test_draw_hypergeometric: Value " << value
+                      << " out of range\n";
+            return ++ret;
+        }
+        sum += value;
+    }
+    double expected = double(draws) * successes / total;
+    if (std::abs(sum / repetitions - expected) > 0.05) {
+        std::cerr << "test_draw_hypergeometric: Mean is " << sum / repetitions
+                  << " (expected " << expected << ")\n";
+        ++ret;
+    }
+    return ret;
+}
+
+/**
+ * Test mean and variance of hypergeometric distribution for large counts
+ */
+int test_draw_hypergeometric_large()
+{
+    int ret = 0;
+    std::default_random_engine generator(42);
+    // total, successes, draws
+    std::vector<std::array<int, 3>> cases = {
+        {4000, 2000, 2000}, {40000, 20000, 20000}, {100000, 30000, 500},
+        {1000000, 999000, 5000}};
+    int repetitions = 4000;
+    for (const auto& item : cases) {
+        double total = item[0];
+        double successes = item[1];
+        double draws = item[2];
+        double sum = 0;
+        double sum_of_squares = 0;
+        for (int i = 0; i < repetitions; ++i) {
+            double value = draw_hypergeometric(item[0], item[1], item[2], generator);
+            sum += value;
+            sum_of_squares += value * value;
+        }
+        double mean = sum / repetitions;
+        double variance = sum_of_squares / repetitions - mean * mean;
+        double expected_mean = draws * successes / total;
+        double expected_variance = draws * successes / total * (1 - successes / total)
+                                   * (total - draws) / (total - 1);
+        // Allow about four standard errors for mean and 10% for variance.
+        if (std::abs(mean - expected_mean)
+                > 4 * std::sqrt(expected_variance / repetitions)
+            || std::abs(variance - expected_variance) > 0.1 * expected_variance) {
+            std::cerr << "test_draw_hypergeometric_large: For (" << item[0] << ", "
+                      << item[1] << ", " << item[2] << ") mean is " << mean
+                      << " and variance is " << variance << " (expected "
+                      << expected_mean << " and " << expected_variance << ")\n";
+            ++ret;
+        }
+    }
+    return ret;
+}
+
 /**
  * Test soils runs together with model
  *
@@ -258,6 +533,107 @@ int test_soil_with_model()
     return ret;
 }
 
+/**
+ * Test sparse soils runs together with model
+ *
+ * Dispersers in the first cell are generated before any random numbers are used
+ * for the soil, so the first cell has the same youngest cohort as with rasters.
+ */
+int test_sparse_soil_with_model()
+{
+    int ret = 0;
+
+    Config config;
+    config.model_type = "SI";
+    config.reproductive_rate = 2;
+    config.establishment_probability = 1;
+    config.random_seed = 42;
+    config.natural_scale = 0.9;
+    config.natural_kernel_type = "cauchy";
+    config.dispersers_to_soils_percentage = 1.0;
+    config.use_anthropogenic_kernel = false;
+    config.anthro_scale = 0.9;
+    config.anthro_kappa = 0;
+    config.ew_res = 30;
+    config.ns_res = 30;
+    config.rows = 3;
+    config.cols = 3;
+    config.create_schedules();
+
+    Raster<double> weather = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+    Raster<int> zeros(config.rows, config.cols, 0);
+    std::vector<Raster<int>> empty_integer;
+    std::vector<Raster<double>> empty_floats;
+    std::vector<std::vector<int>> movements = {};
+    QuarantineEscapeAction<Raster<int>> quarantine(
+        zeros, config.ew_res, config.ns_res, 0);
+
+    auto run = [&](Model<Raster<int>, Raster<double>, Raster<double>::IndexType>&
+                       model) {
+        Raster<int> infected = {{5, 0, 0}, {0, 5, 0}, {0, 0, 2}};
+        Raster<int> susceptible = {{10, 20, 9}, {14, 15, 0}, {3, 0, 2}};
+        Raster<int> total_populations = {{20, 20, 20}, {20, 20, 20}, {20, 20, 20}};
+        Raster<int> total_hosts = susceptible + infected;
+        std::vector<std::vector<int>> suitable_cells =
+            find_suitable_cells<Raster<int>::IndexType, Raster<int>>(total_hosts);
+        Raster<int> dispersers(config.rows, config.cols);
+        Raster<int> established_dispersers(config.rows, config.cols);
+        std::vector<std::tuple<int, int>> outside_dispersers;
+        Raster<int> total_exposed(config.rows, config.cols, 0);
+        Raster<int> died(config.rows, config.cols, 0);
+        std::vector<Raster<int>> mortality_tracker(1, zeros);
+        model.environment().update_weather_coefficient(weather);
+        model.run_step(
+            0,
+            infected,
+            susceptible,
+            total_populations,
+            total_hosts,
+            dispersers,
+            established_dispersers,
+            total_exposed,
+            empty_integer,
+            mortality_tracker,
+            died,
+            empty_floats,
+            empty_floats,
+            zeros,
+            outside_dispersers,
+            quarantine,
+            zeros,
+            movements,
+            Network<int>::null_network(),
+            suitable_cells);
+    };
+
+    Model<Raster<int>, Raster<double>, Raster<double>::IndexType> model{config};
+    std::vector<Raster<int>> soil_reservoir(2, zeros);
+    model.activate_soils(soil_reservoir);
+    run(model);
+    Model<Raster<int>, Raster<double>, Raster<double>::IndexType> sparse_model{config};
+    sparse_model.activate_soils(2);
+    run(sparse_model);
+    const auto& soils = *sparse_model.soil_pool();
+
+    if (soils.cohort_at(1, 0, 0) != soil_reservoir[1](0, 0)) {
+        std::cerr << "test_sparse_soil_with_model: cohort at (0, 0) is "
+                  << soils.cohort_at(1, 0, 0) << " (expected "
+                  << soil_reservoir[1](0, 0) << ")\n";
+        ++ret;
+    }
+    for (int row = 0; row < config.rows; ++row) {
+        for (int col = 0; col < config.cols; ++col) {
+            if (soils.cohort_at(0, row, col) != 0
+                || (weather(row, col) == 0 && soils.total_at(row, col) != 0)) {
+                std::cerr << "test_sparse_soil_with_model: Unexpected dispersers at ("
+                          << row << ", " << col << ")\n";
+                ++ret;
+            }
+        }
+    }
+    return ret;
+}
+
 int main()
 {
     int ret = 0;
@@ -265,6 +641,12 @@ int main()
     ret += test_soils();
     ret += test_soils_weather();
     ret += test_soil_with_model();
+    ret += test_sparse_soils_aging();
+    ret += test_sparse_soils_release();
+    ret += test_sparse_soils_stochastic();
+    ret += test_draw_hypergeometric();
+    ret += test_draw_hypergeometric_large();
+    ret += test_sparse_soil_with_model();
 
     return ret;
 }
@@ -0,0 +1,515 @@
+#ifdef POPS_TEST
+
+/*
+ * Tests for the PoPS spatial decomposition and spread in tiles.
+ *
+ * Copyright (C) 2023 by the authors.
+ *
+ * Authors: Vaclav Petras <wenzeslaus gmail com>
+ *
+ * This file is part of PoPS.
+
+ * PoPS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+
+ * PoPS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PoPS. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+#include <pops/counter_based_generator.hpp>
+#include <pops/infection_tracker.hpp>
+#include <pops/model.hpp>
+#include <pops/raster.hpp>
+#include <pops/spatial_decomposition.hpp>
+
+using namespace pops;
+using std::cout;
+
+int test_decomposition()
+{
+    int ret = 0;
+    SpatialDecomposition<int> decomposition(10, 7, 4);
+    if (decomposition.num_tiles() != 6) {
+        cout << "decomposition: Wrong number of tiles: " << decomposition.num_tiles()
+             << "\n";
+        return ++ret;
+    }
+    const auto& last = decomposition.tiles().back();
+    if (last.row_begin != 8 || last.row_end != 10 || last.col_begin != 4
+        || last.col_end != 7) {
+        cout << "decomposition: Wrong extent of the last tile: " << last.row_begin
+             << "-" << last.row_end << ", " << last.col_begin << "-" << last.col_end
+             << "\n";
+        ++ret;
+    }
+    std::vector<std::vector<int>> cells;
+    for (int row = 0; row < 10; ++row)
+        for (int col = 0; col < 7; ++col)
+            cells.push_back({row, col});
+    decomposition.assign_cells(cells);
+    std::size_t total = 0;
+    for (std::size_t index = 0; index < decomposition.num_tiles(); ++index) {
+        const auto& tile = decomposition.tiles()[index];
+        total += tile.cells.size();
+        for (const auto& cell : tile.cells) {
+            if (cell[0] < tile.row_begin || cell[0] >= tile.row_end
+                || cell[1] < tile.col_begin || cell[1] >= tile.col_end
+                || decomposition.tile_at(cell[0], cell[1]) != index) {
+                cout << "decomposition: Cell (" << cell[0] << ", " << cell[1]
+                     << ") assigned to a wrong tile " << index << "\n";
+                ++ret;
+            }
+        }
+    }
+    if (total != cells.size()) {
+        cout << "decomposition: Assigned " << total << " cells instead of "
+             << cells.size() << "\n";
+        ++ret;
+    }
+    try {
+        SpatialDecomposition<int> invalid(10, 7, 0);
+        cout << "decomposition: No exception for zero tile size\n";
+        ++ret;
+    }
+    catch (const std::invalid_argument&) {
+    }
+    return ret;
+}
+
+int test_parallel_for_each_index()
+{
+    int ret = 0;
+    std::vector<int> visits(100, 0);
+    parallel_for_each_index(visits.size(), 4, [&visits](std::size_t index, unsigned) {
+        ++visits[index];
+    });
+    for (std::size_t index = 0; index < visits.size(); ++index) {
+        if (visits[index] != 1) {
+            cout << "parallel_for_each_index: Index " << index << " visited "
+                 << visits[index] << " times\n";
+            ++ret;
+        }
+    }
+    try {
+        parallel_for_each_index(10, 3, [](std::size_t index, unsigned) {
+            if (index == 5)
+                throw std::runtime_error("Failed");
+        });
+        cout << "parallel_for_each_index: Exception not propagated\n";
+        ++ret;
+    }
+    catch (const std::runtime_error&) {
+    }
+    return ret;
+}
+
+/**
+ * Results of one model run with spread in tiles
+ */
+struct TiledSpreadResult
+{
+    Raster<int> infected;
+    Raster<int> susceptible;
+    Raster<int> established_dispersers;
+    std::vector<std::tuple<int, int>> outside_dispersers;
+};
+
+/**
+ * Run SI model with soils and spread in tiles
+ *
+ * When *outside_counts* is provided, the dispersers which left the area are
+ * counted there instead of listed in the result.
+ */
+TiledSpreadResult run_model_in_tiles(
+    int tile_size,
+    unsigned threads,
+    bool track,
+    const std::string& streams,
+    OutsideDispersers* outside_counts = nullptr,
+    unsigned replicate = 0)
+{
+    int size = 11;
+    Raster<int> infected(size, size, 0);
+    infected(5, 5) = 20;
+    infected(1, 8) = 6;
+    Raster<int> susceptible(size, size, 50);
+    susceptible(3, 3) = 0;
+    Raster<int> total_hosts = susceptible + infected;
+    Raster<int> total_populations = total_hosts;
+    Raster<int> dispersers(size, size, 0);
+    Raster<int> established_dispersers(size, size, 0);
+    std::vector<std::tuple<int, int>> outside_dispersers;
+    std::vector<std::vector<int>> suitable_cells;
+    for (int row = 0; row < size; ++row)
+        for (int col = 0; col < size; ++col)
+            if (total_hosts(row, col) > 0)
+                suitable_cells.push_back({row, col});
+
+    Config config;
+    config.random_seed = 7;
+    config.reproductive_rate = 1.5;
+    config.natural_kernel_type = "cauchy";
+    config.natural_direction = "none";
+    config.natural_scale = 12;
+    config.anthro_scale = 12;
+    config.use_anthropogenic_kernel = false;
+    config.rows = size;
+    config.cols = size;
+    config.ew_res = 10;
+    config.ns_res = 10;
+    config.model_type = "SI";
+    config.set_date_start(2020, 1, 1);
+    config.set_date_end(2020, 12, 31);
+    config.set_step_unit(StepUnit::Month);
+    config.set_step_num_units(1);
+    config.use_spreadrates = true;
+    config.dispersers_to_soils_percentage = 0.2;
+    config.spread_tile_size = tile_size;
+    config.spread_threads = threads;
+    config.spread_random_streams = streams;
+    config.replicate = replicate;
+    config.create_schedules();
+
+    using TestModel = Model<Raster<int>, Raster<double>, int>;
+    TestModel model{config};
+    std::vector<Raster<int>> soil_reservoirs(2, Raster<int>(size, size, 0));
+    Raster<double> weather(size, size, 0.8);
+    model.environment().update_weather_coefficient(weather);
+    model.activate_soils(soil_reservoirs);
+
+    std::vector<Raster<int>> mortality_tracker;
+    Raster<int> died(size, size, 0);
+    Raster<int> total_exposed(size, size, 0);
+    Raster<int> resistant(size, size, 0);
+    std::vector<Raster<int>> exposed;
+    std::vector<Raster<double>> empty_floats;
+    std::vector<std::vector<int>> movements;
+
+    TestModel::StandardSingleHostPool host_pool(
+        config,
+        susceptible,
+        exposed,
+        infected,
+        total_exposed,
+        resistant,
+        mortality_tracker,
+        died,
+        total_hosts,
+        model.environment(),
+        suitable_cells);
+    std::vector<TestModel::StandardSingleHostPool*> host_pools = {&host_pool};
+    TestModel::StandardMultiHostPool multi_host_pool(host_pools, config);
+    TestModel::StandardPestPool pest_pool =
+        outside_counts ? TestModel::StandardPestPool(
+            dispersers, established_dispersers, *outside_counts)
+                       : TestModel::StandardPestPool(
+                           dispersers, established_dispersers, outside_dispersers);
+    SpreadRateAction<TestModel::StandardMultiHostPool, int> spread_rate(
+        multi_host_pool, size, size, config.ew_res, config.ns_res, 0);
+    // The tracker is an infection observer in the host pool.
+    InfectionExtentTracker<int> tracker(size, size);
+    if (track) {
+        multi_host_pool.add_infection_observer(tracker);
+        spread_rate.track_infection(tracker);
+    }
+    Raster<int> quarantine_areas(size, size, 0);
+    QuarantineEscapeAction<Raster<int>> quarantine(
+        quarantine_areas, config.ew_res, config.ns_res, 0);
+    Treatments<TestModel::StandardSingleHostPool, Raster<double>> treatments(
+        config.scheduler());
+
+    for (unsigned step = 0; step < config.scheduler().get_num_steps(); ++step) {
+        model.run_step(
+            step,
+            multi_host_pool,
+            pest_pool,
+            total_populations,
+            treatments,
+            empty_floats,
+            empty_floats,
+            spread_rate,
+            quarantine,
+            quarantine_areas,
+            movements,
+            Network<int>::null_network());
+    }
+    return {infected, susceptible, established_dispersers, outside_dispersers};
+}
+
+int compare_results(
+    const TiledSpreadResult& actual,
+    const TiledSpreadResult& expected,
+    const std::string& name)
+{
+    int ret = 0;
+    if (actual.infected != expected.infected) {
+        cout << name << ": Infected differ (actual, expected):\n"
+             << actual.infected << "  !=\n"
+             << expected.infected << "\n";
+        ++ret;
+    }
+    if (actual.susceptible != expected.susceptible) {
+        cout << name << ": Susceptible differ (actual, expected):\n"
+             << actual.susceptible << "  !=\n"
+             << expected.susceptible << "\n";
+        ++ret;
+    }
+    if (actual.established_dispersers != expected.established_dispersers) {
+        cout << name << ": Established dispersers differ (actual, expected):\n"
+             << actual.established_dispersers << "  !=\n"
+             << expected.established_dispersers << "\n";
+        ++ret;
+    }
+    if (actual.outside_dispersers != expected.outside_dispersers) {
+        cout << name << ": Outside dispersers differ ("
+             << actual.outside_dispersers.size()
+             << " != " << expected.outside_dispersers.size() << ")\n";
+        ++ret;
+    }
+    return ret;
+}
+
+int test_tile_streams_independent_of_threads()
+{
+    int ret = 0;
+    auto expected = run_model_in_tiles(4, 1, false, "tile");
+    int total_infected = 0;
+    for (int row = 0; row < expected.infected.rows(); ++row)
+        for (int col = 0; col < expected.infected.cols(); ++col)
+            total_infected += expected.infected(row, col);
+    if (total_infected <= 26) {
+        cout << "tile_streams: No new infections (total infected: " << total_infected
+             << ")\n";
+        ++ret;
+    }
+    if (expected.outside_dispersers.empty()) {
+        cout << "tile_streams: No dispersers left the area\n";
+        ++ret;
+    }
+    for (unsigned threads : {2u, 3u, 8u, 0u}) {
+        ret += compare_results(
+            run_model_in_tiles(4, threads, false, "tile"),
+            expected,
+            "tile_streams (" + std::to_string(threads) + " threads)");
+    }
+    // With observers, establishment is done in one thread.
+    ret += compare_results(
+        run_model_in_tiles(4, 3, true, "tile"), expected, "tile_streams (tracking)");
+    return ret;
+}
+
+int test_cell_streams_independent_of_tiles_and_threads()
+{
+    int ret = 0;
+    auto expected = run_model_in_tiles(4, 1, false, "cell");
+    for (int tile_size : {1, 3, 4, 5, 100}) {
+        for (unsigned threads : {1u, 2u, 3u, 0u}) {
+            ret += compare_results(
+                run_model_in_tiles(tile_size, threads, false, "cell"),
+                expected,
+                "cell_streams (tile size " + std::to_string(tile_size) + ", "
+                    + std::to_string(threads) + " threads)");
+        }
+    }
+    ret += compare_results(
+        run_model_in_tiles(3, 3, true, "cell"), expected, "cell_streams (tracking)");
+    return ret;
+}
+
+/**
+ * Test that counts of outside dispersers match the list
+ */
+int test_outside_counts_in_tiles()
+{
+    int ret = 0;
+    auto expected = run_model_in_tiles(4, 1, false, "cell");
+    std::map<OutsideDispersers::Cell, OutsideDispersers::Count> expected_counts;
+    for (const auto& item : expected.outside_dispersers)
+        expected_counts[{std::get<0>(item), std::get<1>(item)}] += 1;
+    for (unsigned threads : {1u, 3u}) {
+        OutsideDispersers outside;
+        auto actual = run_model_in_tiles(4, threads, false, "cell", &outside);
+        if (actual.infected != expected.infected
+            || outside.cell_counts() != expected_counts
+            || !actual.outside_dispersers.empty()) {
+            cout << "outside_counts_in_tiles (" << threads << " threads): Counts ("
+                 << outside.total() << ") differ from the list ("
+                 << expected.outside_dispersers.size() << ")\n";
+            ++ret;
+        }
+    }
+    return ret;
+}
+
+/**
+ * Run spread in tiles with the counter-based generator provider
+ */
+Raster<int> run_spread_with_counter_based_generator(
+    int tile_size, unsigned threads, bool reverse_cells, unsigned replicate = 0)
+{
+    int size = 10;
+    Raster<int> infected(size, size, 0);
+    infected(2, 3) = 12;
+    infected(7, 7) = 4;
+    Raster<int> susceptible(size, size, 30);
+    Raster<int> total_hosts = susceptible + infected;
+    Raster<int> dispersers(size, size, 0);
+    Raster<int> established_dispersers(size, size, 0);
+    Raster<int> zeros(size, size, 0);
+    std::vector<std::tuple<int, int>> outside_dispersers;
+    std::vector<std::vector<int>> suitable_cells;
+    for (int row = 0; row < size; ++row)
+        for (int col = 0; col < size; ++col)
+            suitable_cells.push_back({row, col});
+    if (reverse_cells)
+        std::reverse(suitable_cells.begin(), suitable_cells.end());
+
+    Config config;
+    config.reproductive_rate = 2;
+    config.natural_kernel_type = "cauchy";
+    config.natural_direction = "none";
+    config.natural_scale = 15;
+    config.anthro_kernel_type = "exponential";
+    config.anthro_direction = "none";
+    config.anthro_scale = 30;
+    config.use_anthropogenic_kernel = true;
+    config.percent_natural_dispersal = 0.8;
+    config.rows = size;
+    config.cols = size;
+    config.ew_res = 10;
+    config.ns_res = 10;
+    config.model_type = "SI";
+
+    using Provider = CounterBasedGeneratorProvider;
+    using Hosts = HostPool<Raster<int>, Raster<double>, int, Provider>;
+    using Pests = PestPool<Raster<int>, Raster<double>, int>;
+    using Kernel = DispersalKernel<Provider::Generator>;
+    Environment<Raster<int>, Raster<double>, int, Provider> environment;
+    environment.set_total_population(&total_hosts);
+    std::vector<Raster<int>> exposed;
+    std::vector<Raster<int>> mortality_tracker;
+    Hosts host_pool(
+        config,
+        susceptible,
+        exposed,
+        infected,
+        zeros,
+        zeros,
+        mortality_tracker,
+        zeros,
+        total_hosts,
+        environment,
+        suitable_cells);
+    Pests pests(dispersers, established_dispersers, outside_dispersers);
+    DecomposedSpreadAction<
+        Hosts,
+        Pests,
+        Raster<int>,
+        Raster<double>,
+        int,
+        Kernel,
+        Provider>
+        spread(
+            [&config, &dispersers]() {
+                return create_dynamic_kernel<Provider::Generator, Raster<int>, int>(
+                    config, dispersers, Network<int>::null_network());
+            },
+            size,
+            size,
+            tile_size,
+            42,
+            true,
+            threads,
+            RandomStreams::Cell,
+            replicate);
+    for (unsigned step = 0; step < 4; ++step)
+        spread.action(host_pool, pests, step);
+    return infected;
+}
+
+int test_counter_based_generator_in_tiles()
+{
+    int ret = 0;
+    auto expected = run_spread_with_counter_based_generator(4, 1, false);
+    for (int tile_size : {1, 3, 100}) {
+        for (unsigned threads : {1u, 3u}) {
+            for (bool reverse : {false, true}) {
+                auto actual = run_spread_with_counter_based_generator(
+                    tile_size, threads, reverse);
+                if (actual != expected) {
+                    cout << "counter_based_generator_in_tiles: Results differ for tile "
+                         << "size " << tile_size << ", " << threads << " threads"
+                         << (reverse ? ", reversed cells" : "")
+                         << " (actual, expected):\n"
+                         << actual << "  !=\n"
+                         << expected << "\n";
+                    ++ret;
+                }
+            }
+        }
+    }
+    return ret;
+}
+
+/**
+ * Test that replicates with the same seed use different random number streams
+ */
+int test_replicate_streams()
+{
+    int ret = 0;
+    auto first = run_model_in_tiles(4, 1, false, "cell");
+    auto second = run_model_in_tiles(4, 1, false, "cell", nullptr, 1);
+    if (second.infected == first.infected) {
+        cout << "replicate_streams: Replicates 0 and 1 of the model are the same\n";
+        ++ret;
+    }
+    ret += compare_results(
+        run_model_in_tiles(3, 2, false, "cell", nullptr, 1),
+        second,
+        "replicate_streams (replicate 1, tile size 3, 2 threads)");
+    auto expected = run_spread_with_counter_based_generator(4, 1, false, 1);
+    if (expected == run_spread_with_counter_based_generator(4, 1, false, 0)) {
+        cout << "replicate_streams: Replicates 0 and 1 with counter-based generator "
+             << "are the same\n";
+        ++ret;
+    }
+    auto actual = run_spread_with_counter_based_generator(3, 3, true, 1);
+    if (actual != expected) {
+        cout << "replicate_streams: Replicate 1 with counter-based generator differs "
+             << "for tile size 3 and 3 threads (actual, expected):\n"
+             << actual << "  !=\n"
+             << expected << "\n";
+        ++ret;
+    }
+    return ret;
+}
+
+int main()
+{
+    int ret = 0;
+
+    ret += test_decomposition();
+    ret += test_parallel_for_each_index();
+    ret += test_tile_streams_independent_of_threads();
+    ret += test_cell_streams_independent_of_tiles_and_threads();
+    ret += test_outside_counts_in_tiles();
+    ret += test_counter_based_generator_in_tiles();
+    ret += test_replicate_streams();
+
+    std::cout << "Test spatial decomposition number of errors: " << ret << std::endl;
+    return ret;
+}
+
+#endif  // POPS_TEST
@@ -79,12 +79,36 @@ int test_area()
     return err;
 }
 
+int test_summary()
+{
+    int err = 0;
+    ValueSummary summary = summarize_values({2, 4, 4, 4, 5, 5, 7, 9});
+    if (summary.count != 8 || summary.mean != 5 || summary.min != 2
+        || summary.max != 9 || std::abs(summary.stddev - std::sqrt(32. / 7)) > 1e-12) {
+        std::cout << "summary fails: " << summary.count << " " << summary.mean << " "
+                  << summary.stddev << " " << summary.min << " " << summary.max
+                  << std::endl;
+        err++;
+    }
+    summary = summarize_values({3});
+    if (summary.count != 1 || summary.mean != 3 || summary.stddev != 0) {
+        std::cout << "summary of one value fails" << std::endl;
+        err++;
+    }
+    if (summarize_values({}).count != 0) {
+        std::cout << "summary of no values fails" << std::endl;
+        err++;
+    }
+    return err;
+}
+
 int main()
 {
     int num_errors = 0;
 
     num_errors += test_sum();
     num_errors += test_area();
+    num_errors += test_summary();
     std::cout << "Statistics number of errors: " << num_errors << std::endl;
     return num_errors;
 }
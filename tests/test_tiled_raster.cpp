@@ -0,0 +1,332 @@
+#ifdef POPS_TEST
+
+/*
+ * Tests for the PoPS TiledRaster class and cell ordering functions.
+ *
+ * Copyright (C) 2023 by the authors.
+ *
+ * Authors: Vaclav Petras <wenzeslaus gmail com>
+ *
+ * This file is part of PoPS.
+
+ * PoPS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+
+ * PoPS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PoPS. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+#include <pops/model.hpp>
+#include <pops/raster.hpp>
+#include <pops/tiled_raster.hpp>
+
+using namespace pops;
+using std::cout;
+
+int test_tiled_raster_values()
+{
+    int ret = 0;
+    int rows = 13;
+    int cols = 7;
+    Raster<int> raster(rows, cols);
+    for (int i = 0; i < rows; ++i)
+        for (int j = 0; j < cols; ++j)
+            raster(i, j) = i * 100 + j;
+    TiledRaster<int, int, 4> tiled(raster);
+    if (tiled.rows() != rows || tiled.cols() != cols) {
+        cout << "tiled_raster_values: Wrong size: " << tiled.rows() << "x"
+             << tiled.cols() << "\n";
+        return ++ret;
+    }
+    std::set<std::size_t> indices;
+    for (int i = 0; i < rows; ++i) {
+        for (int j = 0; j < cols; ++j) {
+            if (tiled(i, j) != raster(i, j)) {
+                cout << "tiled_raster_values: Wrong value at (" << i << ", " << j
+                     << "): " << tiled(i, j) << "\n";
+                ++ret;
+            }
+            indices.insert(tiled.index(i, j));
+        }
+    }
+    if (indices.size() != std::size_t(rows * cols)) {
+        cout << "tiled_raster_values: Cells share storage\n";
+        ++ret;
+    }
+    // Cells in one tile are next to each other.
+    if (tiled.index(1, 0) != tiled.index(0, 0) + 4 || tiled.index(0, 4) != 16) {
+        cout << "tiled_raster_values: Unexpected layout\n";
+        ++ret;
+    }
+    if (tiled.to_raster() != raster) {
+        cout << "tiled_raster_values: Conversion back does not work:\n"
+             << tiled.to_raster() << raster;
+        ++ret;
+    }
+    return ret;
+}
+
+int test_tiled_raster_operators()
+{
+    int ret = 0;
+    using Tiled = TiledRaster<int, int, 2>;
+    Tiled a = {{1, 2, 3}, {4, 5, 6}, {7, 8, 9}};
+    Tiled b = {{1, 1, 1}, {2, 2, 2}, {3, 3, 3}};
+    Tiled expected = {{3, 5, 7}, {10, 12, 14}, {17, 19, 21}};
+    Tiled result = 2 * a + b;
+    if (result != expected) {
+        cout << "tiled_raster_operators: Result is\n"
+             << result << "instead of\n"
+             << expected;
+        ++ret;
+    }
+    result -= b * 3;
+    result /= b;
+    result *= 0.5;  // rounded down to 0 as for Raster
+    if (result != Tiled(3, 3, 0)) {
+        cout << "tiled_raster_operators: In-place operators do not work:\n" << result;
+        ++ret;
+    }
+    Tiled expected_difference = {{9, 8, 7}, {6, 5, 4}, {3, 2, 1}};
+    if (10 - a != expected_difference) {
+        cout << "tiled_raster_operators: Scalar minus raster is\n"
+             << 10 - a << "instead of\n"
+             << expected_difference;
+        ++ret;
+    }
+    Tiled expected_quotient = {{6, 6, 6}, {3, 3, 3}, {2, 2, 2}};
+    if (6.5 / b != expected_quotient) {
+        cout << "tiled_raster_operators: Scalar divided by raster is\n"
+             << 6.5 / b << "instead of\n"
+             << expected_quotient;
+        ++ret;
+    }
+    using TiledDouble = TiledRaster<double, int, 2>;
+    TiledDouble d = {{1, 2}, {4, 8}};
+    TiledDouble expected_fraction = {{0, 0.5}, {0.75, 0.875}};
+    if (1 - 1 / d != expected_fraction) {
+        cout << "tiled_raster_operators: One minus one over raster is\n"
+             << 1 - 1 / d << "instead of\n"
+             << expected_fraction;
+        ++ret;
+    }
+    Tiled c(3, 2, 0);
+    try {
+        c += a;
+        cout << "tiled_raster_operators: Different sizes did not throw\n";
+        ++ret;
+    }
+    catch (const std::invalid_argument&) {
+    }
+    return ret;
+}
+
+int test_cell_order()
+{
+    int ret = 0;
+    std::vector<std::vector<int>> cells;
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 4; ++j)
+            cells.push_back({i, j});
+    auto morton = cells;
+    sort_cells_in_morton_order(morton);
+    std::vector<std::vector<int>> expected_morton = {
+        {0, 0},
+        {0, 1},
+        {1, 0},
+        {1, 1},
+        {0, 2},
+        {0, 3},
+        {1, 2},
+        {1, 3},
+        {2, 0},
+        {2, 1},
+        {3, 0},
+        {3, 1},
+        {2, 2},
+        {2, 3},
+        {3, 2},
+        {3, 3}};
+    if (morton != expected_morton) {
+        cout << "cell_order: Wrong Morton order\n";
+        ++ret;
+    }
+    auto tiles = cells;
+    sort_cells_in_tile_order(tiles, 2);
+    // For 2x2 tiles of a 4x4 raster, the orders are the same.
+    if (tiles != expected_morton) {
+        cout << "cell_order: Wrong tile order\n";
+        ++ret;
+    }
+    TiledRaster<int, int, 2> tiled(4, 4);
+    for (std::size_t i = 0; i < tiles.size(); ++i) {
+        if (tiled.index(tiles[i][0], tiles[i][1]) != i) {
+            cout << "cell_order: Tile order is not the storage order\n";
+            ++ret;
+        }
+    }
+    return ret;
+}
+
+/**
+ * Run SEI model with mortality, weather, and treatments with given raster types
+ */
+template<typename IntegerRaster, typename FloatRaster>
+Raster<int> run_model_with_raster_types()
+{
+    int size = 9;
+    IntegerRaster infected(size, size, 0);
+    infected(4, 4) = 15;
+    infected(1, 7) = 5;
+    IntegerRaster susceptible(size, size, 40);
+    IntegerRaster total_hosts = susceptible + infected;
+    IntegerRaster total_populations = total_hosts;
+    IntegerRaster zeros(size, size, 0);
+    IntegerRaster dispersers(size, size);
+    IntegerRaster established_dispersers(size, size);
+    std::vector<std::tuple<int, int>> outside_dispersers;
+    std::vector<std::vector<int>> suitable_cells;
+    for (int row = 0; row < size; ++row)
+        for (int col = 0; col < size; ++col)
+            suitable_cells.push_back({row, col});
+    FloatRaster weather(size, size, 0.8);
+    weather(0, 0) = 0.1;
+
+    Config config;
+    config.random_seed = 42;
+    config.reproductive_rate = 1.5;
+    config.natural_kernel_type = "cauchy";
+    config.natural_direction = "none";
+    config.natural_scale = 10;
+    config.anthro_scale = 10;
+    config.use_anthropogenic_kernel = false;
+    config.weather = true;
+    config.rows = size;
+    config.cols = size;
+    config.ew_res = 10;
+    config.ns_res = 10;
+    config.model_type = "SEI";
+    config.latency_period_steps = 1;
+    config.set_date_start(2020, 1, 1);
+    config.set_date_end(2020, 12, 31);
+    config.set_step_unit(StepUnit::Month);
+    config.set_step_num_units(1);
+    config.use_mortality = true;
+    config.mortality_frequency = "month";
+    config.mortality_frequency_n = 3;
+    config.use_treatments = true;
+    config.use_spreadrates = true;
+    config.create_schedules();
+
+    using TestModel = Model<IntegerRaster, FloatRaster, int>;
+    TestModel model{config};
+
+    std::vector<IntegerRaster> mortality_tracker(3, IntegerRaster(size, size, 0));
+    IntegerRaster died(size, size, 0);
+    IntegerRaster total_exposed(size, size, 0);
+    IntegerRaster resistant(size, size, 0);
+    std::vector<IntegerRaster> exposed(
+        config.latency_period_steps + 1, IntegerRaster(size, size, 0));
+    std::vector<FloatRaster> weather_coefficients(
+        config.scheduler().get_num_steps(), weather);
+    std::vector<FloatRaster> empty_floats;
+    std::vector<std::vector<int>> movements;
+
+    typename TestModel::StandardSingleHostPool host_pool(
+        config,
+        susceptible,
+        exposed,
+        infected,
+        total_exposed,
+        resistant,
+        mortality_tracker,
+        died,
+        total_hosts,
+        model.environment(),
+        suitable_cells);
+    std::vector<typename TestModel::StandardSingleHostPool*> host_pools = {
+        &host_pool};
+    typename TestModel::StandardMultiHostPool multi_host_pool(host_pools, config);
+    PestHostTable<typename TestModel::StandardSingleHostPool> pest_host_table(
+        model.environment());
+    pest_host_table.add_host_info(1, 0.5, 1);
+    multi_host_pool.set_pest_host_table(pest_host_table);
+    typename TestModel::StandardPestPool pest_pool{
+        dispersers, established_dispersers, outside_dispersers};
+    SpreadRateAction<typename TestModel::StandardMultiHostPool, int> spread_rate(
+        multi_host_pool, size, size, config.ew_res, config.ns_res, 0);
+    IntegerRaster quarantine_areas(size, size, 0);
+    quarantine_areas(4, 4) = 1;
+    QuarantineEscapeAction<IntegerRaster> quarantine(
+        quarantine_areas, config.ew_res, config.ns_res, 0);
+    Treatments<typename TestModel::StandardSingleHostPool, FloatRaster> treatments(
+        config.scheduler());
+    FloatRaster treatment(size, size, 0);
+    treatment(4, 5) = 1;
+    treatments.add_treatment(
+        treatment, Date(2020, 5, 1), 0, TreatmentApplication::AllInfectedInCell);
+
+    for (unsigned step = 0; step < config.scheduler().get_num_steps(); ++step) {
+        model.run_step(
+            step,
+            multi_host_pool,
+            pest_pool,
+            total_populations,
+            treatments,
+            weather_coefficients,
+            empty_floats,
+            spread_rate,
+            quarantine,
+            quarantine_areas,
+            movements,
+            Network<int>::null_network());
+    }
+    Raster<int> result(size, size);
+    for (int row = 0; row < size; ++row)
+        for (int col = 0; col < size; ++col)
+            result(row, col) = infected(row, col) + died(row, col);
+    return result;
+}
+
+int test_model_with_tiled_rasters()
+{
+    int ret = 0;
+    auto expected = run_model_with_raster_types<Raster<int>, Raster<double>>();
+    auto tiled = run_model_with_raster_types<
+        TiledRaster<int, int, 4>,
+        TiledRaster<double, int, 4>>();
+    if (tiled != expected) {
+        cout << "model_with_tiled_rasters: Results differ (actual, expected):\n"
+             << tiled << "  !=\n"
+             << expected << "\n";
+        ++ret;
+    }
+    return ret;
+}
+
+int main()
+{
+    int ret = 0;
+
+    ret += test_tiled_raster_values();
+    ret += test_tiled_raster_operators();
+    ret += test_cell_order();
+    ret += test_model_with_tiled_rasters();
+
+    std::cout << "Test tiled raster number of errors: " << ret << std::endl;
+    return ret;
+}
+
+#endif  // POPS_TEST
@@ -0,0 +1,333 @@
+#ifdef POPS_TEST
+
+/*
+ * Tests for evaluation of alternative treatment plans.
+ *
+ * Copyright (C) 2023 by the authors.
+ *
+ * Authors: Vaclav Petras <wenzeslaus gmail com>
+ *
+ * This file is part of PoPS.
+
+ * PoPS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+
+ * PoPS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PoPS. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include <pops/raster.hpp>
+#include <pops/treatment_scenarios.hpp>
+
+using namespace pops;
+
+using TestScenarios =
+    TreatmentScenarios<Raster<int>, Raster<double>, Raster<double>::IndexType>;
+using TestTreatments = TestScenarios::ScenarioTreatments;
+
+Config create_config(int size)
+{
+    Config config;
+    config.reproductive_rate = 0.5;
+    config.natural_kernel_type = "cauchy";
+    config.natural_direction = "none";
+    config.natural_scale = 0.9;
+    config.anthro_scale = 0.9;
+    config.use_anthropogenic_kernel = false;
+    config.read_seeds({1, 2, 3, 4, 5, 6, 7, 8, 9, 10});
+    config.rows = size;
+    config.cols = size;
+    config.ew_res = 10;
+    config.ns_res = 10;
+    config.model_type = "SI";
+    config.set_date_start(2020, 1, 1);
+    config.set_date_end(2020, 12, 31);
+    config.set_step_unit(StepUnit::Month);
+    config.set_step_num_units(1);
+    config.use_lethal_temperature = false;
+    config.use_survival_rate = false;
+    config.use_mortality = false;
+    config.use_treatments = true;
+    config.use_spreadrates = false;
+    config.use_quarantine = false;
+    // Streams for each cell keep random numbers aligned across plans.
+    config.spread_tile_size = 3;
+    config.spread_threads = 1;
+    config.spread_random_streams = "cell";
+    config.create_schedules();
+    return config;
+}
+
+SimulationState<Raster<int>> create_state(int size)
+{
+    SimulationState<Raster<int>> state;
+    state.infected = Raster<int>(size, size, 0);
+    state.infected(4, 4) = 20;
+    state.infected(3, 5) = 7;
+    state.susceptible = Raster<int>(size, size, 100);
+    state.total_hosts = state.susceptible + state.infected;
+    state.total_populations = state.total_hosts;
+    state.total_exposed = Raster<int>(size, size, 0);
+    state.resistant = Raster<int>(size, size, 0);
+    for (int row = 0; row < size; ++row)
+        for (int col = 0; col < size; ++col)
+            state.suitable_cells.push_back({row, col});
+    return state;
+}
+
+/**
+ * Run the model directly from the state to compare with the evaluation
+ */
+double run_model(
+    const Config& config, SimulationState<Raster<int>> state, unsigned first_step)
+{
+    using TestModel = TestScenarios::SimulationModel;
+    TestModel model(config);
+    Raster<int> died(config.rows, config.cols, 0);
+    Raster<int> dispersers(config.rows, config.cols, 0);
+    Raster<int> established_dispersers(config.rows, config.cols, 0);
+    Raster<int> zeros(config.rows, config.cols, 0);
+    std::vector<std::tuple<int, int>> outside_dispersers;
+    std::vector<Raster<double>> no_rasters;
+    QuarantineEscapeAction<Raster<int>> quarantine(
+        zeros, config.ew_res, config.ns_res, 0);
+    for (unsigned step = first_step; step < config.scheduler().get_num_steps();
+         ++step) {
+        model.run_step(
+            step,
+            state.infected,
+            state.susceptible,
+            state.total_populations,
+            state.total_hosts,
+            dispersers,
+            established_dispersers,
+            state.total_exposed,
+            state.exposed,
+            state.mortality_tracker,
+            died,
+            no_rasters,
+            no_rasters,
+            state.resistant,
+            outside_dispersers,
+            quarantine,
+            zeros,
+            {},
+            Network<int>::null_network(),
+            state.suitable_cells);
+    }
+    return sum_of_infected(state.infected, state.suitable_cells);
+}
+
+int test_treatment_scenarios()
+{
+    int ret = 0;
+    int size = 9;
+    Config config = create_config(size);
+    auto state = create_state(size);
+    unsigned first_step = 3;
+    unsigned replicates = 6;
+
+    TestScenarios scenarios(config, state, first_step);
+
+    // Reference plan without treatments and the same plan once more
+    TestTreatments no_treatment(config.scheduler());
+    TestTreatments no_treatment_again(config.scheduler());
+    // Removal of all infected hosts in the first simulated step
+    TestTreatments all_removed(config.scheduler());
+    all_removed.add_treatment(
+        Raster<double>(size, size, 1),
+        config.scheduler().get_step(first_step).start_date(),
+        0,
+        TreatmentApplication::AllInfectedInCell);
+    // Removal of a part of the hosts in a part of the area
+    TestTreatments partly_removed(config.scheduler());
+    Raster<double> map(size, size, 0);
+    for (int row = 3; row < 5; ++row)
+        for (int col = 3; col < 6; ++col)
+            map(row, col) = 0.3;
+    partly_removed.add_treatment(map, Date(2020, 6, 1), 0, TreatmentApplication::Ratio);
+
+    std::vector<const TestTreatments*> plans = {
+        &no_treatment, &no_treatment_again, &all_removed, &partly_removed};
+    auto summaries = scenarios.evaluate(plans, replicates, 3);
+    if (summaries.size() != plans.size()) {
+        std::cout << "treatment_scenarios: Wrong number of summaries ("
+                  << summaries.size() << ")\n";
+        return ++ret;
+    }
+    const auto& reference = summaries[0];
+    if (reference.infected.count != replicates || reference.infected.mean <= 27
+        || reference.infected.stddev <= 0) {
+        std::cout << "treatment_scenarios: Unexpected reference: "
+                  << reference.infected.count << " replicates, mean "
+                  << reference.infected.mean << ", stddev "
+                  << reference.infected.stddev << "\n";
+        ++ret;
+    }
+    // Common random numbers make the same plan give the same result.
+    const auto& same = summaries[1];
+    if (same.infected_by_replicate != reference.infected_by_replicate
+        || same.infected_difference.max != 0 || same.infected_difference.min != 0
+        || same.area_difference.stddev != 0) {
+        std::cout << "treatment_scenarios: Same plan gives different results\n";
+        ++ret;
+    }
+    if (summaries[2].infected.max != 0 || summaries[2].infected_area.max != 0
+        || summaries[2].infected_difference.mean != -reference.infected.mean) {
+        std::cout << "treatment_scenarios: Removal of all infected gives "
+                  << summaries[2].infected.mean << " infected\n";
+        ++ret;
+    }
+    if (!(summaries[3].infected.mean < reference.infected.mean)) {
+        std::cout << "treatment_scenarios: Partial removal gives "
+                  << summaries[3].infected.mean << " infected (no treatment "
+                  << reference.infected.mean << ")\n";
+        ++ret;
+    }
+    // Replicates of different plans differ only by treatments, so differences
+    // between plans vary less than differences of independent results.
+    double independent_stddev = std::sqrt(
+        std::pow(reference.infected.stddev, 2)
+        + std::pow(summaries[3].infected.stddev, 2));
+    if (!(summaries[3].infected_difference.stddev < independent_stddev)) {
+        std::cout << "treatment_scenarios: Differences vary as for independent runs ("
+                  << summaries[3].infected_difference.stddev
+                  << " >= " << independent_stddev << ")\n";
+        ++ret;
+    }
+    // Number of threads does not change the result.
+    auto serial = scenarios.evaluate(plans, replicates, 1);
+    for (size_t i = 0; i < plans.size(); ++i) {
+        if (serial[i].infected_by_replicate != summaries[i].infected_by_replicate
+            || serial[i].area_by_replicate != summaries[i].area_by_replicate) {
+            std::cout << "treatment_scenarios: Results differ with one thread for plan "
+                      << i << "\n";
+            ++ret;
+        }
+    }
+    // Replicate is the same as a model run with the replicate configuration.
+    for (unsigned replicate : {0u, replicates - 1}) {
+        double infected =
+            run_model(scenarios.replicate_config(replicate), state, first_step);
+        if (infected != reference.infected_by_replicate[replicate]) {
+            std::cout << "treatment_scenarios: Replicate " << replicate << " has "
+                      << reference.infected_by_replicate[replicate]
+                      << " infected, but model gives " << infected << "\n";
+            ++ret;
+        }
+    }
+    // Runs are parallel, so spread in runs uses one thread.
+    Config all_threads = config;
+    all_threads.spread_threads = 0;
+    TestScenarios all_threads_scenarios(all_threads, state, first_step);
+    if (all_threads_scenarios.replicate_config(0).spread_threads != 1) {
+        std::cout << "treatment_scenarios: Spread in runs uses "
+                  << all_threads_scenarios.replicate_config(0).spread_threads
+                  << " threads\n";
+        ++ret;
+    }
+    return ret;
+}
+
+int test_unsupported_scenarios()
+{
+    int ret = 0;
+    int size = 5;
+    Config config = create_config(size);
+    auto state = create_state(size);
+    try {
+        TestScenarios scenarios(config, state, config.scheduler().get_num_steps());
+        std::cout << "treatment_scenarios: No exception for step outside\n";
+        ++ret;
+    }
+    catch (const std::invalid_argument&) {
+    }
+    config.use_movements = true;
+    try {
+        TestScenarios scenarios(config, state, 0);
+        std::cout << "treatment_scenarios: No exception for movements\n";
+        ++ret;
+    }
+    catch (const std::invalid_argument&) {
+    }
+    config.use_movements = false;
+    config.weather = true;
+    config.weather_type = "deterministic";
+    TestScenarios scenarios(config, state, 0);
+    TestTreatments no_treatment(config.scheduler());
+    try {
+        scenarios.evaluate({&no_treatment}, 1);
+        std::cout << "treatment_scenarios: No exception for missing weather\n";
+        ++ret;
+    }
+    catch (const std::invalid_argument&) {
+    }
+    return ret;
+}
+
+int test_scenarios_missing_rasters()
+{
+    int ret = 0;
+    int size = 5;
+    auto state = create_state(size);
+    Config config = create_config(size);
+    config.use_lethal_temperature = true;
+    config.lethal_temperature_month = 1;
+    config.create_schedules();
+    TestScenarios lethal_scenarios(config, state, 0);
+    TestTreatments no_treatment(config.scheduler());
+    try {
+        lethal_scenarios.evaluate({&no_treatment}, 1);
+        std::cout << "treatment_scenarios: No exception for missing temperatures\n";
+        ++ret;
+    }
+    catch (const std::invalid_argument&) {
+    }
+    // Only one year is simulated, so one raster is enough.
+    std::vector<Raster<double>> temperatures(1, Raster<double>(size, size, 20));
+    lethal_scenarios.set_temperatures(temperatures);
+    lethal_scenarios.evaluate({&no_treatment}, 1);
+
+    config = create_config(size);
+    config.use_survival_rate = true;
+    config.survival_rate_month = 1;
+    config.survival_rate_day = 1;
+    config.create_schedules();
+    TestScenarios survival_scenarios(config, state, 0);
+    try {
+        survival_scenarios.evaluate({&no_treatment}, 1);
+        std::cout << "treatment_scenarios: No exception for missing survival rates\n";
+        ++ret;
+    }
+    catch (const std::invalid_argument&) {
+    }
+    std::vector<Raster<double>> survival_rates(1, Raster<double>(size, size, 1));
+    survival_scenarios.set_survival_rates(survival_rates);
+    survival_scenarios.evaluate({&no_treatment}, 1);
+    return ret;
+}
+
+int main()
+{
+    int ret = 0;
+
+    ret += test_treatment_scenarios();
+    ret += test_unsupported_scenarios();
+    ret += test_scenarios_missing_rasters();
+
+    std::cout << "Test treatment scenarios number of errors: " << ret << std::endl;
+    return ret;
+}
+
+#endif  // POPS_TEST
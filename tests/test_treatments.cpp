@@ -24,6 +24,7 @@
  * along with PoPS. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <memory>
 #include <vector>
 #include <pops/raster.hpp>
 #include <pops/treatments.hpp>
@@ -783,6 +784,159 @@ int test_clear()
     return num_errors;
 }
 
+/**
+ * @brief Test that sparse treatments give the same result as checking all treatments
+ *
+ * Many small treatments are applied with manage() which visits only the treatments
+ * scheduled for a step and, as a reference, by checking all treatments in each step.
+ */
+int test_many_small_treatments()
+{
+    int num_errors = 0;
+    Scheduler scheduler(Date(2020, 1, 1), Date(2022, 12, 31), StepUnit::Week, 1);
+
+    TestEnvironment environment;
+    int rows = 12;
+    int cols = 15;
+    Raster<int> susceptible(rows, cols);
+    Raster<int> infected(rows, cols);
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            susceptible(i, j) = 10 + (3 * i + 7 * j) % 31;
+            infected(i, j) = (5 * i + j) % 9;
+        }
+    }
+    Raster<int> resistant(rows, cols, 0);
+    Raster<int> zeros(rows, cols, 0);
+    auto total_hosts = infected + susceptible + resistant;
+    std::vector<Raster<int>> exposed;
+    std::vector<Raster<int>> mortality_tracker(1, infected);
+    std::vector<std::vector<int>> suitable_cells;
+    for (int i = 0; i < rows; i++)
+        for (int j = 0; j < cols; j++)
+            suitable_cells.push_back({i, j});
+    // Copies for the reference management
+    Raster<int> susceptible2 = susceptible;
+    Raster<int> infected2 = infected;
+    Raster<int> resistant2 = resistant;
+    Raster<int> total_hosts2 = total_hosts;
+    std::vector<Raster<int>> mortality_tracker2 = mortality_tracker;
+
+    StandardSingleHostPool host_pool(
+        ModelType::SusceptibleInfected,
+        true,
+        susceptible,
+        exposed,
+        0,
+        infected,
+        zeros,
+        resistant,
+        mortality_tracker,
+        zeros,
+        total_hosts,
+        environment,
+        false,
+        0,
+        false,
+        0,
+        rows,
+        cols,
+        suitable_cells);
+    StandardSingleHostPool host_pool2(
+        ModelType::SusceptibleInfected,
+        true,
+        susceptible2,
+        exposed,
+        0,
+        infected2,
+        zeros,
+        resistant2,
+        mortality_tracker2,
+        zeros,
+        total_hosts2,
+        environment,
+        false,
+        0,
+        false,
+        0,
+        rows,
+        cols,
+        suitable_cells);
+
+    using Treatment = AbstractTreatment<StandardSingleHostPool, Raster<double>>;
+    Treatments<StandardSingleHostPool, Raster<double>> treatments(scheduler);
+    std::vector<std::unique_ptr<Treatment>> reference;
+    Date date(2020, 1, 6);
+    for (int k = 0; k < 200; k++) {
+        // Treatment of a 2x2 square with a different efficiency each time
+        Raster<double> map(rows, cols, 0);
+        int row = (7 * k) % (rows - 1);
+        int col = (11 * k) % (cols - 1);
+        map(row, col) = map(row + 1, col) = 0.5 + 0.1 * (k % 5);
+        map(row, col + 1) = map(row + 1, col + 1) = 1;
+        SimpleTreatment<StandardSingleHostPool, Raster<double>> simple(
+            map, 0, TreatmentApplication::Ratio);
+        if (simple.treated_cells().size() != 4) {
+            std::cerr << "Wrong number of treated cells: "
+                      << simple.treated_cells().size() << "\n";
+            num_errors++;
+        }
+        // Every third treatment is a pesticide, some end in the same step.
+        int num_days = k % 3 ? 0 : 1 + (k % 4) * 10;
+        auto application = k % 2 ? TreatmentApplication::Ratio
+                                  : TreatmentApplication::AllInfectedInCell;
+        treatments.add_treatment(map, date, num_days, application);
+        unsigned start = scheduler.schedule_action_date(date);
+        if (num_days == 0) {
+            reference.emplace_back(
+                new SimpleTreatment<StandardSingleHostPool, Raster<double>>(
+                    map, start, application));
+        }
+        else {
+            Date end_date(date);
+            end_date.add_days(num_days);
+            reference.emplace_back(
+                new PesticideTreatment<StandardSingleHostPool, Raster<double>>(
+                    map, start, scheduler.schedule_action_date(end_date), application));
+        }
+        date.add_days(k % 4 ? 0 : 5);
+    }
+    unsigned num_active = 0;
+    for (unsigned step = 0; step < scheduler.get_num_steps(); step++) {
+        bool changed = treatments.manage(step, host_pool);
+        bool expected_changed = false;
+        for (auto& treatment : reference) {
+            if (treatment->should_start(step)) {
+                treatment->apply_treatment(host_pool2);
+                expected_changed = true;
+            }
+            else if (treatment->should_end(step)) {
+                treatment->end_treatment(host_pool2);
+                expected_changed = true;
+            }
+        }
+        if (changed != expected_changed) {
+            std::cerr << "Sparse management reported wrong change at " << step << "\n";
+            num_errors++;
+        }
+        if (changed)
+            num_active++;
+    }
+    if (num_active == 0 || num_active == scheduler.get_num_steps()) {
+        std::cerr << "Treatments should be active only in some steps: " << num_active
+                  << "\n";
+        num_errors++;
+    }
+    if (!(susceptible == susceptible2 && infected == infected2
+          && resistant == resistant2 && total_hosts == total_hosts2)) {
+        std::cerr << "Sparse treatments differ from checking all treatments\n";
+        std::cerr << susceptible - susceptible2 << infected - infected2
+                  << resistant - resistant2 << total_hosts - total_hosts2;
+        num_errors++;
+    }
+    return num_errors;
+}
+
 int test_treat_app_from_string()
 {
     int num_errors = 0;
@@ -817,6 +971,7 @@ int main()
     num_errors += test_pesticide_temporal_overlap();
     num_errors += test_steering();
     num_errors += test_clear();
+    num_errors += test_many_small_treatments();
     num_errors += test_treat_app_from_string();
 
     (num_errors ? std::cerr : std::cout)
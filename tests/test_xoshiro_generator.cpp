@@ -0,0 +1,165 @@
+#ifdef POPS_TEST
+
+/*
+ * Tests for the PoPS xoshiro random number generator.
+ *
+ * Copyright (C) 2023 by the authors.
+ *
+ * Authors: Vaclav Petras <wenzeslaus gmail com>
+ *
+ * This file is part of PoPS.
+
+ * PoPS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+
+ * PoPS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PoPS. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <pops/generator_provider.hpp>
+#include <pops/kernel.hpp>
+#include <pops/raster.hpp>
+#include <pops/xoshiro_generator.hpp>
+
+using namespace pops;
+using std::cout;
+
+/**
+ * Compare with known answers of the reference implementation
+ */
+int test_xoshiro_known_answers()
+{
+    int ret = 0;
+    Xoshiro256PlusPlus generator({1, 2, 3, 4});
+    std::vector<std::uint64_t> expected = {
+        41943041ull,
+        58720359ull,
+        3588806011781223ull,
+        3591011842654386ull,
+        9228616714210784205ull,
+        9973669472204895162ull,
+        14011001112246962877ull,
+        12406186145184390807ull,
+        15849039046786891736ull,
+        10450023813501588000ull};
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        auto value = generator();
+        if (value != expected[i]) {
+            cout << "xoshiro_known_answers: Value " << i << " is " << value
+                 << ", not " << expected[i] << "\n";
+            ++ret;
+        }
+    }
+    return ret;
+}
+
+/** Check mean and variance of distributions used by the model */
+template<typename Generator>
+int check_distributions(const char* name)
+{
+    int ret = 0;
+    Generator generator(42);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::poisson_distribution<int> poisson(3.5);
+    std::normal_distribution<double> normal(2, 1);
+    int count = 100000;
+    double uniform_sum = 0;
+    double poisson_sum = 0;
+    double normal_sum = 0;
+    for (int i = 0; i < count; ++i) {
+        uniform_sum += uniform(generator);
+        poisson_sum += poisson(generator);
+        normal_sum += normal(generator);
+    }
+    std::vector<std::pair<double, double>> means = {
+        {uniform_sum / count, 0.5},
+        {poisson_sum / count, 3.5},
+        {normal_sum / count, 2}};
+    for (const auto& mean : means) {
+        if (std::abs(mean.first - mean.second) > 0.02 * mean.second) {
+            cout << "distributions: Mean is " << mean.first << " for " << name
+                 << " (expected " << mean.second << ")\n";
+            ++ret;
+        }
+    }
+    return ret;
+}
+
+int test_distributions()
+{
+    int ret = 0;
+    ret += check_distributions<Xoshiro256PlusPlus>("Xoshiro256PlusPlus");
+    return ret;
+}
+
+/** Check the generator works in the provider and with a kernel */
+int test_provider_with_kernel()
+{
+    int ret = 0;
+    using Provider = RandomNumberGeneratorProvider<Xoshiro256PlusPlus>;
+    Config config;
+    config.natural_kernel_type = "cauchy";
+    config.natural_direction = "none";
+    config.natural_scale = 20;
+    config.anthro_kernel_type = "exponential";
+    config.anthro_direction = "none";
+    config.anthro_scale = 50;
+    config.use_anthropogenic_kernel = true;
+    config.percent_natural_dispersal = 0.8;
+    config.ew_res = 10;
+    config.ns_res = 10;
+    Raster<int> dispersers(5, 5, 0);
+    auto kernel = create_dynamic_kernel<Provider::Generator, Raster<int>, int>(
+        config, dispersers, Network<int>::null_network());
+    std::vector<std::tuple<int, int>> expected;
+    for (bool reseed : {false, true}) {
+        Provider generator(42, true);
+        if (reseed) {
+            generator.seed(1);
+            generator.natural_dispersal()();
+            generator.seed(42);
+        }
+        std::vector<std::tuple<int, int>> targets;
+        for (int i = 0; i < 500; ++i)
+            targets.push_back(kernel(generator, 2, 2));
+        if (!reseed) {
+            expected = targets;
+        }
+        else if (targets != expected) {
+            cout << "provider_with_kernel: Different targets after re-seeding\n";
+            ++ret;
+        }
+    }
+    Provider generator(42, true);
+    if (generator.natural_dispersal()() == generator.establishment()()) {
+        cout << "provider_with_kernel: Same values for different purposes\n";
+        ++ret;
+    }
+    return ret;
+}
+
+int main()
+{
+    int ret = 0;
+
+    ret += test_xoshiro_known_answers();
+    ret += test_distributions();
+    ret += test_provider_with_kernel();
+
+    std::cout << "Test xoshiro generator number of errors: " << ret << std::endl;
+    return ret;
+}
+
+#endif  // POPS_TEST